@@ -0,0 +1,169 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+
+#include "stdafx.h"
+#include "kmc_c_api.h"
+#include "kmc_file.h"
+#include <new>
+
+struct kmc_db
+{
+	CKMCFile file;
+};
+
+//----------------------------------------------------------------------------------
+uint32_t kmc_api_version(void)
+{
+	return KMC_C_API_VERSION;
+}
+//----------------------------------------------------------------------------------
+kmc_db *kmc_open(const char *file_name)
+{
+	if(!file_name)
+		return NULL;
+
+	kmc_db *db = new(std::nothrow) kmc_db;
+	if(!db)
+		return NULL;
+
+	try
+	{
+		if(db->file.OpenForRA(file_name))
+			return db;
+	}
+	catch(std::bad_alloc&)
+	{
+	}
+	delete db;
+	return NULL;
+}
+//----------------------------------------------------------------------------------
+void kmc_close(kmc_db *db)
+{
+	delete db;
+}
+//----------------------------------------------------------------------------------
+int kmc_info(const kmc_db *db, kmc_db_info *info)
+{
+	if(!db || !info)
+		return 0;
+
+	uint32 kmer_length, mode, counter_size, lut_prefix_length, signature_len, min_count, max_count;
+	uint64 total_kmers;
+	if(!const_cast<CKMCFile&>(db->file).Info(kmer_length, mode, counter_size, lut_prefix_length, signature_len, min_count, max_count, total_kmers))
+		return 0;
+
+	info->kmer_length = kmer_length;
+	info->mode = mode;
+	info->counter_size = counter_size;
+	info->lut_prefix_length = lut_prefix_length;
+	info->signature_len = signature_len;
+	info->min_count = min_count;
+	info->max_count = max_count;
+	info->total_kmers = total_kmers;
+	return 1;
+}
+//----------------------------------------------------------------------------------
+int kmc_set_min_count(kmc_db *db, uint32_t min_count)
+{
+	return db && db->file.SetMinCount(min_count);
+}
+//----------------------------------------------------------------------------------
+int kmc_set_max_count(kmc_db *db, uint32_t max_count)
+{
+	return db && db->file.SetMaxCount(max_count);
+}
+//----------------------------------------------------------------------------------
+size_t kmc_kmer_bytes(uint32_t kmer_length)
+{
+	return (kmer_length + 3) / 4;
+}
+//----------------------------------------------------------------------------------
+// Pack a kmer, or its reverse complement if it is smaller
+//----------------------------------------------------------------------------------
+int kmc_pack_kmer(const char *seq, uint32_t kmer_length, int canonical, uint8_t *kmer)
+{
+	uint32 kmer_bytes_no = (kmer_length + 3) / 4;
+	uint32 byte_alignment = kmer_bytes_no * 4 - kmer_length;
+
+	bool rev_compl = false;
+	if(canonical)
+	{
+		// The first position where the kmer and its reverse complement differ decides
+		for(uint32 i = 0; i < kmer_length; ++i)
+		{
+			char s = CKmerAPI::num_codes[(uchar)seq[i]];
+			char r = CKmerAPI::num_codes[(uchar)seq[kmer_length - 1 - i]];
+			if(s == -1 || r == -1)
+				return 0;
+			if(s != 3 - r)
+			{
+				rev_compl = 3 - r < s;
+				break;
+			}
+		}
+	}
+
+	memset(kmer, 0, kmer_bytes_no);
+	for(uint32 i = 0; i < kmer_length; ++i)
+	{
+		char s;
+		if(rev_compl)
+			s = 3 - CKmerAPI::num_codes[(uchar)seq[kmer_length - 1 - i]];
+		else
+			s = CKmerAPI::num_codes[(uchar)seq[i]];
+		if(s < 0 || s > 3)
+			return 0;
+
+		uint32 p = i + byte_alignment;
+		kmer[p >> 2] |= (uint8_t)(s << (6 - 2 * (p & 3)));
+	}
+	return 1;
+}
+//----------------------------------------------------------------------------------
+void kmc_unpack_kmer(const uint8_t *kmer, uint32_t kmer_length, char *seq)
+{
+	uint32 byte_alignment = (kmer_length + 3) / 4 * 4 - kmer_length;
+	for(uint32 i = 0; i < kmer_length; ++i)
+	{
+		uint32 p = i + byte_alignment;
+		seq[i] = CKmerAPI::char_codes[(kmer[p >> 2] >> (6 - 2 * (p & 3))) & 3];
+	}
+}
+//----------------------------------------------------------------------------------
+int kmc_lookup(const kmc_db *db, const uint8_t *kmer, float *count)
+{
+	float _count;
+	if(!db || !const_cast<CKMCFile&>(db->file).CheckPackedKmer(kmer, _count))
+		return 0;
+	if(count)
+		*count = _count;
+	return 1;
+}
+//----------------------------------------------------------------------------------
+uint64_t kmc_lookup_batch(const kmc_db *db, const uint8_t *kmers, uint64_t no_of_kmers, float *counts)
+{
+	if(!db)
+		return 0;
+	return const_cast<CKMCFile&>(db->file).CheckPackedKmers(kmers, no_of_kmers, counts);
+}
+//----------------------------------------------------------------------------------
+uint64_t kmc_list(const kmc_db *db, uint64_t *pos, uint64_t end, uint8_t *kmers, float *counts, uint64_t capacity)
+{
+	if(!db || !pos)
+		return 0;
+
+	uint64 _pos = *pos;
+	uint64 no_of_listed = const_cast<CKMCFile&>(db->file).ListPackedKmers(_pos, end, kmers, counts, capacity);
+	*pos = _pos;
+	return no_of_listed;
+}
+
+// ***** EOF
@@ -0,0 +1,108 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+
+#ifndef _KMC_C_API_H
+#define _KMC_C_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// C interface of kmc_api, built as the shared library libkmc_api (see the makefile), to be used
+// from C and from other language runtimes. Only plain C types cross the boundary.
+//
+// KMC_C_API_VERSION is increased whenever the interface changes. Compatible changes only add
+// functions; kmc_api_version() returns the version the library was built with.
+//
+// Kmers are passed in the packed form: kmc_kmer_bytes(kmer_length) bytes per kmer, 2 bits per
+// symbol (A=0, C=1, G=2, T=3), the first symbol in the most significant bits of the first byte,
+// left-padded with zero symbols to a multiple of 4 symbols. This is the layout of the records of
+// *.kmc_suf. Batches of kmers are stored one after another. All the buffers are supplied by the
+// caller; no function but kmc_open allocates memory.
+//
+// A database is read to RAM by kmc_open (as by CKMCFile::OpenForRA). The lookup and listing
+// functions only read it, so they can be called from many threads with the same handle.
+#define KMC_C_API_VERSION	1
+
+#ifdef WIN32
+	#ifdef KMC_C_API_EXPORTS
+		#define KMC_C_API	__declspec(dllexport)
+	#else
+		#define KMC_C_API	__declspec(dllimport)
+	#endif
+#else
+	#define KMC_C_API	__attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct kmc_db kmc_db;
+
+typedef struct kmc_db_info
+{
+	uint32_t kmer_length;
+	uint32_t mode;					// 0: counters, 1: Quake-compatible (float) counters
+	uint32_t counter_size;			// in bytes
+	uint32_t lut_prefix_length;
+	uint32_t signature_len;
+	uint32_t min_count;				// current thresholds of counters
+	uint32_t max_count;
+	uint64_t total_kmers;			// the number of records, including those outside [min_count, max_count]
+} kmc_db_info;
+
+// Return KMC_C_API_VERSION of the library
+KMC_C_API uint32_t kmc_api_version(void);
+
+// Open the database file_name (without extensions). Return NULL if it cannot be opened
+KMC_C_API kmc_db *kmc_open(const char *file_name);
+
+// Close the database and release its memory. NULL is ignored
+KMC_C_API void kmc_close(kmc_db *db);
+
+// Fill info with the parameters of the database. Return 0 if db is NULL
+KMC_C_API int kmc_info(const kmc_db *db, kmc_db_info *info);
+
+// Set the thresholds of counters; kmers with counters outside [min_count, max_count] are ignored
+// by the lookups and listings. Not to be called during lookups and listings. Return 0 on failure
+KMC_C_API int kmc_set_min_count(kmc_db *db, uint32_t min_count);
+KMC_C_API int kmc_set_max_count(kmc_db *db, uint32_t max_count);
+
+// Return the number of bytes of a packed kmer
+KMC_C_API size_t kmc_kmer_bytes(uint32_t kmer_length);
+
+// Pack kmer_length symbols of seq (ACGT, case insensitive) into kmer. If canonical, the smaller
+// of the kmer and its reverse complement is packed (as stored in the databases of both strands).
+// Return 0 if seq contains another symbol
+KMC_C_API int kmc_pack_kmer(const char *seq, uint32_t kmer_length, int canonical, uint8_t *kmer);
+
+// Unpack a kmer into kmer_length symbols of seq (no terminating zero is written)
+KMC_C_API void kmc_unpack_kmer(const uint8_t *kmer, uint32_t kmer_length, char *seq);
+
+// Look up a packed kmer. Return 1 and its counter in count if it exists, 0 otherwise
+KMC_C_API int kmc_lookup(const kmc_db *db, const uint8_t *kmer, float *count);
+
+// Look up no_of_kmers packed kmers. Store their counters in counts (0 if absent).
+// Return the number of existing kmers
+KMC_C_API uint64_t kmc_lookup_batch(const kmc_db *db, const uint8_t *kmers, uint64_t no_of_kmers, float *counts);
+
+// List the kmers of the records [*pos, end) of the database, at most capacity of them, into kmers
+// and counts. *pos is advanced past the listed records and the number of listed kmers is returned;
+// the range is done when *pos reaches end (or total_kmers). Splitting [0, total_kmers) into
+// ranges lets many threads list a database independently
+KMC_C_API uint64_t kmc_list(const kmc_db *db, uint64_t *pos, uint64_t end, uint8_t *kmers, float *counts, uint64_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// ***** EOF
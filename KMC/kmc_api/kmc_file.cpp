@@ -12,6 +12,7 @@
 #include "mmer.h"
 #include "kmc_file.h"
 #include <iostream>
+#include <algorithm>
 
 
 uint64 CKMCFile::part_size = 1 << 25;
@@ -107,6 +108,7 @@ CKMCFile::CKMCFile()
 
 	is_opened = closed;
 	end_of_file = false;
+	strand_resolved = false;
 };
 //----------------------------------------------------------------------------------	
 CKMCFile::~CKMCFile()
@@ -195,6 +197,32 @@ bool CKMCFile::ReadParamsFrom_prefix_file_buf(uint64 &size)
 	original_max_count = max_count;
 	result = fread(&total_kmers, 1, sizeof(uint64), file_pre);
 
+	// Spaced kmers: the span is stored in the first reserved word, the mask just after the reserved words
+	// Strand-resolved counters: the flag is stored in the second reserved word
+	kmer_span = 0;
+	kmer_mask.clear();
+	uint32 strand_flag = 0;
+	if(header_offset >= 40)
+		result = fread(&kmer_span, 1, sizeof(uint32), file_pre);
+	if(header_offset >= 44)
+		result = fread(&strand_flag, 1, sizeof(uint32), file_pre);
+	strand_resolved = strand_flag != 0;
+	if(kmer_span)
+	{
+		my_fseek(file_pre, 5 * sizeof(uint32), SEEK_CUR);
+		kmer_mask.assign(kmer_span, '0');
+		for(uint32 i = 0; i < kmer_span; i += 32)
+		{
+			uint32 word = 0;
+			result = fread(&word, 1, sizeof(uint32), file_pre);
+			for(uint32 j = i; j < kmer_span && j < i + 32; ++j)
+				if(word & (1u << (j - i)))
+					kmer_mask[j] = '1';
+		}
+	}
+	else
+		kmer_span = kmer_length;
+
 	signature_map_size = ((1 << (2 * signature_len)) + 1);
 	uint64 lut_area_size_in_bytes = size - (signature_map_size * sizeof(uint32) + header_offset + 8);
 	single_LUT_size = 1 << (2 * lut_prefix_length);
@@ -227,6 +255,38 @@ bool CKMCFile::ReadParamsFrom_prefix_file_buf(uint64 &size)
 // RET: true  - if kmer exists
 //------------------------------------------------------------------------------------------
 bool CKMCFile::CheckKmer(CKmerAPI &kmer, float &count)
+{
+	return FindKmer(kmer, count, NULL);
+}
+
+//------------------------------------------------------------------------------------------
+// Check if canonical kmer exists in a strand-resolved database.
+// IN : kmer			 - canonical kmer
+// OUT: count_canonical	 - the no. of its occurrences in canonical orientation if kmer exists
+//      count_rev_compl	 - the no. of its occurrences in reverse-complement orientation if kmer exists
+// RET: true			 - if kmer exists
+//------------------------------------------------------------------------------------------
+bool CKMCFile::CheckKmer(CKmerAPI &kmer, uint32 &count_canonical, uint32 &count_rev_compl)
+{
+	if(!strand_resolved)
+		return false;
+
+	float count;
+	uchar *counter_ptr;
+	if(!FindKmer(kmer, count, &counter_ptr))
+		return false;
+	GetStrandCounters(counter_ptr, count_canonical, count_rev_compl);
+	return true;
+}
+
+//------------------------------------------------------------------------------------------
+// Find a kmer's record. Auxiliary function.
+// IN : kmer		- kmer
+// OUT: count		- kmer's counter if kmer exists
+//      counter_ptr	- the address of the counter area of kmer's record if kmer exists (if not NULL)
+// RET: true		- if kmer exists
+//------------------------------------------------------------------------------------------
+bool CKMCFile::FindKmer(CKmerAPI &kmer, float &count, uchar **counter_ptr)
 {
 	if(is_opened != opened_for_RA)
 		return false;
@@ -234,9 +294,6 @@ bool CKMCFile::CheckKmer(CKmerAPI &kmer, float &count)
 		return false;
 	
 	uint32 signature = kmer.get_signature(signature_len);
-	
-	uint32 bin_start_pos = signature_map[signature];
-	bin_start_pos *= single_LUT_size;
 
 	//recognize a prefix:
 	uint64 pattern_prefix_value = kmer.kmer_data[0];
@@ -248,11 +305,25 @@ bool CKMCFile::CheckKmer(CKmerAPI &kmer, float &count)
 		return false;
 	//look into the array with data
 
-	int64 index_start = *(prefix_file_buf + bin_start_pos + pattern_prefix_value);			
-	int64 index_stop = *(prefix_file_buf + bin_start_pos + pattern_prefix_value + 1) - 1;	
- 
+	int64 index_start, index_stop;
+	GetSufixRange(signature, pattern_prefix_value, index_start, index_stop);
+
+	return FindSufix(kmer, index_start, index_stop, count, counter_ptr);
+}
+
+//------------------------------------------------------------------------------------------
+// Binary search of a kmer's sufix. Auxiliary function.
+// IN : kmer  - kmer
+//      index_start, index_stop - the range of records of the kmer's signature and prefix
+// OUT: count - kmer's counter if kmer exists
+//      counter_ptr - the address of the counter area of kmer's record if kmer exists (if not NULL)
+// RET: true  - if kmer exists and its counter is between min_count and max_count
+//------------------------------------------------------------------------------------------
+bool CKMCFile::FindSufix(CKmerAPI &kmer, int64 index_start, int64 index_stop, float &count, uchar **counter_ptr)
+{
 	uchar *sufix_byte_ptr; 
 	uint64 sufix = 0;
+	uint32 pattern_offset;
 	
 										//sufix_offset is always 56
 	uint32 sufix_offset = 56;			// the ofset of a sufix is for shifting the sufix towards MSB, to compare the sufix with a pattern
@@ -271,7 +342,8 @@ bool CKMCFile::CheckKmer(CKmerAPI &kmer, float &count)
 
 		uint64 pattern = 0;
 	  
-		pattern_offset = (lut_prefix_length + kmer.byte_alignment ) * 2;		
+		pattern_offset = (lut_prefix_length + kmer.byte_alignment ) * 2;
+		row_index = 0;		
 	  
 		for(uint32 a = 0; a < sufix_size; a ++)		//check byte by byte
 		{
@@ -307,23 +379,9 @@ bool CKMCFile::CheckKmer(CKmerAPI &kmer, float &count)
 	
 	if(found)
 	{
-		sufix_byte_ptr += sufix_size;
-		uint32 int_counter;
-	
-		int_counter = *sufix_byte_ptr;
-
-		for(uint32 b = 1; b < counter_size; b ++)
-		{
-			uint32 aux = 0x000000ff & *(sufix_byte_ptr + b);
-
-			aux = aux << 8 * ( b);
-			int_counter = aux | int_counter;
-		}
-	
-		if(mode == 0)
-			count = (float)int_counter;
-		else
-			memcpy(&count, &int_counter, counter_size);
+		count = GetCounter(sufix_byte_ptr + sufix_size);
+		if(counter_ptr)
+			*counter_ptr = sufix_byte_ptr + sufix_size;
 		
 		if((count >= min_count) && (count <= max_count))
 			return true;
@@ -333,6 +391,333 @@ bool CKMCFile::CheckKmer(CKmerAPI &kmer, float &count)
 	return false;
 }
 
+//------------------------------------------------------------------------------------------
+// Find the kmers one substitution away from a kmer. The 3 * kmer_length variants are
+// enumerated here: the signature of a variant is updated from the mmers of the kmer that
+// do not overlap the substitution, the variants are sorted by their LUT entry (signature
+// bin and prefix) and sufix, and the variants of each LUT entry are found in a single pass
+// over its range of records.
+// IN : kmer		 - kmer
+//      threshold	 - the minimal counter of a variant to report
+//      both_strands - if the canonical form of each variant is to be looked for
+// OUT: variants	 - the existing variants, by position and symbol
+// RET: true		 - if the database is opened for random access
+//------------------------------------------------------------------------------------------
+bool CKMCFile::CheckNeighbours(CKmerAPI &kmer, float threshold, std::vector<CKmerVariant> &variants, bool both_strands)
+{
+	variants.clear();
+	if(is_opened != opened_for_RA || kmer.kmer_length != kmer_length)
+		return false;
+
+	std::vector<char> seq(kmer_length);
+	for(uint32 i = 0; i < kmer_length; ++i)
+		seq[i] = kmer.get_num_symbol(i);
+
+	// The normalized mmers of the kmer, and their minima from each end
+	uint32 no_of_mmers = kmer_length - signature_len + 1;
+	std::vector<uint32> mmers(no_of_mmers), min_left(no_of_mmers), min_right(no_of_mmers);
+	CMmer mmer(signature_len);
+	for(uint32 j = 0; j < no_of_mmers; ++j)
+	{
+		mmer.insert(&seq[j]);
+		mmers[j] = mmer.get();
+		min_left[j] = j ? MIN(min_left[j - 1], mmers[j]) : mmers[j];
+	}
+	for(uint32 j = no_of_mmers; j-- > 0;)
+		min_right[j] = (j + 1 < no_of_mmers) ? MIN(min_right[j + 1], mmers[j]) : mmers[j];
+
+	uint32 no_of_variants = 3 * kmer_length;
+	std::vector<uint64> lut_pos(no_of_variants);
+	std::vector<uint32> order(no_of_variants);
+	std::vector<uchar> sufixes((uint64)no_of_variants * sufix_size);
+	std::vector<char> canonical(kmer_length);
+
+	uint32 v = 0;
+	for(uint32 p = 0; p < kmer_length; ++p)
+	{
+		char original = seq[p];
+		for(char symbol = 0; symbol < 4; ++symbol)
+		{
+			if(symbol == original)
+				continue;
+			seq[p] = symbol;
+
+			// Only the mmers overlapping p change; the signature is the same on both strands
+			uint32 first = p + 1 >= signature_len ? p + 1 - signature_len : 0;
+			uint32 last = MIN(p, no_of_mmers - 1);
+			uint32 signature = 0xffffffff;
+			if(first > 0)
+				signature = min_left[first - 1];
+			if(last + 1 < no_of_mmers)
+				signature = MIN(signature, min_right[last + 1]);
+			for(uint32 j = first; j <= last; ++j)
+			{
+				mmer.insert(&seq[j]);
+				signature = MIN(signature, mmer.get());
+			}
+
+			const char *symbols = &seq[0];
+			if(both_strands)
+			{
+				uint32 i = 0;
+				while(i < kmer_length && seq[i] == 3 - seq[kmer_length - 1 - i])
+					++i;
+				if(i < kmer_length && 3 - seq[kmer_length - 1 - i] < seq[i])
+				{
+					for(uint32 j = 0; j < kmer_length; ++j)
+						canonical[j] = 3 - seq[kmer_length - 1 - j];
+					symbols = &canonical[0];
+				}
+			}
+
+			uint64 prefix = 0;
+			for(uint32 j = 0; j < lut_prefix_length; ++j)
+				prefix = (prefix << 2) + symbols[j];
+			lut_pos[v] = (uint64)signature_map[signature] * single_LUT_size + prefix;
+
+			uchar *sufix = &sufixes[(uint64)v * sufix_size];
+			for(uint32 j = 0; j < sufix_size; ++j)
+			{
+				const char *s = symbols + lut_prefix_length + 4 * j;
+				sufix[j] = (uchar)((s[0] << 6) + (s[1] << 4) + (s[2] << 2) + s[3]);
+			}
+			order[v] = v;
+			++v;
+		}
+		seq[p] = original;
+	}
+
+	uint32 cur_sufix_size = sufix_size;
+	std::sort(order.begin(), order.end(), [&](uint32 a, uint32 b) {
+		if(lut_pos[a] != lut_pos[b])
+			return lut_pos[a] < lut_pos[b];
+		return memcmp(&sufixes[(uint64)a * cur_sufix_size], &sufixes[(uint64)b * cur_sufix_size], cur_sufix_size) < 0;
+	});
+
+	int64 index_start = 0, index_stop = -1;
+	for(uint32 i = 0; i < no_of_variants; ++i)
+	{
+		uint32 a = order[i];
+		if(i == 0 || lut_pos[a] != lut_pos[order[i - 1]])
+		{
+			index_start = prefix_file_buf[lut_pos[a]];
+			index_stop = prefix_file_buf[lut_pos[a] + 1] - 1;
+		}
+
+		// The first record not smaller than the variant; the next variants are not smaller
+		const uchar *sufix = &sufixes[(uint64)a * sufix_size];
+		int64 lo = index_start, hi = index_stop + 1;
+		while(lo < hi)
+		{
+			int64 mid = (lo + hi) / 2;
+			if(memcmp(&sufix_file_buf[mid * sufix_rec_size], sufix, sufix_size) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		index_start = lo;
+
+		if(lo <= index_stop && memcmp(&sufix_file_buf[lo * sufix_rec_size], sufix, sufix_size) == 0)
+		{
+			float count = GetCounter(&sufix_file_buf[lo * sufix_rec_size + sufix_size]);
+			if(count >= threshold && count >= min_count && count <= max_count)
+			{
+				CKmerVariant variant;
+				variant.pos = a / 3;
+				variant.symbol = CKmerAPI::char_codes[(a % 3) + ((a % 3) >= (uint32)seq[a / 3])];
+				variant.count = count;
+				variants.push_back(variant);
+			}
+		}
+	}
+
+	std::sort(variants.begin(), variants.end(), [](const CKmerVariant &a, const CKmerVariant &b) {
+		return a.pos < b.pos || (a.pos == b.pos && a.symbol < b.symbol);
+	});
+	return true;
+}
+
+//------------------------------------------------------------------------------------------
+// Find the LUT entry of a packed kmer: its signature is computed from the packed symbols
+// and its prefix is read from the first bytes. Auxiliary function.
+// IN : kmer_bytes - packed kmer
+// OUT: lut_pos	   - the index of the kmer's LUT entry in prefix_file_buf
+// RET: true	   - if the padding of the kmer is zeroed
+//------------------------------------------------------------------------------------------
+bool CKMCFile::GetPackedLUTPos(const uchar *kmer_bytes, uint64 &lut_pos)
+{
+	uint32 kmer_bytes_no = (kmer_length + 3) / 4;
+	uint32 byte_alignment = kmer_bytes_no * 4 - kmer_length;
+	uint32 prefix_bytes = kmer_bytes_no - sufix_size;
+
+	uint64 prefix = 0;
+	for(uint32 i = 0; i < prefix_bytes; ++i)
+		prefix = (prefix << 8) + kmer_bytes[i];
+	if(prefix >= single_LUT_size)
+		return false;
+
+	CMmer cur_mmr(signature_len);
+	uint32 signature = 0;
+	for(uint32 i = 0; i < kmer_length; ++i)
+	{
+		uint32 p = i + byte_alignment;
+		cur_mmr.insert((uchar)((kmer_bytes[p >> 2] >> (6 - 2 * (p & 3))) & 3));
+		if(i + 1 == signature_len || (i + 1 > signature_len && cur_mmr.get() < signature))
+			signature = cur_mmr.get();
+	}
+
+	lut_pos = (uint64)signature_map[signature] * single_LUT_size + prefix;
+	return true;
+}
+
+//------------------------------------------------------------------------------------------
+// Binary search of a packed sufix. Auxiliary function.
+// IN : sufix - the sufix_size last bytes of a packed kmer
+//      index_start, index_stop - the range of records of the kmer's signature and prefix
+// OUT: count - kmer's counter if kmer exists
+// RET: true  - if kmer exists and its counter is between min_count and max_count
+//------------------------------------------------------------------------------------------
+bool CKMCFile::FindPackedSufix(const uchar *sufix, int64 index_start, int64 index_stop, float &count)
+{
+	while(index_start <= index_stop)
+	{
+		int64 mid_index = (index_start + index_stop) / 2;
+		uchar *sufix_byte_ptr = &sufix_file_buf[mid_index * sufix_rec_size];
+
+		int cmp = memcmp(sufix_byte_ptr, sufix, sufix_size);
+		if(cmp == 0)
+		{
+			count = GetCounter(sufix_byte_ptr + sufix_size);
+			return (count >= min_count) && (count <= max_count);
+		}
+		if(cmp < 0)
+			index_start = mid_index + 1;
+		else
+			index_stop = mid_index - 1;
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------------------
+// Check if a packed kmer exists
+// IN : kmer_bytes - packed kmer
+// OUT: count	   - kmer's counter if kmer exists
+// RET: true	   - if kmer exists
+//------------------------------------------------------------------------------------------
+bool CKMCFile::CheckPackedKmer(const uchar *kmer_bytes, float &count)
+{
+	if(is_opened != opened_for_RA)
+		return false;
+
+	uint64 lut_pos;
+	if(!GetPackedLUTPos(kmer_bytes, lut_pos))
+		return false;
+
+	uint32 prefix_bytes = (kmer_length + 3) / 4 - sufix_size;
+	return FindPackedSufix(kmer_bytes + prefix_bytes, prefix_file_buf[lut_pos], prefix_file_buf[lut_pos + 1] - 1, count);
+}
+
+//------------------------------------------------------------------------------------------
+// Check a batch of packed kmers. The kmers are processed in groups: the LUT entries of a
+// group are prefetched, then the middle records of their ranges, and then the binary
+// searches are done.
+// IN : kmers		- packed kmers, (kmer_length + 3) / 4 bytes each
+//      no_of_kmers - the number of kmers
+// OUT: counts		- the counters of the kmers, 0 if absent
+// RET: the number of existing kmers
+//------------------------------------------------------------------------------------------
+uint64 CKMCFile::CheckPackedKmers(const uchar *kmers, uint64 no_of_kmers, float *counts)
+{
+	const uint32 group_size = 64;
+	uint64 lut_pos[group_size];
+	bool valid[group_size];
+	uint64 no_of_found = 0;
+
+	for(uint64 i = 0; i < no_of_kmers; ++i)
+		counts[i] = 0.0f;
+	if(is_opened != opened_for_RA)
+		return 0;
+
+	uint32 kmer_bytes_no = (kmer_length + 3) / 4;
+	uint32 prefix_bytes = kmer_bytes_no - sufix_size;
+
+	for(uint64 first = 0; first < no_of_kmers; first += group_size)
+	{
+		uint32 n = (uint32)MIN(no_of_kmers - first, (uint64)group_size);
+		const uchar *group = kmers + first * kmer_bytes_no;
+
+		for(uint32 i = 0; i < n; ++i)
+			if((valid[i] = GetPackedLUTPos(group + (uint64)i * kmer_bytes_no, lut_pos[i])))
+				KMC_PREFETCH(prefix_file_buf + lut_pos[i]);
+
+		for(uint32 i = 0; i < n; ++i)
+			if(valid[i])
+				KMC_PREFETCH(sufix_file_buf + ((prefix_file_buf[lut_pos[i]] + prefix_file_buf[lut_pos[i] + 1] - 1) / 2) * sufix_rec_size);
+
+		for(uint32 i = 0; i < n; ++i)
+			if(valid[i] && FindPackedSufix(group + (uint64)i * kmer_bytes_no + prefix_bytes, prefix_file_buf[lut_pos[i]], prefix_file_buf[lut_pos[i] + 1] - 1, counts[first + i]))
+				no_of_found++;
+			else
+				counts[first + i] = 0.0f;
+	}
+	return no_of_found;
+}
+
+//------------------------------------------------------------------------------------------
+// Return the number of records of the database
+// RET: the number of records, including those outside [min_count, max_count]
+//------------------------------------------------------------------------------------------
+uint64 CKMCFile::RecordCount(void)
+{
+	return is_opened ? total_kmers : 0;
+}
+
+//------------------------------------------------------------------------------------------
+// List packed kmers from a range of records. The LUT entry of the first record is found
+// by a binary search in the (nondecreasing) LUTs, then the LUT entries are followed.
+// IN	  : end		 - the record to stop at
+//			capacity - the maximal number of kmers to list
+// IN/OUT : pos		 - the first record to list; the first record not listed yet on exit
+// OUT	  : kmers	 - packed kmers, (kmer_length + 3) / 4 bytes each
+//			counts	 - their counters
+// RET	  : the number of listed kmers
+//------------------------------------------------------------------------------------------
+uint64 CKMCFile::ListPackedKmers(uint64 &pos, uint64 end, uchar *kmers, float *counts, uint64 capacity)
+{
+	if(is_opened != opened_for_RA)
+		return 0;
+	if(end > total_kmers)
+		end = total_kmers;
+	if(pos >= end || capacity == 0)
+		return 0;
+
+	uint32 kmer_bytes_no = (kmer_length + 3) / 4;
+	uint32 prefix_bytes = kmer_bytes_no - sufix_size;
+
+	// The last LUT entry starting at or before pos; the last element of prefix_file_buf is a guard
+	uint64 lut_pos = std::upper_bound(prefix_file_buf, prefix_file_buf + prefix_file_buf_size, pos) - prefix_file_buf - 1;
+
+	uint64 no_of_listed = 0;
+	for(; pos < end && no_of_listed < capacity; ++pos)
+	{
+		while(prefix_file_buf[lut_pos + 1] <= pos)
+			++lut_pos;
+
+		uchar *record = sufix_file_buf + pos * sufix_rec_size;
+		float count = GetCounter(record + sufix_size);
+		if((count < min_count) || (count > max_count))
+			continue;
+
+		uchar *kmer = kmers + no_of_listed * kmer_bytes_no;
+		uint64 prefix = lut_pos % single_LUT_size;
+		for(uint32 i = 0; i < prefix_bytes; ++i)
+			kmer[i] = (uchar)(prefix >> (8 * (prefix_bytes - 1 - i)));
+		memcpy(kmer + prefix_bytes, record, sufix_size);
+		counts[no_of_listed++] = count;
+	}
+	return no_of_listed;
+}
+
 //-----------------------------------------------------------------------------------------------
 // Check if end of file
 // RET: true - all kmers are listed
@@ -349,8 +734,6 @@ bool CKMCFile::Eof(void)
 //-----------------------------------------------------------------------------------------------
 bool CKMCFile::ReadNextKmer(CKmerAPI &kmer, float &count)
 {
-	uint32 int_counter;
-
 	if(is_opened != opened_for_listing)
 		return false;
 	do
@@ -400,25 +783,15 @@ bool CKMCFile::ReadNextKmer(CKmerAPI &kmer, float &count)
 		}
 	
 		//read counter:
-		if(index_in_partial_buf == part_size)
-			Reload_sufix_file_buf();
-		
-		int_counter = sufix_file_buf[index_in_partial_buf++];
-
-		for(uint32 b = 1; b < counter_size; b++)
+		for(uint32 b = 0; b < counter_size; b++)
 		{
 			if(index_in_partial_buf == part_size)
 				Reload_sufix_file_buf();
 			
-			uint32 aux = 0x000000ff & sufix_file_buf[index_in_partial_buf++];
-			aux = aux << 8 * ( b);
-			int_counter = aux | int_counter;
+			last_counter[b] = sufix_file_buf[index_in_partial_buf++];
 		}
 	
-		if(mode == 0)
-			count = (float)int_counter;
-		else
-			memcpy(&count, &int_counter, counter_size);
+		count = GetCounter(last_counter);
 	
 		sufix_number++;
 	
@@ -429,6 +802,22 @@ bool CKMCFile::ReadNextKmer(CKmerAPI &kmer, float &count)
 
 	return true;
 }
+
+//-----------------------------------------------------------------------------------------------
+// Read next kmer of a strand-resolved database
+// OUT: kmer - next kmer
+// OUT: count_canonical - the no. of kmer's occurrences in canonical orientation
+// OUT: count_rev_compl - the no. of kmer's occurrences in reverse-complement orientation
+// RET: true - if not EOF
+//-----------------------------------------------------------------------------------------------
+bool CKMCFile::ReadNextKmer(CKmerAPI &kmer, uint32 &count_canonical, uint32 &count_rev_compl)
+{
+	float count;
+	if(!strand_resolved || !ReadNextKmer(kmer, count))
+		return false;
+	GetStrandCounters(last_counter, count_canonical, count_rev_compl);
+	return true;
+}
 //-------------------------------------------------------------------------------
 // Reload a contents of an array "sufix_file_buf" for listing mode. Auxiliary function.
 //-------------------------------------------------------------------------------
@@ -562,6 +951,82 @@ uint32 CKMCFile::KmerLength(void)
 	return kmer_length;			
 }
 
+//----------------------------------------------------------------------------------------
+// Return the no. of symbols covered by a (spaced) kmer
+// RET	: the span of kmers, kmer_length for contiguous kmers
+//----------------------------------------------------------------------------------------
+uint32 CKMCFile::KmerSpan(void)
+{
+	return kmer_span;
+}
+
+//----------------------------------------------------------------------------------------
+// Return the mask of spaced kmers
+// RET	: the mask ('1' - care, '0' - don't care position), empty for contiguous kmers
+//----------------------------------------------------------------------------------------
+std::string CKMCFile::KmerMask(void)
+{
+	return kmer_mask;
+}
+
+//----------------------------------------------------------------------------------------
+// Check if the database keeps the counters of both orientations of canonical kmers
+// RET	: true for a strand-resolved database (kmc -st)
+//----------------------------------------------------------------------------------------
+bool CKMCFile::StrandResolved(void)
+{
+	return strand_resolved;
+}
+
+//----------------------------------------------------------------------------------------
+// Check if the spaced kmer of a window exists
+// IN	: window		- KmerSpan() symbols
+//		  both_strands	- look for the canonical form of the kmer
+// OUT	: count			- kmer's counter if kmer exists
+// RET	: true if kmer exists
+//----------------------------------------------------------------------------------------
+bool CKMCFile::CheckWindow(const std::string &window, float &count, bool both_strands)
+{
+	if(is_opened != opened_for_RA)
+		return false;
+	if(window.size() != kmer_span)
+		return false;
+
+	std::string canonical;
+	canonical.reserve(kmer_length);
+	for(uint32 i = 0; i < kmer_span; ++i)
+	{
+		if(!kmer_mask.empty() && kmer_mask[i] == '0')
+			continue;
+		if(CKmerAPI::num_codes[(uchar)window[i]] == -1)
+			return false;
+		canonical.push_back(CKmerAPI::char_codes[(uchar)CKmerAPI::num_codes[(uchar)window[i]]]);
+	}
+
+	// The reverse kmer is the one of the reverse complement of the window, so for an asymmetric
+	// mask it is taken from the mirrored care positions
+	if(both_strands)
+	{
+		std::string rev_compl;
+		rev_compl.reserve(kmer_length);
+		for(uint32 i = 0; i < kmer_span; ++i)
+		{
+			if(!kmer_mask.empty() && kmer_mask[i] == '0')
+				continue;
+			int code = CKmerAPI::num_codes[(uchar)window[kmer_span - 1 - i]];
+			if(code == -1)
+				return false;
+			rev_compl.push_back(CKmerAPI::char_codes[3 - code]);
+		}
+		if(rev_compl < canonical)
+			canonical.swap(rev_compl);
+	}
+
+	CKmerAPI kmer(kmer_length);
+	kmer.from_string(canonical);
+	return CheckKmer(kmer, count);
+}
+
 //----------------------------------------------------------------------------------------
 // Check if kmer exists
 // IN	: kmer - kmer
@@ -598,6 +1063,14 @@ uint64 CKMCFile::KmerCount(void)
 				for(uint64 i = 0; i < total_kmers; i++)		
 				{
 					ptr += sufix_size;
+					if(strand_resolved)
+					{
+						count = (uint32)GetCounter(ptr);
+						ptr += counter_size;
+						if((count >= min_count) && (count <= max_count))
+							aux_kmerCount++;
+						continue;
+					}
 					int_counter = *ptr;
 					ptr++;
 
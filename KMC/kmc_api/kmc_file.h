@@ -14,6 +14,16 @@
 #include "kmer_defs.h"
 #include "kmer_api.h"
 #include <string>
+#include <vector>
+
+// A kmer one substitution away from a queried kmer: the substituted position,
+// the new symbol (A/C/G/T) and the counter of the kmer
+struct CKmerVariant
+{
+	uint32 pos;
+	char symbol;
+	float count;
+};
 
 class CKMCFile
 {
@@ -46,6 +56,11 @@ class CKMCFile
 	uint32 max_count;
 	uint64 total_kmers;
 
+	uint32 kmer_span;		// the no. of symbols covered by a spaced kmer (kmer_length for contiguous kmers)
+	std::string kmer_mask;	// the mask of spaced kmers ('1' - care, '0' - don't care), empty for contiguous kmers
+	bool strand_resolved;	// the counter area holds two counters: of canonical and of reverse-complement occurrences
+	uchar last_counter[8];	// the counter area of the kmer last read in listing mode
+
 	uint32 sufix_size;		// sufix's size in bytes 
 	uint32 sufix_rec_size;  // sufix_size + counter_size
 
@@ -63,6 +78,30 @@ class CKMCFile
 	// Reload a contents of an array "sufix_file_buf" for listing mode. Auxiliary function. 
 	void Reload_sufix_file_buf();
 
+	// Find the range of sufix records of a kmer's signature and prefix. Auxiliary function.
+	inline void GetSufixRange(uint32 signature, uint64 prefix, int64 &index_start, int64 &index_stop);
+
+	// Find a kmer's record. Optionally return the address of its counter area. Auxiliary function.
+	bool FindKmer(CKmerAPI &kmer, float &count, uchar **counter_ptr);
+
+	// Binary search of a kmer's sufix in the records [index_start, index_stop]. Auxiliary function.
+	bool FindSufix(CKmerAPI &kmer, int64 index_start, int64 index_stop, float &count, uchar **counter_ptr = NULL);
+
+	// Decode the counter of a record. Auxiliary function.
+	inline float GetCounter(uchar *counter_ptr);
+
+	// Decode the two counters of a record of a strand-resolved database. Auxiliary function.
+	inline void GetStrandCounters(uchar *counter_ptr, uint32 &count_canonical, uint32 &count_rev_compl);
+
+	// Find the LUT entry (signature bin and prefix) of a packed kmer. Auxiliary function.
+	bool GetPackedLUTPos(const uchar *kmer_bytes, uint64 &lut_pos);
+
+	// Binary search of a packed sufix in the records [index_start, index_stop]. Auxiliary function.
+	bool FindPackedSufix(const uchar *sufix, int64 index_start, int64 index_stop, float &count);
+
+	friend class CKMCMultiFile;
+	friend class CKMCSimilarity;
+
 public:
 		
 	CKMCFile();
@@ -77,6 +116,10 @@ public:
 	// Return next kmer in CKmerAPI &kmer. Return its counter in float &count. Return true if not EOF
 	bool ReadNextKmer(CKmerAPI &kmer, float &count);
 
+	// Return next kmer in CKmerAPI &kmer and its counters of occurrences in canonical and in
+	// reverse-complement orientation. Return true if not EOF. Only for strand-resolved databases
+	bool ReadNextKmer(CKmerAPI &kmer, uint32 &count_canonical, uint32 &count_rev_compl);
+
 	// Release memory and close files in case they were opened 
 	bool Close();
 
@@ -98,6 +141,18 @@ public:
 	// Return the length of kmers
 	uint32 KmerLength(void);
 
+	// Return the no. of symbols covered by a (spaced) kmer, kmer_length for contiguous kmers
+	uint32 KmerSpan(void);
+
+	// Return the mask of spaced kmers, e.g. "1101", or an empty string for contiguous kmers. The canonical
+	// form of a spaced kmer is the smaller of the kmers of a window and of its reverse complement; unless
+	// the mask is a palindrome, the latter is not the reverse complement of the former, so look windows
+	// up with CheckWindow rather than kmers
+	std::string KmerMask(void);
+
+	// Return true if the database keeps separate counters of both orientations of canonical kmers (kmc -st)
+	bool StrandResolved(void);
+
 	// Set initial values to enable listing kmers from the begining. Only in listing mode
 	bool RestartListing(void);
 
@@ -107,9 +162,45 @@ public:
 	// Return true if kmer exists. In this case return kmer's counter in count
 	bool CheckKmer(CKmerAPI &kmer, float &count);
 
+	// Return true if canonical kmer exists. In this case return its counters of occurrences in canonical and
+	// in reverse-complement orientation (their sum is the counter). Only for strand-resolved databases
+	bool CheckKmer(CKmerAPI &kmer, uint32 &count_canonical, uint32 &count_rev_compl);
+
 	// Return true if kmer exists
 	bool IsKmer(CKmerAPI &kmer);
 
+	// Return true if the spaced kmer of a window of KmerSpan() symbols exists. In this case return its
+	// counter in count. Symbols at don't care positions are ignored. If both_strands, the canonical form
+	// is looked for, so the symbols at the mirrored care positions must be ACGT too. Works for contiguous
+	// kmers too. Only in random access mode
+	bool CheckWindow(const std::string &window, float &count, bool both_strands = true);
+
+	// Return in variants the kmers one substitution away from kmer that exist with a counter of at least
+	// threshold. If both_strands, the canonical form of each variant is looked for. Return false if the
+	// database is not opened for random access
+	bool CheckNeighbours(CKmerAPI &kmer, float threshold, std::vector<CKmerVariant> &variants, bool both_strands = true);
+
+	// The packed form of a kmer has (kmer_length + 3) / 4 bytes, 2 bits per symbol (A=0, C=1, G=2, T=3),
+	// the first symbol in the most significant bits, left-padded with zeros to a multiple of 4 symbols.
+	// It is the layout of the records of *.kmc_suf, so the functions below do no conversions and no
+	// memory allocation. They only read the database, so they can be called from many threads at once.
+
+	// Return true if a packed kmer exists. In this case return kmer's counter in count. Only in random access mode
+	bool CheckPackedKmer(const uchar *kmer_bytes, float &count);
+
+	// Return in counts the counters of no_of_kmers packed kmers stored one after another (0 if absent).
+	// Return the number of existing kmers. Only in random access mode
+	uint64 CheckPackedKmers(const uchar *kmers, uint64 no_of_kmers, float *counts);
+
+	// Return the number of records of the database, including those outside [min_count, max_count]
+	uint64 RecordCount(void);
+
+	// List packed kmers and their counters from the records [pos, end), at most capacity of them.
+	// Records outside [min_count, max_count] are skipped. Advance pos past the listed records and
+	// return the number of listed kmers. Disjoint record ranges can be listed independently. Only in
+	// random access mode
+	uint64 ListPackedKmers(uint64 &pos, uint64 end, uchar *kmers, float *counts, uint64 capacity);
+
 	// Set original (readed from *.kmer_pre) values for min_count and max_count
 	void ResetMinMaxCounts(void);
 
@@ -117,6 +208,61 @@ public:
 	bool Info(uint32 &_kmer_length, uint32 &_mode, uint32 &_counter_size, uint32 &_lut_prefix_length, uint32 &_signature_len, uint32 &_min_count, uint32 &_max_count, uint64 &_total_kmers);
 };
 
+//----------------------------------------------------------------------------------
+// Find the range of sufix records of a kmer's signature and prefix
+// IN	: signature - the kmer's signature
+//		  prefix	- the kmer's lut_prefix_length first symbols
+// OUT	: index_start, index_stop - the first and the last record to search
+//----------------------------------------------------------------------------------
+inline void CKMCFile::GetSufixRange(uint32 signature, uint64 prefix, int64 &index_start, int64 &index_stop)
+{
+	uint64 *lut = prefix_file_buf + (uint64)signature_map[signature] * single_LUT_size + prefix;
+	index_start = *lut;
+	index_stop = *(lut + 1) - 1;
+}
+
+//----------------------------------------------------------------------------------
+// Decode the counter of a record
+// IN	: counter_ptr - the first byte of the counter (after the sufix)
+// RET	: the counter
+//----------------------------------------------------------------------------------
+inline float CKMCFile::GetCounter(uchar *counter_ptr)
+{
+	if(strand_resolved)
+	{
+		uint32 count_canonical, count_rev_compl;
+		GetStrandCounters(counter_ptr, count_canonical, count_rev_compl);
+		return (float)count_canonical + (float)count_rev_compl;
+	}
+
+	uint32 int_counter = *counter_ptr;
+	for(uint32 b = 1; b < counter_size; b ++)
+		int_counter |= (0x000000ff & (uint32)counter_ptr[b]) << (8 * b);
+
+	float count;
+	if(mode == 0)
+		count = (float)int_counter;
+	else
+		memcpy(&count, &int_counter, counter_size);
+	return count;
+}
+
+//----------------------------------------------------------------------------------
+// Decode the two counters of a record of a strand-resolved database
+// IN	: counter_ptr - the first byte of the counter area (after the sufix)
+// OUT	: count_canonical, count_rev_compl - the counters of both orientations
+//----------------------------------------------------------------------------------
+inline void CKMCFile::GetStrandCounters(uchar *counter_ptr, uint32 &count_canonical, uint32 &count_rev_compl)
+{
+	uint32 half = counter_size / 2;
+	count_canonical = count_rev_compl = 0;
+	for(uint32 b = 0; b < half; b ++)
+	{
+		count_canonical |= (uint32)counter_ptr[b] << (8 * b);
+		count_rev_compl |= (uint32)counter_ptr[half + b] << (8 * b);
+	}
+}
+
 #endif
 
 // ***** EOF
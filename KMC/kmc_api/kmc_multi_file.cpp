@@ -0,0 +1,214 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+
+#include "stdafx.h"
+#include "kmc_multi_file.h"
+
+// The searches of this many kmers are interleaved
+const uint32 CKMCMultiFile::batch_size = 256;
+
+//----------------------------------------------------------------------------------
+CKMCMultiFile::CKMCMultiFile()
+{
+	kmer_length = 0;
+	lut_prefix_length = 0;
+	signature_len = 0;
+	both_strands = true;
+}
+//----------------------------------------------------------------------------------
+CKMCMultiFile::~CKMCMultiFile()
+{
+	Close();
+}
+//----------------------------------------------------------------------------------
+// Open the databases for random access
+// IN	: file_names	- the names of kmer_counter's outputs
+//		  _both_strands - if the queried kmers should be replaced by their canonical form
+// RET	: true			- if all the databases were opened and are compatible
+//----------------------------------------------------------------------------------
+bool CKMCMultiFile::OpenForRA(const std::vector<std::string> &file_names, bool _both_strands)
+{
+	if(!databases.empty() || file_names.empty())
+		return false;
+
+	for(uint32 i = 0; i < file_names.size(); ++i)
+	{
+		CKMCFile *db = new CKMCFile;
+		if(!db->OpenForRA(file_names[i]))
+		{
+			delete db;
+			Close();
+			return false;
+		}
+		databases.push_back(db);
+
+		if(i == 0)
+		{
+			kmer_length = db->kmer_length;
+			lut_prefix_length = db->lut_prefix_length;
+			signature_len = db->signature_len;
+		}
+		else if(db->kmer_length != kmer_length || db->kmer_mask != databases[0]->kmer_mask ||
+				db->lut_prefix_length != lut_prefix_length || db->signature_len != signature_len)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	both_strands = _both_strands;
+	queries.resize(batch_size);
+	index_start.resize(batch_size);
+	index_stop.resize(batch_size);
+	return true;
+}
+//----------------------------------------------------------------------------------
+// Release memory of all the databases
+// RET	: true - if the databases were opened
+//----------------------------------------------------------------------------------
+bool CKMCMultiFile::Close()
+{
+	if(databases.empty())
+		return false;
+
+	for(uint32 i = 0; i < databases.size(); ++i)
+		delete databases[i];
+	databases.clear();
+	queries.clear();
+	return true;
+}
+//----------------------------------------------------------------------------------
+uint32 CKMCMultiFile::NoOfDatabases(void)
+{
+	return (uint32)databases.size();
+}
+//----------------------------------------------------------------------------------
+uint32 CKMCMultiFile::KmerLength(void)
+{
+	return kmer_length;
+}
+//----------------------------------------------------------------------------------
+CKMCFile& CKMCMultiFile::Database(uint32 i)
+{
+	return *databases[i];
+}
+//----------------------------------------------------------------------------------
+// Fill a query with the canonical form of a kmer, its signature and prefix
+// IN	: kmer_string	- kmer
+// OUT	: query			- the query
+// RET	: true			- if the kmer is valid
+//----------------------------------------------------------------------------------
+bool CKMCMultiFile::PrepareQuery(const std::string &kmer_string, CQuery &query)
+{
+	query.valid = false;
+	if(kmer_string.size() != kmer_length)
+		return false;
+
+	std::string canonical(kmer_string);
+	for(uint32 i = 0; i < kmer_length; ++i)
+	{
+		if(CKmerAPI::num_codes[(uchar)canonical[i]] == -1)
+			return false;
+		canonical[i] = CKmerAPI::char_codes[(uchar)CKmerAPI::num_codes[(uchar)canonical[i]]];
+	}
+
+	if(both_strands)
+	{
+		std::string rev_compl(kmer_length, 'A');
+		for(uint32 i = 0; i < kmer_length; ++i)
+			rev_compl[kmer_length - 1 - i] = CKmerAPI::char_codes[3 - CKmerAPI::num_codes[(uchar)canonical[i]]];
+		if(rev_compl < canonical)
+			canonical.swap(rev_compl);
+	}
+
+	query.kmer.from_string(canonical);
+	query.signature = query.kmer.get_signature(signature_len);
+	uint32 prefix_offset = 64 - (lut_prefix_length * 2) - (query.kmer.byte_alignment * 2);
+	query.prefix = query.kmer.kmer_data[0] >> prefix_offset;
+	query.valid = true;
+	return true;
+}
+//----------------------------------------------------------------------------------
+// Find the counters of the prepared queries in all the databases. For each database,
+// the LUT entries of all the queries are prefetched, then the middle records of their
+// ranges, and then the binary searches are done.
+// IN	: no_of_queries	- the number of queries
+// OUT	: counts		- NoOfDatabases() counters per query, set to 0 beforehand
+//----------------------------------------------------------------------------------
+void CKMCMultiFile::CheckQueries(uint32 no_of_queries, float *counts)
+{
+	uint32 no_of_databases = (uint32)databases.size();
+
+	for(uint32 d = 0; d < no_of_databases; ++d)
+	{
+		CKMCFile &db = *databases[d];
+
+		for(uint32 q = 0; q < no_of_queries; ++q)
+			if(queries[q].valid)
+				KMC_PREFETCH(db.prefix_file_buf + (uint64)db.signature_map[queries[q].signature] * db.single_LUT_size + queries[q].prefix);
+
+		for(uint32 q = 0; q < no_of_queries; ++q)
+		{
+			if(!queries[q].valid)
+				continue;
+			db.GetSufixRange(queries[q].signature, queries[q].prefix, index_start[q], index_stop[q]);
+			if(index_start[q] <= index_stop[q])
+				KMC_PREFETCH(db.sufix_file_buf + ((index_start[q] + index_stop[q]) / 2) * db.sufix_rec_size);
+		}
+
+		for(uint32 q = 0; q < no_of_queries; ++q)
+		{
+			float count;
+			if(queries[q].valid && db.FindSufix(queries[q].kmer, index_start[q], index_stop[q], count))
+				counts[(uint64)q * no_of_databases + d] = count;
+		}
+	}
+}
+//----------------------------------------------------------------------------------
+// Return the counters of a kmer in all the databases
+// IN	: kmer	 - kmer
+// OUT	: counts - the counter of the kmer in each database, 0 if absent
+// RET	: true	 - if the kmer is valid
+//----------------------------------------------------------------------------------
+bool CKMCMultiFile::CheckKmer(const std::string &kmer, std::vector<float> &counts)
+{
+	counts.assign(databases.size(), 0.0f);
+	if(databases.empty() || !PrepareQuery(kmer, queries[0]))
+		return false;
+
+	CheckQueries(1, counts.data());
+	return true;
+}
+//----------------------------------------------------------------------------------
+// Return the counters of a batch of kmers in all the databases
+// IN	: kmers	 - kmers
+// OUT	: counts - NoOfDatabases() counters per kmer, 0 if absent
+// RET	: the number of valid kmers
+//----------------------------------------------------------------------------------
+uint64 CKMCMultiFile::CheckKmers(const std::vector<std::string> &kmers, std::vector<float> &counts)
+{
+	uint64 no_of_valid = 0;
+	counts.assign(kmers.size() * databases.size(), 0.0f);
+	if(databases.empty())
+		return 0;
+
+	for(uint64 first = 0; first < kmers.size(); first += batch_size)
+	{
+		uint32 no_of_queries = (uint32)MIN(kmers.size() - first, (uint64)batch_size);
+		for(uint32 q = 0; q < no_of_queries; ++q)
+			if(PrepareQuery(kmers[first + q], queries[q]))
+				no_of_valid++;
+
+		CheckQueries(no_of_queries, counts.data() + first * databases.size());
+	}
+	return no_of_valid;
+}
+
+// ***** EOF
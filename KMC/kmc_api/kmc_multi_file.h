@@ -0,0 +1,90 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+
+#ifndef _KMC_MULTI_FILE_H
+#define _KMC_MULTI_FILE_H
+
+#include "kmer_defs.h"
+#include "kmer_api.h"
+#include "kmc_file.h"
+#include <string>
+#include <vector>
+
+// Random access to many databases of the same kmer length, spaced kmer mask,
+// signature length and LUT prefix length (e.g. one per sample) at once. A kmer is answered with
+// the vector of its counters in all databases; its canonical form, signature
+// and prefix are computed once, and the searches in the databases are
+// interleaved with prefetching of the LUT entries and of the first sufix
+// records to compare.
+// The databases are read to RAM as by CKMCFile::OpenForRA, so no file is kept
+// opened.
+class CKMCMultiFile
+{
+	struct CQuery
+	{
+		CKmerAPI kmer;
+		uint32 signature;
+		uint64 prefix;
+		bool valid;
+	};
+
+	std::vector<CKMCFile*> databases;
+
+	uint32 kmer_length;
+	uint32 lut_prefix_length;
+	uint32 signature_len;
+	bool both_strands;
+
+	std::vector<CQuery> queries;
+	std::vector<int64> index_start;
+	std::vector<int64> index_stop;
+
+	static const uint32 batch_size;
+
+	// Fill a query with the canonical form of a kmer, its signature and prefix. Auxiliary function.
+	bool PrepareQuery(const std::string &kmer_string, CQuery &query);
+
+	// Find the counters of a batch of prepared queries in all the databases. Auxiliary function.
+	void CheckQueries(uint32 no_of_queries, float *counts);
+
+public:
+	CKMCMultiFile();
+	~CKMCMultiFile();
+
+	// Open the databases for random access. They must have the same kmer length, spaced kmer mask,
+	// signature length and LUT prefix length. If both_strands, the queried kmers are replaced with their canonical form
+	// (as the databases of kmc counting both strands store them)
+	bool OpenForRA(const std::vector<std::string> &file_names, bool _both_strands = true);
+
+	// Release memory of all the databases
+	bool Close();
+
+	// Return the number of opened databases
+	uint32 NoOfDatabases(void);
+
+	// Return the length of kmers
+	uint32 KmerLength(void);
+
+	// Access a database, e.g. to set its min_count and max_count
+	CKMCFile& Database(uint32 i);
+
+	// Return in counts the counter of a kmer in each database (0 if absent).
+	// Return false if the kmer has a wrong length or a symbol other than ACGT
+	bool CheckKmer(const std::string &kmer, std::vector<float> &counts);
+
+	// Return in counts the counters of a batch of kmers, NoOfDatabases() counters per kmer.
+	// The counters of kmers of a wrong length or with a symbol other than ACGT are 0.
+	// Return the number of valid kmers
+	uint64 CheckKmers(const std::vector<std::string> &kmers, std::vector<float> &counts);
+};
+
+#endif
+
+// ***** EOF
@@ -0,0 +1,423 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+
+#include "stdafx.h"
+#include "kmc_similarity.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// The prefixes are split into at least this many ranges per thread, for load balancing
+#define RANGES_PER_THREAD	8
+
+//----------------------------------------------------------------------------------
+CKMCSimilarity::CKMCSimilarity()
+{
+	kmer_length = 0;
+	lut_prefix_length = 0;
+	key_size = 0;
+	weighted = false;
+}
+//----------------------------------------------------------------------------------
+CKMCSimilarity::~CKMCSimilarity()
+{
+	Close();
+}
+//----------------------------------------------------------------------------------
+// Open the databases. Only *.kmc_pre files are read, *.kmc_suf files are checked
+// IN	: _file_names	- the names of kmer_counter's outputs
+// RET	: true			- if all the databases were opened and have the same kmer length and mask
+//----------------------------------------------------------------------------------
+bool CKMCSimilarity::Open(const std::vector<std::string> &_file_names)
+{
+	if(!databases.empty() || _file_names.empty())
+		return false;
+
+	for(uint32 i = 0; i < _file_names.size(); ++i)
+	{
+		CKMCFile *db = new CKMCFile;
+		databases.push_back(db);
+
+		uint64 size;
+		if(!db->OpenASingleFile(_file_names[i] + ".kmc_pre", db->file_pre, size, (char *)"KMCP"))
+		{
+			Close();
+			return false;
+		}
+		db->ReadParamsFrom_prefix_file_buf(size);
+		fclose(db->file_pre);
+		db->file_pre = NULL;
+
+		if(!db->OpenASingleFile(_file_names[i] + ".kmc_suf", db->file_suf, size, (char *)"KMCS"))
+		{
+			Close();
+			return false;
+		}
+		fclose(db->file_suf);
+		db->file_suf = NULL;
+
+		if(i == 0)
+		{
+			kmer_length = db->kmer_length;
+			lut_prefix_length = db->lut_prefix_length;
+		}
+		else if(db->kmer_length != kmer_length || db->kmer_mask != databases[0]->kmer_mask)
+		{
+			Close();
+			return false;
+		}
+		lut_prefix_length = MIN(lut_prefix_length, db->lut_prefix_length);
+	}
+
+	// kmer_length - lut_prefix_length is a multiple of 4 in each database, so the symbols of longer
+	// prefixes beyond lut_prefix_length form whole bytes preceding the sufixes
+	key_size = (kmer_length - lut_prefix_length) / 4;
+	file_names = _file_names;
+	intersections.clear();
+	min_sums.clear();
+	return true;
+}
+//----------------------------------------------------------------------------------
+// Release memory of all the databases
+// RET	: true - if the databases were opened
+//----------------------------------------------------------------------------------
+bool CKMCSimilarity::Close()
+{
+	if(databases.empty())
+		return false;
+
+	for(uint32 i = 0; i < databases.size(); ++i)
+		delete databases[i];
+	databases.clear();
+	file_names.clear();
+	intersections.clear();
+	min_sums.clear();
+	return true;
+}
+//----------------------------------------------------------------------------------
+uint32 CKMCSimilarity::NoOfDatabases(void)
+{
+	return (uint32)databases.size();
+}
+//----------------------------------------------------------------------------------
+CKMCFile& CKMCSimilarity::Database(uint32 i)
+{
+	return *databases[i];
+}
+//----------------------------------------------------------------------------------
+// Split the prefixes into ranges of records of at most max_range_bytes (unless a single
+// prefix is larger) in all the databases. The sizes of the records are after expanding
+// the sufixes to key_size bytes.
+// IN	: max_range_bytes	- the maximal size of a range
+// OUT	: range_bounds		- the first prefix of each range and the end of the last range
+//----------------------------------------------------------------------------------
+void CKMCSimilarity::PlanRanges(uint64 max_range_bytes, std::vector<uint64> &range_bounds)
+{
+	uint64 no_of_prefixes = 1ull << (2 * lut_prefix_length);
+	std::vector<uint64> prefix_bytes(no_of_prefixes, 0);
+
+	for(uint32 d = 0; d < databases.size(); ++d)
+	{
+		CKMCFile &db = *databases[d];
+		uint32 shift = 2 * (db.lut_prefix_length - lut_prefix_length);
+		uint64 no_of_bins = (db.prefix_file_buf_size - 1) / db.single_LUT_size;
+		uint64 rec_size = key_size + db.counter_size;
+
+		for(uint64 b = 0; b < no_of_bins; ++b)
+		{
+			uint64 lut_start = b * db.single_LUT_size;
+			for(uint64 p = 0; p < no_of_prefixes; ++p)
+				prefix_bytes[p] += (LUTEntry(db, lut_start + ((p + 1) << shift)) - LUTEntry(db, lut_start + (p << shift))) * rec_size;
+		}
+	}
+
+	range_bounds.clear();
+	range_bounds.push_back(0);
+	uint64 range_bytes = 0;
+	for(uint64 p = 0; p < no_of_prefixes; ++p)
+	{
+		if(range_bytes && range_bytes + prefix_bytes[p] > max_range_bytes)
+		{
+			range_bounds.push_back(p);
+			range_bytes = 0;
+		}
+		range_bytes += prefix_bytes[p];
+	}
+	range_bounds.push_back(no_of_prefixes);
+}
+//----------------------------------------------------------------------------------
+// Read the records of a range of prefixes of all the databases and merge them. For each
+// database and bin, the records of a prefix are sorted, so each of them is a run to merge;
+// equal kmers of different databases are met at the top of a heap of runs.
+// IN	: prefix_start, prefix_stop	- the range of prefixes (of lut_prefix_length symbols)
+//		  buf, raw_buf				- buffers for the records
+// OUT	: _intersections, _min_sums	- the statistics of the range are added to them
+// RET	: true						- if the *.kmc_suf files were read
+//----------------------------------------------------------------------------------
+bool CKMCSimilarity::ProcessRange(uint64 prefix_start, uint64 prefix_stop, std::vector<uchar> &buf, std::vector<uchar> &raw_buf,
+	std::vector<uint64> &_intersections, std::vector<double> &_min_sums)
+{
+	uint32 no_of_databases = (uint32)databases.size();
+
+	// The records of each (database, bin) are stored in buf with their keys expanded to key_size bytes
+	std::vector<uint64> bin_offsets;
+	std::vector<uint32> first_bin(no_of_databases + 1);
+	uint64 buf_size = 0;
+	for(uint32 d = 0; d < no_of_databases; ++d)
+	{
+		CKMCFile &db = *databases[d];
+		uint32 shift = 2 * (db.lut_prefix_length - lut_prefix_length);
+		uint64 no_of_bins = (db.prefix_file_buf_size - 1) / db.single_LUT_size;
+
+		first_bin[d] = (uint32)bin_offsets.size();
+		for(uint64 b = 0; b < no_of_bins; ++b)
+		{
+			uint64 lut_start = b * db.single_LUT_size;
+			bin_offsets.push_back(buf_size);
+			buf_size += (LUTEntry(db, lut_start + (prefix_stop << shift)) - LUTEntry(db, lut_start + (prefix_start << shift))) * (key_size + db.counter_size);
+		}
+	}
+	first_bin[no_of_databases] = (uint32)bin_offsets.size();
+	if(buf.size() < buf_size)
+		buf.resize(buf_size);
+
+	for(uint32 d = 0; d < no_of_databases; ++d)
+	{
+		CKMCFile &db = *databases[d];
+		uint32 shift = 2 * (db.lut_prefix_length - lut_prefix_length);
+		uint32 head_size = key_size - db.sufix_size;
+
+		FILE *file_suf = my_fopen((file_names[d] + ".kmc_suf").c_str(), "rb");
+		if(!file_suf)
+			return false;
+
+		for(uint32 b = first_bin[d]; b < first_bin[d + 1]; ++b)
+		{
+			uint64 lut_start = (uint64)(b - first_bin[d]) * db.single_LUT_size;
+			uint64 rec_start = LUTEntry(db, lut_start + (prefix_start << shift));
+			uint64 rec_stop = LUTEntry(db, lut_start + (prefix_stop << shift));
+			if(rec_start == rec_stop)
+				continue;
+
+			uint64 bytes = (rec_stop - rec_start) * db.sufix_rec_size;
+			uchar *dest = buf.data() + bin_offsets[b];
+			uchar *src = dest;
+			if(head_size)
+			{
+				if(raw_buf.size() < bytes)
+					raw_buf.resize(bytes);
+				src = raw_buf.data();
+			}
+
+			my_fseek(file_suf, 4 + rec_start * db.sufix_rec_size, SEEK_SET);
+			if(fread(src, 1, bytes, file_suf) != bytes)
+			{
+				fclose(file_suf);
+				return false;
+			}
+
+			// Prepend the symbols of the longer prefix of each record
+			if(head_size)
+			{
+				uint64 lut_pos = lut_start + (prefix_start << shift);
+				for(uint64 r = rec_start; r < rec_stop; ++r)
+				{
+					while(LUTEntry(db, lut_pos + 1) <= r)
+						++lut_pos;
+					uint64 prefix = lut_pos - lut_start;
+					for(uint32 i = 0; i < head_size; ++i)
+						*dest++ = (uchar)(prefix >> (8 * (head_size - 1 - i)));
+					memcpy(dest, src, db.sufix_rec_size);
+					dest += db.sufix_rec_size;
+					src += db.sufix_rec_size;
+				}
+			}
+		}
+		fclose(file_suf);
+	}
+
+	uint32 _key_size = key_size;
+	auto greater = [_key_size](const CRun &x, const CRun &y) {
+		return memcmp(x.cur, y.cur, _key_size) > 0;
+	};
+
+	std::vector<CRun> heap;
+	std::vector<std::pair<uint32, float> > present;
+	for(uint64 p = prefix_start; p < prefix_stop; ++p)
+	{
+		heap.clear();
+		for(uint32 d = 0; d < no_of_databases; ++d)
+		{
+			CKMCFile &db = *databases[d];
+			uint32 shift = 2 * (db.lut_prefix_length - lut_prefix_length);
+			uint64 rec_size = key_size + db.counter_size;
+
+			for(uint32 b = first_bin[d]; b < first_bin[d + 1]; ++b)
+			{
+				uint64 lut_start = (uint64)(b - first_bin[d]) * db.single_LUT_size;
+				uint64 range_start = LUTEntry(db, lut_start + (prefix_start << shift));
+				uint64 rec_start = LUTEntry(db, lut_start + (p << shift));
+				uint64 rec_stop = LUTEntry(db, lut_start + ((p + 1) << shift));
+				if(rec_start == rec_stop)
+					continue;
+
+				CRun run;
+				run.cur = buf.data() + bin_offsets[b] + (rec_start - range_start) * rec_size;
+				run.end = run.cur + (rec_stop - rec_start) * rec_size;
+				run.db = d;
+				heap.push_back(run);
+			}
+		}
+		std::make_heap(heap.begin(), heap.end(), greater);
+
+		while(!heap.empty())
+		{
+			// Gather the counters of the smallest kmer from all the runs starting with it
+			const uchar *key = heap.front().cur;
+			present.clear();
+			do
+			{
+				std::pop_heap(heap.begin(), heap.end(), greater);
+				CRun &run = heap.back();
+				CKMCFile &db = *databases[run.db];
+
+				float count = db.GetCounter((uchar *)run.cur + key_size);
+				if(count >= db.min_count && count <= db.max_count)
+					present.push_back(std::make_pair(run.db, count));
+
+				run.cur += key_size + db.counter_size;
+				if(run.cur < run.end)
+					std::push_heap(heap.begin(), heap.end(), greater);
+				else
+					heap.pop_back();
+			} while(!heap.empty() && memcmp(heap.front().cur, key, key_size) == 0);
+
+			for(uint32 i = 0; i < present.size(); ++i)
+			{
+				uint32 d_i = present[i].first;
+				_intersections[(uint64)d_i * no_of_databases + d_i]++;
+				if(weighted)
+					_min_sums[(uint64)d_i * no_of_databases + d_i] += present[i].second;
+
+				for(uint32 j = i + 1; j < present.size(); ++j)
+				{
+					uint32 d_j = present[j].first;
+					uint64 pos = (uint64)MIN(d_i, d_j) * no_of_databases + MAX(d_i, d_j);
+					_intersections[pos]++;
+					if(weighted)
+						_min_sums[pos] += MIN(present[i].second, present[j].second);
+				}
+			}
+		}
+	}
+	return true;
+}
+//----------------------------------------------------------------------------------
+// Compare all the databases in a single pass over their records
+// IN	: no_of_threads		- the number of threads
+//		  max_range_bytes	- the maximal size of records read at once by a thread
+//		  _weighted			- if the sums of minimal counters should be gathered
+// RET	: true				- if successful
+//----------------------------------------------------------------------------------
+bool CKMCSimilarity::Compute(uint32 no_of_threads, uint64 max_range_bytes, bool _weighted)
+{
+	if(databases.empty())
+		return false;
+	no_of_threads = MAX(no_of_threads, 1u);
+	weighted = _weighted;
+
+	uint64 total_bytes = 0;
+	for(uint32 d = 0; d < databases.size(); ++d)
+		total_bytes += databases[d]->total_kmers * (key_size + databases[d]->counter_size);
+	max_range_bytes = MIN(max_range_bytes, total_bytes / (no_of_threads * RANGES_PER_THREAD) + 1);
+
+	std::vector<uint64> range_bounds;
+	PlanRanges(max_range_bytes, range_bounds);
+
+	uint64 matrix_size = (uint64)databases.size() * databases.size();
+	std::vector<std::vector<uint64> > thr_intersections(no_of_threads, std::vector<uint64>(matrix_size, 0));
+	std::vector<std::vector<double> > thr_min_sums(no_of_threads, std::vector<double>(weighted ? matrix_size : 0, 0.0));
+
+	std::atomic<uint64> next_range(0);
+	std::atomic<bool> failed(false);
+	std::vector<std::thread> threads;
+	for(uint32 t = 0; t < no_of_threads; ++t)
+		threads.push_back(std::thread([&, t]{
+			std::vector<uchar> buf, raw_buf;
+			uint64 r;
+			while(!failed && (r = next_range++) + 1 < range_bounds.size())
+				if(!ProcessRange(range_bounds[r], range_bounds[r + 1], buf, raw_buf, thr_intersections[t], thr_min_sums[t]))
+					failed = true;
+		}));
+	for(uint32 t = 0; t < no_of_threads; ++t)
+		threads[t].join();
+
+	if(failed)
+	{
+		intersections.clear();
+		min_sums.clear();
+		return false;
+	}
+
+	intersections.assign(matrix_size, 0);
+	min_sums.assign(weighted ? matrix_size : 0, 0.0);
+	for(uint32 t = 0; t < no_of_threads; ++t)
+		for(uint64 i = 0; i < matrix_size; ++i)
+		{
+			intersections[i] += thr_intersections[t][i];
+			if(weighted)
+				min_sums[i] += thr_min_sums[t][i];
+		}
+	return true;
+}
+//----------------------------------------------------------------------------------
+uint64 CKMCSimilarity::KmerCount(uint32 i)
+{
+	return Intersection(i, i);
+}
+//----------------------------------------------------------------------------------
+uint64 CKMCSimilarity::Intersection(uint32 i, uint32 j)
+{
+	if(intersections.empty())
+		return 0;
+	return intersections[(uint64)MIN(i, j) * databases.size() + MAX(i, j)];
+}
+//----------------------------------------------------------------------------------
+uint64 CKMCSimilarity::Union(uint32 i, uint32 j)
+{
+	return KmerCount(i) + KmerCount(j) - Intersection(i, j);
+}
+//----------------------------------------------------------------------------------
+double CKMCSimilarity::Jaccard(uint32 i, uint32 j)
+{
+	uint64 _union = Union(i, j);
+	return _union ? (double)Intersection(i, j) / _union : 0.0;
+}
+//----------------------------------------------------------------------------------
+double CKMCSimilarity::Containment(uint32 i, uint32 j)
+{
+	uint64 kmer_count = KmerCount(i);
+	return kmer_count ? (double)Intersection(i, j) / kmer_count : 0.0;
+}
+//----------------------------------------------------------------------------------
+// Weighted Jaccard index; sum(max(count_i, count_j)) = sum(count_i) + sum(count_j) - sum(min(count_i, count_j))
+//----------------------------------------------------------------------------------
+double CKMCSimilarity::WeightedJaccard(uint32 i, uint32 j)
+{
+	if(min_sums.empty())
+		return 0.0;
+
+	uint64 no_of_databases = databases.size();
+	double min_sum = min_sums[(uint64)MIN(i, j) * no_of_databases + MAX(i, j)];
+	double max_sum = min_sums[i * no_of_databases + i] + min_sums[j * no_of_databases + j] - min_sum;
+	return max_sum > 0.0 ? min_sum / max_sum : 0.0;
+}
+
+// ***** EOF
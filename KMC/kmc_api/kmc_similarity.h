@@ -0,0 +1,113 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+
+#ifndef _KMC_SIMILARITY_H
+#define _KMC_SIMILARITY_H
+
+#include "kmer_defs.h"
+#include "kmc_file.h"
+#include <string>
+#include <vector>
+
+// All-versus-all comparison of many databases of the same kmer length and spaced kmer mask (e.g. one per sample).
+// The *.kmc_suf files are read in a single pass: the space of prefixes of the shortest LUT prefix
+// length is split into ranges, and for each prefix the sorted runs of records of all the bins of
+// all the databases are merged, so that each distinct kmer is seen once together with its counters
+// in the databases containing it. The ranges are processed by many threads. The databases may have
+// different numbers of bins, signature maps and LUT prefix lengths.
+// The pass gives the sizes of all pairwise intersections (and, if weighted, the sums of minimal
+// counters); unions, Jaccard and containment indices are derived from them.
+// Only *.kmc_pre files are kept in RAM; the records of a range of prefixes are read at once.
+class CKMCSimilarity
+{
+	struct CRun
+	{
+		const uchar *cur;
+		const uchar *end;
+		uint32 db;
+	};
+
+	std::vector<CKMCFile*> databases;
+	std::vector<std::string> file_names;
+
+	uint32 kmer_length;
+	uint32 lut_prefix_length;				// the shortest LUT prefix length of the databases
+	uint32 key_size;						// the bytes of a kmer after the first lut_prefix_length symbols
+
+	bool weighted;
+	std::vector<uint64> intersections;		// no_of_databases^2, [i][i] are the numbers of kmers
+	std::vector<double> min_sums;			// as above, for the sums of (minimal) counters
+
+	// Split the prefixes into ranges of at most max_range_bytes of records. Auxiliary function.
+	void PlanRanges(uint64 max_range_bytes, std::vector<uint64> &range_bounds);
+
+	// Merge the records of a range of prefixes and accumulate their statistics. Auxiliary function.
+	bool ProcessRange(uint64 prefix_start, uint64 prefix_stop, std::vector<uchar> &buf, std::vector<uchar> &raw_buf,
+		std::vector<uint64> &_intersections, std::vector<double> &_min_sums);
+
+	// Return the index of the first record of a LUT entry of a database. Auxiliary function.
+	inline uint64 LUTEntry(const CKMCFile &db, uint64 lut_pos);
+
+public:
+	CKMCSimilarity();
+	~CKMCSimilarity();
+
+	// Open the databases (only *.kmc_pre are read). They must have the same kmer length and mask
+	bool Open(const std::vector<std::string> &_file_names);
+
+	// Release memory of all the databases
+	bool Close();
+
+	// Return the number of opened databases
+	uint32 NoOfDatabases(void);
+
+	// Access a database, e.g. to set its min_count and max_count before Compute
+	CKMCFile& Database(uint32 i);
+
+	// Compare all the databases using no_of_threads threads, each of them reading at most
+	// max_range_bytes of records at once. If _weighted, the sums of minimal counters are gathered too.
+	// Return false if a *.kmc_suf file cannot be read
+	bool Compute(uint32 no_of_threads, uint64 max_range_bytes, bool _weighted = false);
+
+	// Statistics of the last Compute. Kmers with counters outside [min_count, max_count] of a database
+	// are treated as absent from it.
+	// Return the number of kmers of database i
+	uint64 KmerCount(uint32 i);
+
+	// Return the number of kmers present in both database i and database j
+	uint64 Intersection(uint32 i, uint32 j);
+
+	// Return the number of kmers present in database i or database j
+	uint64 Union(uint32 i, uint32 j);
+
+	// Return |i & j| / |i | j|
+	double Jaccard(uint32 i, uint32 j);
+
+	// Return |i & j| / |i|, the fraction of kmers of database i present in database j
+	double Containment(uint32 i, uint32 j);
+
+	// Return sum(min(count_i, count_j)) / sum(max(count_i, count_j)) over all kmers. Only if weighted
+	double WeightedJaccard(uint32 i, uint32 j);
+};
+
+//----------------------------------------------------------------------------------
+// Return the index of the first record of a LUT entry; the guard is clipped to total_kmers
+// IN	: db		- a database
+//		  lut_pos	- the index of the entry in prefix_file_buf
+// RET	: the index of the record
+//----------------------------------------------------------------------------------
+inline uint64 CKMCSimilarity::LUTEntry(const CKMCFile &db, uint64 lut_pos)
+{
+	return MIN(db.prefix_file_buf[lut_pos], db.total_kmers);
+}
+
+#endif
+
+// ***** EOF
@@ -32,6 +32,7 @@ protected:
 	uint32 no_of_rows;				// A number of 64-bits words allocated for kmer_data 	
 
 	friend class CKMCFile;
+	friend class CKMCMultiFile;
 
 public:
 	static const char char_codes[];
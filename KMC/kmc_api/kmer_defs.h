@@ -16,6 +16,14 @@
 #define KMC_DATE	"2014-07-04"
 
 #define MIN(x,y)	((x) < (y) ? (x) : (y))
+#define MAX(x,y)	((x) > (y) ? (x) : (y))
+
+#ifdef WIN32
+	#include <xmmintrin.h>
+	#define KMC_PREFETCH(p)	_mm_prefetch((const char *)(p), _MM_HINT_T0)
+#else
+	#define KMC_PREFETCH(p)	__builtin_prefetch(p)
+#endif
 
 #ifndef WIN32
 	#include <stdint.h>
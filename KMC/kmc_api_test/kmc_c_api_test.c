@@ -0,0 +1,287 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  This file tests the C interface of kmc_api (libkmc_api). It is compiled with a C compiler
+  and linked against the shared library. The database given is checked against the k-mers
+  of the FASTA file it was built from (kmc -k<k> -m4 -ci1 -fa), counted here by brute force.
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kmc_c_api.h"
+
+#define MAX_READ_LEN	4096
+#define LIST_CAPACITY	7			// small, so that listing takes many calls
+
+static int n_failed = 0;
+
+#define CHECK(cond, msg) \
+	do { if(!(cond)) { printf("FAIL: %s (line %d)\n", msg, __LINE__); n_failed++; } } while(0)
+
+static size_t kmer_bytes;
+
+//----------------------------------------------------------------------------------
+static int cmp_kmers(const void *a, const void *b)
+{
+	return memcmp(a, b, kmer_bytes);
+}
+
+//----------------------------------------------------------------------------------
+// Find a packed kmer among the sorted distinct kmers
+// RET	: its index or -1 if absent
+//----------------------------------------------------------------------------------
+static long find_kmer(const uint8_t *kmers, size_t n, const uint8_t *kmer)
+{
+	const uint8_t *p = (const uint8_t*) bsearch(kmer, kmers, n, kmer_bytes, cmp_kmers);
+	return p ? (long)((p - kmers) / kmer_bytes) : -1;
+}
+
+//----------------------------------------------------------------------------------
+// Pack all canonical kmers of the reads, sort them and count the distinct ones
+// OUT	: kmers	 - the distinct kmers, sorted
+//		  counts - their counters
+// RET	: the number of distinct kmers
+//----------------------------------------------------------------------------------
+static size_t count_kmers(const char *file_name, uint32_t k, uint8_t **kmers, float **counts)
+{
+	FILE *in = fopen(file_name, "r");
+	if(!in)
+	{
+		printf("Cannot open %s\n", file_name);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t n = 0, capacity = 1024;
+	uint8_t *all = (uint8_t*) malloc(capacity * kmer_bytes);
+	char line[MAX_READ_LEN];
+	while(fgets(line, sizeof(line), in))
+	{
+		if(line[0] == '>')
+			continue;
+		size_t len = strcspn(line, "\r\n");
+		for(size_t i = 0; i + k <= len; ++i)
+		{
+			if(n == capacity)
+			{
+				capacity *= 2;
+				all = (uint8_t*) realloc(all, capacity * kmer_bytes);
+			}
+			if(kmc_pack_kmer(line + i, k, 1, all + n * kmer_bytes))
+				n++;
+		}
+	}
+	fclose(in);
+
+	qsort(all, n, kmer_bytes, cmp_kmers);
+
+	*kmers = (uint8_t*) malloc(n * kmer_bytes + 1);
+	*counts = (float*) malloc(n * sizeof(float) + 1);
+	size_t n_distinct = 0;
+	for(size_t i = 0; i < n; ++i)
+	{
+		if(n_distinct && memcmp(*kmers + (n_distinct - 1) * kmer_bytes, all + i * kmer_bytes, kmer_bytes) == 0)
+			(*counts)[n_distinct - 1] += 1;
+		else
+		{
+			memcpy(*kmers + n_distinct * kmer_bytes, all + i * kmer_bytes, kmer_bytes);
+			(*counts)[n_distinct++] = 1;
+		}
+	}
+	free(all);
+	return n_distinct;
+}
+
+//----------------------------------------------------------------------------------
+// Find a kmer absent from the reads (in any orientation)
+//----------------------------------------------------------------------------------
+static void absent_kmer(const uint8_t *kmers, size_t n, uint32_t k, uint8_t *kmer)
+{
+	static const char symbols[] = "ACGT";
+	char seq[MAX_READ_LEN];
+	uint32_t x = 12345;
+	do
+	{
+		for(uint32_t i = 0; i < k; ++i)
+		{
+			x = x * 1103515245u + 12345u;
+			seq[i] = symbols[(x >> 16) & 3];
+		}
+		kmc_pack_kmer(seq, k, 1, kmer);
+	} while(find_kmer(kmers, n, kmer) >= 0);
+}
+
+//----------------------------------------------------------------------------------
+// The error returns: NULL handles, a bad path and kmers of a wrong length
+//----------------------------------------------------------------------------------
+static void test_errors(uint32_t k)
+{
+	kmc_db_info info;
+	uint8_t kmer[64] = {0};
+	float count;
+	uint64_t pos = 0;
+	char seq[MAX_READ_LEN];
+
+	CHECK(kmc_open("no/such/kmc/database") == NULL, "kmc_open of a bad path returns NULL");
+	CHECK(kmc_open(NULL) == NULL, "kmc_open(NULL) returns NULL");
+	CHECK(kmc_info(NULL, &info) == 0, "kmc_info of a NULL handle returns 0");
+	CHECK(kmc_set_min_count(NULL, 2) == 0, "kmc_set_min_count of a NULL handle returns 0");
+	CHECK(kmc_set_max_count(NULL, 2) == 0, "kmc_set_max_count of a NULL handle returns 0");
+	CHECK(kmc_lookup(NULL, kmer, &count) == 0, "kmc_lookup of a NULL handle returns 0");
+	CHECK(kmc_lookup_batch(NULL, kmer, 1, &count) == 0, "kmc_lookup_batch of a NULL handle returns 0");
+	CHECK(kmc_list(NULL, &pos, 1, kmer, &count, 1) == 0, "kmc_list of a NULL handle returns 0");
+	kmc_close(NULL);
+
+	// A sequence shorter than k, or with a symbol other than ACGT, cannot be packed
+	memset(seq, 'A', k - 1);
+	seq[k - 1] = '\0';
+	CHECK(kmc_pack_kmer(seq, k, 0, kmer) == 0, "kmc_pack_kmer of k-1 symbols returns 0");
+	CHECK(kmc_pack_kmer(seq, k, 1, kmer) == 0, "kmc_pack_kmer of k-1 symbols (canonical) returns 0");
+	memset(seq, 'A', k);
+	seq[k / 2] = 'N';
+	CHECK(kmc_pack_kmer(seq, k, 1, kmer) == 0, "kmc_pack_kmer of a kmer with N returns 0");
+}
+
+//----------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	if(argc < 4)
+	{
+		printf("Usage: kmc_api_test <kmc_database> <reads.fa> <k>\n");
+		printf("The database is to be built by: kmc -k<k> -m4 -ci1 -fa <reads.fa> <kmc_database> <tmp_dir>\n");
+		return EXIT_FAILURE;
+	}
+	uint32_t k = (uint32_t) atoi(argv[3]);
+	kmer_bytes = kmc_kmer_bytes(k);
+
+	CHECK(kmc_api_version() == KMC_C_API_VERSION, "kmc_api_version");
+	test_errors(k);
+
+	// Open and info
+	kmc_db *db = kmc_open(argv[1]);
+	if(!db)
+	{
+		printf("FAIL: cannot open %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	kmc_db_info info;
+	CHECK(kmc_info(db, &info) == 1, "kmc_info");
+	if(info.kmer_length != k)
+	{
+		printf("FAIL: the database has k = %u, expected %u\n", info.kmer_length, k);
+		kmc_close(db);
+		return EXIT_FAILURE;
+	}
+	CHECK(info.mode == 0, "info.mode");
+	CHECK(info.min_count == 1, "info.min_count (the database is to be built with -ci1)");
+
+	uint8_t *kmers;
+	float *counts;
+	size_t n = count_kmers(argv[2], k, &kmers, &counts);
+	CHECK(info.total_kmers == n, "info.total_kmers equals the no. of distinct canonical kmers");
+
+	// Pack and unpack
+	char seq[MAX_READ_LEN];
+	uint8_t *kmer = (uint8_t*) malloc(kmer_bytes);
+	for(size_t i = 0; i < n; ++i)
+	{
+		kmc_unpack_kmer(kmers + i * kmer_bytes, k, seq);
+		CHECK(kmc_pack_kmer(seq, k, 0, kmer) == 1 && memcmp(kmer, kmers + i * kmer_bytes, kmer_bytes) == 0,
+			"unpacking and packing a kmer gives it back");
+	}
+
+	// Lookup: every kmer with its counter, its reverse complement as canonical, no absent kmer
+	size_t n_palindromes = 0;
+	for(size_t i = 0; i < n; ++i)
+	{
+		float count = -1;
+		CHECK(kmc_lookup(db, kmers + i * kmer_bytes, &count) == 1 && count == counts[i], "kmc_lookup of a kmer");
+
+		char rc[MAX_READ_LEN];
+		kmc_unpack_kmer(kmers + i * kmer_bytes, k, seq);
+		for(uint32_t j = 0; j < k; ++j)
+			rc[k - 1 - j] = seq[j] == 'A' ? 'T' : seq[j] == 'C' ? 'G' : seq[j] == 'G' ? 'C' : 'A';
+		CHECK(kmc_pack_kmer(rc, k, 1, kmer) == 1 && memcmp(kmer, kmers + i * kmer_bytes, kmer_bytes) == 0,
+			"canonical packing of the reverse complement");
+		kmc_pack_kmer(rc, k, 0, kmer);
+		if(memcmp(kmer, kmers + i * kmer_bytes, kmer_bytes) == 0)
+			n_palindromes++;
+		else
+			CHECK(kmc_lookup(db, kmer, NULL) == 0, "kmc_lookup of a non-canonical kmer returns 0");
+	}
+	absent_kmer(kmers, n, k, kmer);
+	CHECK(kmc_lookup(db, kmer, NULL) == 0, "kmc_lookup of an absent kmer returns 0");
+
+	// Batched lookup: all the kmers followed by an absent one
+	uint8_t *batch = (uint8_t*) malloc((n + 1) * kmer_bytes);
+	float *batch_counts = (float*) malloc((n + 1) * sizeof(float));
+	memcpy(batch, kmers, n * kmer_bytes);
+	memcpy(batch + n * kmer_bytes, kmer, kmer_bytes);
+	CHECK(kmc_lookup_batch(db, batch, n + 1, batch_counts) == n, "kmc_lookup_batch finds all the kmers");
+	for(size_t i = 0; i < n; ++i)
+		CHECK(batch_counts[i] == counts[i], "kmc_lookup_batch counters");
+	CHECK(batch_counts[n] == 0, "kmc_lookup_batch of an absent kmer gives 0");
+
+	// Listing in 3 ranges, a few kmers per call
+	uint8_t *listed = (uint8_t*) malloc((n + LIST_CAPACITY) * kmer_bytes);
+	float *listed_counts = (float*) malloc((n + LIST_CAPACITY) * sizeof(float));
+	size_t n_listed = 0;
+	for(uint64_t r = 0; r < 3; ++r)
+	{
+		uint64_t pos = info.total_kmers * r / 3;
+		uint64_t end = info.total_kmers * (r + 1) / 3;
+		while(pos < end)
+		{
+			uint64_t prev_pos = pos;
+			uint64_t no = kmc_list(db, &pos, end, listed + n_listed * kmer_bytes, listed_counts + n_listed, LIST_CAPACITY);
+			CHECK(no <= LIST_CAPACITY && pos > prev_pos, "kmc_list makes progress within its capacity");
+			if(pos == prev_pos)
+				break;
+			n_listed += no;
+			if(n_listed > n)
+				break;
+		}
+	}
+	CHECK(n_listed == n, "kmc_list lists every kmer once");
+	if(n_listed == n)
+		for(size_t i = 0; i < n; ++i)
+		{
+			long j = find_kmer(kmers, n, listed + i * kmer_bytes);
+			CHECK(j >= 0 && listed_counts[i] == counts[j], "kmc_list kmers and counters");
+		}
+
+	// Thresholds: with min_count 2 the kmers occurring once are ignored
+	size_t n_frequent = 0;
+	for(size_t i = 0; i < n; ++i)
+		n_frequent += counts[i] >= 2;
+	CHECK(kmc_set_min_count(db, 2) == 1, "kmc_set_min_count");
+	CHECK(kmc_lookup_batch(db, batch, n, batch_counts) == n_frequent, "kmc_lookup_batch with min_count 2");
+	for(size_t i = 0; i < n; ++i)
+		CHECK((kmc_lookup(db, kmers + i * kmer_bytes, NULL) == 1) == (counts[i] >= 2), "kmc_lookup with min_count 2");
+	CHECK(kmc_set_min_count(db, 1) == 1, "kmc_set_min_count back to 1");
+
+	kmc_close(db);
+	free(kmers);
+	free(counts);
+	free(kmer);
+	free(batch);
+	free(batch_counts);
+	free(listed);
+	free(listed_counts);
+
+	if(n_failed)
+	{
+		printf("k = %u: %d check(s) failed\n", k, n_failed);
+		return EXIT_FAILURE;
+	}
+	printf("k = %u: %lu kmers (%lu palindromes), all checks passed\n", k, (unsigned long) n, (unsigned long) n_palindromes);
+	return EXIT_SUCCESS;
+}
+
+// ***** EOF
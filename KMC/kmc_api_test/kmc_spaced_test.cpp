@@ -0,0 +1,182 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  This file tests the counting of spaced k-mers. The database given is checked against the spaced
+  k-mers of the FASTA file it was built from (kmc -g<mask> -m4 -ci1 -fa), counted here by brute force:
+  the canonical k-mer of a window is the smaller of the care symbols of the window and of the care
+  symbols of its reverse complement.
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+
+#include "../kmc_api/stdafx.h"
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "../kmc_api/kmc_file.h"
+
+static int n_failed = 0;
+
+#define CHECK(cond, msg) \
+	do { if(!(cond)) { std::cout << "FAIL: " << msg << " (line " << __LINE__ << ")\n"; n_failed++; } } while(0)
+
+//----------------------------------------------------------------------------------
+static std::string reverse_complement(const std::string &seq)
+{
+	std::string rev(seq.rbegin(), seq.rend());
+	for(uint32 i = 0; i < rev.size(); ++i)
+		switch(rev[i])
+		{
+		case 'A': rev[i] = 'T'; break;
+		case 'C': rev[i] = 'G'; break;
+		case 'G': rev[i] = 'C'; break;
+		case 'T': rev[i] = 'A'; break;
+		default: rev[i] = 'N';
+		}
+	return rev;
+}
+
+//----------------------------------------------------------------------------------
+// Return in kmer the symbols of window at the care positions of mask
+// RET	: false if one of them is not ACGT
+//----------------------------------------------------------------------------------
+static bool apply_mask(const std::string &window, const std::string &mask, std::string &kmer)
+{
+	kmer.clear();
+	for(uint32 i = 0; i < mask.size(); ++i)
+		if(mask[i] == '1')
+		{
+			if(window[i] != 'A' && window[i] != 'C' && window[i] != 'G' && window[i] != 'T')
+				return false;
+			kmer.push_back(window[i]);
+		}
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+// Return in kmer the canonical spaced k-mer of a window
+// RET	: false if the window has a symbol other than ACGT at a care position of either strand
+//----------------------------------------------------------------------------------
+static bool canonical_kmer(const std::string &window, const std::string &mask, std::string &kmer)
+{
+	std::string rev_kmer;
+	if(!apply_mask(window, mask, kmer) || !apply_mask(reverse_complement(window), mask, rev_kmer))
+		return false;
+	if(rev_kmer < kmer)
+		kmer.swap(rev_kmer);
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+static bool read_fasta(const char *file_name, std::vector<std::string> &reads)
+{
+	std::ifstream in(file_name);
+	if(!in)
+		return false;
+	std::string line;
+	while(std::getline(in, line))
+	{
+		if(!line.empty() && line[line.size() - 1] == '\r')
+			line.resize(line.size() - 1);
+		if(line.empty())
+			continue;
+		if(line[0] == '>')
+			reads.push_back("");
+		else if(!reads.empty())
+		{
+			for(uint32 i = 0; i < line.size(); ++i)
+				line[i] = toupper(line[i]);
+			reads.back() += line;
+		}
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	if(argc < 4)
+	{
+		std::cout << "Usage: kmc_spaced_test <database> <reads.fa> <mask>\n";
+		std::cout << "  the database must be built by kmc -g<mask> -m4 -ci1 -fa <reads.fa> <database> <tmp_dir>\n";
+		return EXIT_FAILURE;
+	}
+	std::string db_name(argv[1]);
+	std::string mask(argv[3]);
+
+	std::vector<std::string> reads;
+	if(!read_fasta(argv[2], reads))
+	{
+		std::cout << "Cannot read " << argv[2] << "\n";
+		return EXIT_FAILURE;
+	}
+
+	// Brute-force counts
+	std::map<std::string, uint32> counts;
+	std::string kmer;
+	for(uint32 r = 0; r < reads.size(); ++r)
+		for(uint32 i = 0; i + mask.size() <= reads[r].size(); ++i)
+			if(canonical_kmer(reads[r].substr(i, mask.size()), mask, kmer))
+				counts[kmer]++;
+
+	// Listing
+	CKMCFile db;
+	CHECK(db.OpenForListing(db_name), "open for listing");
+	CHECK(db.KmerMask() == mask, "mask of the database");
+	CHECK(db.KmerSpan() == mask.size(), "span of the database");
+
+	CKmerAPI kmer_api(db.KmerLength());
+	std::vector<char> kmer_str(db.KmerLength() + 1);
+	float count;
+	uint64 n_listed = 0, n_wrong = 0;
+	while(db.ReadNextKmer(kmer_api, count))
+	{
+		++n_listed;
+		kmer_api.to_string(kmer_str.data());
+		std::map<std::string, uint32>::iterator it = counts.find(kmer_str.data());
+		if(it == counts.end() || it->second != (uint32)count)
+			++n_wrong;
+	}
+	db.Close();
+	std::cout << "mask " << mask << ": " << counts.size() << " distinct k-mers by brute force, "
+		<< n_listed << " in the database\n";
+	CHECK(n_listed == counts.size(), "number of distinct k-mers");
+	CHECK(n_wrong == 0, "k-mers listed with wrong counters or not in the reads");
+
+	// Random access by windows of both strands
+	CHECK(db.OpenForRA(db_name), "open for random access");
+	uint64 n_windows = 0, n_wrong_windows = 0;
+	for(uint32 r = 0; r < reads.size(); ++r)
+	{
+		std::string rev_read = reverse_complement(reads[r]);
+		for(uint32 i = 0; i + mask.size() <= reads[r].size(); ++i)
+		{
+			std::string window = reads[r].substr(i, mask.size());
+			if(!canonical_kmer(window, mask, kmer))
+				continue;
+			++n_windows;
+			float count_rev;
+			if(!db.CheckWindow(window, count) || (uint32)count != counts[kmer] ||
+				!db.CheckWindow(rev_read.substr(rev_read.size() - i - mask.size(), mask.size()), count_rev) || count_rev != count)
+				++n_wrong_windows;
+		}
+	}
+	db.Close();
+	CHECK(n_windows > 0, "windows to look up");
+	CHECK(n_wrong_windows == 0, "windows looked up with wrong counters or different on both strands");
+
+	if(n_failed)
+	{
+		std::cout << n_failed << " check(s) failed\n";
+		return EXIT_FAILURE;
+	}
+	std::cout << "All checks passed\n";
+	return EXIT_SUCCESS;
+}
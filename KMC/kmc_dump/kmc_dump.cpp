@@ -25,6 +25,7 @@ int _tmain(int argc, char* argv[])
 	int32 i;
 	uint32 min_count_to_set = 0;
 	uint32 max_count_to_set = 0;
+	bool strand_counters = false;
 	std::string input_file_name;
 	std::string output_file_name;
 
@@ -46,6 +47,8 @@ int _tmain(int argc, char* argv[])
 				min_count_to_set = atoi(&argv[i][3]);
 			else if(strncmp(argv[i], "-cx", 3) == 0)
 					max_count_to_set = atoi(&argv[i][3]);
+			else if(strcmp(argv[i], "-s") == 0)
+				strand_counters = true;
 		}
 		else
 			break;
@@ -104,23 +107,48 @@ int _tmain(int argc, char* argv[])
 		if (!(kmer_data_base.SetMaxCount(max_count_to_set)))
 				return EXIT_FAILURE;	
 
-		while (kmer_data_base.ReadNextKmer(kmer_object, counter))
+		if(strand_counters)
 		{
-			kmer_object.to_string(str);
-
-			str[_kmer_length] = '\t';
-			if (_mode)
-				counter_len = CNumericConversions::Double2PChar(counter, 6, (uchar*)str + _kmer_length + 1);
-			else
-				counter_len = CNumericConversions::Int2PChar((uint64)counter, (uchar*)str + _kmer_length + 1);
-
-			str[_kmer_length + 1 + counter_len] = '\n';
-			fwrite(str, 1, _kmer_length + counter_len + 2, out_file);
-
-			/*if(_mode)		
-				fprintf(out_file, "%s\t%f\n", str.c_str(), counter);
-			else
-				fprintf(out_file, "%s\t%d\n", str.c_str(), (int)counter);*/
+			if(!kmer_data_base.StrandResolved())
+			{
+				std::cout << "Error: " << input_file_name << " has no strand-resolved counters (kmc -st)\n";
+				return EXIT_FAILURE;
+			}
+
+			uint32 counter_canonical, counter_rev_compl;
+			while (kmer_data_base.ReadNextKmer(kmer_object, counter_canonical, counter_rev_compl))
+			{
+				kmer_object.to_string(str);
+
+				uint32 pos = _kmer_length;
+				str[pos++] = '\t';
+				pos += CNumericConversions::Int2PChar(counter_canonical, (uchar*)str + pos);
+				str[pos++] = '\t';
+				pos += CNumericConversions::Int2PChar(counter_rev_compl, (uchar*)str + pos);
+				str[pos++] = '\n';
+				fwrite(str, 1, pos, out_file);
+			}
+		}
+		else
+		{
+			while (kmer_data_base.ReadNextKmer(kmer_object, counter))
+			{
+				kmer_object.to_string(str);
+
+				str[_kmer_length] = '\t';
+				if (_mode)
+					counter_len = CNumericConversions::Double2PChar(counter, 6, (uchar*)str + _kmer_length + 1);
+				else
+					counter_len = CNumericConversions::Int2PChar((uint64)counter, (uchar*)str + _kmer_length + 1);
+
+				str[_kmer_length + 1 + counter_len] = '\n';
+				fwrite(str, 1, _kmer_length + counter_len + 2, out_file);
+
+				/*if(_mode)		
+					fprintf(out_file, "%s\t%f\n", str.c_str(), counter);
+				else
+					fprintf(out_file, "%s\t%d\n", str.c_str(), (int)counter);*/
+			}
 		}
 	
 		fclose(out_file);
@@ -141,6 +169,7 @@ void print_info(void)
 	std::cout << "Options:\n";
 	std::cout << "-ci<value> - print k-mers occurring less than <value> times\n";
 	std::cout << "-cx<value> - print k-mers occurring more of than <value> times\n";
+	std::cout << "-s - print the counters of canonical and reverse-complement occurrences (databases built with kmc -st)\n";
 };
 
 // ***** EOF
@@ -0,0 +1,203 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  It compares many kmer_counter's outputs all versus all and prints
+  matrices of their intersection sizes and similarity indices.
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+
+#include "stdafx.h"
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include "../kmc_api/kmc_similarity.h"
+
+
+void print_info(void);
+bool store_matrix(const std::string &file_name, const std::vector<std::string> &names, CKMCSimilarity &similarity, int kind);
+
+enum {matrix_intersection, matrix_jaccard, matrix_containment, matrix_weighted};
+
+int _tmain(int argc, char* argv[])
+{
+	CKMCSimilarity similarity;
+	int32 i;
+	uint32 min_count_to_set = 0;
+	uint32 max_count_to_set = 0;
+	uint32 no_of_threads = 0;
+	uint32 max_mem_size = 1;
+	bool weighted = false;
+	std::string output_prefix;
+	std::vector<std::string> input_file_names;
+
+	//------------------------------------------------------------
+	// Parse input parameters
+	//------------------------------------------------------------
+	if(argc < 3)
+	{
+		print_info();
+		return EXIT_FAILURE;
+	}
+
+	for(i = 1; i < argc; ++i)
+	{
+		if(argv[i][0] == '-')
+		{
+			if(strncmp(argv[i], "-ci", 3) == 0)
+				min_count_to_set = atoi(&argv[i][3]);
+			else if(strncmp(argv[i], "-cx", 3) == 0)
+				max_count_to_set = atoi(&argv[i][3]);
+			else if(strncmp(argv[i], "-t", 2) == 0)
+				no_of_threads = atoi(&argv[i][2]);
+			else if(strncmp(argv[i], "-m", 2) == 0)
+				max_mem_size = MAX(atoi(&argv[i][2]), 1);
+			else if(strncmp(argv[i], "-w", 2) == 0)
+				weighted = true;
+			else if(strncmp(argv[i], "-f", 2) == 0)
+			{
+				std::ifstream list_file(&argv[i][2]);
+				std::string name;
+				if(!list_file)
+				{
+					std::cout << "Error: cannot open file " << &argv[i][2] << "\n";
+					return EXIT_FAILURE;
+				}
+				while(std::getline(list_file, name))
+				{
+					if(!name.empty() && name[name.size() - 1] == '\r')
+						name.erase(name.size() - 1);
+					if(!name.empty())
+						input_file_names.push_back(name);
+				}
+			}
+		}
+		else
+			break;
+	}
+
+	if(argc - i < 1)
+	{
+		print_info();
+		return EXIT_FAILURE;
+	}
+
+	output_prefix = std::string(argv[i++]);
+	for(; i < argc; ++i)
+		input_file_names.push_back(std::string(argv[i]));
+
+	if(input_file_names.size() < 2)
+	{
+		print_info();
+		return EXIT_FAILURE;
+	}
+
+	if(!no_of_threads)
+		no_of_threads = MAX(std::thread::hardware_concurrency(), 1u);
+
+	//------------------------------------------------------------------------------
+	// Open kmer databases, compare them and print the matrices
+	//------------------------------------------------------------------------------
+	if(!similarity.Open(input_file_names))
+	{
+		std::cout << "Error: cannot open the databases or their kmer lengths or spaced kmer masks differ\n";
+		return EXIT_FAILURE;
+	}
+
+	for(uint32 j = 0; j < similarity.NoOfDatabases(); ++j)
+	{
+		if(min_count_to_set)
+		if(!similarity.Database(j).SetMinCount(min_count_to_set))
+			return EXIT_FAILURE;
+		if(max_count_to_set)
+		if(!similarity.Database(j).SetMaxCount(max_count_to_set))
+			return EXIT_FAILURE;
+	}
+
+	if(!similarity.Compute(no_of_threads, ((uint64)max_mem_size << 30) / no_of_threads, weighted))
+	{
+		std::cout << "Error: cannot read the databases\n";
+		return EXIT_FAILURE;
+	}
+
+	if(!store_matrix(output_prefix + ".intersection", input_file_names, similarity, matrix_intersection) ||
+		!store_matrix(output_prefix + ".jaccard", input_file_names, similarity, matrix_jaccard) ||
+		!store_matrix(output_prefix + ".containment", input_file_names, similarity, matrix_containment) ||
+		(weighted && !store_matrix(output_prefix + ".weighted", input_file_names, similarity, matrix_weighted)))
+	{
+		std::cout << "Error: cannot write the output files\n";
+		return EXIT_FAILURE;
+	}
+
+	similarity.Close();
+
+	return EXIT_SUCCESS;
+}
+// -------------------------------------------------------------------------
+// Print a matrix of all pairs of databases as a tab-separated table with
+// the names of the databases in the first row and column
+// -------------------------------------------------------------------------
+bool store_matrix(const std::string &file_name, const std::vector<std::string> &names, CKMCSimilarity &similarity, int kind)
+{
+	FILE *out_file;
+	if((out_file = fopen(file_name.c_str(), "wb")) == NULL)
+		return false;
+
+	uint32 n = similarity.NoOfDatabases();
+	for(uint32 i = 0; i < n; ++i)
+		fprintf(out_file, "\t%s", names[i].c_str());
+	fprintf(out_file, "\n");
+
+	for(uint32 i = 0; i < n; ++i)
+	{
+		fprintf(out_file, "%s", names[i].c_str());
+		for(uint32 j = 0; j < n; ++j)
+			switch(kind)
+			{
+			case matrix_intersection:
+				fprintf(out_file, "\t%llu", similarity.Intersection(i, j));
+				break;
+			case matrix_jaccard:
+				fprintf(out_file, "\t%.6f", similarity.Jaccard(i, j));
+				break;
+			case matrix_containment:
+				fprintf(out_file, "\t%.6f", similarity.Containment(i, j));
+				break;
+			case matrix_weighted:
+				fprintf(out_file, "\t%.6f", similarity.WeightedJaccard(i, j));
+				break;
+			}
+		fprintf(out_file, "\n");
+	}
+
+	fclose(out_file);
+	return true;
+}
+// -------------------------------------------------------------------------
+// Print execution options
+// -------------------------------------------------------------------------
+void print_info(void)
+{
+	std::cout << "KMC similarity ver. " << KMC_VER << " (" << KMC_DATE << ")\n";
+	std::cout << "\nUsage:\nkmc_similarity [options] <output_prefix> <kmc_database_1> <kmc_database_2> ...\n";
+	std::cout << "Parameters:\n";
+	std::cout << "<output_prefix> - the prefix of output files:\n";
+	std::cout << "   <output_prefix>.intersection - the numbers of kmers common to each pair of databases\n";
+	std::cout << "   <output_prefix>.jaccard - Jaccard indices |A & B| / |A | B|\n";
+	std::cout << "   <output_prefix>.containment - containment indices |A & B| / |A| (A in rows)\n";
+	std::cout << "   <output_prefix>.weighted - weighted Jaccard indices sum(min) / sum(max) of counters (with -w)\n";
+	std::cout << "<kmc_database_N> - kmer_counter's outputs of the same kmer length\n";
+	std::cout << "Options:\n";
+	std::cout << "-ci<value> - ignore k-mers occurring less than <value> times\n";
+	std::cout << "-cx<value> - ignore k-mers occurring more of than <value> times\n";
+	std::cout << "-t<value> - total number of threads (default: no. of CPU cores)\n";
+	std::cout << "-m<size> - max amount of RAM in GB; default: 1\n";
+	std::cout << "-w - compute weighted Jaccard indices from counters\n";
+	std::cout << "-f<file_name> - read the names of databases from a file, one per line\n";
+};
+
+// ***** EOF
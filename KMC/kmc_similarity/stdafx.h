@@ -0,0 +1,26 @@
+#ifdef WIN32
+
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+
+#pragma once
+
+#include "targetver.h"
+
+#include <stdio.h>
+#include <tchar.h>
+
+
+
+// TODO: reference additional headers your program requires here
+
+#else
+
+#include <stdio.h>
+#include <ext/algorithm>
+#include <iostream>
+using namespace std;
+
+#endif
\ No newline at end of file
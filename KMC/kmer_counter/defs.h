@@ -36,7 +36,10 @@
 #define EXPAND_BUFFER_RECS (1 << 16)
 
 
-#define MAX_BINS 512
+// Range of number of bins; by default the number is chosen from the input size, memory and no. of threads
+#define MIN_BINS		64
+#define MAX_BINS		2000
+#define DEFAULT_BINS	512
 
 
 #ifndef MAX_K
@@ -45,6 +48,9 @@
 
 #define MIN_K		10
 
+// Maximal span of spaced k-mers (the length of the mask); the mask is stored in the header of *.kmc_pre
+#define MAX_SPAN	1024
+
 #define MIN_MEM		4
 
 // Range of number of FASTQ/FASTA reading threads
@@ -373,7 +373,7 @@ CWFastqReader::CWFastqReader(CKMCParams &Params, CKMCQueues &Queues)
 	part_size		  = Params.fastq_buffer_size;
 	part_queue		  = Queues.part_queue;
 	file_type         = Params.file_type;
-	kmer_len		  = Params.p_k;
+	kmer_len		  = Params.kmer_span;
 
 	gzip_buffer_size  = Params.gzip_buffer_size;
 	bzip2_buffer_size = Params.bzip2_buffer_size;
@@ -425,7 +425,7 @@ CWStatsFastqReader::CWStatsFastqReader(CKMCParams &Params, CKMCQueues &Queues)
 	part_size = Params.fastq_buffer_size;
 	stats_part_queue = Queues.stats_part_queue;
 	file_type = Params.file_type;
-	kmer_len = Params.p_k;
+	kmer_len = Params.kmer_span;
 
 	gzip_buffer_size = Params.gzip_buffer_size;
 	bzip2_buffer_size = Params.bzip2_buffer_size;
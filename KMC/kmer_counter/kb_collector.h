@@ -37,6 +37,7 @@ class CKmerBinCollector
 	CBinPartQueue *bin_part_queue;
 	CBinDesc *bd;
 	uint32 kmer_len;
+	uint32 kmer_span;		// the no. of symbols of the first k-mer of an extended k-mer
 	uchar* buffer;
 	uint32 buffer_size;
 	uint32 buffer_pos;
@@ -67,6 +68,7 @@ CKmerBinCollector::CKmerBinCollector(CKMCQueues& Queues, CKMCParams& Params, uin
 {
 	bin_part_queue	= Queues.bpq;
 	kmer_len		= Params.kmer_len;
+	kmer_span		= Params.kmer_span;
 	bd				= Queues.bd;
 	buffer_size		= _buffer_size;	
 	pmm_bins		= Queues.pmm_bins;
@@ -100,7 +102,7 @@ void CKmerBinCollector::PutExtendedKmer(char* seq, uint32 n)
 	}
 	
 	
-	buffer[buffer_pos++] = n - kmer_len;		
+	buffer[buffer_pos++] = n - kmer_span;		
 	for(uint32 i = 0, j = 0 ; i < n / 4 ; ++i,j+=4)
 		buffer[buffer_pos++] = (seq[j] << 6) + (seq[j + 1] << 4) + (seq[j + 2] << 2) + seq[j + 3];
 	switch (n%4)
@@ -117,7 +119,7 @@ void CKmerBinCollector::PutExtendedKmer(char* seq, uint32 n)
 	}
 
 	++n_super_kmers;
-	n_recs += n - kmer_len + 1;
+	n_recs += n - kmer_span + 1;
 	if (max_x) ///for max_x = 0 k-mers (not k+x-mers) will be sorted
 	{
 		if (!both_strands)
@@ -39,6 +39,7 @@ CKmerBinCompleter::CKmerBinCompleter(CKMCParams &Params, CKMCQueues &Queues)
 
 	kmer_len       = Params.kmer_len;
 	signature_len  = Params.signature_len;
+	mask           = Params.p_mask;
 
 	cutoff_min     = Params.cutoff_min;
 	cutoff_max     = Params.cutoff_max;
@@ -48,11 +49,26 @@ CKmerBinCompleter::CKmerBinCompleter(CKMCParams &Params, CKMCQueues &Queues)
 	kmer_t_size    = Params.KMER_T_size;
 
 	use_quake      = Params.use_quake;
+
+	if(use_quake)
+		counter_size = 4;
+	else
+		counter_size = min(BYTE_LOG(cutoff_max), BYTE_LOG(counter_max));
+
+	// Strand-resolved databases store two counters per k-mer: canonical and reverse-complement orientation
+	strand_counts  = Params.strand_counts;
+	if(strand_counts)
+		counter_size *= 2;
+
+	sketch         = CKmerSketch::Enabled(Params) ? new CKmerSketch(Params, counter_size) : NULL;
+	store_database = !Params.p_sketch_only;
 }
 
 //----------------------------------------------------------------------------------
 CKmerBinCompleter::~CKmerBinCompleter()
 {
+	if(sketch)
+		delete sketch;
 }
 
 //----------------------------------------------------------------------------------
@@ -64,32 +80,32 @@ void CKmerBinCompleter::ProcessBins()
 	uint64 data_size = 0;
 	uchar *lut = NULL;
 	uint64 lut_size = 0;
-	uint64 counter_size = 0;
 	uint32 sig_map_size = (1 << (signature_len * 2)) + 1;
 	uint32 *sig_map = new uint32[sig_map_size];
 	fill_n(sig_map, sig_map_size, 0);
 	uint32 lut_pos = 0;
-	if(use_quake)
-		counter_size = 4;
-	else
-		counter_size = min(BYTE_LOG(cutoff_max), BYTE_LOG(counter_max));	
 	
 	// Open output file
-	FILE *out_kmer = fopen(kmer_file_name.c_str(), "wb");
-	if(!out_kmer)
+	FILE *out_kmer = NULL;
+	FILE *out_lut = NULL;
+	if(store_database)
 	{
-		cout << "Error: Cannot create " << kmer_file_name << "\n";
-		exit(1);
-		return;
-	}
+		out_kmer = fopen(kmer_file_name.c_str(), "wb");
+		if(!out_kmer)
+		{
+			cout << "Error: Cannot create " << kmer_file_name << "\n";
+			exit(1);
+			return;
+		}
 
-	FILE *out_lut = fopen(lut_file_name.c_str(), "wb");
-	if(!out_lut)
-	{
-		cout << "Error: Cannot create " << lut_file_name << "\n";
-		fclose(out_kmer);
-		exit(1);
-		return;
+		out_lut = fopen(lut_file_name.c_str(), "wb");
+		if(!out_lut)
+		{
+			cout << "Error: Cannot create " << lut_file_name << "\n";
+			fclose(out_kmer);
+			exit(1);
+			return;
+		}
 	}
 
 	uint64 _n_unique, _n_cutoff_min, _n_cutoff_max, _n_total;
@@ -102,8 +118,11 @@ void CKmerBinCompleter::ProcessBins()
 	char s_kmc_suf[] = "KMCS";
 
 	// Markers at the beginning
-	fwrite(s_kmc_pre, 1, 4, out_lut);
-	fwrite(s_kmc_suf, 1, 4, out_kmer);
+	if(store_database)
+	{
+		fwrite(s_kmc_pre, 1, 4, out_lut);
+		fwrite(s_kmc_suf, 1, 4, out_kmer);
+	}
 
 	// Process priority queue of ready-to-output bins
 	while(!kq->empty())
@@ -123,19 +142,25 @@ void CKmerBinCompleter::ProcessBins()
 		bd->read(bin_id, file, name, raw_size, n_rec, n_plus_x_recs, n_super_kmers);
 
 		uint64 lut_recs        = lut_size / sizeof(uint64);
+		uint64 *ulut = (uint64*) lut;
+
+		// The sketch needs the no. of records of each prefix, before the LUT is made cumulative
+		if(sketch)
+			sketch->AddBin(data, data_size, ulut, lut_recs);
 		
 		// Write bin data to the output file
-		fwrite(data, 1, data_size, out_kmer);
+		if(store_database)
+			fwrite(data, 1, data_size, out_kmer);
 		memory_bins->free(bin_id, CMemoryBins::mba_suffix);
 
-		uint64 *ulut = (uint64*) lut;
 		for(uint64 i = 0; i < lut_recs; ++i)
 		{
 			uint64 x  = ulut[i];
 			ulut[i]   = n_recs;
 			n_recs   += x;
 		}
-		fwrite(lut, lut_recs, sizeof(uint64), out_lut);
+		if(store_database)
+			fwrite(lut, lut_recs, sizeof(uint64), out_lut);
 		//fwrite(&n_rec, 1, sizeof(uint64), out_lut);
 		memory_bins->free(bin_id, CMemoryBins::mba_lut);
 
@@ -153,6 +178,21 @@ void CKmerBinCompleter::ProcessBins()
 		++lut_pos;
 	}
 	
+	if(sketch)
+	{
+		string sketch_file_name = file_name + ".kmc_sketch";
+		if(!sketch->Store(sketch_file_name))
+			exit(1);
+		cout << "\nSketch of " << sketch->Size() << " k-mers stored in " << sketch_file_name;
+	}
+
+	if(!store_database)
+	{
+		cout << "\n";
+		delete[] sig_map;
+		return;
+	}
+
 	// Marker at the end
 	fwrite(s_kmc_suf, 1, 4, out_kmer);
 	fclose(out_kmer);
@@ -174,12 +214,29 @@ void CKmerBinCompleter::ProcessBins()
 	store_uint(out_lut, cutoff_max, 4);				offset += 4;
 	store_uint(out_lut, n_unique - n_cutoff_min - n_cutoff_max, 8);		offset += 8;
 
+	// Span of spaced k-mers (0 for contiguous k-mers)
+	store_uint(out_lut, mask.size(), 4);			offset += 4;
+
+	// Strand-resolved counters (1) or a single counter (0)
+	store_uint(out_lut, (uint32) strand_counts, 4);	offset += 4;
+
 	// Space for future use
-	for(int32 i = 0; i < 7; ++i)
+	for(int32 i = 0; i < 5; ++i)
 	{
 		store_uint(out_lut, 0, 4);
 		offset += 4;
 	}
+
+	// Mask of spaced k-mers, bit i of word i / 32 set for a care position i
+	for(uint32 i = 0; i < mask.size(); i += 32)
+	{
+		uint32 word = 0;
+		for(uint32 j = i; j < mask.size() && j < i + 32; ++j)
+			if(mask[j] == '1')
+				word |= 1u << (j - i);
+		store_uint(out_lut, word, 4);
+		offset += 4;
+	}
 	
 	store_uint(out_lut, 0x200, 4);
 	offset += 4;
@@ -14,6 +14,7 @@
 #include "params.h"
 #include "kmer.h"
 #include "radix.h"
+#include "kmer_sketch.h"
 #include <string>
 #include <algorithm>
 #include <numeric>
@@ -39,7 +40,13 @@ class CKmerBinCompleter {
 	int32 counter_max;
 	int32 kmer_len;
 	int32 signature_len;
+	string mask;				// mask of spaced k-mers (empty for contiguous k-mers)
 	bool use_quake;
+	bool strand_counts;
+	uint32 counter_size;
+
+	CKmerSketch *sketch;		// NULL if no sketch is built
+	bool store_database;
 
 	bool store_uint(FILE *out, uint64 x, uint32 size);
 
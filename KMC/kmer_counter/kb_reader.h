@@ -44,6 +44,7 @@ template <typename KMER_T, unsigned SIZE> class CKmerBinReader {
 	uint32 max_x;
 
 	bool both_strands;
+	bool strand_counts;
 	bool use_quake;
 
 	int64 round_up_to_alignment(int64 x)
@@ -77,6 +78,7 @@ template <typename KMER_T, unsigned SIZE> CKmerBinReader<KMER_T, SIZE>::CKmerBin
 	cutoff_max     = Params.cutoff_max;
 	counter_max    = Params.counter_max;
 	both_strands   = Params.both_strands;
+	strand_counts  = Params.strand_counts;
 	use_quake = Params.use_quake;
 	max_x = Params.max_x;
 	s_mapper	   = Queues.s_mapper;
@@ -130,13 +132,15 @@ template <typename KMER_T, unsigned SIZE> void CKmerBinReader<KMER_T, SIZE>::Pro
 		{
 			input_kmer_size = n_rec * sizeof(KMER_T); 
 			kxmer_counter_size = 0;
-			kxmer_symbols = kmer_len;
+			kxmer_symbols = kmer_len + (strand_counts ? 1 : 0);	// the orientation is sorted as an additional symbol
 		}
 		uint64 max_out_recs    = (n_rec+1) / max(cutoff_min, 1);	
 		
 		uint64 counter_size    = min(BYTE_LOG(cutoff_max), BYTE_LOG(counter_max));
 		if(KMER_T::QUALITY_SIZE > counter_size)
 			counter_size = KMER_T::QUALITY_SIZE;
+		if(strand_counts)
+			counter_size *= 2;
 
 		uint32 kmer_symbols = kmer_len - lut_prefix_len;
 		uint64 kmer_bytes = kmer_symbols / 4;
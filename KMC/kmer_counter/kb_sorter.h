@@ -57,6 +57,9 @@ template <typename KMER_T, unsigned SIZE> class CKmerBinSorter {
 	string desc;
 	uint32 buffer_size;
 	uint32 kmer_len;
+	uint32 kmer_span;
+	vector<uint32> mask_positions;		// care positions of spaced k-mers (empty for contiguous k-mers)
+	vector<uint32> mirror_positions;	// care positions of the reverse complement of a window
 	uint32 max_x;
 
 	//KMC_2 : usunac te zmienne potem
@@ -66,6 +69,7 @@ template <typename KMER_T, unsigned SIZE> class CKmerBinSorter {
 	int n_omp_threads;
 
 	bool both_strands;
+	bool strand_counts;		// the orientation of each canonical k-mer is appended as a symbol (0: canonical, 1: reverse complement)
 	bool use_quake;
 	CSignatureMapper* s_mapper;
 
@@ -117,10 +121,12 @@ template <unsigned SIZE> class CKmerBinSorter_Impl<CKmer<SIZE>, SIZE> {
 	static void CompactKxmers(CKmerBinSorter<CKmer<SIZE>, SIZE> &ptr);
 	static void PreCompactKxmers(CKmerBinSorter<CKmer<SIZE>, SIZE> &ptr, uint64& compacted_count);
 	static void CompactKmers(CKmerBinSorter<CKmer<SIZE>, SIZE> &ptr);
+	static void CompactStrandKmers(CKmerBinSorter<CKmer<SIZE>, SIZE> &ptr);
 	static void ExpandKxmersAll(CKmerBinSorter<CKmer<SIZE>, SIZE>& ptr, uint64 tmp_size);
 	static void ExpandKxmersBoth(CKmerBinSorter<CKmer<SIZE>, SIZE>& ptr, uint64 tmp_size);
 	static void ExpandKmersAll(CKmerBinSorter<CKmer<SIZE>, SIZE>& ptr, uint64 tmp_size);
 	static void ExpandKmersBoth(CKmerBinSorter<CKmer<SIZE>, SIZE>& ptr, uint64 tmp_size);
+	static void ExpandMaskedKmers(CKmerBinSorter<CKmer<SIZE>, SIZE>& ptr, uint64 tmp_size);
 	static void GetNextSymb(uchar& symb, uchar& byte_shift, uint64& pos, uchar* data_p);
 	static void FromChildThread(CKmerBinSorter<CKmer<SIZE>, SIZE>& ptr, CKmer<SIZE>* thread_buffer, uint64 size);
 	static void ExpandKxmerBothParaller(CKmerBinSorter<CKmer<SIZE>, SIZE>& ptr, uint64 start_pos, uint64 end_pos);
@@ -205,6 +211,7 @@ template <unsigned SIZE> double CKmerBinSorter_Impl<CKmerQuake<SIZE>, SIZE>::inv
 template <typename KMER_T, unsigned SIZE> CKmerBinSorter<KMER_T, SIZE>::CKmerBinSorter(CKMCParams &Params, CKMCQueues &Queues, int thread_no) : kxmer_set(Params.kmer_len)
 {
 	both_strands = Params.both_strands;
+	strand_counts = Params.strand_counts;
 	mm = Queues.mm;
 	n_bins = Params.n_bins;
 	bd = Queues.bd;
@@ -225,6 +232,9 @@ template <typename KMER_T, unsigned SIZE> CKmerBinSorter<KMER_T, SIZE>::CKmerBin
 	counter_max = Params.counter_max;
 	max_x = Params.max_x;
 	use_quake = Params.use_quake;
+	kmer_span = Params.kmer_span;
+	mask_positions = Params.mask_positions;
+	mirror_positions = Params.mirror_positions;
 	
 	lut_prefix_len = Params.lut_prefix_len;
 
@@ -380,6 +390,8 @@ template <unsigned SIZE> void CKmerBinSorter_Impl<CKmer<SIZE>, SIZE>::ExpandKmer
 		rev_kmer.mask(kmer_mask);
 
 		kmer_can = kmer < rev_kmer ? kmer : rev_kmer;
+		if (ptr.strand_counts)
+			kmer_can.SHL_insert_2bits(rev_kmer < kmer);
 		ptr.buffer_input[ptr.input_pos++].set(kmer_can);
 
 		for (int i = 0; i < additional_symbols; ++i)
@@ -396,6 +408,8 @@ template <unsigned SIZE> void CKmerBinSorter_Impl<CKmer<SIZE>, SIZE>::ExpandKmer
 			kmer.mask(kmer_mask);
 			rev_kmer.SHR_insert_2bits(3 - symb, kmer_len_shift);
 			kmer_can = kmer < rev_kmer ? kmer : rev_kmer;
+			if (ptr.strand_counts)
+				kmer_can.SHL_insert_2bits(rev_kmer < kmer);
 			ptr.buffer_input[ptr.input_pos++].set(kmer_can);
 		}
 		if (byte_shift != 6)
@@ -403,6 +417,62 @@ template <unsigned SIZE> void CKmerBinSorter_Impl<CKmer<SIZE>, SIZE>::ExpandKmer
 	}
 }
 
+//----------------------------------------------------------------------------------
+// Uncompact spaced k-mers. An extended k-mer holds kmer_span + additional_symbols symbols of a read;
+// each of its windows of kmer_span symbols gives the k-mer of the symbols at the care positions. The
+// reverse k-mer is the one of the reverse complement of the window, i.e. the complements of the symbols
+// at the mirrored care positions in reverse order.
+template <unsigned SIZE> void CKmerBinSorter_Impl<CKmer<SIZE>, SIZE>::ExpandMaskedKmers(CKmerBinSorter<CKmer<SIZE>, SIZE>& ptr, uint64 tmp_size)
+{
+	uint64 pos = 0;
+	CKmer<SIZE> kmer;
+	CKmer<SIZE> rev_kmer;
+
+	uint32 kmer_len_shift = (ptr.kmer_len - 1) * 2;
+	uint32 *care = ptr.mask_positions.data();
+	uint32 *mirror = ptr.mirror_positions.data();
+	uchar *data_p = ptr.data;
+	ptr.input_pos = 0;
+
+	vector<uchar> symbols(ptr.kmer_span + 255);
+	while (pos < tmp_size)
+	{
+		uint32 n = ptr.kmer_span + data_p[pos++];
+		for (uint32 i = 0; i < n; ++i)
+			symbols[i] = (data_p[pos + i / 4] >> (6 - 2 * (i % 4))) & 3;
+		pos += (n + 3) / 4;
+
+		for (uint32 i = 0; i + ptr.kmer_span <= n; ++i)
+		{
+			uchar *window = symbols.data() + i;
+			kmer.clear();
+			if (ptr.both_strands)
+			{
+				rev_kmer.clear();
+				for (uint32 j = 0; j < ptr.kmer_len; ++j)
+				{
+					kmer.SHL_insert_2bits(window[care[j]]);
+					rev_kmer.SHR_insert_2bits(3 - window[mirror[j]], kmer_len_shift);
+				}
+				if (ptr.strand_counts)
+				{
+					CKmer<SIZE> kmer_can = kmer < rev_kmer ? kmer : rev_kmer;
+					kmer_can.SHL_insert_2bits(rev_kmer < kmer);
+					ptr.buffer_input[ptr.input_pos++].set(kmer_can);
+				}
+				else
+					ptr.buffer_input[ptr.input_pos++].set(kmer < rev_kmer ? kmer : rev_kmer);
+			}
+			else
+			{
+				for (uint32 j = 0; j < ptr.kmer_len; ++j)
+					kmer.SHL_insert_2bits(window[care[j]]);
+				ptr.buffer_input[ptr.input_pos++].set(kmer);
+			}
+		}
+	}
+}
+
 template <unsigned SIZE> void CKmerBinSorter_Impl<CKmer<SIZE>, SIZE>::FromChildThread(CKmerBinSorter<CKmer<SIZE>, SIZE>& ptr, CKmer<SIZE>* thread_buffer, uint64 size)
 {
 	lock_guard<mutex> lcx(ptr.expander_mtx);
@@ -714,7 +784,9 @@ template <unsigned SIZE> void CKmerBinSorter_Impl<CKmer<SIZE>, SIZE>::Expand(CKm
 	ptr.buffer_input = (CKmer<SIZE> *) raw_buffer_input;
 	ptr.buffer_tmp = (CKmer<SIZE> *) raw_buffer_tmp;
 
-	if (ptr.max_x)
+	if (!ptr.mask_positions.empty())
+		ExpandMaskedKmers(ptr, tmp_size);
+	else if (ptr.max_x)
 	{
 		if (ptr.both_strands)
 			ExpandKxmersBoth(ptr, tmp_size);
@@ -861,7 +933,7 @@ template <typename KMER_T, unsigned SIZE> void CKmerBinSorter<KMER_T, SIZE>::Sor
 	else
 	{
 		sort_rec = n_rec;
-		rec_len = (kmer_len + 3) / 4;
+		rec_len = (kmer_len + (strand_counts ? 1 : 0) + 3) / 4;
 	}
 	sum_n_plus_x_rec += n_plus_x_recs;
 	sum_n_rec += n_rec;
@@ -1198,11 +1270,103 @@ template <unsigned SIZE> void CKmerBinSorter_Impl<CKmer<SIZE>, SIZE>::CompactKme
 
 
 
+//----------------------------------------------------------------------------------
+// Compact the kmers with their orientations (the last symbol) to a single kmer and two counters:
+// of occurrences in canonical and in reverse-complement orientation. Cutoffs apply to their sum.
+template <unsigned SIZE> void CKmerBinSorter_Impl<CKmer<SIZE>, SIZE>::CompactStrandKmers(CKmerBinSorter<CKmer<SIZE>, SIZE> &ptr)
+{
+	uint32 kmer_symbols = ptr.kmer_len - ptr.lut_prefix_len;
+	uint64 kmer_bytes = kmer_symbols / 4;
+	uint64 lut_recs = 1 << (2 * (ptr.lut_prefix_len));
+	uint64 lut_size = lut_recs * sizeof(uint64);
+
+	uint64 counter_size = min(BYTE_LOG(ptr.cutoff_max), BYTE_LOG(ptr.counter_max));
+
+	uchar *out_buffer;
+	uchar *raw_lut;
+
+	ptr.memory_bins->reserve(ptr.bin_id, out_buffer, CMemoryBins::mba_suffix);
+	ptr.memory_bins->reserve(ptr.bin_id, raw_lut, CMemoryBins::mba_lut);
+	uint64 *lut = (uint64*)raw_lut;
+	fill_n(lut, lut_recs, 0);
+
+	uint32 out_pos = 0;
+	uint32 counts[2];
+	CKmer<SIZE> act_kmer, kmer;
+	act_kmer.clear();
+	kmer.clear();
+	counts[0] = counts[1] = 0;
+
+	ptr.n_unique = 0;
+	ptr.n_cutoff_min = 0;
+	ptr.n_cutoff_max = 0;
+	ptr.n_total = ptr.n_rec;
+
+	for (uint64 i = 0; i <= ptr.n_rec; ++i)
+	{
+		uchar strand = 0;
+		if (i < ptr.n_rec)
+		{
+			kmer.set(ptr.buffer[i]);
+			strand = kmer.get_2bits(0);
+			kmer.SHR(1);
+			if (i && kmer == act_kmer)
+			{
+				counts[strand]++;
+				continue;
+			}
+		}
+
+		if (i)
+		{
+			uint32 count = counts[0] + counts[1];
+			ptr.n_unique++;
+			if (count < (uint32)ptr.cutoff_min)
+				ptr.n_cutoff_min++;
+			else if (count > (uint32)ptr.cutoff_max)
+				ptr.n_cutoff_max++;
+			else
+			{
+				// Store compacted kmer
+				for (int32 j = (int32)kmer_bytes - 1; j >= 0; --j)
+					out_buffer[out_pos++] = act_kmer.get_byte(j);
+				for (int32 s = 0; s < 2; ++s)
+				{
+					uint32 strand_count = MIN(counts[s], (uint32)ptr.counter_max);
+					for (int32 j = 0; j < (int32)counter_size; ++j)
+						out_buffer[out_pos++] = (strand_count >> (j * 8)) & 0xFF;
+				}
+
+				lut[act_kmer.remove_suffix(2 * kmer_symbols)]++;
+			}
+		}
+
+		if (i < ptr.n_rec)
+		{
+			act_kmer.set(kmer);
+			counts[0] = counts[1] = 0;
+			counts[strand] = 1;
+		}
+	}
+
+	// Push the sorted and compacted kmer bin to a priority queue in a form ready to be stored to HDD
+	ptr.kq->push(ptr.bin_id, out_buffer, out_pos, raw_lut, lut_size, ptr.n_unique, ptr.n_cutoff_min, ptr.n_cutoff_max, ptr.n_total);
+
+	if (ptr.buffer_input)
+	{
+		ptr.memory_bins->free(ptr.bin_id, CMemoryBins::mba_input_array);
+		ptr.memory_bins->free(ptr.bin_id, CMemoryBins::mba_tmp_array);
+	}
+	ptr.buffer = NULL;
+}
+
 //----------------------------------------------------------------------------------
 template <unsigned SIZE> void CKmerBinSorter_Impl<CKmer<SIZE>, SIZE>::Compact(CKmerBinSorter<CKmer<SIZE>, SIZE> &ptr)
 {
 	if (ptr.max_x)
 		CompactKxmers(ptr);
+	else if (ptr.strand_counts)
+		CompactStrandKmers(ptr);
 	else
 		CompactKmers(ptr);
 }
@@ -1359,4 +1523,4 @@ template <typename KMER_T, unsigned SIZE> void CWKmerBinSorter<KMER_T, SIZE>::op
 
 #endif
 
-// ***** EOF
\ No newline at end of file
+// ***** EOF
\ No newline at end of file
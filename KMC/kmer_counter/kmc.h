@@ -32,6 +32,10 @@
 #include "libs/asmlib.h"
 #include <boost/filesystem.hpp>
 
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
 #ifdef DEVELOP_MODE
 #include "develop.h"
 #endif
@@ -70,6 +74,9 @@ template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> class CKMC {
 
 	void SetThreads1Stage();
 	void SetThreads2Stage(vector<int64>& sorted_sizes);
+
+	uint64 EstimateInputSize();
+	uint32 ChooseBinCount(uint32 *stats, uint64 stats_bytes);
 	
 	bool AdjustMemoryLimits();
 	void AdjustMemoryLimitsStage2();
@@ -116,7 +123,24 @@ template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> void CKMC<KMER_T, SIZ
 	Params = _Params;
 	Params.kmer_len	= Params.p_k;
 
-	if (Params.kmer_len % 32 == 0)
+	// Spaced k-mers are taken from windows of the mask length; only their care symbols are stored
+	Params.kmer_span = Params.kmer_len;
+	Params.mask_positions.clear();
+	Params.mirror_positions.clear();
+	if (!Params.p_mask.empty())
+	{
+		Params.kmer_span = (int) Params.p_mask.size();
+		for (uint32 i = 0; i < Params.p_mask.size(); ++i)
+			if (Params.p_mask[i] == '1')
+				Params.mask_positions.push_back(i);
+		// The reverse k-mer of a window is made of the complements of the symbols at these positions, in reverse order
+		for (uint32 i = 0; i < Params.mask_positions.size(); ++i)
+			Params.mirror_positions.push_back(Params.kmer_span - 1 - Params.mask_positions[Params.mask_positions.size() - 1 - i]);
+	}
+
+	// Consecutive spaced k-mers do not share k-1 symbols, so k+x-mers are not used for them;
+	// neither are they used for strand-resolved counting, as the orientation of each k-mer must be kept
+	if (Params.kmer_len % 32 == 0 || !Params.mask_positions.empty() || Params.p_strand_counts)
 		Params.max_x = 0;
 	else
 		Params.max_x = MIN(31 - (Params.kmer_len % 32), KMER_X);
@@ -136,6 +160,7 @@ template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> void CKMC<KMER_T, SIZ
 
 	Params.lowest_quality = Params.p_quality;
 	Params.both_strands   = Params.p_both_strands;
+	Params.strand_counts  = Params.p_strand_counts;
 	Params.mem_mode		  = Params.p_mem_mode;
 	
 	// Technical parameters related to no. of threads and memory usage
@@ -232,6 +257,96 @@ template<typename KMER_T, unsigned SIZE, bool QUAKE_MODE> void CKMC<KMER_T, SIZE
 	}
 }
 
+//----------------------------------------------------------------------------------
+// Estimate the size of the (decompressed) input
+template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> uint64 CKMC<KMER_T, SIZE, QUAKE_MODE>::EstimateInputSize()
+{
+	uint64 input_size = 0;
+	for (auto& p : Params.input_file_names)
+	{
+		FILE* tmp = my_fopen(p.c_str(), "rb");
+		if (!tmp)
+			continue;
+		my_fseek(tmp, 0, SEEK_END);
+		uint64 file_size = my_ftell(tmp);
+		fclose(tmp);
+
+		// FASTQ files compress about 4 times
+		string ext(p.end() - MIN(p.size(), 4), p.end());
+		if (ext.find(".gz") != string::npos || ext == ".bz2")
+			file_size *= 4;
+		input_size += file_size;
+	}
+	return input_size;
+}
+
+//----------------------------------------------------------------------------------
+// Choose the no. of bins. The no. of records to sort in stage 2 is estimated from the
+// statistics of signatures, collected from a prefix of the input of stats_bytes bytes.
+// There should be:
+//  * enough bins for the sorters to sort bins of at most 1/(2 * no. of threads) of the
+//    memory each (as estimated in SetThreads2Stage), so that all threads are used,
+//  * 16 bins per thread, to keep the tail of stage 2 short.
+// Above DEFAULT_BINS, there can be at most as many bins as the parts of bin collectors
+// of splitters fit in a half of the memory of bin parts not used by the storer. In disk
+// mode, there can be at most as many bins as temporary files can be opened.
+template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> uint32 CKMC<KMER_T, SIZE, QUAKE_MODE>::ChooseBinCount(uint32 *stats, uint64 stats_bytes)
+{
+	if (Params.p_n_bins)
+		return Params.p_n_bins;
+
+	uint32 map_size = (1 << Params.signature_len * 2) + 1;
+	double n_kmers = 0.0, n_super_kmers = 0.0;
+	for (uint32 i = 0; i < map_size; ++i)
+	{
+		n_kmers += stats[i];
+		n_super_kmers += stats[map_size + i];
+	}
+
+	// The whole input is in the sample, unless the readers stopped at STATS_FASTQ_SIZE
+	double scale = 1.0;
+	if (stats_bytes >= STATS_FASTQ_SIZE)
+		scale = MAX(1.0, (double) EstimateInputSize() / stats_bytes);
+	double n_recs = Queues.s_mapper->SortedRecords(n_kmers, n_super_kmers) * scale;
+
+	int64 n_threads;
+	if (Params.p_sf && Params.p_sp && Params.p_so && Params.p_sr)
+		n_threads = accumulate(Params.n_omp_threads.begin(), Params.n_omp_threads.end(), 0);
+	else
+		n_threads = Params.n_threads;
+	n_threads = MAX(n_threads, 1);
+
+	double bin_mem = (double) Params.max_mem_size / (2 * n_threads);
+	uint64 n_bins = (uint64) (n_recs * 2 * sizeof(KMER_T) / bin_mem);
+	n_bins = MAX(n_bins, (uint64) (16 * n_threads));
+	n_bins = MAX(n_bins, (uint64) DEFAULT_BINS);
+
+	int64 stage1_mem = (Params.mem_tot_pmm_bins - Params.max_mem_storer) / 2;
+	n_bins = MIN(n_bins, (uint64) MAX(stage1_mem / ((int64) Params.n_splitters * Params.mem_part_pmm_bins), DEFAULT_BINS));
+
+	if (!Params.mem_mode)
+	{
+#ifdef WIN32
+		uint64 max_files = 2040;			// see _setmaxstdio in main
+#else
+		uint64 max_files = MAX_BINS;
+		struct rlimit file_limit;
+		if (getrlimit(RLIMIT_NOFILE, &file_limit) == 0 && file_limit.rlim_cur != RLIM_INFINITY)
+			max_files = file_limit.rlim_cur;
+#endif
+		// Some descriptors are used by input, output and standard streams
+		if (max_files > 64)
+			n_bins = MIN(n_bins, max_files - 64);
+	}
+	n_bins = NORM(n_bins, (uint64) MIN_BINS, (uint64) MAX_BINS);
+
+	if (Params.verbose)
+		cout << "Estimated no. of records to sort: " << (uint64) n_recs << ", no. of bins: " << n_bins << "\n";
+
+	return (uint32) n_bins;
+}
+
+//----------------------------------------------------------------------------------
 template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> void CKMC<KMER_T, SIZE, QUAKE_MODE>::AdjustMemoryLimitsStage2()
 {
 	// Memory for 2nd stage
@@ -273,8 +388,8 @@ template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> bool CKMC<KMER_T, SIZ
 	// Memory for splitter internal buffers
 	int64 m_rest = Params.max_mem_size;  
 
-	Params.mem_part_pmm_stats = ((1 << Params.signature_len * 2) + 1) * sizeof(uint32);
-	Params.mem_tot_pmm_stats = (Params.n_splitters + 1 + 1) * Params.mem_part_pmm_stats; //1 merged in main thread, 1 for sorting indices
+	Params.mem_part_pmm_stats = 2 * ((1 << Params.signature_len * 2) + 1) * sizeof(uint32);		// k-mers and super-k-mers per signature
+	Params.mem_tot_pmm_stats = (Params.n_splitters + 1 + 2) * Params.mem_part_pmm_stats; //1 merged in main thread, 2 for sorting indices and costs
 
 	
 	// Settings for memory manager of FASTQ buffers
@@ -348,6 +463,8 @@ template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> void CKMC<KMER_T, SIZ
 	}
 	cout << "\n";
 	cout << "k-mer length                 : " << Params.kmer_len << "\n";
+	if(!Params.mask_positions.empty())
+		cout << "Mask of spaced k-mers        : " << Params.p_mask << "\n";
 	cout << "Max. k-mer length            : " << MAX_K << "\n";
 	cout << "Signature length             : " << Params.signature_len << "\n"; 
 	cout << "Min. count threshold         : " << Params.cutoff_min << "\n";
@@ -357,6 +474,7 @@ template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> void CKMC<KMER_T, SIZ
 	if(Params.use_quake)
 		cout << "Lowest quality value         : " << Params.lowest_quality << "\n";
 	cout << "Both strands                 : " << (Params.both_strands ? "true\n" : "false\n");	
+	cout << "Strand-resolved counters     : " << (Params.strand_counts ? "true\n" : "false\n");
 	cout << "RAM olny mode                : " << (Params.mem_mode ? "true\n" : "false\n");
 
 	cout << "\n******* Stage 1 configuration: *******\n";
@@ -444,7 +562,7 @@ template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> bool CKMC<KMER_T, SIZ
 
 	
 
-	Queues.s_mapper = new CSignatureMapper(Queues.pmm_stats, Params.signature_len);
+	Queues.s_mapper = new CSignatureMapper(Queues.pmm_stats, Params.signature_len, Params.kmer_len, Params.use_quake ? 0 : Params.max_x);
 	
 	// ***** Stage 0 *****
 	w0.startTimer();
@@ -472,7 +590,7 @@ template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> bool CKMC<KMER_T, SIZ
 
 	uint32 *stats;
 	Queues.pmm_stats->reserve(stats);
-	fill_n(stats, (1 << Params.signature_len * 2) + 1, 0);
+	fill_n(stats, 2 * ((1 << Params.signature_len * 2) + 1), 0);
 
 
 	for (int i = 0; i < Params.n_readers; ++i)
@@ -484,13 +602,14 @@ template <typename KMER_T, unsigned SIZE, bool QUAKE_MODE> bool CKMC<KMER_T, SIZ
 		delete w_stats_splitters[i];
 	}		
 
+	uint64 stats_bytes = Queues.stats_part_queue->get_bytes_read();
 	delete Queues.stats_part_queue;
 	Queues.stats_part_queue = NULL;
 	delete Queues.input_files_queue;
 	Queues.input_files_queue = new CInputFilesQueue(Params.input_file_names);
 
 	heuristic_time.startTimer();
-	Queues.s_mapper->Init(stats);
+	Queues.s_mapper->Init(stats, ChooseBinCount(stats, stats_bytes));
 	heuristic_time.stopTimer();
 
 	cout << "\n";
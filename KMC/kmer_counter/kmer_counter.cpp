@@ -12,12 +12,17 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <time.h>
 #include <functional>
 #include "timer.h"
 #include "kmc.h"
 #include "meta_oper.h"
 
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
 using namespace std;
 
 uint64 total_reads, total_fastq_size;
@@ -41,7 +46,7 @@ template<template<unsigned X> class KMER_TPL, unsigned SIZE, bool QUAKE_MODE> cl
 
 public:
 	CApplication(CKMCParams &Params) {
-		p_k = Params.p_k;
+		p_k = Params.p_k + (Params.p_strand_counts ? 1 : 0);		// the orientation is sorted as an additional symbol
 		is_selected = p_k <= (int32) SIZE * 32 && p_k > ((int32) SIZE-1)*32;
 
 		app_1 = new CApplication<KMER_TPL, SIZE - 1, QUAKE_MODE>(Params);
@@ -90,7 +95,7 @@ template<template<unsigned X> class KMER_TPL, bool QUAKE_MODE> class CApplicatio
 
 public:
 	CApplication(CKMCParams &Params) {
-		is_selected = Params.p_k <= 32;
+		is_selected = Params.p_k + (Params.p_strand_counts ? 1 : 0) <= 32;
 		if(is_selected)
 		{
 			kmc = new CKMC<KMER_TPL<1>, 1, QUAKE_MODE>;
@@ -139,18 +144,25 @@ void usage()
 	cout << "  -k<len> - k-mer length (k from " << MIN_K << " to " << MAX_K << "; default: 25\n";
 	cout << "  -m<size> - max amount of RAM in GB (from 4 to 1024); default: 12\n";
 	cout << "  -p<par> - signature length (5, 6, 7, 8); default: 7\n";
+	cout << "  -n<value> - number of bins (from " << MIN_BINS << " to " << MAX_BINS << "); default: chosen from input size, memory and no. of threads\n";
 	cout << "  -f<a/q/m> - input in FASTA format (-fa), FASTQ format (-fq) or mulit FASTA (-fm); default: FASTQ\n";
 	cout << "  -q[value] - use Quake's compatible counting with [value] representing lowest quality (default: 33)\n";
 	cout << "  -ci<value> - exclude k-mers occurring less than <value> times (default: 2)\n";
 	cout << "  -cs<value> - maximal value of a counter (default: 255)\n";
 	cout << "  -cx<value> - exclude k-mers occurring more of than <value> times (default: 1e9)\n";
 	cout << "  -b - turn off transformation of k-mers into canonical form\n";	
+	cout << "  -st - store two counters per canonical k-mer: occurrences in canonical and in reverse-complement orientation\n";
+	cout << "  -g<mask> - count spaced k-mers: <mask> of 0s (don't care) and 1s (care positions), starting and ending with 1;\n";
+	cout << "             k is the number of 1s (from " << MIN_K << " to " << MAX_K << "), the length of <mask> at most " << MAX_SPAN << "; -k is ignored\n";
 	cout << "  -r - turn on RAM-only mode \n";
 	cout << "  -t<value> - total number of threads (default: no. of CPU cores)\n";
 	cout << "  -sf<value> - number of FASTQ reading threads\n";
 	cout << "  -sp<value> - number of splitting threads\n";
 	cout << "  -sr<value> - number of sorter threads\n";
 	cout << "  -so<value> - number of threads per single sorter\n";	
+	cout << "  -hs<value> - also store a FracMinHash sketch of the k-mers with hash at most 2^64/<value> (in *.kmc_sketch)\n";
+	cout << "  -hk<value> - also store a bottom-k sketch of the <value> k-mers with smallest hashes (in *.kmc_sketch)\n";
+	cout << "  -ho - store only the sketch, not the k-mer database\n";
 	cout << "Example:\n";
 	cout << "kmc -k27 -m24 NA19238.fastq NA.res \\data\\kmc_tmp_dir\\\n";
 	cout << "kmc -k27 -q -m24 @files.lst NA.res \\data\\kmc_tmp_dir\\\n";
@@ -226,6 +238,18 @@ bool parse_parameters(int argc, char *argv[])
 			else
 				Params.p_p1 = tmp;
 		}
+		// Number of bins
+		else if (strncmp(argv[i], "-n", 2) == 0)
+		{
+			tmp = atoi(&argv[i][2]);
+			if (tmp < MIN_BINS || tmp > MAX_BINS)
+			{
+				cout << "Wrong parameter: number of bins must be from range <" << MIN_BINS << "," << MAX_BINS << ">\n";
+				return false;
+			}
+			else
+				Params.p_n_bins = tmp;
+		}
 		// FASTA input files
 		else if(strncmp(argv[i], "-fa", 3) == 0)
 			Params.p_file_type = fasta;
@@ -240,6 +264,19 @@ bool parse_parameters(int argc, char *argv[])
 			Params.p_mem_mode = true;
 		else if(strncmp(argv[i], "-b", 2) == 0)
 			Params.p_both_strands = false;
+		// Mask of spaced k-mers
+		else if(strncmp(argv[i], "-g", 2) == 0)
+			Params.p_mask = &argv[i][2];
+		// Sketch of the k-mers
+		else if(strncmp(argv[i], "-hs", 3) == 0)
+			Params.p_sketch_scaled = atoll(&argv[i][3]);
+		else if(strncmp(argv[i], "-hk", 3) == 0)
+			Params.p_sketch_size = atoll(&argv[i][3]);
+		else if(strncmp(argv[i], "-ho", 3) == 0)
+			Params.p_sketch_only = true;
+		// Strand-resolved counters
+		else if(strncmp(argv[i], "-st", 3) == 0)
+			Params.p_strand_counts = true;
 		// Number of reading threads
 		else if(strncmp(argv[i], "-sf", 3) == 0)
 		{
@@ -290,6 +327,50 @@ bool parse_parameters(int argc, char *argv[])
 		}
 	}
 
+	if(!Params.p_mask.empty())
+	{
+		uint32 weight = (uint32) count(Params.p_mask.begin(), Params.p_mask.end(), '1');
+		if(Params.p_mask.find_first_not_of("01") != string::npos || Params.p_mask[0] != '1' || Params.p_mask[Params.p_mask.size() - 1] != '1')
+		{
+			cout << "Wrong parameter: mask must consist of 0s and 1s and start and end with 1\n";
+			return false;
+		}
+		if(weight < MIN_K || weight > MAX_K || Params.p_mask.size() > MAX_SPAN)
+		{
+			cout << "Wrong parameter: mask must have from " << MIN_K << " to " << MAX_K << " 1s and at most " << MAX_SPAN << " symbols\n";
+			return false;
+		}
+		if(Params.p_quake)
+		{
+			cout << "Wrong parameters: -g and -q cannot be used together\n";
+			return false;
+		}
+		Params.p_k = weight;
+	}
+	if(Params.p_strand_counts)
+	{
+		if(Params.p_quake || !Params.p_both_strands)
+		{
+			cout << "Wrong parameters: -st cannot be used together with -q or -b\n";
+			return false;
+		}
+		if(Params.p_k >= MAX_K)
+		{
+			cout << "Wrong parameter: k must be less than " << MAX_K << " for -st\n";
+			return false;
+		}
+	}
+	if(Params.p_sketch_scaled && Params.p_sketch_size)
+	{
+		cout << "Wrong parameters: -hs and -hk cannot be used together\n";
+		return false;
+	}
+	if(Params.p_sketch_only && !Params.p_sketch_scaled && !Params.p_sketch_size)
+	{
+		cout << "Wrong parameter: -ho requires -hs or -hk\n";
+		return false;
+	}
+
 	if(argc - i < 3)
 		return false;
 
@@ -333,6 +414,14 @@ int _tmain(int argc, _TCHAR* argv[])
 
 #ifdef WIN32
 	_setmaxstdio(2040);
+#else
+	// Temporary files of all bins are opened at once
+	struct rlimit file_limit;
+	if(getrlimit(RLIMIT_NOFILE, &file_limit) == 0 && file_limit.rlim_cur < file_limit.rlim_max)
+	{
+		file_limit.rlim_cur = file_limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &file_limit);
+	}
 #endif
 
 	if(!parse_parameters(argc, argv))
@@ -0,0 +1,149 @@
+#include "stdafx.h"
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+#include <algorithm>
+#include <iostream>
+#include "kmer_sketch.h"
+
+using namespace std;
+
+//************************************************************************************************************
+// CKmerSketch
+//************************************************************************************************************
+
+//----------------------------------------------------------------------------------
+CKmerSketch::CKmerSketch(CKMCParams &Params, uint32 _counter_size)
+{
+	kmer_len       = Params.kmer_len;
+	lut_prefix_len = Params.lut_prefix_len;
+	counter_size   = _counter_size;
+	use_quake      = Params.use_quake;
+	both_strands   = Params.both_strands;
+	strand_counts  = Params.strand_counts;
+
+	scaled         = Params.p_sketch_scaled;
+	sketch_size    = Params.p_sketch_size;
+	max_hash       = scaled ? ~0ull / scaled : ~0ull;
+}
+
+//----------------------------------------------------------------------------------
+// Hash of a k-mer in its 2-bit encoding
+uint64 CKmerSketch::Hash(const uchar *kmer_bytes, uint32 n_bytes)
+{
+	uint64 h = seed;
+	for(uint32 i = 0; i < n_bytes; i += 8)
+	{
+		uint64 word = 0;
+		for(uint32 j = 0; j < 8; ++j)
+			word = (word << 8) + (i + j < n_bytes ? kmer_bytes[i + j] : 0);
+		h = fmix64(h ^ word);
+	}
+	return h;
+}
+
+//----------------------------------------------------------------------------------
+// Add the k-mers of a compacted bin
+void CKmerSketch::AddBin(const uchar *data, uint64 data_size, const uint64 *lut, uint64 lut_recs)
+{
+	uint32 sufix_bytes  = (kmer_len - lut_prefix_len) / 4;
+	uint32 prefix_bytes = (kmer_len + 3) / 4 - sufix_bytes;		// the prefix, left-padded to full bytes
+	uint32 rec_size     = sufix_bytes + counter_size;
+	uchar kmer_bytes[MAX_K / 4 + 1];
+
+	const uchar *rec = data;
+	for(uint64 prefix = 0; prefix < lut_recs; ++prefix)
+	{
+		for(uint32 i = 0; i < prefix_bytes; ++i)
+			kmer_bytes[i] = (prefix >> (8 * (prefix_bytes - 1 - i))) & 0xFF;
+
+		for(uint64 r = 0; r < lut[prefix]; ++r, rec += rec_size)
+		{
+			memcpy(kmer_bytes + prefix_bytes, rec, sufix_bytes);
+			uint64 h = Hash(kmer_bytes, prefix_bytes + sufix_bytes);
+			if(h > max_hash)
+				continue;
+
+			uint32 counter = 0;
+			if(strand_counts)
+			{
+				uint32 half = counter_size / 2;
+				for(uint32 s = 0; s < 2; ++s)
+				{
+					uint32 strand_counter = 0;
+					for(uint32 j = 0; j < half; ++j)
+						strand_counter += (uint32) rec[sufix_bytes + s * half + j] << (8 * j);
+					counter += strand_counter;
+				}
+			}
+			else
+				for(uint32 j = 0; j < counter_size; ++j)
+					counter += (uint32) rec[sufix_bytes + j] << (8 * j);
+
+			if(!sketch_size)
+				entries.push_back(make_pair(h, counter));
+			else if(entries.size() < sketch_size)
+			{
+				entries.push_back(make_pair(h, counter));
+				push_heap(entries.begin(), entries.end());
+			}
+			else if(h < entries.front().first)
+			{
+				pop_heap(entries.begin(), entries.end());
+				entries.back() = make_pair(h, counter);
+				push_heap(entries.begin(), entries.end());
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------------
+// Store the sketch in a file
+bool CKmerSketch::Store(const string &file_name)
+{
+	FILE *out = fopen(file_name.c_str(), "wb");
+	if(!out)
+	{
+		cout << "Error: Cannot create " << file_name << "\n";
+		return false;
+	}
+
+	sort(entries.begin(), entries.end());
+
+	char s_kmc_sketch[] = "KMCH";
+	fwrite(s_kmc_sketch, 1, 4, out);
+	store_uint(out, kmer_len, 4);
+	store_uint(out, (uint32) use_quake, 4);
+	store_uint(out, (uint32) both_strands, 4);
+	store_uint(out, sketch_size ? 1 : 0, 4);
+	store_uint(out, sketch_size ? sketch_size : scaled, 8);
+	store_uint(out, seed, 8);
+	store_uint(out, entries.size(), 8);
+	for(auto &p : entries)
+	{
+		store_uint(out, p.first, 8);
+		store_uint(out, p.second, 4);
+	}
+	fwrite(s_kmc_sketch, 1, 4, out);
+	fclose(out);
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+// Store single unsigned integer in LSB fashion
+bool CKmerSketch::store_uint(FILE *out, uint64 x, uint32 size)
+{
+	for(uint32 i = 0; i < size; ++i)
+		putc((x >> (i * 8)) & 0xFF, out);
+
+	return true;
+}
+
+// ***** EOF
@@ -0,0 +1,83 @@
+/*
+  This file is a part of KMC software distributed under GNU GPL 3 licence.
+  The homepage of the KMC project is http://sun.aei.polsl.pl/kmc
+
+  Authors: Sebastian Deorowicz, Agnieszka Debudaj-Grabysz, Marek Kokot
+
+  Version: 2.0
+  Date   : 2014-07-04
+*/
+#ifndef _KMER_SKETCH_H
+#define _KMER_SKETCH_H
+
+#include "defs.h"
+#include "params.h"
+#include <string>
+#include <vector>
+#include <utility>
+
+//************************************************************************************************************
+// CKmerSketch - a sketch of the counted k-mers, built from the compacted bins by the completer
+//
+// The hash of a k-mer is computed from its 2-bit encoding (A=0, C=1, G=2, T=3, first symbol in the most
+// significant bits, left-padded with zeros to a multiple of 4 symbols), read as big-endian 64-bit words
+// (the last one padded with zeros): h = seed; h = fmix64(h ^ word) for each word, fmix64 being the
+// finalizer of MurmurHash3.
+//
+// Two kinds of sketches:
+//  * FracMinHash - the k-mers whose hash is at most 2^64 / scaled
+//  * bottom-k    - the k-mers with the sketch_size smallest hashes
+//
+// File format (*.kmc_sketch), integers in LSB fashion:
+//  "KMCH", kmer_len (4B), mode (4B; 0: counting, 1: Quake-compatibile counting), both_strands (4B),
+//  sketch type (4B; 0: FracMinHash, 1: bottom-k), scaled or sketch_size (8B), seed (8B), no. of entries (8B),
+//  entries sorted by hash: hash (8B), counter (4B; a float in mode 1; the sum of both orientations for -st), "KMCH"
+//************************************************************************************************************
+class CKmerSketch {
+	uint32 kmer_len;
+	uint32 lut_prefix_len;
+	uint32 counter_size;
+	bool use_quake;
+	bool both_strands;
+	bool strand_counts;			// the counter area holds two counters (canonical, reverse complement) to be summed
+
+	uint64 scaled;
+	uint64 sketch_size;
+	uint64 max_hash;
+
+	// (hash, counter); a max-heap on hashes for bottom-k sketches
+	std::vector<std::pair<uint64, uint32>> entries;
+
+	static const uint64 seed = 0;
+
+	static inline uint64 fmix64(uint64 x)
+	{
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdull;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ull;
+		x ^= x >> 33;
+		return x;
+	}
+
+	bool store_uint(FILE *out, uint64 x, uint32 size);
+
+public:
+	CKmerSketch(CKMCParams &Params, uint32 _counter_size);
+
+	static bool Enabled(CKMCParams &Params) { return Params.p_sketch_scaled || Params.p_sketch_size; }
+
+	// Hash of a k-mer in its 2-bit encoding (kmer_bytes bytes)
+	static uint64 Hash(const uchar *kmer_bytes, uint32 n_bytes);
+
+	// Add the k-mers of a compacted bin: its records (sufixes with counters) and the no. of records of each prefix
+	void AddBin(const uchar *data, uint64 data_size, const uint64 *lut, uint64 lut_recs);
+
+	uint64 Size() { return entries.size(); }
+
+	bool Store(const std::string &file_name);
+};
+
+#endif
+
+// ***** EOF
@@ -179,4 +179,110 @@ inline void CMmer::insert(char* seq)
 }
 
 
-#endif
\ No newline at end of file
+// *************************************************************************
+// Minima of m-mers in a sliding window. The queue holds the m-mers of the window that are smaller
+// than all the m-mers after them (the rightmost one among equal values), so its front is the
+// minimum of the window. It is updated lazily: only when the minimum leaves the window, the m-mers
+// that came since the last update are scanned once and appended. Thus a read is processed in
+// amortised O(1) time per symbol, and nothing is done as long as the minimum stays in the window.
+// *************************************************************************
+class CMmerQueue
+{
+	uint32 *vals;
+	uint32 *pos;
+	uint32 *new_vals;		// the m-mers being appended
+	uint32 *new_idx;		// the m-mers being appended that are smaller than all the m-mers after them
+	uint32 mask;			// capacity - 1, capacity is a power of 2
+	uint32 head, tail;
+	uint32 last_pos;		// the starting position of the last scanned m-mer
+	uint32 len;
+	CMmer mmer;
+
+public:
+	// _len - the length of m-mers, capacity - the max. no. of m-mers in a window
+	CMmerQueue(uint32 _len, uint32 capacity) : len(_len), mmer(_len)
+	{
+		uint32 size = 1;
+		while (size < capacity)
+			size <<= 1;
+		vals = new uint32[size];
+		pos = new uint32[size];
+		new_vals = new uint32[size];
+		new_idx = new uint32[size];
+		mask = size - 1;
+		head = tail = 0;
+	}
+	~CMmerQueue()
+	{
+		delete[] vals;
+		delete[] pos;
+		delete[] new_vals;
+		delete[] new_idx;
+	}
+
+	// Forget all the m-mers, e.g. at the beginning of a read
+	inline void clear()
+	{
+		head = tail = 0;
+	}
+
+	inline uint32 next_min(char *seq, uint32 min_pos, uint32 end_pos);
+};
+
+//--------------------------------------------------------------------------
+// Find the new minimum of a window after the current one left it
+// IN	: seq		- the read
+//		  min_pos	- the starting position of the minimum that left the window
+//		  end_pos	- the starting position of the last m-mer of the window
+// RET	: the starting position of the new minimum
+//--------------------------------------------------------------------------
+inline uint32 CMmerQueue::next_min(char *seq, uint32 min_pos, uint32 end_pos)
+{
+	if (head != tail && pos[head & mask] == min_pos)
+		++head;
+	else		// the minimum was found at the end of the window, so the m-mers before it do not matter
+	{
+		head = tail;
+		last_pos = min_pos;
+	}
+
+	// The new m-mers and, from the right, those smaller than all the m-mers after them
+	// (local copies of the members, so that the stores to the arrays do not force their reloading)
+	uint32 n = end_pos - last_pos;
+	uint32 *_new_vals = new_vals;
+	uint32 *_new_idx = new_idx;
+	CMmer _mmer(mmer);
+	char *new_symb = seq + last_pos + len;
+	_mmer.insert(seq + last_pos + 1);
+	_new_vals[0] = _mmer.get();
+	for (uint32 i = 1; i < n; ++i)
+	{
+		_mmer.insert((uchar)new_symb[i]);
+		_new_vals[i] = _mmer.get();
+	}
+
+	uint32 n_idx = 0;
+	uint32 cur_min = _new_vals[n - 1];
+	_new_idx[n_idx++] = n - 1;
+	for (uint32 i = n - 1; i-- > 0;)
+		if (_new_vals[i] < cur_min)
+		{
+			cur_min = _new_vals[i];
+			_new_idx[n_idx++] = i;
+		}
+
+	while (tail != head && vals[(tail - 1) & mask] >= cur_min)
+		--tail;
+	while (n_idx--)
+	{
+		vals[tail & mask] = _new_vals[_new_idx[n_idx]];
+		pos[tail & mask] = last_pos + 1 + _new_idx[n_idx];
+		++tail;
+	}
+	last_pos = end_pos;
+
+	return pos[head & mask];
+}
+
+
+#endif
\ No newline at end of file
@@ -42,6 +42,12 @@ struct CKMCParams {
 	bool p_verbose;						// verbose mode
 	bool p_both_strands;				// compute canonical k-mer representation
 	int p_p1;							// signature length	
+	int p_n_bins;						// number of bins (0: chosen automatically)
+	uint64 p_sketch_scaled;				// FracMinHash sketch: keep k-mers with hash at most 2^64 / p_sketch_scaled (0: no sketch)
+	uint64 p_sketch_size;				// bottom-k sketch: keep the p_sketch_size k-mers with smallest hashes (0: no sketch)
+	bool p_sketch_only;					// store only the sketch, not the k-mer database
+	string p_mask;						// spaced k-mers: '1' for care and '0' for don't care positions (empty: contiguous k-mers)
+	bool p_strand_counts;				// count occurrences of canonical k-mers in both orientations separately
 
 	// File names
 	vector<string> input_file_names;
@@ -79,6 +85,9 @@ struct CKMCParams {
 	bool verbose;	
 
 	int kmer_len;			// kmer length
+	int kmer_span;			// length of the window of a read a k-mer is taken from; kmer_len for contiguous k-mers
+	vector<uint32> mask_positions;	// positions of care symbols in a window of spaced k-mers (empty for contiguous k-mers)
+	vector<uint32> mirror_positions;	// positions of care symbols of the reverse complement of a window, i.e. mask_positions mirrored
 	int signature_len;
 	int cutoff_min;			// exclude k-mers occurring less than times
 	int cutoff_max;			// exclude k-mers occurring more than times
@@ -86,9 +95,10 @@ struct CKMCParams {
 	bool use_quake;			// use Quake's counting based on qualities
 	int lowest_quality;		// lowest quality value	    
 	bool both_strands;		// find canonical representation of each k-mer
+	bool strand_counts;		// two counters per canonical k-mer: occurrences in canonical and in reverse-complement orientation
 	bool mem_mode;			// use RAM instead of disk
 
-	int n_bins;				// number of bins; fixed: 448
+	int n_bins;				// number of bins; chosen after the statistics of signatures are collected
 	int bin_part_size;		// size of a bin part; fixed: 2^15
 	int fastq_buffer_size;	// size of FASTQ file buffer; fixed: 2^23
 
@@ -121,6 +131,11 @@ struct CKMCParams {
 		p_verbose = false;
 		p_both_strands = true;
 		p_p1 = 7;		
+		p_n_bins = 0;
+		p_sketch_scaled = 0;
+		p_sketch_size = 0;
+		p_sketch_only = false;
+		p_strand_counts = false;
 
 		gzip_buffer_size  = 64 << 20;
 		bzip2_buffer_size = 64 << 20;
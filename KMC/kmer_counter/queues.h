@@ -153,12 +153,14 @@ class CStatsPartQueue
 	condition_variable cv_queue_empty;
 	int n_readers;
 	int64 bytes_to_read;
+	int64 bytes_read;
 public:
 	CStatsPartQueue(int _n_readers, int64 _bytes_to_read)
 	{
 		unique_lock<mutex> lck(mtx);
 		n_readers = _n_readers;
 		bytes_to_read = _bytes_to_read;
+		bytes_read = 0;
 	}
 
 	~CStatsPartQueue() {};
@@ -184,12 +186,18 @@ public:
 		bool was_empty = q.empty();
 		q.push(make_pair(part, size));
 		bytes_to_read -= size;
+		bytes_read += size;
 		if (was_empty)
 			cv_queue_empty.notify_one();
 
 		return true;
 	}
 
+	int64 get_bytes_read() {
+		lock_guard<mutex> lck(mtx);
+		return bytes_read;
+	}
+
 	bool pop(uchar *&part, uint64 &size) {
 		unique_lock<mutex> lck(mtx);
 		cv_queue_empty.wait(lck, [this]{return !this->q.empty() || !this->n_readers; });
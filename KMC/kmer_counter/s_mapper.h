@@ -27,50 +27,84 @@ class CSignatureMapper
 	uint32 special_signature;
 	CMemoryPool* pmm_stats;
 
+	uint32 max_x;				// k+x-mers are sorted in stage 2 (0: k-mers)
+	uint32 radix_passes;		// no. of passes of the radix sort in stage 2
+
 	class Comp
 	{
-		uint32* signature_occurences;
+		double* signature_costs;
 	public:
-		Comp(uint32* _signature_occurences) : signature_occurences(_signature_occurences){}
+		Comp(double* _signature_costs) : signature_costs(_signature_costs){}
 		bool operator()(int i, int j)
 		{
-			return signature_occurences[i] > signature_occurences[j];
+			return signature_costs[i] > signature_costs[j];
 		}
 	};
 	
 public:	
-	void Init(uint32* stats)
+	// Expected no. of records sorted in stage 2 for the given numbers of k-mers and super-k-mers.
+	// A super-k-mer of n k-mers is expanded to ceil(n / (max_x + 1)) k+x-mers.
+	double SortedRecords(double n_kmers, double n_super_kmers)
+	{
+		if (!max_x)
+			return n_kmers;
+		return (n_kmers + n_super_kmers * max_x / 2.0) / (max_x + 1);
+	}
+
+	// Expected cost of stage 2 for the k-mers of a signature (in record moves): the expansion
+	// of super-k-mers touches each k-mer, the radix sort and the compaction touch each record
+	double SignatureCost(double n_kmers, double n_super_kmers)
+	{
+		return n_kmers + SortedRecords(n_kmers, n_super_kmers) * (radix_passes + 1);
+	}
+
+	// Group the signatures into at most n_bins bins of similar costs. In stats there are
+	// the numbers of k-mers of signatures followed by the numbers of their super-k-mers
+	void Init(uint32* stats, uint32 n_bins)
 	{
 		uint32 *sorted;
+		double *costs;
 		pmm_stats->reserve(sorted);
+		pmm_stats->reserve(costs);
+
+		// Each signature gets a prior of 1000 k-mers (in super-k-mers of the average length),
+		// as its occurrences in the sample are only an estimate
+		double n_kmers = 0.0, n_super_kmers = 0.0;
+		for (uint32 i = 0; i < map_size; ++i)
+		{
+			n_kmers += stats[i];
+			n_super_kmers += stats[map_size + i];
+		}
+		double prior_kmers = 1000.0;
+		double prior_super_kmers = n_kmers > 0 ? prior_kmers * n_super_kmers / n_kmers : prior_kmers;
+		for (uint32 i = 0; i < map_size; ++i)
+			costs[i] = SignatureCost(stats[i] + prior_kmers, stats[map_size + i] + prior_super_kmers);
+
 		for (uint32 i = 0; i < map_size ; ++i)
 			sorted[i] = i;
-		sort(sorted, sorted + map_size, Comp(stats));
+		sort(sorted, sorted + map_size, Comp(costs));
 
-		list<pair<uint32, uint64>> _stats;
+		list<pair<uint32, double>> _stats;
 		for (uint32 i = 0; i < map_size ; ++i)
 		{
 			if (CMmer::is_allowed(sorted[i], signature_len))
-				_stats.push_back(make_pair(sorted[i], stats[sorted[i]]));
+				_stats.push_back(make_pair(sorted[i], costs[sorted[i]]));
 		}
 
-		list<pair<uint32, uint64>> group;
+		list<pair<uint32, double>> group;
 		uint32 bin_no = 0;
 		//counting sum
 		double sum = 0.0;
 		for (auto &i : _stats)
-		{
-			i.second += 1000;
 			sum += i.second;
-		}
 
-		double mean = sum / MAX_BINS;
+		double mean = sum / n_bins;
 		double max_bin_size = 1.1 * mean;
-		uint32 n = MAX_BINS - 1; //one is needed for disabled signatures
-		uint32 max_bins = MAX_BINS - 1;
+		uint32 n = n_bins - 1; //one is needed for disabled signatures
+		uint32 max_bins = n_bins - 1;
 		while (_stats.size() > n)
 		{
-			pair<uint32, uint64>& max = _stats.front();
+			pair<uint32, double>& max = _stats.front();
 
 			if (max.second > mean)
 			{
@@ -122,6 +156,7 @@ public:
 			}
 		}
 		signature_map[special_signature] = bin_no;
+		pmm_stats->free(costs);
 		pmm_stats->free(sorted);
 
 #ifdef DEVELOP_MODE
@@ -129,10 +164,12 @@ public:
 #endif
 
 	}
-	CSignatureMapper(CMemoryPool* _pmm_stats, uint32 _signature_len)
+	CSignatureMapper(CMemoryPool* _pmm_stats, uint32 _signature_len, uint32 _kmer_len, uint32 _max_x)
 	{
 		pmm_stats = _pmm_stats;
 		signature_len = _signature_len;
+		max_x = _max_x;
+		radix_passes = (_kmer_len + (max_x ? max_x + 1 : 0) + 3) / 4;
 		special_signature = 1 << 2 * signature_len;
 		map_size = (1 << 2 * signature_len) + 1;
 		signature_map = new int32[map_size];		
@@ -163,4 +200,4 @@ public:
 
 };
 
-#endif 
\ No newline at end of file
+#endif 
\ No newline at end of file
@@ -56,6 +56,11 @@ template <bool QUAKE_MODE> class CSplitter {
 	uint32 kmer_len;
 	//uint32 prefix_len;
 	uint32 signature_len;
+	uint32 kmer_span;
+	vector<uint32> mask_positions;		// care positions of spaced k-mers (empty for contiguous k-mers)
+	vector<uint32> mirror_positions;	// care positions of the reverse complement of a window
+	bool asymmetric_mask;				// mirror_positions differ from mask_positions and both strands are counted
+	vector<char> masked_seq;
 	uint32 n_bins;	
 	uint64 n_reads;//for multifasta its a sequences counter	
 
@@ -64,6 +69,16 @@ template <bool QUAKE_MODE> class CSplitter {
 	inline bool GetSeq(char *seq, uint32 &seq_size);
 	inline bool GetSeq(char *seq, char *quals, uint32 &seq_size);
 
+	inline void PutMaskedKmers(char *seq, uint32 start, uint32 n_kmers, uint32 signature, uint32* _stats);
+	inline bool IsRevKmerSmaller(char *window);
+	void ProcessMaskedSeq(char *seq, uint32 seq_size, uint32* _stats);
+
+	// Count a super-k-mer of n_kmers k-mers in the statistics of its signature
+	inline void UpdateStats(uint32* _stats, uint32 signature, uint32 n_kmers)
+	{
+		_stats[signature] += n_kmers;
+		_stats[(1 << signature_len * 2) + 1 + signature]++;
+	}
 	
 
 	friend class CSplitter_Impl<QUAKE_MODE>;
@@ -247,7 +262,7 @@ template <bool QUAKE_MODE> bool CSplitter<QUAKE_MODE>::GetSeq(char *seq, uint32
 		seq_size = pos;
 		if(part_pos < part_size && part[part_pos] != '>')//need to copy last k-1 kmers 
 		{
-			part_pos -= kmer_len - 1;
+			part_pos -= kmer_span - 1;
 		}
 		return true;
 		
@@ -349,7 +364,9 @@ template <bool QUAKE_MODE> bool CSplitter<QUAKE_MODE>::GetSeq(char *seq, char *q
 	return (c == '\n' || c == '\r');
 }
 
-
+//----------------------------------------------------------------------------------
+// Collect the statistics of signatures: the no. of k-mers of each signature, followed by
+// the no. of super-k-mers of each signature
 template <bool QUAKE_MODE> void CSplitter<QUAKE_MODE>::CalcStats(uchar* _part, uint64 _part_size, uint32* _stats)
 {
 	part = _part;
@@ -362,12 +379,18 @@ template <bool QUAKE_MODE> void CSplitter<QUAKE_MODE>::CalcStats(uchar* _part, u
 
 	uint32 signature_start_pos;
 	CMmer current_signature(signature_len), end_mmer(signature_len);
+	CMmerQueue signature_queue(signature_len, kmer_len);
 
 	uint32 i;
 	uint32 len;//length of extended kmer
 
 	while (GetSeq(seq, seq_size))
 	{
+		if (!mask_positions.empty())
+		{
+			ProcessMaskedSeq(seq, seq_size, _stats);
+			continue;
+		}
 		i = 0;
 		len = 0;
 		while (i + kmer_len - 1 < seq_size)
@@ -390,12 +413,13 @@ template <bool QUAKE_MODE> void CSplitter<QUAKE_MODE>::CalcStats(uchar* _part, u
 			signature_start_pos = i - signature_len;
 			current_signature.insert(seq + signature_start_pos);
 			end_mmer.set(current_signature);
+			signature_queue.clear();
 			for (; i < seq_size; ++i)
 			{
 				if (seq[i] < 0)//'N'
 				{
 					if (len >= kmer_len)
-						_stats[current_signature.get()] += 1 + len - kmer_len;
+						UpdateStats(_stats, current_signature.get(), 1 + len - kmer_len);
 					len = 0;
 					++i;
 					break;
@@ -405,7 +429,7 @@ template <bool QUAKE_MODE> void CSplitter<QUAKE_MODE>::CalcStats(uchar* _part, u
 				{
 					if (len >= kmer_len)
 					{
-						_stats[current_signature.get()] += 1 + len - kmer_len;
+						UpdateStats(_stats, current_signature.get(), 1 + len - kmer_len);
 						len = kmer_len - 1;
 					}
 					current_signature.set(end_mmer);
@@ -418,28 +442,17 @@ template <bool QUAKE_MODE> void CSplitter<QUAKE_MODE>::CalcStats(uchar* _part, u
 				}
 				else if (signature_start_pos + kmer_len - 1 < i)//need to find new signature
 				{
-					_stats[current_signature.get()] += 1 + len - kmer_len;
+					UpdateStats(_stats, current_signature.get(), 1 + len - kmer_len);
 					len = kmer_len - 1;
 					//looking for new signature
-					++signature_start_pos;
-					//building first signature in current k-mer
-					end_mmer.insert(seq + signature_start_pos);
-					current_signature.set(end_mmer);
-					for (uint32 j = signature_start_pos + signature_len; j <= i; ++j)
-					{
-						end_mmer.insert(seq[j]);
-						if (end_mmer <= current_signature)
-						{
-							current_signature.set(end_mmer);
-							signature_start_pos = j - signature_len + 1;
-						}
-					}
+					signature_start_pos = signature_queue.next_min(seq, signature_start_pos, i - signature_len + 1);
+					current_signature.insert(seq + signature_start_pos);
 				}
 				++len;
 			}
 		}
 		if (len >= kmer_len)//last one in read
-			_stats[current_signature.get()] += 1 + len - kmer_len;
+			UpdateStats(_stats, current_signature.get(), 1 + len - kmer_len);
 	}
 
 	putchar('*');
@@ -447,6 +460,116 @@ template <bool QUAKE_MODE> void CSplitter<QUAKE_MODE>::CalcStats(uchar* _part, u
 
 	pmm_reads->free(seq);
 }
+
+//----------------------------------------------------------------------------------
+// Split a read into spaced k-mers: the care symbols of windows of kmer_span symbols. When both strands
+// are counted, the k-mer of a window is the smaller of the care symbols of the window and of its reverse
+// complement; for an asymmetric mask, the latter are taken at the mirrored positions of the window, so
+// they are not the reverse complement of the former. The signature of a spaced k-mer is the smallest
+// canonical m-mer of this canonical form (as for contiguous k-mers, so that kmc_api finds it), which
+// depends neither on the don't care symbols nor on the strand of the window. A window with 'N' at a care
+// position of either strand is skipped. Runs of consecutive windows of the same signature are passed to
+// the bins (or, if _stats is given, to the statistics) as extended k-mers.
+template <bool QUAKE_MODE> void CSplitter<QUAKE_MODE>::ProcessMaskedSeq(char *seq, uint32 seq_size, uint32* _stats)
+{
+	CMmer mmer(signature_len);
+	uint32 no_signature = 1 << signature_len * 2;		// greater than the values of all m-mers
+	uint32 run_start = 0, run_len = 0, run_signature = 0;
+
+	for (uint32 i = 0; i + kmer_span <= seq_size; ++i)
+	{
+		uint32 signature = no_signature;
+		uint32 j;
+		for (j = 0; j < kmer_len; ++j)
+		{
+			char symb = seq[i + mask_positions[j]];
+			if (symb < 0)//'N' at a care position
+				break;
+			mmer.insert((uchar)symb);
+			if (j + 1 >= signature_len && mmer.get() < signature)
+				signature = mmer.get();
+		}
+		// The m-mers of the reverse k-mer are the reverse complements of the ones of the symbols at the
+		// mirrored positions, which have the same canonical form
+		if (asymmetric_mask && j == kmer_len)
+		{
+			uint32 rev_signature = no_signature;
+			for (j = 0; j < kmer_len; ++j)
+			{
+				char symb = seq[i + mirror_positions[j]];
+				if (symb < 0)//'N' at a care position of the reverse complement
+					break;
+				mmer.insert((uchar)symb);
+				if (j + 1 >= signature_len && mmer.get() < rev_signature)
+					rev_signature = mmer.get();
+			}
+			if (j == kmer_len && IsRevKmerSmaller(seq + i))
+				signature = rev_signature;
+		}
+
+		//one byte is used to store counter of additional symbols in extended k-mer
+		if (j < kmer_len || (run_len && signature != run_signature) || run_len == 256)
+		{
+			if (run_len)
+				PutMaskedKmers(seq, run_start, run_len, run_signature, _stats);
+			run_len = 0;
+			if (j < kmer_len)
+				continue;
+		}
+		if (!run_len)
+		{
+			run_start = i;
+			run_signature = signature;
+		}
+		++run_len;
+	}
+	if (run_len)
+		PutMaskedKmers(seq, run_start, run_len, run_signature, _stats);
+}
+
+//----------------------------------------------------------------------------------
+// Check if the spaced k-mer of the reverse complement of a window is smaller than the one of the window
+template <bool QUAKE_MODE> inline bool CSplitter<QUAKE_MODE>::IsRevKmerSmaller(char *window)
+{
+	for (uint32 j = 0; j < kmer_len; ++j)
+	{
+		char symb = window[mask_positions[j]];
+		char rev_symb = 3 - window[mirror_positions[kmer_len - 1 - j]];
+		if (symb != rev_symb)
+			return rev_symb < symb;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------------
+// Store a run of n_kmers consecutive spaced k-mers of the same signature starting at seq[start]
+// as an extended k-mer of kmer_span + n_kmers - 1 symbols, or count it in _stats
+template <bool QUAKE_MODE> inline void CSplitter<QUAKE_MODE>::PutMaskedKmers(char *seq, uint32 start, uint32 n_kmers, uint32 signature, uint32* _stats)
+{
+	if (_stats)
+	{
+		UpdateStats(_stats, signature, n_kmers);
+		return;
+	}
+
+	uint32 n = kmer_span + n_kmers - 1;
+	char *ext_kmer = seq + start;
+
+	// 'N' can occur only at don't care positions of all the k-mers of the run, so it is stored as any symbol
+	for (uint32 i = 0; i < n; ++i)
+		if (ext_kmer[i] < 0)
+		{
+			masked_seq.assign(ext_kmer, ext_kmer + n);
+			for (uint32 j = i; j < n; ++j)
+				if (masked_seq[j] < 0)
+					masked_seq[j] = 0;
+			ext_kmer = masked_seq.data();
+			break;
+		}
+
+	bins[s_mapper->get_bin_id(signature)]->PutExtendedKmer(ext_kmer, n);
+}
+
 //----------------------------------------------------------------------------------
 // Assigns queues and monitors
 template <bool QUAKE_MODE> CSplitter<QUAKE_MODE>::CSplitter(CKMCParams &Params, CKMCQueues &Queues)
@@ -462,6 +585,10 @@ template <bool QUAKE_MODE> CSplitter<QUAKE_MODE>::CSplitter(CKMCParams &Params,
 	pmm_reads	   = Queues.pmm_reads;
 	kmer_len		  = Params.kmer_len;
 	signature_len     = Params.signature_len;
+	kmer_span		  = Params.kmer_span;
+	mask_positions	  = Params.mask_positions;
+	mirror_positions  = Params.mirror_positions;
+	asymmetric_mask	  = both_strands && mirror_positions != mask_positions;
 	
 	mem_part_pmm_bins = Params.mem_part_pmm_bins;
 
@@ -552,6 +679,7 @@ bool CSplitter_Impl<false>::ProcessReads(CSplitter<false> &ptr, uchar *_part, ui
 
 	uint32 signature_start_pos;
 	CMmer current_signature(ptr.signature_len), end_mmer(ptr.signature_len);
+	CMmerQueue signature_queue(ptr.signature_len, ptr.kmer_len);
 	uint32 bin_no;
 	
 	uint32 i;
@@ -561,6 +689,11 @@ bool CSplitter_Impl<false>::ProcessReads(CSplitter<false> &ptr, uchar *_part, ui
 	{
 		if (ptr.file_type != multiline_fasta)
 			ptr.n_reads++;
+		if (!ptr.mask_positions.empty())
+		{
+			ptr.ProcessMaskedSeq(seq, seq_size, NULL);
+			continue;
+		}
 		i = 0;
 		len = 0;
 		while (i + ptr.kmer_len - 1 < seq_size)
@@ -583,6 +716,7 @@ bool CSplitter_Impl<false>::ProcessReads(CSplitter<false> &ptr, uchar *_part, ui
 			signature_start_pos = i - ptr.signature_len;
 			current_signature.insert(seq + signature_start_pos);
 			end_mmer.set(current_signature);
+			signature_queue.clear();
 			for (; i < seq_size; ++i)
 			{
 				if (seq[i] < 0)//'N'
@@ -619,19 +753,8 @@ bool CSplitter_Impl<false>::ProcessReads(CSplitter<false> &ptr, uchar *_part, ui
 					ptr.bins[bin_no]->PutExtendedKmer(seq + i - len, len);
 					len = ptr.kmer_len - 1;
 					//looking for new signature
-					++signature_start_pos;
-					//building first signature in current k-mer
-					end_mmer.insert(seq + signature_start_pos);
-					current_signature.set(end_mmer);
-					for (uint32 j = signature_start_pos + ptr.signature_len; j <= i; ++j)
-					{
-						end_mmer.insert(seq[j]);
-						if (end_mmer <= current_signature)
-						{
-							current_signature.set(end_mmer);
-							signature_start_pos = j - ptr.signature_len + 1;
-						}
-					}
+					signature_start_pos = signature_queue.next_min(seq, signature_start_pos, i - ptr.signature_len + 1);
+					current_signature.insert(seq + signature_start_pos);
 				}
 				++len;
 				if (len == ptr.kmer_len + 255) //one byte is used to store counter of additional symbols in extended k-mer
@@ -680,6 +803,7 @@ bool CSplitter_Impl<true>::ProcessReads(CSplitter<true> &ptr, uchar *_part, uint
 
 	uint32 signature_start_pos;
 	CMmer current_signature(ptr.signature_len), end_mmer(ptr.signature_len);
+	CMmerQueue signature_queue(ptr.signature_len, ptr.kmer_len);
 	uint32 bin_no;
 
 	uint32 i;
@@ -713,6 +837,7 @@ bool CSplitter_Impl<true>::ProcessReads(CSplitter<true> &ptr, uchar *_part, uint
 			signature_start_pos = i - ptr.signature_len;
 			current_signature.insert(seq + signature_start_pos);
 			end_mmer.set(current_signature);
+			signature_queue.clear();
 			for (; i < seq_size; ++i)
 			{
 				if (seq[i] < 0)//'N'
@@ -749,19 +874,8 @@ bool CSplitter_Impl<true>::ProcessReads(CSplitter<true> &ptr, uchar *_part, uint
 					ptr.bins[bin_no]->PutExtendedKmer(seq + i - len, quals + i - len, len);
 					len = ptr.kmer_len - 1;
 					//looking for new signature
-					++signature_start_pos;
-					//building first signature in current k-mer
-					end_mmer.insert(seq + signature_start_pos);
-					current_signature.set(end_mmer);
-					for (uint32 j = signature_start_pos + ptr.signature_len; j <= i; ++j)
-					{
-						end_mmer.insert(seq[j]);
-						if (end_mmer <= current_signature)
-						{
-							current_signature.set(end_mmer);
-							signature_start_pos = j - ptr.signature_len + 1;
-						}
-					}
+					signature_start_pos = signature_queue.next_min(seq, signature_start_pos, i - ptr.signature_len + 1);
+					current_signature.insert(seq + signature_start_pos);
 				}
 				++len;
 				if (len == ptr.kmer_len + 255) //one byte is used to store counter of additional symbols in extended k-mer
@@ -897,7 +1011,7 @@ template <bool QUAKE_MODE> CWStatsSplitter<QUAKE_MODE>::CWStatsSplitter(CKMCPara
 	
 	signature_len = Params.signature_len;
 	pmm_stats->reserve(stats);
-	fill_n(stats, (1 << signature_len * 2) + 1, 0);
+	fill_n(stats, 2 * ((1 << signature_len * 2) + 1), 0);
 }
 
 //----------------------------------------------------------------------------------
@@ -930,7 +1044,7 @@ template <bool QUAKE_MODE> void CWStatsSplitter<QUAKE_MODE>::operator()()
 //----------------------------------------------------------------------------------
 template <bool QUAKE_MODE> void CWStatsSplitter<QUAKE_MODE>::GetStats(uint32* _stats)
 {
-	uint32 size = (1 << signature_len * 2) + 1;
+	uint32 size = 2 * ((1 << signature_len * 2) + 1);
 	for (uint32 i = 0; i < size; ++i)
 		_stats[i] += stats[i];
 }
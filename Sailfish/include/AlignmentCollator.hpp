@@ -0,0 +1,125 @@
+#ifndef ALIGNMENT_COLLATOR_HPP
+#define ALIGNMENT_COLLATOR_HPP
+
+#include "StadenUtils.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+  * One fragment of a collated read: both ends of a concordant (or unmapped)
+  * pair, or a single record (mapped orphan, single-end read) with
+  * read2 == nullptr.
+  */
+struct CollatedFragment {
+    bam_seq_t* read1;
+    bam_seq_t* read2;
+};
+
+/**
+  * Groups the alignment records of a file which is *not* grouped by read name
+  * (e.g. coordinate-sorted) into the set of alignments of each read.
+  *
+  * Records are held in a hash keyed by read name until the read is complete,
+  * i.e. until as many fragments as announced by its NH tag have been seen, and
+  * are then handed out by nextGroup().  Reads without an NH tag stay pending
+  * until the end of the input.  When the pending records exceed the memory
+  * budget, they are spilled to hash-partitioned files in the temporary
+  * directory, along with every later record of the same reads; after
+  * finish(), the spill files are collated one partition at a time.
+  *
+  * The hashes of the spilled read names count against the memory budget
+  * too.  On input that is far from grouped by name, they could otherwise
+  * grow with the number of reads; once they take half of the budget, every
+  * record from then on goes straight to the spill files and the hashes are
+  * dropped.  A spill file larger than the budget is split again, by other
+  * bits of the hash, before it is read back, so that only the records of
+  * a single read can exceed the budget.
+  *
+  * The collator owns the records it is given; records handed out in a group
+  * must be returned with recycle() (or swapped for the ones they replace).
+  */
+class AlignmentCollator {
+public:
+    AlignmentCollator(bool paired, size_t memoryBudget,
+                      const boost::filesystem::path& tmpDir);
+    ~AlignmentCollator();
+
+    /** Take ownership of rec and replace it with an empty record in which
+      * to read the next alignment.  If waitForMate is true, the record is
+      * paired with the matching record of its mate before being emitted.
+      */
+    void add(bam_seq_t*& rec, bool waitForMate);
+
+    /** No more records: reads that are still pending are complete. */
+    void finish();
+
+    /** Get the next complete read, if any.  Once finish() has been called,
+      * a false return value means that all of the reads have been emitted.
+      */
+    bool nextGroup(std::vector<CollatedFragment>& group);
+
+    /** Give back a record that is no longer needed. */
+    void recycle(bam_seq_t* rec);
+
+    size_t numSpilledRecords() const { return numSpilledRecords_; }
+    size_t numUnmatchedRecords() const { return numUnmatchedRecords_; }
+
+private:
+    struct PartialGroup {
+        std::vector<CollatedFragment> fragments;
+        std::vector<bam_seq_t*> unmatched;
+        int32_t expected{-1};
+        size_t bytes{0};
+    };
+
+    std::string readKey_(bam_seq_t* rec) const;
+    void insert_(const std::string& key, bam_seq_t* rec, bool waitForMate, bool closeOnCount);
+    void close_(std::unordered_map<std::string, PartialGroup>::iterator it);
+    void spillAll_();
+    void spillRecord_(uint64_t hash, bam_seq_t* rec, bool waitForMate);
+    void writeSpilled_(size_t partition, bam_seq_t* rec, bool waitForMate);
+    bam_seq_t* readSpilled_(size_t partition, bool& waitForMate);
+    void splitPartition_(size_t partition);
+    bool loadPartition_();
+    bam_seq_t* spare_();
+
+    bool paired_;
+    size_t memoryBudget_;
+    boost::filesystem::path spillDir_;
+
+    std::unordered_map<std::string, PartialGroup> pending_;
+    size_t pendingBytes_{0};
+    std::deque<std::vector<CollatedFragment>> ready_;
+    std::vector<bam_seq_t*> spares_;
+
+    // Hashes of the names of the reads sent to the spill files; a collision
+    // only sends the records of another read there too.
+    std::unordered_set<uint64_t> spilledReads_;
+    // Set once spilledReads_ outgrew its share of the budget
+    bool spillEverything_{false};
+    std::vector<FILE*> spillFiles_;
+    std::vector<boost::filesystem::path> spillPaths_;
+    // The number of times the records of each partition were split
+    std::vector<uint32_t> spillLevels_;
+    size_t nextPartition_{0};
+    bool finished_{false};
+
+    size_t numSpilledRecords_{0};
+    size_t numUnmatchedRecords_{0};
+};
+
+/**
+  * Returns true if the header of a SAM/BAM file declares that the records
+  * are sorted by coordinate (SO:coordinate in the @HD line).
+  */
+bool isCoordinateSorted(SAM_hdr* header);
+
+#endif // ALIGNMENT_COLLATOR_HPP
@@ -76,7 +76,11 @@ class AlignmentLibrary {
             // The alignment file existed, so create the alignment queue
             size_t numParseThreads = salmonOpts.numParseThreads;
             std::cerr << "parseThreads = " << numParseThreads << "\n";
-            bq = std::unique_ptr<BAMQueue<FragT>>(new BAMQueue<FragT>(alnFiles, libFmt_, numParseThreads));
+            bq = std::unique_ptr<BAMQueue<FragT>>(new BAMQueue<FragT>(alnFiles, libFmt_, numParseThreads,
+                                                                        salmonOpts.numCachedFragments));
+            bq->setCollation(salmonOpts.collateAlignments,
+                             salmonOpts.collationMemoryMB * 1024 * 1024,
+                             salmonOpts.collationDirectory);
 
             std::cerr << "Checking that provided alignment files have consistent headers . . . ";
             if (! salmon::utils::headersAreConsistent(bq->headers()) ) {
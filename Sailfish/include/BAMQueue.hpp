@@ -19,6 +19,7 @@
 #include "SailfishMath.hpp"
 #include "ReadPair.hpp"
 #include "UnpairedRead.hpp"
+#include "AlignmentCollator.hpp"
 #include "spdlog/spdlog.h"
 
 extern "C" {
@@ -37,6 +38,7 @@ struct AlignmentFile {
     scram_fd* fp;
     SAM_hdr* header;
     uint32_t numParseThreads;
+    bool coordinateSorted;
 };
 
 /**
@@ -49,7 +51,15 @@ struct AlignmentFile {
 template <typename FragT>
 class BAMQueue {
 public:
-  BAMQueue(std::vector<boost::filesystem::path>& fnames, LibraryFormat& libFmt, uint32_t numParseThreads);
+  BAMQueue(std::vector<boost::filesystem::path>& fnames, LibraryFormat& libFmt, uint32_t numParseThreads,
+           size_t numCachedFragments = 5000000);
+
+  /** Collate the records of the files by read name, in at most memoryBudget
+    * bytes plus spill files in tmpDir, rather than expect the alignments
+    * of a read to be consecutive.  This is always done for files whose
+    * header says they are sorted by coordinate.
+    */
+  void setCollation(bool force, size_t memoryBudget, const boost::filesystem::path& tmpDir);
   ~BAMQueue();
   void forceEndParsing();
 
@@ -80,6 +90,28 @@ private:
   template <typename FilterT>
   void fillQueue_(FilterT);
 
+  /** Fill the queue from files which are not grouped by read name */
+  template <typename FilterT>
+  void fillQueueCollated_(FilterT filt);
+
+  /** Overload of collate_ for paired-end reads */
+  template <typename FilterT>
+  inline void collate_(bam_seq_t*& rec, ReadPair& scratch, AlignmentCollator& collator, FilterT filt);
+  /** Overload of collate_ for single-end reads */
+  template <typename FilterT>
+  inline void collate_(bam_seq_t*& rec, UnpairedRead& scratch, AlignmentCollator& collator, FilterT filt);
+
+  /** Overload of makeFrag_ for paired-end reads */
+  template <typename FilterT>
+  inline bool makeFrag_(CollatedFragment& cfrag, ReadPair& rpair, FilterT filt);
+  /** Overload of makeFrag_ for single-end reads */
+  template <typename FilterT>
+  inline bool makeFrag_(CollatedFragment& cfrag, UnpairedRead& sread, FilterT filt);
+
+  /** Send the alignments of a collated read to the group queue */
+  template <typename FilterT>
+  void pushCollatedGroup_(std::vector<CollatedFragment>& group, AlignmentCollator& collator, FilterT filt);
+
   /** Overload of getFrag_ for paired-end reads */
   template <typename FilterT>
   inline bool getFrag_(ReadPair& rpair, FilterT filt);
@@ -113,6 +145,10 @@ private:
 
   size_t batchNum_;
   std::string readMode_;
+
+  bool forceCollation_{false};
+  size_t collationMemory_{size_t(2) << 30};
+  boost::filesystem::path collationDir_;
 };
 
 #include "BAMQueue.tpp"
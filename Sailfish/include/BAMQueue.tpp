@@ -2,17 +2,18 @@
 #include "IOUtils.hpp"
 #include <boost/config.hpp> // for BOOST_LIKELY/BOOST_UNLIKELY
 #include <chrono>
+#include <type_traits>
 
 template <typename FragT>
 BAMQueue<FragT>::BAMQueue(std::vector<boost::filesystem::path>& fnames, LibraryFormat& libFmt,
-                          uint32_t numParseThreads):
+                          uint32_t numParseThreads, size_t numCachedFragments):
     files_(std::vector<AlignmentFile>()),
     libFmt_(libFmt), totalReads_(0),
     numUnaligned_(0), numMappedReads_(0), doneParsing_(false) {
 
         logger_ = spdlog::get("jointLog");
 
-        size_t capacity{5000000};
+        size_t capacity{numCachedFragments};
         fragmentQueue_.set_capacity(capacity);
         for (size_t i = 0; i < capacity; ++i) {
             // avoid r-value ref until we figure out what's
@@ -21,7 +22,7 @@ BAMQueue<FragT>::BAMQueue(std::vector<boost::filesystem::path>& fnames, LibraryF
             fragmentQueue_.push(fragPtr);
         }
 
-        size_t groupCapacity = 5000000;
+        size_t groupCapacity = numCachedFragments;
         alnGroupPool_.set_capacity(groupCapacity);
         for (size_t i = 0; i < groupCapacity; ++i) {
             // avoid r-value ref until we figure out what's
@@ -50,9 +51,19 @@ BAMQueue<FragT>::BAMQueue(std::vector<boost::filesystem::path>& fnames, LibraryF
                 scram_close(fp);
                 fp = nullptr;
             }
-            files_.push_back({fname, readMode_, fp, header, numParseThreads});
+            files_.push_back({fname, readMode_, fp, header, numParseThreads,
+                              isCoordinateSorted(header)});
             firstFile = false;
         }
+        collationDir_ = boost::filesystem::temp_directory_path();
+}
+
+template <typename FragT>
+void BAMQueue<FragT>::setCollation(bool force, size_t memoryBudget,
+                                   const boost::filesystem::path& tmpDir) {
+    forceCollation_ = force;
+    collationMemory_ = memoryBudget;
+    collationDir_ = tmpDir;
 }
 
 template <typename FragT>
@@ -466,9 +477,185 @@ size_t BAMQueue<FragT>::numMappedReads(){
     return numMappedReads_;
 }
 
+template <typename FragT>
+template <typename FilterT>
+inline void BAMQueue<FragT>::collate_(bam_seq_t*& rec, ReadPair& scratch,
+                                      AlignmentCollator& collator, FilterT filt) {
+    switch (getPairedAlignmentType_(rec)) {
+        case AlignmentType::MappedConcordantPair:
+        case AlignmentType::UnmappedPair:
+            collator.add(rec, true);
+            break;
+        case AlignmentType::MappedOrphan:
+            collator.add(rec, false);
+            break;
+        case AlignmentType::UnmappedOrphan:
+            ++numUnaligned_;
+            if (filt != nullptr) {
+                std::swap(scratch.read1, rec);
+                scratch.orphanStatus = salmon::utils::OrphanStatus::LeftOrphan;
+                filt->processFrag(&scratch);
+                std::swap(scratch.read1, rec);
+            }
+            break;
+        case AlignmentType::MappedDiscordantPair:
+            // Skipped, as in getFrag_
+            break;
+    }
+}
+
+template <typename FragT>
+template <typename FilterT>
+inline void BAMQueue<FragT>::collate_(bam_seq_t*& rec, UnpairedRead& scratch,
+                                      AlignmentCollator& collator, FilterT filt) {
+    if (!(bam_flag(rec) & BAM_FDUP) and
+        !(bam_flag(rec) & BAM_FQCFAIL) and
+        !(bam_flag(rec) & BAM_FUNMAP) and
+        bam_ref(rec) >= 0) {
+        collator.add(rec, false);
+        return;
+    }
+    if (filt != nullptr) {
+        std::swap(scratch.read, rec);
+        filt->processFrag(&scratch);
+        std::swap(scratch.read, rec);
+    }
+    ++numUnaligned_;
+    ++totalReads_;
+}
+
+template <typename FragT>
+template <typename FilterT>
+inline bool BAMQueue<FragT>::makeFrag_(CollatedFragment& cfrag, ReadPair& rpair, FilterT filt) {
+    // The records of the fragment go to rpair, the ones it held are
+    // given back through cfrag.
+    std::swap(rpair.read1, cfrag.read1);
+    rpair.logProb = sailfish::math::LOG_0;
+    if (cfrag.read2 == nullptr) {
+        rpair.orphanStatus = (bam_flag(rpair.read1) & BAM_FREVERSE) ?
+            salmon::utils::OrphanStatus::LeftOrphan :
+            salmon::utils::OrphanStatus::RightOrphan;
+        return true;
+    }
+    std::swap(rpair.read2, cfrag.read2);
+    rpair.orphanStatus = salmon::utils::OrphanStatus::Paired;
+    ++totalReads_;
+    if (bam_flag(rpair.read1) & BAM_FUNMAP) {
+        ++numUnaligned_;
+        if (filt != nullptr) { filt->processFrag(&rpair); }
+        return false;
+    }
+    return true;
+}
+
+template <typename FragT>
+template <typename FilterT>
+inline bool BAMQueue<FragT>::makeFrag_(CollatedFragment& cfrag, UnpairedRead& sread, FilterT filt) {
+    std::swap(sread.read, cfrag.read1);
+    sread.logProb = sailfish::math::LOG_0;
+    ++totalReads_;
+    return true;
+}
+
+template <typename FragT>
+template <typename FilterT>
+void BAMQueue<FragT>::pushCollatedGroup_(std::vector<CollatedFragment>& group,
+                                         AlignmentCollator& collator, FilterT filt) {
+    AlignmentGroup<FragT*>* alngroup;
+    alnGroupPool_.pop(alngroup);
+    for (auto& cfrag : group) {
+        FragT* f;
+        fragmentQueue_.pop(f);
+        bool isAligned = makeFrag_(cfrag, *f, filt);
+        collator.recycle(cfrag.read1);
+        if (cfrag.read2 != nullptr) { collator.recycle(cfrag.read2); }
+        if (isAligned) {
+            alngroup->addAlignment(f);
+        } else {
+            fragmentQueue_.push(f);
+        }
+    }
+
+    if (alngroup->size() > 0) {
+        while(!alnGroupQueue_.push(alngroup));
+        numMappedReads_++;
+    } else {
+        alnGroupPool_.push(alngroup);
+    }
+}
+
+template <typename FragT>
+template <typename FilterT>
+void BAMQueue<FragT>::fillQueueCollated_(FilterT filt) {
+    AlignmentCollator collator(std::is_same<FragT, ReadPair>::value,
+                               collationMemory_, collationDir_);
+    std::vector<CollatedFragment> group;
+
+    // Used to hand unaligned records to the filter
+    FragT* scratch;
+    fragmentQueue_.pop(scratch);
+    bam_seq_t* rec = staden::utils::bam_init();
+
+    for (currFile_ = files_.begin(); currFile_ != files_.end(); ++currFile_) {
+        if (currFile_->fp == nullptr) {
+            currFile_->fp = scram_open(currFile_->fileName.c_str(), currFile_->readMode.c_str());
+            if (currFile_->fp == nullptr) {
+                fmt::MemoryWriter errstr;
+                errstr << "ERROR: Failed to open file " << currFile_->fileName.c_str() << ", exiting!\n";
+                logger_->warn(errstr.str());
+                std::exit(1);
+            }
+            scram_set_option(currFile_->fp, CRAM_OPT_NTHREADS, currFile_->numParseThreads);
+        }
+        fp_ = currFile_->fp;
+        hdr_ = currFile_->header;
+
+        while (scram_get_seq(fp_, &rec) >= 0) {
+            collate_(rec, *scratch, collator, filt);
+            while (collator.nextGroup(group)) {
+                pushCollatedGroup_(group, collator, filt);
+            }
+        }
+        scram_close(currFile_->fp);
+        currFile_->fp = nullptr;
+    }
+
+    // Reads whose alignments were not all announced, and the ones
+    // that went to disk
+    collator.finish();
+    while (collator.nextGroup(group)) {
+        pushCollatedGroup_(group, collator, filt);
+    }
+
+    staden::utils::bam_destroy(rec);
+    fragmentQueue_.push(scratch);
+
+    if (collator.numSpilledRecords() > 0 or collator.numUnmatchedRecords() > 0) {
+        fmt::MemoryWriter infostr;
+        infostr << "Collated the alignments by read name: "
+                << collator.numSpilledRecords() << " records went through temporary files in "
+                << collationDir_.string() << ", " << collator.numUnmatchedRecords()
+                << " records of concordant pairs had no mate and were skipped\n";
+        logger_->info(infostr.str());
+    }
+
+    currFile_ = files_.end();
+    fp_ = nullptr;
+    hdr_ = nullptr;
+    doneParsing_ = true;
+}
+
 template <typename FragT>
 template <typename FilterT>
 void BAMQueue<FragT>::fillQueue_(FilterT filt) {
+    // Files which are not grouped by read name go through the collator
+    bool collate = forceCollation_;
+    for (auto& file : files_) { collate = collate or file.coordinateSorted; }
+    if (collate) {
+        fillQueueCollated_(filt);
+        return;
+    }
+
     size_t n{0};
     AlignmentGroup<FragT*>* alngroup;
     alnGroupPool_.pop(alngroup);
@@ -0,0 +1,86 @@
+#ifndef CONVERGENCE_MONITOR_HPP
+#define CONVERGENCE_MONITOR_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "Transcript.hpp"
+#include "FragmentLengthDistribution.hpp"
+
+/**
+  * Decides when the online inference can stop, by comparing the estimates
+  * at successive checkpoints rather than counting observed fragments.
+  *
+  * At each checkpoint, the relative change in the abundance (TPM-like) and
+  * in the estimated number of reads of the transcripts that are expressed
+  * enough to matter is computed, as a mean weighted by the estimates, along
+  * with the total variation distance between the fragment length
+  * distributions.  The estimates have
+  * converged once all three are below the tolerance for a few checkpoints
+  * in a row.
+  */
+class ConvergenceMonitor {
+public:
+    struct Checkpoint {
+        uint64_t numObserved;
+        double abundanceChange;
+        double countChange;
+        double fragLengthChange;
+    };
+
+    /**
+      * A checkpoint is taken every `interval` observed fragments; the estimates
+      * have converged after `numStable` consecutive checkpoints under `tolerance`.
+      * A tolerance of 0 disables the monitor.
+      */
+    ConvergenceMonitor(double tolerance, uint64_t interval, uint32_t numStable = 3);
+
+    /** Track this fragment length distribution too (e.g. one per read library) */
+    void addFragmentLengthDistribution(FragmentLengthDistribution* fld);
+
+    /**
+      * Called by the workers as fragments are processed; takes a checkpoint
+      * if `numObserved` went past the next one.  Only one caller does the work,
+      * the others return right away.
+      */
+    void update(uint64_t numObserved, uint64_t numAssigned, std::vector<Transcript>& transcripts);
+
+    /** Take a checkpoint now, e.g. at the end of a pass, unless one was just taken */
+    void checkpoint(uint64_t numObserved, uint64_t numAssigned, std::vector<Transcript>& transcripts);
+
+    bool enabled() const { return tolerance_ > 0.0; }
+    bool converged() const { return converged_; }
+
+    const std::vector<Checkpoint>& trajectory() const { return trajectory_; }
+
+    /** Write one line per checkpoint, as a tab-separated table */
+    void writeTrajectory(const boost::filesystem::path& fname) const;
+
+private:
+    void checkpoint_(uint64_t numObserved, uint64_t numAssigned, std::vector<Transcript>& transcripts);
+
+    double tolerance_;
+    uint64_t interval_;
+    uint32_t numStable_;
+
+    std::mutex mutex_;
+    std::atomic<uint64_t> nextCheckpoint_;
+    std::atomic<bool> converged_{false};
+    uint32_t numStableCheckpoints_{0};
+    bool lastScheduled_{false};
+    uint64_t maxAssigned_{0};
+
+    std::vector<FragmentLengthDistribution*> flDists_;
+    // The estimates at the previous checkpoint
+    std::vector<double> prevAbundances_;
+    std::vector<double> prevCounts_;
+    std::vector<std::vector<double>> prevFragLengthPMFs_;
+    std::vector<Checkpoint> trajectory_;
+};
+
+#endif // CONVERGENCE_MONITOR_HPP
@@ -0,0 +1,64 @@
+#ifndef MEMORY_BUDGET_HPP
+#define MEMORY_BUDGET_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+/**
+  * Sizes the pools and queues of a quantification run from a single memory
+  * budget.  The components that can't shrink (the index, the transcript
+  * sequences) are reserved first; the others get a share of what remains,
+  * within the bounds they need to work.  When the budget is too small,
+  * they fall back to their minimum sizes, and smaller batches, rather than
+  * failing.
+  *
+  * Without a budget, every component keeps its default size.
+  */
+class MemoryBudget {
+public:
+    /** A budget of 0 MB means no budget */
+    explicit MemoryBudget(size_t budgetMB);
+
+    bool limited() const { return budget_ > 0; }
+
+    /** Account for a component of a fixed size */
+    void reserve(const std::string& component, size_t bytes);
+
+    /** Memory left for the pools, after the fixed components */
+    size_t available() const;
+
+    /**
+      * The number of items of `itemBytes` bytes this component can hold
+      * with the given share of the available memory; between minItems
+      * and defaultItems (the size without a budget).  The component is
+      * then accounted for, like a fixed one.
+      */
+    size_t capacity(const std::string& component, size_t itemBytes, double share,
+                    size_t minItems, size_t defaultItems);
+
+    /** Record the peak resident set size at the end of a stage of the run */
+    void recordPeakRSS(const std::string& stage);
+
+    /** Log the size of each component, and the growth of the peak RSS at each stage */
+    void report(std::shared_ptr<spdlog::logger> log) const;
+
+    /** Peak resident set size of the process, in bytes */
+    static size_t peakRSS();
+
+private:
+    struct Component {
+        std::string name;
+        size_t bytes;
+    };
+
+    size_t budget_;
+    size_t reserved_{0};
+    std::vector<Component> components_;
+    std::vector<Component> stages_;
+};
+
+#endif // MEMORY_BUDGET_HPP
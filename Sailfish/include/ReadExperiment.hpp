@@ -6,10 +6,12 @@ extern "C" {
 #include "bwamem.h"
 #include "kvec.h"
 #include "utils.h"
+#include "bwt_interleaved.h"
 }
 
 // Our includes
 #include "ClusterForest.hpp"
+#include "FragmentLengthDistribution.hpp"
 #include "Transcript.hpp"
 #include "ReadLibrary.hpp"
 
@@ -23,6 +25,9 @@ extern "C" {
 // Standard includes
 #include <vector>
 #include <memory>
+#include <thread>
+#include <algorithm>
+#include <atomic>
 
 /**
   *  This class represents a library of alignments used to quantify
@@ -66,6 +71,18 @@ class ReadExperiment {
                     fmt::print(stderr, "Please make sure that 'salmon index' has been run successfully\n");
                     std::exit(1);
                 }
+                // Indices built by older versions don't have the interleaved
+                // occurrence table; the BWA one is used then.
+                bfs::path interleavedPath = indexDirectory / "bwaidx.ilv";
+                if (bfs::exists(interleavedPath)) {
+                    interleavedBWT_ = bwtil_restore(interleavedPath.string().c_str());
+                    // The seeds are then found, and the suffix array decoded,
+                    // with the interleaved table only; BWA's copy of the BWT
+                    // is released (the sampled suffix array is kept).
+                    free(idx_->bwt->bwt);
+                    idx_->bwt->bwt = nullptr;
+                    idx_->bwt->bwt_size = 0;
+                }
             }
 
             size_t numRecords = idx_->bns->n_seqs;
@@ -129,10 +146,49 @@ class ReadExperiment {
 
             // Create the cluster forest for this set of transcripts
             clusters_.reset(new ClusterForest(transcripts_.size(), transcripts_));
+
+            // Each library may come from a different preparation, so it
+            // gets its own fragment length distribution.
+            size_t maxFragLen = 800;
+            size_t meanFragLen = 200;
+            size_t fragLenStd = 80;
+            size_t fragLenKernelN = 4;
+            double fragLenKernelP = 0.5;
+            for (size_t i = 0; i < readLibraries_.size(); ++i) {
+                flDists_.emplace_back(new FragmentLengthDistribution(
+                            1.0, maxFragLen,
+                            meanFragLen, fragLenStd,
+                            fragLenKernelN,
+                            fragLenKernelP, 1));
+            }
         }
 
     std::vector<Transcript>& transcripts() { return transcripts_; }
 
+    const bwtil_t* interleavedBWT() { return interleavedBWT_; }
+
+    bwaidx_t* index() { return idx_; }
+
+    /**
+      * Approximate size of the loaded index: the BWT and its occurrence table
+      * (BWA's or the interleaved one, whichever is kept), the sampled suffix
+      * array and the packed reference.
+      */
+    size_t indexBytes() const {
+        size_t bytes = idx_->bwt->n_sa * sizeof(bwtint_t);
+        if (idx_->bwt->bwt) { bytes += idx_->bwt->bwt_size * sizeof(uint32_t); }
+        if (interleavedBWT_) { bytes += interleavedBWT_->n_blocks * BWTIL_BLOCK_WORDS * sizeof(uint64_t); }
+        if (idx_->pac) { bytes += idx_->bns->l_pac / 4 + 1; }
+        return bytes;
+    }
+
+    /** Size of the transcript sequences (4 bits per base) */
+    size_t sequenceBytes() const {
+        size_t bytes{0};
+        for (auto& t : transcripts_) { bytes += (t.RefLength + 1) / 2; }
+        return bytes;
+    }
+
     uint64_t numAssignedFragments() { return numAssignedFragments_; }
     uint64_t numMappedReads() { return numAssignedFragments_; }
 
@@ -140,19 +196,52 @@ class ReadExperiment {
     std::atomic<uint64_t>& numAssignedFragmentsAtomic() { return numAssignedFragments_; }
     std::atomic<uint64_t>& batchNumAtomic() { return batchNum_; }
 
+    FragmentLengthDistribution& fragmentLengthDistribution(size_t libIdx) {
+        return *flDists_[libIdx].get();
+    }
+
+    /**
+     * Process the read libraries concurrently.  The threads are split among
+     * as many libraries as there are threads; a group of threads moves on to
+     * the next library once it's done with its own, so that the start-up and
+     * the tail of a small library don't leave the rest of the pool idle.
+     * The callback is given the index of the library and its fragment
+     * length distribution; the transcripts and the cluster forest are shared.
+     */
     template <typename CallbackT>
     bool processReads(const uint32_t& numThreads, CallbackT& processReadLibrary) {
         bool burnedIn = (totalAssignedFragments_ + numAssignedFragments_ > 5000000);
-        for (auto& rl : readLibraries_) {
-            processReadLibrary(rl, idx_, transcripts_, clusterForest(),
-                               numAssignedFragments_, batchNum_, numThreads, burnedIn);
+        size_t numLibs = readLibraries_.size();
+        size_t numGroups = std::max(size_t(1), std::min(numLibs, static_cast<size_t>(numThreads)));
+
+        std::atomic<size_t> nextLib{0};
+        auto processLibraries = [&](size_t groupThreads) -> void {
+            size_t i;
+            while ((i = nextLib++) < numLibs) {
+                processReadLibrary(readLibraries_[i], i, idx_, transcripts_, clusterForest(),
+                                   *flDists_[i].get(), numAssignedFragments_, batchNum_,
+                                   groupThreads, burnedIn);
+            }
+        };
+
+        if (numGroups == 1) {
+            processLibraries(std::max(numThreads, uint32_t(1)));
+            return true;
         }
+
+        std::vector<std::thread> groups;
+        for (size_t g = 0; g < numGroups; ++g) {
+            size_t groupThreads = numThreads / numGroups + ((g < numThreads % numGroups) ? 1 : 0);
+            groups.emplace_back(processLibraries, groupThreads);
+        }
+        for (auto& t : groups) { t.join(); }
         return true;
     }
 
     ~ReadExperiment() {
         // ---- Get rid of things we no longer need --------
         bwa_idx_destroy(idx_);
+        bwtil_destroy(interleavedBWT_);
     }
 
     ClusterForest& clusterForest() { return *clusters_.get(); }
@@ -207,7 +296,8 @@ class ReadExperiment {
         uint64_t numAgree{0};
         uint64_t numDisagree{0};
 
-        for (auto& rl : readLibraries_) {
+        for (size_t libIdx = 0; libIdx < readLibraries_.size(); ++libIdx) {
+            auto& rl = readLibraries_[libIdx];
             auto fmt = rl.format();
             auto& counts = rl.libTypeCounts();
 
@@ -308,6 +398,11 @@ class ReadExperiment {
                 errstr.clear();
             }
 
+            if (rl.isPairedEnd()) {
+                ofile << "estimated mean fragment length: "
+                      << flDists_[libIdx]->mean() << "\n\n";
+            }
+
             ofile << "---- counts for each format type ---\n";
             for (size_t i = 0; i < counts.size(); ++i) {
                 ofile << LibraryFormat::formatFromID(i) << " : " << counts[i] << "\n";
@@ -339,6 +434,11 @@ class ReadExperiment {
      * The index we've built on the set of transcripts.
      */
     bwaidx_t *idx_{nullptr};
+    /**
+     * The occurrence table of the index, in the interleaved layout
+     * (nullptr if the index doesn't have it).
+     */
+    bwtil_t *interleavedBWT_{nullptr};
     /**
      * The cluster forest maintains the dynamic relationship
      * defined by transcripts and reads --- if two transcripts
@@ -346,6 +446,10 @@ class ReadExperiment {
      * in the same cluster.
      */
     std::unique_ptr<ClusterForest> clusters_;
+    /**
+     * The fragment length distribution of each read library.
+     */
+    std::vector<std::unique_ptr<FragmentLengthDistribution>> flDists_;
     /** Keeps track of the number of passes that have been
      *  made through the alignment file.
      */
@@ -3,6 +3,8 @@
 
 #include <boost/filesystem.hpp>
 
+struct bwtil_s;
+
 /**
   * A structure to hold some common options used
   * by Salmon so that we don't have to pass them
@@ -21,7 +23,10 @@ struct SalmonOpts {
     */
 
     SalmonOpts() : splitSpanningSeeds(false), useFragLenDist(false),
-                   useReadCompat(false), maxReadOccs(200), extraSeedPass(false) {}
+                   useReadCompat(false), maxReadOccs(200), extraSeedPass(false),
+                   collateAlignments(false), collationMemoryMB(2048),
+                   convergenceTolerance(0.01), convergenceInterval(1000000), maxPasses(20),
+                   memoryBudgetMB(0), miniBatchSize(1000), numCachedFragments(5000000) {}
     bool splitSpanningSeeds; // Attempt to split seeds that span multiple transcripts.
 
     bool useFragLenDist; // Give a fragment assignment a likelihood based on an emperically
@@ -46,6 +51,26 @@ struct SalmonOpts {
 
     boost::filesystem::path indexDirectory; // Index directory
 
+    const bwtil_s* interleavedBWT{nullptr}; // Occurrence table of the index in the cache-friendly layout, if the index has one
+
+    bool collateAlignments; // Group the alignments by read name even if the header doesn't say they are sorted by coordinate
+
+    size_t collationMemoryMB; // Memory for the alignments of incomplete reads before spilling them to disk
+
+    boost::filesystem::path collationDirectory; // Directory of the spill files of the collation
+
+    double convergenceTolerance; // Stop once the estimates change by less than this between checkpoints (0 to use a fixed number of fragments)
+
+    uint64_t convergenceInterval; // Number of fragments between two convergence checkpoints
+
+    uint32_t maxPasses; // Give up on convergence after this many passes over the input
+
+    size_t memoryBudgetMB; // Size the caches, queues and batches to fit in this much memory (0 for no budget)
+
+    uint32_t miniBatchSize; // Number of fragments in each batch handed to a worker
+
+    size_t numCachedFragments; // Number of fragment and alignment group structures preallocated by the alignment parser
+
     uint32_t numThreads;
     uint32_t numQuantThreads;
     uint32_t numParseThreads;
@@ -0,0 +1,161 @@
+#ifndef SINGLE_CELL_QUANT_HPP
+#define SINGLE_CELL_QUANT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+
+#include "Transcript.hpp"
+#include "TranscriptDuplicates.hpp"
+
+/**
+  * Where the cell barcode and the UMI are in the barcode read of a pair.
+  * The geometry is given as a list of segments, each one a letter followed
+  * by a length: B for the barcode, U for the UMI and X for bases to skip.
+  * For instance, "B16U10" is a 16 base barcode followed by a 10 base UMI.
+  */
+class ReadGeometry {
+public:
+    /** Throws std::invalid_argument if the geometry can't be parsed */
+    explicit ReadGeometry(const std::string& spec);
+
+    /** Returns false if the read is too short for the geometry */
+    bool extract(const std::string& seq, std::string& barcode, std::string& umi) const;
+
+    uint32_t barcodeLength() const { return barcodeLength_; }
+    uint32_t umiLength() const { return umiLength_; }
+
+private:
+    struct Segment {
+        char kind;
+        uint32_t length;
+    };
+    std::vector<Segment> segments_;
+    uint32_t barcodeLength_{0};
+    uint32_t umiLength_{0};
+};
+
+/**
+  * The set of barcodes expected for the protocol.  An observed barcode
+  * which isn't in the list is corrected if exactly one of the barcodes in
+  * the list is a single substitution away from it.
+  */
+class BarcodeWhitelist {
+public:
+    /** Load one barcode per line */
+    bool load(const boost::filesystem::path& fname);
+
+    bool empty() const { return barcodes_.empty(); }
+    size_t size() const { return barcodes_.size(); }
+
+    /**
+      * Returns false if the barcode can't be assigned to a listed one;
+      * otherwise, the barcode is replaced with the listed one, and
+      * `corrected` says if it had to be changed.
+      */
+    bool assign(std::string& barcode, bool& corrected) const;
+
+private:
+    std::unordered_set<uint64_t> barcodes_;
+};
+
+/** 2-bit encoding of sequences of at most 32 bases; false if the sequence has an N */
+bool encodeSequence(const std::string& seq, uint64_t& code);
+std::string decodeSequence(uint64_t code, uint32_t length);
+
+/** Counters for the log, updated by the mapping threads */
+struct SingleCellStats {
+    std::atomic<uint64_t> numReads{0};
+    std::atomic<uint64_t> numNoBarcode{0}; // too short, or an N in the barcode or the UMI
+    std::atomic<uint64_t> numNotWhitelisted{0};
+    std::atomic<uint64_t> numCorrected{0};
+    std::atomic<uint64_t> numMapped{0};
+};
+
+/**
+  * The reads of every cell, as the number of distinct UMIs observed in each
+  * cell for each set of transcripts the reads map to (equivalence class).
+  * The abundances of each cell are then estimated from its equivalence
+  * classes with an EM, the cells being processed in parallel.
+  */
+class CellCounts {
+public:
+    struct Record {
+        uint64_t cell;
+        uint64_t umi;
+        uint32_t eqClass;
+    };
+
+    using TranscriptSet = std::vector<uint32_t>;
+    using TranscriptSetHash = boost::hash<TranscriptSet>;
+
+    /**
+      * The records of a mapping thread, with equivalence classes numbered
+      * locally; they are merged into the CellCounts when flushed.
+      */
+    class Buffer {
+    public:
+        explicit Buffer(CellCounts& counts) : counts_(counts) {}
+        ~Buffer() { flush(); }
+
+        /** transcripts must be sorted and have no duplicates */
+        void add(uint64_t cell, const TranscriptSet& transcripts, uint64_t umi);
+        void flush();
+
+    private:
+        friend class CellCounts;
+        CellCounts& counts_;
+        std::unordered_map<TranscriptSet, uint32_t, TranscriptSetHash> eqIDs_;
+        std::vector<TranscriptSet> eqClasses_;
+        std::vector<Record> records_;
+    };
+
+    /**
+      * Count the distinct UMIs of each cell and equivalence class, once all
+      * the buffers have been flushed; the cells with fewer than `minUMIs`
+      * are dropped.
+      */
+    void collapse(uint32_t minUMIs);
+
+    /** Run the EM of every cell */
+    void quantify(uint32_t numThreads);
+
+    size_t numCells() const { return cells_.size(); }
+
+    /**
+      * Write the estimates as a sparse cells x transcripts matrix in the
+      * MatrixMarket format (quants_mat.mtx), with the barcodes of the rows
+      * (quants_mat_rows.txt) and the names of the columns (quants_mat_cols.txt).
+      * The columns are the indexed transcripts: those collapsed into another
+      * one at index build time are listed, with their representative column,
+      * in quants_mat_collapsed.txt.  Throws std::runtime_error if an output
+      * file can't be written.
+      */
+    void writeMatrix(const boost::filesystem::path& outputDirectory,
+                     std::vector<Transcript>& transcripts,
+                     const TranscriptDuplicates& duplicates,
+                     uint32_t barcodeLength) const;
+
+private:
+    void merge_(Buffer& buffer);
+
+    std::mutex mutex_;
+    std::unordered_map<TranscriptSet, uint32_t, TranscriptSetHash> eqIDs_;
+    std::vector<TranscriptSet> eqClasses_;
+    std::vector<Record> records_;
+
+    // After collapse(): the barcode of each cell, the (class, # UMIs)
+    // of each cell, and after quantify(), the (transcript, estimate) pairs
+    std::vector<uint64_t> cells_;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> cellClasses_;
+    std::vector<std::vector<std::pair<uint32_t, double>>> cellEstimates_;
+};
+
+#endif // SINGLE_CELL_QUANT_HPP
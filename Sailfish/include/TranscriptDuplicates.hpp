@@ -0,0 +1,57 @@
+#ifndef TRANSCRIPT_DUPLICATES_HPP
+#define TRANSCRIPT_DUPLICATES_HPP
+
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+  * The transcripts removed from the reference at index build time, because
+  * their sequence is identical to (or, optionally, contained in) the one of
+  * another transcript, the representative, which is indexed in their place.
+  *
+  * The groups are stored in the index directory as lines of
+  *   representative \t member \t member length \t identical|contained
+  */
+class TranscriptDuplicates {
+public:
+    struct Member {
+        std::string name;
+        uint32_t length;
+        bool contained;
+    };
+
+    /** Find the duplicates among the sequences of the FASTA files, and write
+      * one copy of each group to outFasta.  Sequences are hashed in parallel.
+      * If collapseContained is true, the sequences contained in another one
+      * are removed too.  Returns the number of sequences removed.
+      */
+    size_t collapse(const std::vector<std::string>& fastaFiles,
+                    const boost::filesystem::path& outFasta,
+                    bool collapseContained, uint32_t numThreads);
+
+    bool load(const boost::filesystem::path& fname);
+    void save(const boost::filesystem::path& fname) const;
+
+    bool empty() const { return members_.empty(); }
+    size_t numRemoved() const;
+
+    /** The transcripts collapsed into representative, or nullptr */
+    const std::vector<Member>* membersOf(const std::string& representative) const;
+
+    /** Restore the collapsed transcripts in a quantification file (one line per
+      * transcript: name, length, then abundance columns).  The abundances of a
+      * representative are split evenly with its identical copies, which the
+      * reads cannot tell apart; contained transcripts are reported with no
+      * abundance, their reads having been attributed to the representative.
+      */
+    bool expandQuantFile(const boost::filesystem::path& fname) const;
+
+private:
+    std::unordered_map<std::string, std::vector<Member>> members_;
+};
+
+#endif // TRANSCRIPT_DUPLICATES_HPP
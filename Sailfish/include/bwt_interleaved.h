@@ -0,0 +1,52 @@
+#ifndef BWT_INTERLEAVED_H
+#define BWT_INTERLEAVED_H
+
+#include <stdint.h>
+#include "bwt.h"
+
+/* The BWT and its occurrence table in a single array of 64-byte blocks.
+ * Each block holds the counts of A, C, G and T before it, followed by the
+ * 128 bases it covers, packed 2 bits per base into 4 words.  A rank query
+ * touches one cache line, and counts inside the block with popcount.
+ *
+ * The functions below are equivalent to their bwt_* counterparts in BWA. */
+
+#define BWTIL_BLOCK_SHIFT 7
+#define BWTIL_BLOCK_BASES (1 << BWTIL_BLOCK_SHIFT)
+#define BWTIL_BLOCK_WORDS 8
+
+typedef struct bwtil_s {
+	bwtint_t primary; // S^{-1}(0), or the primary index of BWT
+	bwtint_t L2[5]; // C(), cumulative count
+	bwtint_t seq_len; // sequence length
+	bwtint_t n_blocks;
+	uint64_t *blocks; // n_blocks * BWTIL_BLOCK_WORDS words, aligned on 64 bytes
+} bwtil_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	bwtil_t *bwtil_from_bwt(const bwt_t *bwt);
+	void bwtil_dump(const char *fn, const bwtil_t *b);
+	bwtil_t *bwtil_restore(const char *fn);
+	void bwtil_destroy(bwtil_t *b);
+
+	bwtint_t bwtil_occ(const bwtil_t *b, bwtint_t k, ubyte_t c);
+	void bwtil_2occ(const bwtil_t *b, bwtint_t k, bwtint_t l, ubyte_t c, bwtint_t *ok, bwtint_t *ol);
+	void bwtil_occ4(const bwtil_t *b, bwtint_t k, bwtint_t cnt[4]);
+	void bwtil_2occ4(const bwtil_t *b, bwtint_t k, bwtint_t l, bwtint_t cntk[4], bwtint_t cntl[4]);
+
+	void bwtil_extend(const bwtil_t *b, const bwtintv_t *ik, bwtintv_t ok[4], int is_back);
+	int bwtil_smem1(const bwtil_t *b, int len, const uint8_t *q, int x, int min_intv, bwtintv_v *mem, bwtintv_v *tmpvec[2]);
+	int bwtil_smem1a(const bwtil_t *b, int len, const uint8_t *q, int x, int min_intv, uint64_t max_intv, bwtintv_v *mem, bwtintv_v *tmpvec[2]);
+	int bwtil_seed_strategy1(const bwtil_t *b, int len, const uint8_t *q, int x, int min_len, int max_intv, bwtintv_t *mem);
+
+	// position of the k-th suffix, from the sampled suffix array of bwt
+	bwtint_t bwtil_sa(const bwtil_t *b, const bwt_t *bwt, bwtint_t k);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,329 @@
+#include "AlignmentCollator.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+
+namespace bfs = boost::filesystem;
+
+// Number of files over which spilled records are spread by read name; only
+// one of them is held in memory at a time when they are read back.  A file
+// larger than the memory budget is split as many ways again by the next
+// bits of the hash of the read names.
+constexpr size_t kSpillPartitionBits = 6;
+constexpr size_t kSpillPartitions = size_t(1) << kSpillPartitionBits;
+constexpr uint32_t kMaxSpillLevel = 64 / kSpillPartitionBits;
+// Number of empty records kept around for re-use.
+constexpr size_t kMaxSpares = 1 << 16;
+// Approximate memory taken by a hash in the set of spilled reads, with the
+// node and bucket overhead of std::unordered_set.
+constexpr size_t kSpilledReadBytes = 48;
+
+AlignmentCollator::AlignmentCollator(bool paired, size_t memoryBudget,
+                                     const bfs::path& tmpDir) :
+    paired_(paired), memoryBudget_(memoryBudget), spillDir_(tmpDir),
+    spillFiles_(kSpillPartitions, nullptr), spillPaths_(kSpillPartitions),
+    spillLevels_(kSpillPartitions, 0) {}
+
+AlignmentCollator::~AlignmentCollator() {
+    for (auto& kv : pending_) {
+        for (auto& frag : kv.second.fragments) {
+            staden::utils::bam_destroy(frag.read1);
+            staden::utils::bam_destroy(frag.read2);
+        }
+        for (auto* rec : kv.second.unmatched) { staden::utils::bam_destroy(rec); }
+    }
+    for (auto& group : ready_) {
+        for (auto& frag : group) {
+            staden::utils::bam_destroy(frag.read1);
+            staden::utils::bam_destroy(frag.read2);
+        }
+    }
+    for (auto* rec : spares_) { staden::utils::bam_destroy(rec); }
+    for (size_t i = 0; i < spillFiles_.size(); ++i) {
+        if (spillFiles_[i] != nullptr) {
+            std::fclose(spillFiles_[i]);
+            bfs::remove(spillPaths_[i]);
+        }
+    }
+}
+
+std::string AlignmentCollator::readKey_(bam_seq_t* rec) const {
+    std::string key(bam_name(rec));
+    // The two ends of a pair may be named name/1 and name/2
+    size_t len = key.size();
+    if (paired_ and len > 2 and key[len-2] == '/' and
+        (key[len-1] == '1' or key[len-1] == '2')) {
+        key.resize(len - 2);
+    }
+    return key;
+}
+
+bam_seq_t* AlignmentCollator::spare_() {
+    if (spares_.empty()) { return staden::utils::bam_init(); }
+    bam_seq_t* rec = spares_.back();
+    spares_.pop_back();
+    return rec;
+}
+
+void AlignmentCollator::recycle(bam_seq_t* rec) {
+    if (spares_.size() < kMaxSpares) {
+        spares_.push_back(rec);
+    } else {
+        staden::utils::bam_destroy(rec);
+    }
+}
+
+/**
+  * Two records are the ends of the same fragment if they are the
+  * first and the last segment, and each one is where the other one
+  * says its mate is.
+  */
+static inline bool areMates(bam_seq_t* a, bam_seq_t* b) {
+    bool firstAndLast = ((bam_flag(a) & BAM_FREAD1) and (bam_flag(b) & BAM_FREAD2)) or
+                        ((bam_flag(a) & BAM_FREAD2) and (bam_flag(b) & BAM_FREAD1));
+    return firstAndLast and
+           bam_ref(a) == bam_mate_ref(b) and bam_pos(a) == bam_mate_pos(b) and
+           bam_ref(b) == bam_mate_ref(a) and bam_pos(b) == bam_mate_pos(a);
+}
+
+void AlignmentCollator::insert_(const std::string& key, bam_seq_t* rec,
+                                bool waitForMate, bool closeOnCount) {
+    auto it = pending_.find(key);
+    if (it == pending_.end()) {
+        it = pending_.emplace(key, PartialGroup()).first;
+        auto& group = it->second;
+        // An unmapped pair has no other record
+        if ((bam_flag(rec) & BAM_FUNMAP) and (bam_flag(rec) & BAM_FMUNMAP)) {
+            group.expected = 1;
+        } else {
+            uint8_t* nh = reinterpret_cast<uint8_t*>(bam_aux_find(rec, const_cast<char*>("NH")));
+            if (nh != nullptr) { group.expected = bam_aux_i(nh); }
+        }
+    }
+
+    auto& group = it->second;
+    group.bytes += rec->alloc;
+    pendingBytes_ += rec->alloc;
+    if (!waitForMate) {
+        group.fragments.push_back({rec, nullptr});
+    } else {
+        auto& unmatched = group.unmatched;
+        size_t i = 0;
+        while (i < unmatched.size() and !areMates(unmatched[i], rec)) { ++i; }
+        if (i == unmatched.size()) {
+            unmatched.push_back(rec);
+        } else {
+            bam_seq_t* mate = unmatched[i];
+            unmatched[i] = unmatched.back();
+            unmatched.pop_back();
+            if (bam_flag(rec) & BAM_FREAD1) {
+                group.fragments.push_back({rec, mate});
+            } else {
+                group.fragments.push_back({mate, rec});
+            }
+        }
+    }
+
+    if (closeOnCount and group.expected > 0 and group.unmatched.empty() and
+        group.fragments.size() >= static_cast<size_t>(group.expected)) {
+        close_(it);
+    }
+}
+
+void AlignmentCollator::close_(std::unordered_map<std::string, PartialGroup>::iterator it) {
+    auto& group = it->second;
+    // The mates of these records never showed up
+    for (auto* rec : group.unmatched) { recycle(rec); }
+    numUnmatchedRecords_ += group.unmatched.size();
+    pendingBytes_ -= group.bytes;
+    if (!group.fragments.empty()) {
+        ready_.emplace_back(std::move(group.fragments));
+    }
+    pending_.erase(it);
+}
+
+void AlignmentCollator::add(bam_seq_t*& rec, bool waitForMate) {
+    std::string key = readKey_(rec);
+    if (spillEverything_ or !spilledReads_.empty()) {
+        uint64_t hash = std::hash<std::string>()(key);
+        // The other records of this read are on disk; the record can be
+        // re-used as soon as it is written.
+        if (spillEverything_ or spilledReads_.find(hash) != spilledReads_.end()) {
+            spillRecord_(hash, rec, waitForMate);
+            return;
+        }
+    }
+    insert_(key, rec, waitForMate, true);
+    rec = spare_();
+    if (pendingBytes_ + spilledReads_.size() * kSpilledReadBytes > memoryBudget_) { spillAll_(); }
+}
+
+void AlignmentCollator::spillRecord_(uint64_t hash, bam_seq_t* rec, bool waitForMate) {
+    writeSpilled_(hash % kSpillPartitions, rec, waitForMate);
+    ++numSpilledRecords_;
+}
+
+void AlignmentCollator::writeSpilled_(size_t p, bam_seq_t* rec, bool waitForMate) {
+    if (spillFiles_[p] == nullptr) {
+        spillPaths_[p] = spillDir_ / bfs::unique_path("collate-%%%%-%%%%-%%%%.tmp");
+        spillFiles_[p] = std::fopen(spillPaths_[p].c_str(), "wb");
+        if (spillFiles_[p] == nullptr) {
+            std::stringstream errstr;
+            errstr << "Could not create the temporary file " << spillPaths_[p]
+                   << " to collate the alignments; check the --collationDir option.\n";
+            throw std::runtime_error(errstr.str());
+        }
+    }
+    FILE* out = spillFiles_[p];
+    std::fputc(waitForMate ? 1 : 0, out);
+    // the record is stored as allocated, its size first
+    if (std::fwrite(rec, rec->alloc, 1, out) != 1) {
+        std::stringstream errstr;
+        errstr << "Could not write to the temporary file " << spillPaths_[p] << ".\n";
+        throw std::runtime_error(errstr.str());
+    }
+}
+
+void AlignmentCollator::spillAll_() {
+    std::hash<std::string> hasher;
+    for (auto& kv : pending_) {
+        uint64_t hash = hasher(kv.first);
+        spilledReads_.insert(hash);
+        for (auto& frag : kv.second.fragments) {
+            spillRecord_(hash, frag.read1, frag.read2 != nullptr);
+            recycle(frag.read1);
+            if (frag.read2 != nullptr) {
+                spillRecord_(hash, frag.read2, true);
+                recycle(frag.read2);
+            }
+        }
+        for (auto* rec : kv.second.unmatched) {
+            spillRecord_(hash, rec, true);
+            recycle(rec);
+        }
+    }
+    pending_.clear();
+    pendingBytes_ = 0;
+
+    // From now on, every record goes to disk, which doesn't need
+    // to know which reads are there.
+    if (spilledReads_.size() * kSpilledReadBytes > memoryBudget_ / 2) {
+        spillEverything_ = true;
+        std::unordered_set<uint64_t>().swap(spilledReads_);
+    }
+}
+
+/**
+  * Read the next record of a spill file opened for reading; returns
+  * nullptr at the end of the file.  A truncated record is an error.
+  */
+bam_seq_t* AlignmentCollator::readSpilled_(size_t p, bool& waitForMate) {
+    FILE* in = spillFiles_[p];
+    int flag = std::fgetc(in);
+    if (flag == EOF) { return nullptr; }
+    waitForMate = (flag != 0);
+    uint32_t alloc;
+    bam_seq_t* rec{nullptr};
+    if (std::fread(&alloc, sizeof(alloc), 1, in) == 1 and alloc > sizeof(alloc)) {
+        rec = reinterpret_cast<bam_seq_t*>(std::malloc(alloc));
+        std::memcpy(rec, &alloc, sizeof(alloc));
+        if (std::fread(reinterpret_cast<char*>(rec) + sizeof(alloc), alloc - sizeof(alloc), 1, in) != 1) {
+            std::free(rec);
+            rec = nullptr;
+        }
+    }
+    if (rec == nullptr) {
+        std::stringstream errstr;
+        errstr << "The temporary file " << spillPaths_[p] << " is truncated; "
+               << "check the free space in the --collationDir directory.\n";
+        throw std::runtime_error(errstr.str());
+    }
+    return rec;
+}
+
+/**
+  * Spread the records of a spill file over kSpillPartitions new ones, by
+  * the next bits of the hash of their read names; they are appended to
+  * the partitions still to be loaded.
+  */
+void AlignmentCollator::splitPartition_(size_t p) {
+    uint32_t level = spillLevels_[p] + 1;
+    size_t first = spillFiles_.size();
+    spillFiles_.resize(first + kSpillPartitions, nullptr);
+    spillPaths_.resize(first + kSpillPartitions);
+    spillLevels_.resize(first + kSpillPartitions, level);
+
+    std::hash<std::string> hasher;
+    bool waitForMate;
+    while (bam_seq_t* rec = readSpilled_(p, waitForMate)) {
+        uint64_t hash = hasher(readKey_(rec));
+        writeSpilled_(first + ((hash >> (level * kSpillPartitionBits)) % kSpillPartitions),
+                      rec, waitForMate);
+        std::free(rec);
+    }
+    std::fclose(spillFiles_[p]);
+    spillFiles_[p] = nullptr;
+    bfs::remove(spillPaths_[p]);
+}
+
+bool AlignmentCollator::loadPartition_() {
+    while (nextPartition_ < spillFiles_.size()) {
+        size_t p = nextPartition_++;
+        if (spillFiles_[p] == nullptr) { continue; }
+        std::fclose(spillFiles_[p]);
+        spillFiles_[p] = std::fopen(spillPaths_[p].c_str(), "rb");
+        if (spillFiles_[p] == nullptr) {
+            std::stringstream errstr;
+            errstr << "Could not read back the temporary file " << spillPaths_[p] << ".\n";
+            throw std::runtime_error(errstr.str());
+        }
+
+        // Too large to be collated within the budget; the records of a
+        // single read are not split any further.
+        if (bfs::file_size(spillPaths_[p]) > memoryBudget_ and spillLevels_[p] + 1 < kMaxSpillLevel) {
+            splitPartition_(p);
+            continue;
+        }
+
+        // All of the records of these reads are in this partition,
+        // so the groups are complete at the end of the file.
+        bool waitForMate;
+        while (bam_seq_t* rec = readSpilled_(p, waitForMate)) {
+            insert_(readKey_(rec), rec, waitForMate, false);
+        }
+        std::fclose(spillFiles_[p]);
+        spillFiles_[p] = nullptr;
+        bfs::remove(spillPaths_[p]);
+
+        while (!pending_.empty()) { close_(pending_.begin()); }
+        if (!ready_.empty()) { return true; }
+    }
+    return false;
+}
+
+void AlignmentCollator::finish() {
+    finished_ = true;
+    while (!pending_.empty()) { close_(pending_.begin()); }
+}
+
+bool AlignmentCollator::nextGroup(std::vector<CollatedFragment>& group) {
+    while (ready_.empty()) {
+        if (!finished_ or !loadPartition_()) { return false; }
+    }
+    group = std::move(ready_.front());
+    ready_.pop_front();
+    return true;
+}
+
+bool isCoordinateSorted(SAM_hdr* header) {
+    const char* text = sam_hdr_str(header);
+    if (text == nullptr) { return false; }
+    const char* hd = std::strstr(text, "@HD");
+    if (hd == nullptr) { return false; }
+    const char* end = std::strchr(hd, '\n');
+    const char* so = std::strstr(hd, "SO:coordinate");
+    return so != nullptr and (end == nullptr or so < end);
+}
@@ -49,6 +49,8 @@
 #include "SailfishUtils.hpp"
 #include "GenomicFeature.hpp"
 #include "PerfectHashIndex.hpp"
+#include "TranscriptDuplicates.hpp"
+#include "bwt_interleaved.h"
 #include "format.h"
 #include "spdlog/spdlog.h"
 
@@ -77,6 +79,8 @@ int salmonIndex(int argc, char* argv[]) {
 
     uint32_t maxThreads = std::thread::hardware_concurrency();
     uint32_t numThreads;
+    bool keepDuplicates{false};
+    bool collapseContained{false};
 
     po::options_description generic("Command Line Options");
     generic.add_options()
@@ -85,7 +89,14 @@ int salmonIndex(int argc, char* argv[]) {
     ("transcripts,t", po::value<string>()->required(), "Transcript fasta file.")
     ("index,i", po::value<string>()->required(), "Salmon index.")
     ("threads,p", po::value<uint32_t>(&numThreads)->default_value(maxThreads)->required(),
-                            "Number of threads to use (only used for computing bias features)")
+                            "Number of threads to use (only used for computing bias features and finding duplicates)")
+    ("keepDuplicates", po::bool_switch(&keepDuplicates)->default_value(false),
+                            "Index every copy of identical transcript sequences.  By default, each group of "
+                            "identical transcripts is indexed once, and the abundance estimated for the group "
+                            "is split evenly between its members in the output.")
+    ("collapseContained", po::bool_switch(&collapseContained)->default_value(false),
+                            "Also remove the transcripts whose sequence is contained in another transcript; they "
+                            "are reported with no abundance, their reads being attributed to the containing transcript.")
     ;
 
     po::variables_map vm;
@@ -145,17 +156,54 @@ Salmon index if it exists, or creates a new index
         computeBiasFeatures(transcriptFiles, transcriptBiasFile, useStreamingParser, numThreads);
         // ==== finished computing bias fetures
 
+        // Index one copy of each group of identical transcripts
+        bfs::path duplicatesFile = indexDirectory / "duplicates.txt";
+        bfs::path indexedTranscriptFile(transcriptFile);
+        bfs::remove(duplicatesFile);
+        if (!keepDuplicates) {
+            TranscriptDuplicates duplicates;
+            bfs::path collapsedFile = indexDirectory / "transcripts.collapsed.fa";
+            size_t numRemoved = duplicates.collapse(transcriptFiles, collapsedFile,
+                                                    collapseContained, numThreads);
+            jointLog->info() << "Removed " << numRemoved << " duplicate transcripts "
+                             << "from the index (groups listed in " << duplicatesFile.string() << ")\n";
+            if (numRemoved > 0) {
+                duplicates.save(duplicatesFile);
+                indexedTranscriptFile = collapsedFile;
+            } else {
+                bfs::remove(collapsedFile);
+            }
+        }
+
         bfs::path outputPrefix = indexDirectory / "bwaidx";
+        string indexedTranscripts = indexedTranscriptFile.string();
 
         std::vector<char*> bwaArgVec{ "index", "-p",
                                     const_cast<char*>(outputPrefix.string().c_str()),
-                                    const_cast<char*>(transcriptFile.c_str()) };
+                                    const_cast<char*>(indexedTranscripts.c_str()) };
 
         char* bwaArgv[] = { bwaArgVec[0], bwaArgVec[1],
                             bwaArgVec[2], bwaArgVec[3] };
         int bwaArgc = 4;
 
         ret = bwa_index(bwaArgc, bwaArgv);
+        if (indexedTranscriptFile != bfs::path(transcriptFile)) {
+            bfs::remove(indexedTranscriptFile);
+        }
+
+        // The interleaved occurrence table used by quant for seed finding.
+        // It's built here rather than in bwa_index, as bwtindex.c is
+        // replaced by BWA's own copy when the external project is built.
+        if (ret == 0) {
+            jointLog->info("Building the interleaved occurrence table");
+            string bwtPath = outputPrefix.string() + ".bwt";
+            string interleavedPath = outputPrefix.string() + ".ilv";
+            bwt_t* bwt = bwt_restore_bwt(bwtPath.c_str());
+            bwtil_t* interleaved = bwtil_from_bwt(bwt);
+            bwtil_dump(interleavedPath.c_str(), interleaved);
+            bwtil_destroy(interleaved);
+            bwt_destroy(bwt);
+        }
 
         jointLog->info("done\n");
 
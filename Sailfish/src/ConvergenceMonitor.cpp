@@ -0,0 +1,144 @@
+#include "ConvergenceMonitor.hpp"
+#include "SailfishMath.hpp"
+
+#include "format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+// Transcripts below these levels at both checkpoints don't take part in the
+// test; their estimates are dominated by the sampling noise of the online
+// updates.
+constexpr double kMinTPM = 1.0;
+constexpr double kMinReads = 10.0;
+
+ConvergenceMonitor::ConvergenceMonitor(double tolerance, uint64_t interval, uint32_t numStable) :
+    tolerance_(tolerance), interval_(std::max(interval, uint64_t(1))),
+    numStable_(std::max(numStable, uint32_t(1))), nextCheckpoint_(interval_) {}
+
+void ConvergenceMonitor::addFragmentLengthDistribution(FragmentLengthDistribution* fld) {
+    std::lock_guard<std::mutex> l(mutex_);
+    flDists_.push_back(fld);
+}
+
+void ConvergenceMonitor::update(uint64_t numObserved, uint64_t numAssigned,
+                                std::vector<Transcript>& transcripts) {
+    if (!enabled() or numObserved < nextCheckpoint_) { return; }
+    std::unique_lock<std::mutex> l(mutex_, std::try_to_lock);
+    if (!l.owns_lock() or numObserved < nextCheckpoint_) { return; }
+    checkpoint_(numObserved, numAssigned, transcripts);
+    lastScheduled_ = true;
+}
+
+void ConvergenceMonitor::checkpoint(uint64_t numObserved, uint64_t numAssigned,
+                                    std::vector<Transcript>& transcripts) {
+    if (!enabled()) { return; }
+    std::lock_guard<std::mutex> l(mutex_);
+    // Right after a scheduled checkpoint, the estimates have hardly
+    // moved, which would look like convergence.
+    if (lastScheduled_ and numObserved - trajectory_.back().numObserved < interval_ / 2) {
+        return;
+    }
+    checkpoint_(numObserved, numAssigned, transcripts);
+    lastScheduled_ = false;
+}
+
+/**
+ * The mean relative change between two vectors of estimates, weighted by
+ * the larger of the two values; i.e. sum |cur - prev| / sum max(prev, cur)
+ * over the entries reaching the threshold.  Unlike the largest relative
+ * change, this isn't driven by the noise of the many barely expressed
+ * transcripts, while a real change in the transcripts carrying most of
+ * the mass still shows.
+ */
+static double weightedRelativeChange(const std::vector<double>& prev,
+                                     const std::vector<double>& cur,
+                                     double threshold) {
+    double totalChange{0.0};
+    double totalLargest{0.0};
+    for (size_t i = 0; i < cur.size(); ++i) {
+        double largest = std::max(prev[i], cur[i]);
+        if (largest < threshold) { continue; }
+        totalChange += std::abs(cur[i] - prev[i]);
+        totalLargest += largest;
+    }
+    return (totalLargest > 0.0) ? totalChange / totalLargest : 0.0;
+}
+
+void ConvergenceMonitor::checkpoint_(uint64_t numObserved, uint64_t numAssigned,
+                                     std::vector<Transcript>& transcripts) {
+    using sailfish::math::LOG_0;
+    nextCheckpoint_ = numObserved + interval_;
+    // The estimated counts are scaled by the largest number of assigned
+    // fragments seen, as the count restarts with each pass.
+    maxAssigned_ = std::max(maxAssigned_, numAssigned);
+
+    size_t numTranscripts = transcripts.size();
+    std::vector<double> counts(numTranscripts, 0.0);
+    std::vector<double> abundances(numTranscripts, 0.0);
+    double totalMass{0.0};
+    double totalAbundance{0.0};
+    for (size_t i = 0; i < numTranscripts; ++i) {
+        auto& t = transcripts[i];
+        double logMass = t.mass(false);
+        if (logMass == LOG_0) { continue; }
+        double mass = std::exp(logMass);
+        double len = (t.RefLength > 0) ? t.RefLength : 1.0;
+        counts[i] = mass;
+        abundances[i] = mass / len;
+        totalMass += mass;
+        totalAbundance += mass / len;
+    }
+    if (totalMass > 0.0) {
+        for (size_t i = 0; i < numTranscripts; ++i) {
+            counts[i] *= maxAssigned_ / totalMass;
+            abundances[i] *= 1000000.0 / totalAbundance;
+        }
+    }
+
+    std::vector<std::vector<double>> pmfs;
+    for (auto fld : flDists_) {
+        size_t maxVal = fld->maxVal();
+        pmfs.emplace_back(maxVal + 1);
+        for (size_t len = 0; len <= maxVal; ++len) {
+            pmfs.back()[len] = std::exp(fld->pmf(len));
+        }
+    }
+
+    Checkpoint cp{numObserved, 1.0, 1.0, 0.0};
+    if (!prevCounts_.empty()) {
+        cp.abundanceChange = weightedRelativeChange(prevAbundances_, abundances, kMinTPM);
+        cp.countChange = weightedRelativeChange(prevCounts_, counts, kMinReads);
+        for (size_t d = 0; d < pmfs.size(); ++d) {
+            double dist{0.0};
+            for (size_t len = 0; len < pmfs[d].size(); ++len) {
+                dist += std::abs(pmfs[d][len] - prevFragLengthPMFs_[d][len]);
+            }
+            cp.fragLengthChange = std::max(cp.fragLengthChange, 0.5 * dist);
+        }
+    }
+    trajectory_.push_back(cp);
+
+    bool stable = cp.abundanceChange < tolerance_ and
+                  cp.countChange < tolerance_ and
+                  cp.fragLengthChange < tolerance_;
+    numStableCheckpoints_ = stable ? numStableCheckpoints_ + 1 : 0;
+    converged_ = (numStableCheckpoints_ >= numStable_);
+
+    prevAbundances_ = std::move(abundances);
+    prevCounts_ = std::move(counts);
+    prevFragLengthPMFs_ = std::move(pmfs);
+}
+
+void ConvergenceMonitor::writeTrajectory(const boost::filesystem::path& fname) const {
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> output(std::fopen(fname.c_str(), "w"), std::fclose);
+    if (!output) { return; }
+    fmt::print(output.get(), "# tolerance = {}\n", tolerance_);
+    fmt::print(output.get(), "# NumObserved\tAbundanceChange\tCountChange\tFragLengthChange\n");
+    for (auto& cp : trajectory_) {
+        fmt::print(output.get(), "{}\t{}\t{}\t{}\n", cp.numObserved, cp.abundanceChange,
+                   cp.countChange, cp.fragLengthChange);
+    }
+}
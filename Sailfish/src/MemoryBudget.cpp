@@ -0,0 +1,68 @@
+#include "MemoryBudget.hpp"
+
+#include "format.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+
+constexpr size_t kMB = 1024 * 1024;
+
+MemoryBudget::MemoryBudget(size_t budgetMB) : budget_(budgetMB * kMB) {}
+
+void MemoryBudget::reserve(const std::string& component, size_t bytes) {
+    reserved_ += bytes;
+    components_.push_back({component, bytes});
+}
+
+size_t MemoryBudget::available() const {
+    return (reserved_ < budget_) ? budget_ - reserved_ : 0;
+}
+
+size_t MemoryBudget::capacity(const std::string& component, size_t itemBytes, double share,
+                              size_t minItems, size_t defaultItems) {
+    size_t numItems = defaultItems;
+    if (limited()) {
+        size_t fit = static_cast<size_t>(available() * share) / std::max(itemBytes, size_t(1));
+        numItems = std::max(minItems, std::min(defaultItems, fit));
+    }
+    reserve(component, numItems * itemBytes);
+    return numItems;
+}
+
+size_t MemoryBudget::peakRSS() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+#ifdef __APPLE__
+    return usage.ru_maxrss; // in bytes
+#else
+    return usage.ru_maxrss * 1024; // in kilobytes
+#endif
+}
+
+void MemoryBudget::recordPeakRSS(const std::string& stage) {
+    stages_.push_back({stage, peakRSS()});
+}
+
+void MemoryBudget::report(std::shared_ptr<spdlog::logger> log) const {
+    fmt::MemoryWriter msg;
+    if (limited()) {
+        msg << "memory budget: " << budget_ / kMB << " MB";
+        if (reserved_ > budget_) {
+            msg << " (exceeded by the fixed components; the pools were given their minimum sizes)";
+        }
+        msg << "\n";
+    }
+    msg << "estimated memory per component:\n";
+    for (auto& c : components_) {
+        msg << "  " << c.name << ": " << c.bytes / kMB << " MB\n";
+    }
+    msg << "peak RSS per stage:\n";
+    size_t prev{0};
+    for (auto& s : stages_) {
+        msg << "  " << s.name << ": " << s.bytes / kMB << " MB (+"
+            << (s.bytes - std::min(prev, s.bytes)) / kMB << " MB)\n";
+        prev = s.bytes;
+    }
+    log->info(msg.str());
+}
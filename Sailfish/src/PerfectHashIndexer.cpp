@@ -63,6 +63,7 @@
 #include "SailfishUtils.hpp"
 #include "GenomicFeature.hpp"
 #include "PerfectHashIndex.hpp"
+#include "TranscriptDuplicates.hpp"
 #include "spdlog/spdlog.h"
 
 void buildPerfectHashIndex(bool canonical, std::vector<uint64_t>& keys, std::vector<uint32_t>& counts,
@@ -272,6 +273,12 @@ int mainIndex( int argc, char *argv[] ) {
     //("thash,t", po::value<string>(), "transcript hash file [Jellyfish format]")
     //("index,i", po::value<string>(), "transcript index file [Sailfish format]")
     ("threads,p", po::value<uint32_t>()->default_value(maxThreads), "The number of threads to use concurrently.")
+    ("keepDuplicates", po::bool_switch(), "Index every copy of identical transcript sequences.  By default, "
+                                          "each group of identical transcripts is indexed once, and the abundance "
+                                          "estimated for the group is split evenly between its members in the output.")
+    ("collapseContained", po::bool_switch(), "Also remove the transcripts whose sequence is contained in another "
+                                             "transcript; they are reported with no abundance, their reads being "
+                                             "attributed to the containing transcript.")
     ("force,f", po::bool_switch(), "" )
     ;
 
@@ -367,6 +374,24 @@ the Jellyfish database [thash] of the transcripts.
         }
 
         if (mustRecompute) {
+            // Index one copy of each group of identical transcripts
+            bfs::path duplicatesFile(outputPath); duplicatesFile /= "duplicates.txt";
+            bfs::remove(duplicatesFile);
+            if (!vm["keepDuplicates"].as<bool>()) {
+                TranscriptDuplicates duplicates;
+                bfs::path collapsedFile(outputPath); collapsedFile /= "transcripts.collapsed.fa";
+                size_t numRemoved = duplicates.collapse(transcriptFiles, collapsedFile,
+                                                        vm["collapseContained"].as<bool>(), numThreads);
+                jointLog->info() << "Removed " << numRemoved << " duplicate transcripts "
+                                 << "from the index (groups listed in " << duplicatesFile.string() << ")\n";
+                if (numRemoved > 0) {
+                    duplicates.save(duplicatesFile);
+                    transcriptFiles = {collapsedFile.string()};
+                } else {
+                    bfs::remove(collapsedFile);
+                }
+            }
+
             std::cerr << "Running Jellyfish on transcripts\n";
             runJellyfish(canonical, merLen, numThreads, outputStem, transcriptFiles);
             std::cerr << "Jellyfish finished\n";
@@ -466,6 +491,9 @@ the Jellyfish database [thash] of the transcripts.
             buildLUTs(transcriptFiles, sfIndex, sfTranscriptCountIndex,
                       tgmap, tlutPath.string(), klutPath.string(), numThreads);
 
+            bfs::path collapsedFile(outputPath); collapsedFile /= "transcripts.collapsed.fa";
+            bfs::remove(collapsedFile);
+
         } else {
             std::cerr << "All index files seem up-to-date.\n";
             std::cerr << "To force Sailfish to rebuild the index, use the --force option.\n";
@@ -44,6 +44,7 @@
 #include "SailfishUtils.hpp"
 #include "GenomicFeature.hpp"
 #include "TranscriptGeneMap.hpp"
+#include "TranscriptDuplicates.hpp"
 #include "CollapsedIterativeOptimizer.hpp"
 #include "LibraryFormat.hpp"
 #include "ReadLibrary.hpp"
@@ -226,6 +227,16 @@ int runIterativeOptimizer(int argc, char* argv[] ) {
 
     solver.writeAbundances(outputFilePath, headerLines.str(), minAbundance, haveCI);
 
+    { // put back the transcripts collapsed at index build time
+        bfs::path duplicatesFile = sfIndexBasePath.parent_path() / "duplicates.txt";
+        TranscriptDuplicates duplicates;
+        if (duplicates.load(duplicatesFile) and !duplicates.empty()) {
+            jointLog->info() << "restoring " << duplicates.numRemoved()
+                             << " duplicate transcripts in the output\n";
+            duplicates.expandQuantFile(outputFilePath);
+        }
+    }
+
     bool applyCoverageFilter{false};
 
     if (computeBiasCorrection) {
@@ -108,6 +108,10 @@ extern "C" {
 #include "PairSequenceParser.hpp"
 #include "FragmentLengthDistribution.hpp"
 #include "ReadExperiment.hpp"
+#include "TranscriptDuplicates.hpp"
+#include "ConvergenceMonitor.hpp"
+#include "SingleCellQuant.hpp"
+#include "MemoryBudget.hpp"
 #include "SalmonOpts.hpp"
 
 /* This allows us to use CLASP for optimal MEM
@@ -156,11 +160,13 @@ static void mem_collect_intv(const SalmonOpts& sopt, const mem_opt_t *opt, const
     int i, k, x = 0, old_n;
     int start_width = (opt->flag & MEM_F_SELF_OVLP)? 2 : 1;
     int split_len = (int)(opt->min_seed_len * opt->split_factor + .499);
+    const bwtil_t *ilv = sopt.interleavedBWT;
     a->mem.n = 0;
     // first pass: find all SMEMs
     while (x < len) {
         if (seq[x] < 4) {
-            x = bwt_smem1(bwt, len, seq, x, start_width, &a->mem1, a->tmpv);
+            x = ilv? bwtil_smem1(ilv, len, seq, x, start_width, &a->mem1, a->tmpv) :
+                     bwt_smem1(bwt, len, seq, x, start_width, &a->mem1, a->tmpv);
             for (i = 0; i < a->mem1.n; ++i) {
                 bwtintv_t *p = &a->mem1.a[i];
                 int slen = (uint32_t)p->info - (p->info>>32); // seed length
@@ -175,7 +181,8 @@ static void mem_collect_intv(const SalmonOpts& sopt, const mem_opt_t *opt, const
         bwtintv_t *p = &a->mem.a[k];
         int start = p->info>>32, end = (int32_t)p->info;
         if (end - start < split_len || p->x[2] > opt->split_width) continue;
-        bwt_smem1(bwt, len, seq, (start + end)>>1, p->x[2]+1, &a->mem1, a->tmpv);
+        if (ilv) bwtil_smem1(ilv, len, seq, (start + end)>>1, p->x[2]+1, &a->mem1, a->tmpv);
+        else bwt_smem1(bwt, len, seq, (start + end)>>1, p->x[2]+1, &a->mem1, a->tmpv);
         for (i = 0; i < a->mem1.n; ++i)
             if ((uint32_t)a->mem1.a[i].info - (a->mem1.a[i].info>>32) >= opt->min_seed_len)
                 kv_push(bwtintv_t, a->mem, a->mem1.a[i]);
@@ -187,10 +194,12 @@ static void mem_collect_intv(const SalmonOpts& sopt, const mem_opt_t *opt, const
             if (seq[x] < 4) {
                 if (1) {
                     bwtintv_t m;
-                    x = bwt_seed_strategy1(bwt, len, seq, x, opt->min_seed_len, opt->max_mem_intv, &m);
+                    x = ilv? bwtil_seed_strategy1(ilv, len, seq, x, opt->min_seed_len, opt->max_mem_intv, &m) :
+                             bwt_seed_strategy1(bwt, len, seq, x, opt->min_seed_len, opt->max_mem_intv, &m);
                     if (m.x[2] > 0) kv_push(bwtintv_t, a->mem, m);
                 } else { // for now, we never come to this block which is slower
-                    x = bwt_smem1a(bwt, len, seq, x, start_width, opt->max_mem_intv, &a->mem1, a->tmpv);
+                    x = ilv? bwtil_smem1a(ilv, len, seq, x, start_width, opt->max_mem_intv, &a->mem1, a->tmpv) :
+                             bwt_smem1a(bwt, len, seq, x, start_width, opt->max_mem_intv, &a->mem1, a->tmpv);
                     for (i = 0; i < a->mem1.n; ++i)
                         kv_push(bwtintv_t, a->mem, a->mem1.a[i]);
                 }
@@ -213,8 +222,6 @@ using TranscriptIDVector = std::vector<TranscriptID>;
 using KmerIDMap = std::vector<TranscriptIDVector>;
 using my_mer = jellyfish::mer_dna_ns::mer_base_static<uint64_t, 1>;
 
-constexpr uint32_t miniBatchSize{1000};
-
 class SMEMAlignment {
     public:
         SMEMAlignment() :
@@ -925,7 +932,9 @@ inline void collectHitsForRead(const bwaidx_t *idx, const bwtintv_v* a, smem_aux
             uint32_t rlen = readLen;
 
             // Get the position in the reference index of this MEM occurrence
-            int64_t refStart = bwt_sa(idx->bwt, p->x[0] + k);
+            int64_t refStart = salmonOpts.interleavedBWT ?
+                               bwtil_sa(salmonOpts.interleavedBWT, idx->bwt, p->x[0] + k) :
+                               bwt_sa(idx->bwt, p->x[0] + k);
 
             pos = startPos = bns_depos(idx->bns, refStart, &isRevStart);
             endPos = bns_depos(idx->bns, refStart + slen - 1, &isRevEnd);
@@ -1319,7 +1328,8 @@ void processReadsMEM(ParserT* parser,
 	           std::mutex& iomutex,
                bool initialRound,
                bool& burnedIn,
-               volatile bool& writeToCache
+               volatile bool& writeToCache,
+               ConvergenceMonitor& monitor
                ) {
   uint64_t count_fwd = 0, count_bwd = 0;
 
@@ -1334,7 +1344,7 @@ void processReadsMEM(ParserT* parser,
   std::vector<AlignmentGroup<SMEMAlignment>*> hitLists;
   //std::vector<std::vector<Alignment>> hitLists;
   uint64_t prevObservedFrags{1};
-  hitLists.resize(miniBatchSize);
+  hitLists.resize(salmonOpts.miniBatchSize);
 
   uint64_t leftHitCount{0};
   uint64_t hitListCount{0};
@@ -1350,6 +1360,9 @@ void processReadsMEM(ParserT* parser,
   while(true) {
     typename ParserT::job j(*parser); // Get a job from the parser: a bunch of read (at most max_read_group)
     if(j.is_empty()) break;           // If got nothing, quit
+    // Once the estimates have converged, the rest of the pass is
+    // read through without being mapped.
+    if (!initialRound and monitor.converged()) { continue; }
 
     hitLists.resize(j->nb_filled);
     //structureCache.try_dequeue_bulk(hitLists.begin() , j->nb_filled);
@@ -1400,6 +1413,7 @@ void processReadsMEM(ParserT* parser,
     prevObservedFrags = numObservedFragments;
     processMiniBatch(logForgettingMass, rl, salmonOpts, hitLists, transcripts, clusterForest,
                      fragLengthDist, numAssignedFragments, eng, initialRound, burnedIn);
+    monitor.update(numObservedFragments, numAssignedFragments, transcripts);
     if (writeToCache) {
         outputGroups.enqueue_bulk(hitLists.begin(), hitLists.size());
     } else {
@@ -1431,7 +1445,8 @@ void processCachedAlignmentsHelper(
         std::mutex& iomutex,
         bool initialRound,
         bool& cacheExhausted,
-        bool& burnedIn
+        bool& burnedIn,
+        ConvergenceMonitor& monitor
         ) {
 
     double forgettingFactor{0.65};
@@ -1491,6 +1506,7 @@ void processCachedAlignmentsHelper(
 
         processMiniBatch(logForgettingMass, rl, salmonOpts, hitLists, transcripts, clusterForest,
                 fragLengthDist, numAssignedFragments, eng, initialRound, burnedIn);
+        monitor.update(numObservedFragments, numAssignedFragments, transcripts);
 
         structureCache.enqueue_bulk(hitLists.begin() , hitLists.size());
         // At this point, the parser can re-claim the strings
@@ -1527,6 +1543,7 @@ void processCachedAlignments(
         bool initialRound,
         bool& cacheExhausted,
         bool& burnedIn,
+        ConvergenceMonitor& monitor,
         size_t numQuantThreads) {
 
         std::atomic<uint64_t> numValidHits{0};
@@ -1550,7 +1567,8 @@ void processCachedAlignments(
                         std::ref(ioMutex),
                         initialRound,
                         std::ref(cacheExhausted),
-                        std::ref(burnedIn));
+                        std::ref(burnedIn),
+                        std::ref(monitor));
 
         }
         for (auto& t : quantThreads) { t.join(); }
@@ -1577,7 +1595,8 @@ void processReadLibrary(
         size_t numThreads,
         AlnGroupQueue& structureCache,
         AlnGroupQueue& outputGroups,
-        volatile bool& writeToCache) {
+        volatile bool& writeToCache,
+        ConvergenceMonitor& monitor) {
 
             std::vector<std::thread> threads;
 
@@ -1589,7 +1608,7 @@ void processReadLibrary(
                 char* readFiles[] = { const_cast<char*>(rl.mates1().front().c_str()),
                     const_cast<char*>(rl.mates2().front().c_str()) };
 
-                size_t maxReadGroup{miniBatchSize}; // Number of reads in each "job"
+                size_t maxReadGroup{salmonOpts.miniBatchSize}; // Number of reads in each "job"
                 size_t concurrentFile{2}; // Number of files to read simultaneously
                 paired_parser parser(4 * numThreads, maxReadGroup, concurrentFile,
                         readFiles, readFiles + 2);
@@ -1618,7 +1637,8 @@ void processReadLibrary(
                                     iomutex,
                                     initialRound,
                                     burnedIn,
-                                    writeToCache);
+                                    writeToCache,
+                                    monitor);
                         };
                         threads.emplace_back(threadFun);
                     } else {
@@ -1655,7 +1675,7 @@ void processReadLibrary(
             else if (rl.format().type == ReadType::SINGLE_END) {
 
                 char* readFiles[] = { const_cast<char*>(rl.unmated().front().c_str()) };
-                size_t maxReadGroup{miniBatchSize}; // Number of files to read simultaneously
+                size_t maxReadGroup{salmonOpts.miniBatchSize}; // Number of files to read simultaneously
                 size_t concurrentFile{1}; // Number of reads in each "job"
                 stream_manager streams( rl.unmated().begin(),
                         rl.unmated().end(), concurrentFile);
@@ -1686,7 +1706,8 @@ void processReadLibrary(
                                     iomutex,
                                     initialRound,
                                     burnedIn,
-                                    writeToCache);
+                                    writeToCache,
+                                    monitor);
                         };
                         threads.emplace_back(threadFun);
                     } else {
@@ -1726,7 +1747,7 @@ bool writeAlignmentCacheToFile(
         volatile bool& writeToCache,
         cereal::BinaryOutputArchive& outputStream ) {
 
-        size_t blockSize{miniBatchSize};
+        size_t blockSize{1000};
         size_t numDequed{0};
         AlignmentGroup<SMEMAlignment>* alnGroups[blockSize];
 
@@ -1760,11 +1781,13 @@ bool readAlignmentCache(
         uint64_t numWritten,
         bool& finishedParsing,
         std::ifstream& inputStream,
-        cereal::BinaryInputArchive& inputArchive) {
+        cereal::BinaryInputArchive& inputArchive,
+        ConvergenceMonitor& monitor) {
 
         uint64_t numRead{0};
         AlignmentGroup<SMEMAlignment>* alnGroup;
-        while (numRead < numWritten) {
+        // Stop reading once the estimates have converged
+        while (numRead < numWritten and !monitor.converged()) {
             while (!structureCache.try_dequeue(alnGroup)) {}
             inputArchive((*alnGroup));
             alnGroupQueue.enqueue(alnGroup);
@@ -1774,6 +1797,162 @@ bool readAlignmentCache(
         return true;
 }
 
+/**
+  * Single-cell mode: the first read of each pair holds the cell barcode and
+  * the UMI, the second one is mapped.  Each mapped read is recorded as its
+  * cell, the set of transcripts it maps to and its UMI.
+  */
+void processReadsSingleCell(paired_parser* parser,
+                            bwaidx_t* idx,
+                            std::vector<Transcript>& transcripts,
+                            const ReadGeometry& geometry,
+                            const BarcodeWhitelist& whitelist,
+                            CellCounts& cellCounts,
+                            SingleCellStats& stats,
+                            mem_opt_t* memOptions,
+                            const SalmonOpts& salmonOpts,
+                            double coverageThresh,
+                            std::mutex& iomutex) {
+    smem_i *itr = smem_itr_init(idx->bwt);
+    const bwtintv_v *a = nullptr;
+    smem_aux_t* auxHits = smem_aux_init();
+
+    AlignmentGroup<SMEMAlignment> hitList;
+    uint64_t hitListCount{0};
+    CellCounts::Buffer buffer(cellCounts);
+    std::string barcode, umi;
+    std::vector<uint32_t> transcriptSet;
+
+    while (true) {
+        paired_parser::job j(*parser);
+        if (j.is_empty()) { break; }
+
+        for (size_t i = 0; i < j->nb_filled; ++i) {
+            auto& frag = j->data[i];
+            uint64_t numReads = ++stats.numReads;
+            if (numReads % 500000 == 0) {
+                iomutex.lock();
+                const char RESET_COLOR[] = "\x1b[0m";
+                char green[] = "\x1b[30m";
+                green[3] = '0' + static_cast<char>(fmt::GREEN);
+                char red[] = "\x1b[30m";
+                red[3] = '0' + static_cast<char>(fmt::RED);
+                fmt::print(stderr, "\r\r{}processed{} {} {}reads{} ({} mapped)",
+                           green, red, numReads, green, RESET_COLOR, stats.numMapped.load());
+                iomutex.unlock();
+            }
+
+            uint64_t cell, umiCode;
+            if (!geometry.extract(frag.first.seq, barcode, umi) or
+                !encodeSequence(umi, umiCode)) {
+                ++stats.numNoBarcode;
+                continue;
+            }
+            if (!whitelist.empty()) {
+                bool corrected{false};
+                if (!whitelist.assign(barcode, corrected)) {
+                    ++stats.numNotWhitelisted;
+                    continue;
+                }
+                if (corrected) { ++stats.numCorrected; }
+            }
+            if (!encodeSequence(barcode, cell)) {
+                ++stats.numNoBarcode;
+                continue;
+            }
+
+            getHitsForFragment<TranscriptHitList>(frag.second, idx, itr, a,
+                                                  auxHits,
+                                                  memOptions,
+                                                  salmonOpts,
+                                                  coverageThresh,
+                                                  hitList, hitListCount,
+                                                  transcripts);
+            if (hitList.size() == 0 or hitList.size() > salmonOpts.maxReadOccs) { continue; }
+
+            transcriptSet.clear();
+            for (auto& aln : hitList.alignments()) { transcriptSet.push_back(aln.transcriptID()); }
+            std::sort(transcriptSet.begin(), transcriptSet.end());
+            transcriptSet.erase(std::unique(transcriptSet.begin(), transcriptSet.end()),
+                                transcriptSet.end());
+            buffer.add(cell, transcriptSet, umiCode);
+            ++stats.numMapped;
+        }
+    }
+    buffer.flush();
+    smem_aux_destroy(auxHits);
+    smem_itr_destroy(itr);
+}
+
+/**
+  * Quantify every cell of a droplet-based single-cell experiment: the reads
+  * are mapped once, and the abundances of each cell are estimated from the
+  * UMI-deduplicated counts of its equivalence classes.
+  */
+void quantifySingleCells(
+        ReadExperiment& experiment,
+        const ReadGeometry& geometry,
+        const BarcodeWhitelist& whitelist,
+        uint32_t minCellUMIs,
+        mem_opt_t* memOptions,
+        const SalmonOpts& salmonOpts,
+        double coverageThresh,
+        uint32_t numThreads) {
+
+    auto jointLog = spdlog::get("jointLog");
+    auto& rl = experiment.readLibraries().front();
+    if (experiment.readLibraries().size() != 1 or rl.format().type != ReadType::PAIRED_END) {
+        throw std::invalid_argument("The single-cell mode expects a single library of paired "
+                                    "reads: the barcode reads as mates1, and the cDNA reads as mates2");
+    }
+
+    rl.checkValid();
+
+    CellCounts cellCounts;
+    SingleCellStats stats;
+    std::mutex iomutex;
+    {
+        // The parser takes the files of every lane as consecutive
+        // (mate1, mate2) pairs.
+        std::vector<char*> readFiles;
+        for (size_t i = 0; i < rl.mates1().size(); ++i) {
+            readFiles.push_back(const_cast<char*>(rl.mates1()[i].c_str()));
+            readFiles.push_back(const_cast<char*>(rl.mates2()[i].c_str()));
+        }
+        size_t maxReadGroup{salmonOpts.miniBatchSize};
+        size_t concurrentFile{2};
+        paired_parser parser(4 * numThreads, maxReadGroup, concurrentFile,
+                readFiles.data(), readFiles.data() + readFiles.size());
+
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < numThreads; ++i) {
+            threads.emplace_back(processReadsSingleCell, &parser, experiment.index(),
+                                 std::ref(experiment.transcripts()), std::cref(geometry),
+                                 std::cref(whitelist), std::ref(cellCounts), std::ref(stats),
+                                 memOptions, std::cref(salmonOpts), coverageThresh,
+                                 std::ref(iomutex));
+        }
+        for (auto& t : threads) { t.join(); }
+    }
+    fmt::print(stderr, "\n");
+
+    jointLog->info() << "single-cell mode: " << stats.numReads.load() << " reads, "
+                     << stats.numNoBarcode.load() << " without a valid barcode or UMI, "
+                     << stats.numNotWhitelisted.load() << " with a barcode not in the whitelist, "
+                     << stats.numCorrected.load() << " with a corrected barcode, "
+                     << stats.numMapped.load() << " mapped";
+
+    cellCounts.collapse(minCellUMIs);
+    jointLog->info() << "quantifying " << cellCounts.numCells() << " cells "
+                     << "(with at least " << minCellUMIs << " UMIs)";
+    cellCounts.quantify(numThreads);
+
+    TranscriptDuplicates duplicates;
+    duplicates.load(salmonOpts.indexDirectory / "duplicates.txt");
+    cellCounts.writeMatrix(salmonOpts.outputDirectory, experiment.transcripts(),
+                           duplicates, geometry.barcodeLength());
+}
+
 struct CacheFile {
     CacheFile(boost::filesystem::path& pathIn, uint64_t numWrittenIn) :
         filePath(pathIn), numWritten(numWrittenIn) {}
@@ -1796,7 +1975,8 @@ void quantifyLibrary(
         SalmonOpts& salmonOpts,
         double coverageThresh,
         size_t numRequiredFragments,
-        uint32_t numQuantThreads) {
+        uint32_t numQuantThreads,
+        MemoryBudget& budget) {
 
     bool burnedIn{false};
     //ErrorModel errMod(1.00);
@@ -1806,15 +1986,6 @@ void quantifyLibrary(
 
     auto jointLog = spdlog::get("jointLog");
 
-    size_t maxFragLen = 800;
-    size_t meanFragLen = 200;
-    size_t fragLenStd = 80;
-    size_t fragLenKernelN = 4;
-    double fragLenKernelP = 0.5;
-    FragmentLengthDistribution fragLengthDist(1.0, maxFragLen,
-                                              meanFragLen, fragLenStd,
-                                              fragLenKernelN,
-                                              fragLenKernelP, 1);
     double logForgettingMass{std::log(1.0)};
     double forgettingFactor{0.60};
     bool initialRound{true};
@@ -1823,16 +1994,74 @@ void quantifyLibrary(
     std::mutex ioMutex;
 
     size_t numPrevObservedFragments = 0;
+    // One alignment cache per read library, as the libraries are
+    // processed concurrently.
     std::vector<CacheFile> cacheFiles;
+    for (size_t i = 0; i < experiment.readLibraries().size(); ++i) {
+        fmt::MemoryWriter fname;
+        fname << "alnCache_" << i << ".bin";
+        boost::filesystem::path alnCacheFilename = salmonOpts.outputDirectory / fname.str();
+        cacheFiles.emplace_back(alnCacheFilename, uint64_t(0));
+    }
 
-    size_t maxReadGroup{miniBatchSize};
-    uint32_t structCacheSize = numQuantThreads * maxReadGroup * 10;
+    // Under a memory budget, the batches handed to the workers, and the
+    // pool of alignment groups they draw from, shrink to fit what the index
+    // and the transcripts leave.  Each parser keeps 4 batches per thread
+    // (~1KB per read), and an alignment group holds a few alignments.
+    size_t numLibraries = experiment.readLibraries().size();
+    salmonOpts.miniBatchSize = budget.capacity("read parser buffers",
+                                               4 * numQuantThreads * 1024, 0.25,
+                                               100, salmonOpts.miniBatchSize);
+    size_t maxReadGroup{salmonOpts.miniBatchSize};
+    size_t groupBytes = sizeof(AlignmentGroup<SMEMAlignment>) + 8 * sizeof(SMEMAlignment);
+    uint32_t structCacheSize = budget.capacity("alignment group pool", groupBytes, 0.5,
+                                               numQuantThreads * maxReadGroup * 2,
+                                               numQuantThreads * maxReadGroup * 10);
+    // The queues of the libraries being written to the mapping cache
+    budget.reserve("mapping cache queues",
+                   std::min(numLibraries, size_t(numQuantThreads)) * structCacheSize * sizeof(void*));
     AlnGroupQueue groupCache(structCacheSize);
-    for (size_t i = 0; i < structCacheSize; ++i) {
-        groupCache.enqueue( new AlignmentGroup<SMEMAlignment>() );
+    try {
+        for (size_t i = 0; i < structCacheSize; ++i) {
+            groupCache.enqueue( new AlignmentGroup<SMEMAlignment>() );
+        }
+    } catch (std::bad_alloc& e) {
+        // Work with the groups we could get rather than fail; the
+        // workers wait for free groups when the pool is empty.
+        jointLog->warn() << "could only allocate " << groupCache.size_approx()
+                         << " of the " << structCacheSize << " alignment groups; "
+                         << "consider lowering --memoryBudget";
+        if (groupCache.size_approx() < numQuantThreads * maxReadGroup) {
+            throw;
+        }
+    }
+    budget.recordPeakRSS("alignment group pool allocated");
+
+    // Unless it is disabled, the convergence of the estimates, rather
+    // than numRequiredFragments, decides when to stop.  The first pass
+    // is always complete, so that every fragment is seen at least once.
+    ConvergenceMonitor monitor(salmonOpts.convergenceTolerance,
+                               salmonOpts.convergenceInterval);
+    for (size_t i = 0; i < experiment.readLibraries().size(); ++i) {
+        if (experiment.readLibraries()[i].isPairedEnd()) {
+            monitor.addFragmentLengthDistribution(&experiment.fragmentLengthDistribution(i));
+        }
     }
+    // There is no point in caching the mappings past the required
+    // number of fragments, unless the number of passes isn't known.
+    uint64_t numFragmentsToCache = monitor.enabled() ?
+                                   std::numeric_limits<uint64_t>::max() :
+                                   numRequiredFragments;
+    uint32_t numPasses{0};
+    auto needAnotherPass = [&]() -> bool {
+        if (numPasses == 0) { return true; }
+        if (monitor.enabled()) {
+            return !monitor.converged() and numPasses < salmonOpts.maxPasses;
+        }
+        return numObservedFragments < numRequiredFragments;
+    };
 
-    while (numObservedFragments < numRequiredFragments) {
+    while (needAnotherPass()) {
         if (!initialRound) {
             bool didReset = (salmonOpts.disableMappingCache) ?
                             (experiment.reset()) :
@@ -1860,33 +2089,32 @@ void quantifyLibrary(
         }
 
         if (initialRound or salmonOpts.disableMappingCache) {
-            AlnGroupQueue outputGroups(structCacheSize);
-
-            volatile bool writeToCache = !salmonOpts.disableMappingCache;
             auto processReadLibraryCallback =  [&](
-                    ReadLibrary& rl, bwaidx_t* idx,
+                    ReadLibrary& rl, size_t libIdx, bwaidx_t* idx,
                     std::vector<Transcript>& transcripts, ClusterForest& clusterForest,
+                    FragmentLengthDistribution& fragLengthDist,
                     std::atomic<uint64_t>& numAssignedFragments,
                     std::atomic<uint64_t>& batchNum, size_t numQuantThreads,
                     bool& burnedIn) -> void  {
 
+                AlnGroupQueue outputGroups(structCacheSize);
+                volatile bool writeToCache = !salmonOpts.disableMappingCache;
+
                 // The file where the alignment cache was / will be written
-                fmt::MemoryWriter fname;
-                fname << "alnCache_" << cacheFiles.size() << ".bin";
-                boost::filesystem::path alnCacheFilename = salmonOpts.outputDirectory / fname.str();
-                cacheFiles.emplace_back(alnCacheFilename, uint64_t(0));
+                auto& cf = cacheFiles[libIdx];
+                cf.numWritten = 0;
 
                 std::unique_ptr<std::ofstream> alnCacheFile{nullptr};
                 std::unique_ptr<std::thread> cacheWriterThread{nullptr};
                 if (writeToCache) {
-                    alnCacheFile.reset(new std::ofstream(alnCacheFilename.c_str(), std::ios::binary));
+                    alnCacheFile.reset(new std::ofstream(cf.filePath.c_str(), std::ios::binary));
                     cereal::BinaryOutputArchive alnCacheArchive(*alnCacheFile);
                     cacheWriterThread.reset(new std::thread(writeAlignmentCacheToFile,
                         std::ref(outputGroups),
                         std::ref(groupCache),
-                        std::ref(cacheFiles.back().numWritten),
+                        std::ref(cf.numWritten),
                         std::ref(numObservedFragments),
-                        numRequiredFragments,
+                        numFragmentsToCache,
                         std::ref(writeToCache),
                         std::ref(alnCacheArchive)));
                 }
@@ -1896,7 +2124,7 @@ void quantifyLibrary(
                         initialRound, burnedIn, logForgettingMass, ffMutex, fragLengthDist,
                         memOptions, salmonOpts, coverageThresh, greedyChain,
                         ioMutex, numQuantThreads,
-                        groupCache, outputGroups, writeToCache);
+                        groupCache, outputGroups, writeToCache, monitor);
 
                 // join the thread the writes the file
                 writeToCache = false;
@@ -1907,22 +2135,19 @@ void quantifyLibrary(
             // Process all of the reads
             experiment.processReads(numQuantThreads, processReadLibraryCallback);
         } else {
-            AlnGroupQueue alnGroupQueue;
-
-
-            uint32_t libNum{0};
             auto processReadLibraryCallback =  [&](
-                    ReadLibrary& rl, bwaidx_t* idx,
+                    ReadLibrary& rl, size_t libIdx, bwaidx_t* idx,
                     std::vector<Transcript>& transcripts, ClusterForest& clusterForest,
+                    FragmentLengthDistribution& fragLengthDist,
                     std::atomic<uint64_t>& numAssignedFragments,
                     std::atomic<uint64_t>& batchNum, size_t numQuantThreads,
                     bool& burnedIn) -> void  {
 
+                AlnGroupQueue alnGroupQueue;
                 bool finishedParsing{false};
 
                 // The file where the alignment cache was / will be written
-                auto& cf = cacheFiles[libNum];
-                ++libNum;
+                auto& cf = cacheFiles[libIdx];
 
                 std::ifstream alnCacheFile(cf.filePath.c_str(), std::ios::binary);
                 cereal::BinaryInputArchive alnCacheArchive(alnCacheFile);
@@ -1933,14 +2158,15 @@ void quantifyLibrary(
                         cf.numWritten,
                         std::ref(finishedParsing),
                         std::ref(alnCacheFile),
-                        std::ref(alnCacheArchive));
+                        std::ref(alnCacheArchive),
+                        std::ref(monitor));
 
                 processCachedAlignments(rl, groupCache, alnGroupQueue,
                         numObservedFragments, numAssignedFragments,
                         transcripts, batchNum, logForgettingMass,
                         ffMutex, clusterForest, fragLengthDist,
                         salmonOpts, ioMutex, initialRound, finishedParsing,
-                        burnedIn, numQuantThreads);
+                        burnedIn, monitor, numQuantThreads);
 
                 cacheReaderThread.join();
                 alnCacheFile.close();
@@ -1951,14 +2177,35 @@ void quantifyLibrary(
         }
 
         initialRound = false;
-        fmt::print(stderr, "\n# observed = {} / # required = {}\n",
-                   numObservedFragments, numRequiredFragments);
+        ++numPasses;
+        monitor.checkpoint(numObservedFragments, experiment.numAssignedFragments(), refs);
+        if (monitor.enabled()) {
+            auto& cp = monitor.trajectory().back();
+            fmt::print(stderr, "\n# pass {} : relative change in abundance = {}, in counts = {}; "
+                       "fragment length change = {}\n",
+                       numPasses, cp.abundanceChange, cp.countChange, cp.fragLengthChange);
+        } else {
+            fmt::print(stderr, "\n# observed = {} / # required = {}\n",
+                       numObservedFragments, numRequiredFragments);
+        }
         fmt::print(stderr, "# assigned = {} / # observed (this round) = {}\033[F\033[F",
                    experiment.numAssignedFragments(),
                    numObservedFragments - numPrevObservedFragments);
     }
     fmt::print(stderr, "\n\n\n\n");
 
+    if (monitor.enabled()) {
+        if (monitor.converged()) {
+            jointLog->info() << "the estimates converged after " << numObservedFragments
+                             << " fragments (" << numPasses << " passes)";
+        } else {
+            jointLog->warn() << "the estimates did not converge to within "
+                             << salmonOpts.convergenceTolerance << " in "
+                             << numPasses << " passes; consider increasing --maxPasses";
+        }
+        monitor.writeTrajectory(salmonOpts.outputDirectory / "convergence.txt");
+    }
+
     AlignmentGroup<SMEMAlignment>* ag;
     while (groupCache.try_dequeue(ag)) { delete ag; }
     // delete any temporary alignment cache files
@@ -1968,6 +2215,8 @@ void quantifyLibrary(
         }
     }
 
+    budget.recordPeakRSS("quantification");
+    budget.report(jointLog);
     jointLog->info("finished quantifyLibrary()\n");
 }
 
@@ -1994,6 +2243,7 @@ int salmonQuantify(int argc, char *argv[]) {
     memOptions->split_factor = 1.5;
 
     double coverageThresh;
+    uint32_t minCellUMIs;
     vector<string> unmatedReadFiles;
     vector<string> mate1ReadFiles;
     vector<string> mate2ReadFiles;
@@ -2023,7 +2273,24 @@ int salmonQuantify(int argc, char *argv[]) {
     ("num_required_obs,n", po::value(&requiredObservations)->default_value(50000000),
                                         "The minimum number of observations (mapped reads) that must be observed before "
                                         "the inference procedure will terminate.  If fewer mapped reads exist in the "
-                                        "input file, then it will be read through multiple times.")
+                                        "input file, then it will be read through multiple times.  This is only used "
+                                        "when --convergenceTol is 0.")
+    ("convergenceTol", po::value<double>(&(sopt.convergenceTolerance))->default_value(0.01),
+                                        "Stop the inference once the relative abundances, the estimated read counts and the "
+                                        "fragment length distribution change by less than this between consecutive checkpoints. "
+                                        "The input is read through once, and then as many more times as necessary.  A value of "
+                                        "0 stops after --num_required_obs observations instead.  The changes at each "
+                                        "checkpoint are written to convergence.txt in the output directory.")
+    ("checkpointInterval", po::value<uint64_t>(&(sopt.convergenceInterval))->default_value(1000000),
+                                        "The number of fragments between two convergence checkpoints (there is one at the end "
+                                        "of each pass as well).")
+    ("maxPasses", po::value<uint32_t>(&(sopt.maxPasses))->default_value(20),
+                                        "The maximum number of passes over the input when waiting for the estimates to converge.")
+    ("memoryBudget", po::value<size_t>(&(sopt.memoryBudgetMB))->default_value(0),
+                                        "The memory (in MB) the run should fit in.  The index and the transcripts are accounted "
+                                        "for first, and the batches of reads and the pool of alignment structures are sized to fit "
+                                        "in what remains (down to the minimum they need).  The estimated size of each component, and "
+                                        "the peak memory use at each stage, are written to the log.  0 keeps the default sizes.")
     ("minLen,k", po::value<int>(&(memOptions->min_seed_len))->default_value(19), "(S)MEMs smaller than this size won't be considered.")
     ("maxOcc,m", po::value<int>(&(memOptions->max_occ))->default_value(200), "(S)MEMs occuring more than this many times won't be considered.")
     ("maxReadOcc,w", po::value<uint32_t>(&(sopt.maxReadOccs))->default_value(100), "Reads \"mapping\" to more than this many places won't be considered.")
@@ -2042,6 +2309,16 @@ int salmonQuantify(int argc, char *argv[]) {
                                         "typically slow down quantification by ~40%.  Consider enabling this option if you find the mapping rate to "
                                         "be significantly lower than expected.")
     ("coverage,c", po::value<double>(&coverageThresh)->default_value(0.75), "required coverage of read by union of SMEMs to consider it a \"hit\".")
+    ("barcodeGeometry", po::value<string>(), "Enables the single-cell mode, for droplet-based protocols: the #1 mates hold "
+                                        "the cell barcode and the UMI, as described by this geometry, and the #2 mates are "
+                                        "mapped.  The geometry is a list of segments: B<n> for n bases of barcode, U<n> for "
+                                        "n bases of UMI and X<n> for n bases to skip (e.g. B16U10).  The abundances of each "
+                                        "cell are written as a sparse matrix (quants_mat.mtx) instead of quant.sf.")
+    ("whitelist", po::value<string>(), "[single-cell mode] : File of the expected cell barcodes, one per line.  "
+                                        "Barcodes one substitution away from a single listed barcode are corrected; the "
+                                        "reads with other barcodes are discarded.")
+    ("minCellUMIs", po::value<uint32_t>(&minCellUMIs)->default_value(10), "[single-cell mode] : Cells with fewer "
+                                        "distinct UMIs than this are not quantified.")
     ("output,o", po::value<std::string>()->required(), "Output quantification file.")
     ("bias_correct", po::value(&biasCorrect)->zero_tokens(), "[Experimental: Output both bias-corrected and non-bias-corrected "
                                                                "qunatification estimates.")
@@ -2140,10 +2417,34 @@ transcript abundance from RNA-seq reads
 
         vector<ReadLibrary> readLibraries = sailfish::utils::extractReadLibraries(orderedOptions);
         ReadExperiment experiment(readLibraries, indexDirectory);
+        sopt.interleavedBWT = experiment.interleavedBWT();
         uint32_t nbThreads = vm["threads"].as<uint32_t>();
 
+        MemoryBudget budget(sopt.memoryBudgetMB);
+        budget.reserve("index", experiment.indexBytes());
+        budget.reserve("transcript sequences", experiment.sequenceBytes());
+        budget.recordPeakRSS("index and transcripts loaded");
+
+        if (vm.count("barcodeGeometry")) {
+            ReadGeometry geometry(vm["barcodeGeometry"].as<string>());
+            BarcodeWhitelist whitelist;
+            if (vm.count("whitelist")) {
+                bfs::path whitelistPath(vm["whitelist"].as<string>());
+                if (!whitelist.load(whitelistPath)) {
+                    std::cerr << "Could not read the barcode whitelist " << whitelistPath << "\n";
+                    std::exit(1);
+                }
+                jointLog->info() << "loaded " << whitelist.size() << " whitelisted barcodes";
+            }
+            quantifySingleCells(experiment, geometry, whitelist, minCellUMIs,
+                                memOptions, sopt, coverageThresh, nbThreads);
+            free(memOptions);
+            jointLog->info("done\n");
+            return 0;
+        }
+
         quantifyLibrary(experiment, greedyChain, memOptions, sopt, coverageThresh,
-                        requiredObservations, nbThreads);
+                        requiredObservations, nbThreads, budget);
 
         free(memOptions);
         size_t tnum{0};
@@ -2153,6 +2454,14 @@ transcript abundance from RNA-seq reads
         bfs::path estFilePath = outputDirectory / "quant.sf";
         salmon::utils::writeAbundances(experiment, estFilePath, commentString);
 
+        // Put back the transcripts collapsed at index build time
+        TranscriptDuplicates duplicates;
+        if (duplicates.load(indexDirectory / "duplicates.txt") and !duplicates.empty()) {
+            jointLog->info() << "restoring " << duplicates.numRemoved()
+                             << " duplicate transcripts in the output\n";
+            duplicates.expandQuantFile(estFilePath);
+        }
+
         bfs::path libCountFilePath = outputDirectory / "libFormatCounts.txt";
         experiment.summarizeLibraryTypeCounts(libCountFilePath);
 
@@ -55,6 +55,8 @@ extern "C" {
 #include "SalmonConfig.hpp"
 #include "SalmonOpts.hpp"
 #include "NullFragmentFilter.hpp"
+#include "ConvergenceMonitor.hpp"
+#include "MemoryBudget.hpp"
 #include "Sampler.hpp"
 #include "spdlog/spdlog.h"
 
@@ -325,7 +327,7 @@ bool quantifyLibrary(
 
     auto& refs = alnLib.transcripts();
     size_t numTranscripts = refs.size();
-    size_t miniBatchSize{1000};
+    size_t miniBatchSize{salmonOpts.miniBatchSize};
     size_t numObservedFragments{0};
 
     MiniBatchQueue<AlignmentGroup<FragT*>> workQueue;
@@ -336,10 +338,25 @@ bool quantifyLibrary(
 
     NullFragmentFilter<FragT>* nff = nullptr;
 
+    // Unless it is disabled, the convergence of the estimates, rather
+    // than numRequiredFragments, decides when to stop.  The first pass
+    // is always complete, so that every fragment is seen at least once.
+    ConvergenceMonitor monitor(salmonOpts.convergenceTolerance,
+                               salmonOpts.convergenceInterval);
+    monitor.addFragmentLengthDistribution(&alnLib.fragmentLengthDistribution());
+    uint32_t numPasses{0};
+    auto needAnotherPass = [&]() -> bool {
+        if (numPasses == 0) { return true; }
+        if (monitor.enabled()) {
+            return !monitor.converged() and numPasses < salmonOpts.maxPasses;
+        }
+        return numObservedFragments < numRequiredFragments;
+    };
+
     // Give ourselves some space
     fmt::print(stderr, "\n\n\n\n");
 
-    while (numObservedFragments < numRequiredFragments) {
+    while (needAnotherPass()) {
         if (!initialRound) {
             if (!alnLib.reset(true, nff)) {
                 fmt::print(stderr,
@@ -393,10 +410,19 @@ bool quantifyLibrary(
                 }
                 MiniBatchInfo<AlignmentGroup<FragT*>>* mbi =
                     new MiniBatchInfo<AlignmentGroup<FragT*>>(batchNum, alignments, logForgettingMass);
-                workQueue.push(mbi);
-                {
-                    std::unique_lock<std::mutex> l(cvmutex);
-                    workAvailable.notify_one();
+                if (!initialRound and monitor.converged()) {
+                    // The estimates have converged; the rest of
+                    // the pass is read through without processing it.
+                    mbi->release(alnLib.fragmentQueue(), alnLib.alignmentGroupQueue());
+                    delete mbi;
+                } else {
+                    workQueue.push(mbi);
+                    {
+                        std::unique_lock<std::mutex> l(cvmutex);
+                        workAvailable.notify_one();
+                    }
+                    monitor.update(numObservedFragments + processedReads,
+                                   alnLib.numMappedReads(), refs);
                 }
                 alignments = new std::vector<AlignmentGroup<FragT*>*>;
                 alignments->reserve(miniBatchSize);
@@ -434,13 +460,34 @@ bool quantifyLibrary(
         fmt::print(stderr, "\n\n");
 
         initialRound = false;
+        ++numPasses;
         numObservedFragments += alnLib.numMappedReads();
 
-        fmt::print(stderr, "# observed = {} / # required = {}\033[F\033[F\033[F\033[F\033[F",
-                   numObservedFragments, numRequiredFragments);
+        monitor.checkpoint(numObservedFragments, alnLib.numMappedReads(), refs);
+        if (monitor.enabled()) {
+            auto& cp = monitor.trajectory().back();
+            fmt::print(stderr, "# pass {} : relative change in abundance = {}, in counts = {}; "
+                       "fragment length change = {}\033[F\033[F\033[F\033[F\033[F",
+                       numPasses, cp.abundanceChange, cp.countChange, cp.fragLengthChange);
+        } else {
+            fmt::print(stderr, "# observed = {} / # required = {}\033[F\033[F\033[F\033[F\033[F",
+                       numObservedFragments, numRequiredFragments);
+        }
     }
 
     fmt::print(stderr, "\n\n\n\n");
+    if (monitor.enabled()) {
+        auto jointLog = spdlog::get("jointLog");
+        if (monitor.converged()) {
+            jointLog->info() << "the estimates converged after " << numObservedFragments
+                             << " fragments (" << numPasses << " passes)";
+        } else {
+            jointLog->warn() << "the estimates did not converge to within "
+                             << salmonOpts.convergenceTolerance << " in "
+                             << numPasses << " passes; consider increasing --maxPasses";
+        }
+        monitor.writeTrajectory(salmonOpts.outputDirectory / "convergence.txt");
+    }
     return burnedIn;
     // Write the inferred fragment length distribution
     /*
@@ -518,10 +565,35 @@ int salmonAlignmentQuantify(int argc, char* argv[]) {
                         "the un-aligned reads to \"posSample.bam\".")
     ("bias_correct", po::value(&biasCorrect)->zero_tokens(), "[Experimental]: Output both bias-corrected and non-bias-corrected "
                                                              "qunatification estimates.")
+    ("collate", po::bool_switch(&(sopt.collateAlignments))->default_value(false), "Group the alignments of each "
+                        "read even if they are not consecutive in the input, as for files sorted by coordinate.  This is "
+                        "done automatically when the header of a file says it is sorted by coordinate (SO:coordinate).")
+    ("collationMemory", po::value<size_t>(&(sopt.collationMemoryMB))->default_value(2048), "Memory (in MB) used to hold "
+                        "the alignments of reads which are not complete yet when collating the input; beyond it, they are "
+                        "written to temporary files.")
+    ("collationDir", po::value<std::string>(), "Directory for the temporary files of the collation (default: the "
+                        "output directory).")
     ("num_required_obs,n", po::value(&requiredObservations)->default_value(50000000),
                                         "The minimum number of observations (mapped reads) that must be observed before "
                                         "the inference procedure will terminate.  If fewer mapped reads exist in the "
-                                        "input file, then it will be read through multiple times.")
+                                        "input file, then it will be read through multiple times.  This is only used "
+                                        "when --convergenceTol is 0.")
+    ("convergenceTol", po::value<double>(&(sopt.convergenceTolerance))->default_value(0.01),
+                                        "Stop the inference once the relative abundances, the estimated read counts and the "
+                                        "fragment length distribution change by less than this between consecutive checkpoints. "
+                                        "The input is read through once, and then as many more times as necessary.  A value of "
+                                        "0 stops after --num_required_obs observations instead.  The changes at each "
+                                        "checkpoint are written to convergence.txt in the output directory.")
+    ("checkpointInterval", po::value<uint64_t>(&(sopt.convergenceInterval))->default_value(1000000),
+                                        "The number of fragments between two convergence checkpoints (there is one at the end "
+                                        "of each pass as well).")
+    ("maxPasses", po::value<uint32_t>(&(sopt.maxPasses))->default_value(20),
+                                        "The maximum number of passes over the input when waiting for the estimates to converge.")
+    ("memoryBudget", po::value<size_t>(&(sopt.memoryBudgetMB))->default_value(0),
+                                        "The memory (in MB) the run should fit in.  The transcripts are accounted for first, and "
+                                        "the pool of preallocated alignment records and the collation buffer are sized to fit in "
+                                        "what remains (down to the minimum they need).  The estimated size of each component, and "
+                                        "the peak memory use at each stage, are written to the log.  0 keeps the default sizes.")
     ("gene_map,g", po::value<std::string>(), "File containing a mapping of transcripts to genes.  If this file is provided "
                                         "Sailfish will output both quant.sf and quant.genes.sf files, where the latter "
                                         "contains aggregated gene-level abundance estimates.  The transcript to gene mapping "
@@ -657,6 +729,11 @@ int salmonAlignmentQuantify(int argc, char* argv[]) {
         }
 
         // If we made it this far, the output directory exists
+        sopt.outputDirectory = outputDirectory;
+        sopt.collationDirectory = outputDirectory;
+        if (vm.count("collationDir")) {
+            sopt.collationDirectory = bfs::path(vm["collationDir"].as<std::string>());
+        }
         bfs::path outputFile = outputDirectory / "quant.sf";
         // Now create a subdirectory for any parameters of interest
         bfs::path paramsDir = outputDirectory / "libParams";
@@ -686,6 +763,24 @@ int salmonAlignmentQuantify(int argc, char* argv[]) {
         sopt.numParseThreads = numParseThreads;
         std::cerr << "numQuantThreads = " << numQuantThreads << "\n";
 
+        // Under a memory budget, the pool of alignment records the parser
+        // preallocates (a fragment and an alignment group each, with the
+        // BAM record: ~400 bytes), and the buffer of the collation, shrink
+        // to fit what the transcript sequences leave.
+        MemoryBudget budget(sopt.memoryBudgetMB);
+        budget.reserve("transcript sequences", bfs::file_size(transcriptFile) / 2);
+        sopt.numCachedFragments = budget.capacity("alignment record pool", 400, 0.6,
+                                                  100000, sopt.numCachedFragments);
+        if (budget.limited()) {
+            size_t collationMB = std::max(size_t(64), budget.available() / 5 / (1024 * 1024));
+            if (collationMB < sopt.collationMemoryMB) {
+                jointLog->info() << "limiting the collation buffer to " << collationMB
+                                 << " MB to fit in the memory budget";
+                sopt.collationMemoryMB = collationMB;
+            }
+        }
+        budget.reserve("collation buffer", sopt.collationMemoryMB * 1024 * 1024);
+
         switch (libFmt.type) {
             case ReadType::SINGLE_END:
                 {
@@ -732,6 +827,8 @@ int salmonAlignmentQuantify(int argc, char* argv[]) {
                           << libFmt << "\n";
                 std::exit(1);
         }
+        budget.recordPeakRSS("quantification");
+        budget.report(jointLog);
 
         bfs::path estFilePath = outputDirectory / "quant.sf";
 
@@ -0,0 +1,321 @@
+#include "SingleCellQuant.hpp"
+
+#include "format.h"
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_scheduler_init.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+// Number of records a buffer holds before removing its duplicates
+constexpr size_t kBufferRecords = 1 << 22;
+// The EM of a cell stops when no estimate above kMinEMCount changes by more
+// than kEMRelDiff, or after kMaxEMIterations.
+constexpr uint32_t kMaxEMIterations = 1000;
+constexpr double kEMRelDiff = 1e-3;
+constexpr double kMinEMCount = 1e-2;
+
+ReadGeometry::ReadGeometry(const std::string& spec) {
+    size_t i = 0;
+    while (i < spec.size()) {
+        char kind = std::toupper(spec[i++]);
+        size_t start = i;
+        while (i < spec.size() and std::isdigit(spec[i])) { ++i; }
+        if ((kind != 'B' and kind != 'U' and kind != 'X') or i == start) {
+            std::stringstream errstr;
+            errstr << "Invalid read geometry [" << spec << "]; expected segments such as "
+                   << "B16 (barcode), U10 (UMI) or X4 (skipped bases), e.g. B16U10";
+            throw std::invalid_argument(errstr.str());
+        }
+        uint32_t length = std::stoul(spec.substr(start, i - start));
+        segments_.push_back({kind, length});
+        if (kind == 'B') { barcodeLength_ += length; }
+        if (kind == 'U') { umiLength_ += length; }
+    }
+    if (barcodeLength_ == 0 or barcodeLength_ > 32 or umiLength_ > 32) {
+        std::stringstream errstr;
+        errstr << "Invalid read geometry [" << spec << "]; the barcode must have between "
+               << "1 and 32 bases, and the UMI at most 32";
+        throw std::invalid_argument(errstr.str());
+    }
+}
+
+bool ReadGeometry::extract(const std::string& seq, std::string& barcode, std::string& umi) const {
+    barcode.clear();
+    umi.clear();
+    size_t pos = 0;
+    for (auto& segment : segments_) {
+        if (pos + segment.length > seq.size()) { return false; }
+        if (segment.kind == 'B') {
+            barcode.append(seq, pos, segment.length);
+        } else if (segment.kind == 'U') {
+            umi.append(seq, pos, segment.length);
+        }
+        pos += segment.length;
+    }
+    return true;
+}
+
+bool encodeSequence(const std::string& seq, uint64_t& code) {
+    code = 0;
+    for (auto c : seq) {
+        uint64_t b;
+        switch (c) {
+            case 'A': case 'a': b = 0; break;
+            case 'C': case 'c': b = 1; break;
+            case 'G': case 'g': b = 2; break;
+            case 'T': case 't': b = 3; break;
+            default: return false;
+        }
+        code = (code << 2) | b;
+    }
+    return true;
+}
+
+std::string decodeSequence(uint64_t code, uint32_t length) {
+    std::string seq(length, 'A');
+    for (uint32_t i = 0; i < length; ++i) {
+        seq[length - 1 - i] = "ACGT"[code & 0x3];
+        code >>= 2;
+    }
+    return seq;
+}
+
+bool BarcodeWhitelist::load(const boost::filesystem::path& fname) {
+    std::ifstream in(fname.string());
+    if (!in.good()) { return false; }
+    std::string line;
+    while (in >> line) {
+        uint64_t code;
+        if (encodeSequence(line, code)) { barcodes_.insert(code); }
+    }
+    return true;
+}
+
+bool BarcodeWhitelist::assign(std::string& barcode, bool& corrected) const {
+    corrected = false;
+    uint64_t code;
+    if (encodeSequence(barcode, code) and barcodes_.count(code) > 0) { return true; }
+
+    // Look for the listed barcodes one substitution away (an N is a
+    // substitution too); the barcode is kept only if there is one.
+    std::string candidate(barcode);
+    std::string match;
+    size_t numMatches{0};
+    for (size_t p = 0; p < barcode.size() and numMatches < 2; ++p) {
+        for (char b : {'A', 'C', 'G', 'T'}) {
+            if (b == std::toupper(barcode[p])) { continue; }
+            candidate[p] = b;
+            if (encodeSequence(candidate, code) and barcodes_.count(code) > 0) {
+                match = candidate;
+                ++numMatches;
+            }
+        }
+        candidate[p] = barcode[p];
+    }
+    if (numMatches != 1) { return false; }
+    barcode = match;
+    corrected = true;
+    return true;
+}
+
+/**
+ * Sort the records and remove the duplicates, i.e. the reads of
+ * the same cell, equivalence class and UMI.
+ */
+static void removeDuplicates(std::vector<CellCounts::Record>& records) {
+    std::sort(records.begin(), records.end(),
+              [](const CellCounts::Record& a, const CellCounts::Record& b) -> bool {
+                  return (a.cell != b.cell) ? (a.cell < b.cell) :
+                         (a.eqClass != b.eqClass) ? (a.eqClass < b.eqClass) :
+                         (a.umi < b.umi);
+              });
+    auto last = std::unique(records.begin(), records.end(),
+                            [](const CellCounts::Record& a, const CellCounts::Record& b) -> bool {
+                                return a.cell == b.cell and a.eqClass == b.eqClass and a.umi == b.umi;
+                            });
+    records.erase(last, records.end());
+}
+
+void CellCounts::Buffer::add(uint64_t cell, const TranscriptSet& transcripts, uint64_t umi) {
+    auto it = eqIDs_.find(transcripts);
+    if (it == eqIDs_.end()) {
+        it = eqIDs_.emplace(transcripts, eqClasses_.size()).first;
+        eqClasses_.push_back(transcripts);
+    }
+    records_.push_back({cell, umi, it->second});
+    if (records_.size() >= kBufferRecords) {
+        removeDuplicates(records_);
+        // Still mostly distinct molecules; hand them over
+        if (records_.size() >= kBufferRecords / 2) { flush(); }
+    }
+}
+
+void CellCounts::Buffer::flush() {
+    if (records_.empty()) { return; }
+    counts_.merge_(*this);
+    eqIDs_.clear();
+    eqClasses_.clear();
+    records_.clear();
+}
+
+void CellCounts::merge_(Buffer& buffer) {
+    std::lock_guard<std::mutex> l(mutex_);
+    std::vector<uint32_t> globalIDs(buffer.eqClasses_.size());
+    for (size_t i = 0; i < buffer.eqClasses_.size(); ++i) {
+        auto it = eqIDs_.find(buffer.eqClasses_[i]);
+        if (it == eqIDs_.end()) {
+            it = eqIDs_.emplace(buffer.eqClasses_[i], eqClasses_.size()).first;
+            eqClasses_.push_back(buffer.eqClasses_[i]);
+        }
+        globalIDs[i] = it->second;
+    }
+    records_.reserve(records_.size() + buffer.records_.size());
+    for (auto& r : buffer.records_) {
+        records_.push_back({r.cell, r.umi, globalIDs[r.eqClass]});
+    }
+}
+
+void CellCounts::collapse(uint32_t minUMIs) {
+    removeDuplicates(records_);
+
+    size_t i = 0;
+    while (i < records_.size()) {
+        uint64_t cell = records_[i].cell;
+        std::vector<std::pair<uint32_t, uint32_t>> classes;
+        uint64_t numUMIs{0};
+        for (; i < records_.size() and records_[i].cell == cell; ++i) {
+            if (classes.empty() or classes.back().first != records_[i].eqClass) {
+                classes.emplace_back(records_[i].eqClass, 0);
+            }
+            ++classes.back().second;
+            ++numUMIs;
+        }
+        if (numUMIs >= minUMIs) {
+            cells_.push_back(cell);
+            cellClasses_.emplace_back(std::move(classes));
+        }
+    }
+    records_.clear();
+    records_.shrink_to_fit();
+}
+
+void CellCounts::quantify(uint32_t numThreads) {
+    tbb::task_scheduler_init init(numThreads);
+    cellEstimates_.clear();
+    cellEstimates_.resize(cells_.size());
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, cells_.size()),
+        [this](const tbb::blocked_range<size_t>& range) -> void {
+            for (auto c = range.begin(); c != range.end(); ++c) {
+                auto& classes = cellClasses_[c];
+
+                // Number the transcripts of this cell from 0
+                std::unordered_map<uint32_t, uint32_t> localIDs;
+                std::vector<uint32_t> transcripts;
+                std::vector<std::vector<uint32_t>> labels(classes.size());
+                double total{0.0};
+                for (size_t e = 0; e < classes.size(); ++e) {
+                    for (auto t : eqClasses_[classes[e].first]) {
+                        auto it = localIDs.find(t);
+                        if (it == localIDs.end()) {
+                            it = localIDs.emplace(t, transcripts.size()).first;
+                            transcripts.push_back(t);
+                        }
+                        labels[e].push_back(it->second);
+                    }
+                    total += classes[e].second;
+                }
+
+                size_t n = transcripts.size();
+                std::vector<double> alpha(n, total / n);
+                std::vector<double> next(n);
+                for (uint32_t iter = 0; iter < kMaxEMIterations; ++iter) {
+                    std::fill(next.begin(), next.end(), 0.0);
+                    for (size_t e = 0; e < classes.size(); ++e) {
+                        double denom{0.0};
+                        for (auto t : labels[e]) { denom += alpha[t]; }
+                        if (denom <= 0.0) { continue; }
+                        double scale = classes[e].second / denom;
+                        for (auto t : labels[e]) { next[t] += alpha[t] * scale; }
+                    }
+                    bool converged{true};
+                    for (size_t t = 0; t < n and converged; ++t) {
+                        if (next[t] > kMinEMCount and
+                            std::abs(next[t] - alpha[t]) / next[t] > kEMRelDiff) {
+                            converged = false;
+                        }
+                    }
+                    std::swap(alpha, next);
+                    if (converged) { break; }
+                }
+
+                auto& estimates = cellEstimates_[c];
+                for (size_t t = 0; t < n; ++t) {
+                    if (alpha[t] > kMinEMCount) { estimates.emplace_back(transcripts[t], alpha[t]); }
+                }
+                std::sort(estimates.begin(), estimates.end());
+            }
+        });
+}
+
+void CellCounts::writeMatrix(const boost::filesystem::path& outputDirectory,
+                             std::vector<Transcript>& transcripts,
+                             const TranscriptDuplicates& duplicates,
+                             uint32_t barcodeLength) const {
+    size_t numEntries{0};
+    for (auto& estimates : cellEstimates_) { numEntries += estimates.size(); }
+
+    auto openError = [](const boost::filesystem::path& fname) -> std::runtime_error {
+        std::stringstream errstr;
+        errstr << "Could not create the output file " << fname
+               << "; check that the output directory is writable.\n";
+        return std::runtime_error(errstr.str());
+    };
+
+    boost::filesystem::path matPath = outputDirectory / "quants_mat.mtx";
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> mat(std::fopen(matPath.c_str(), "w"), std::fclose);
+    if (mat == nullptr) { throw openError(matPath); }
+    fmt::print(mat.get(), "%%MatrixMarket matrix coordinate real general\n");
+    fmt::print(mat.get(), "{} {} {}\n", cells_.size(), transcripts.size(), numEntries);
+    for (size_t c = 0; c < cellEstimates_.size(); ++c) {
+        for (auto& est : cellEstimates_[c]) {
+            fmt::print(mat.get(), "{} {} {}\n", c + 1, est.first + 1, est.second);
+        }
+    }
+
+    boost::filesystem::path rowsPath = outputDirectory / "quants_mat_rows.txt";
+    std::ofstream rows(rowsPath.string());
+    if (!rows) { throw openError(rowsPath); }
+    for (auto cell : cells_) { rows << decodeSequence(cell, barcodeLength) << '\n'; }
+
+    boost::filesystem::path colsPath = outputDirectory / "quants_mat_cols.txt";
+    std::ofstream cols(colsPath.string());
+    if (!cols) { throw openError(colsPath); }
+    for (auto& t : transcripts) { cols << t.RefName << '\n'; }
+
+    // The collapsed transcripts have no column of their own: their reads are
+    // counted in the column of their representative.
+    if (!duplicates.empty()) {
+        boost::filesystem::path collapsedPath = outputDirectory / "quants_mat_collapsed.txt";
+        std::ofstream collapsed(collapsedPath.string());
+        if (!collapsed) { throw openError(collapsedPath); }
+        collapsed << "# column\trepresentative\tcollapsed transcript\tidentical|contained\n";
+        for (size_t i = 0; i < transcripts.size(); ++i) {
+            auto* members = duplicates.membersOf(transcripts[i].RefName);
+            if (members == nullptr) { continue; }
+            for (auto& m : *members) {
+                collapsed << i + 1 << '\t' << transcripts[i].RefName << '\t' << m.name << '\t'
+                          << (m.contained ? "contained" : "identical") << '\n';
+            }
+        }
+    }
+}
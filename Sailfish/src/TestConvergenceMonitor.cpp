@@ -0,0 +1,150 @@
+/**
+ * Checks that the ConvergenceMonitor stops on estimates that have converged
+ * up to sampling noise, and not on estimates that still move.
+ *
+ * The online estimates are modelled as the read counts accumulated over the
+ * intervals between checkpoints, each interval drawing its reads around
+ * fixed expected counts with Poisson-like noise.  The many transcripts with a
+ * few tens of reads then change by far more than the tolerance from one
+ * checkpoint to the next, while the estimates as a whole don't.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ConvergenceMonitor.hpp"
+#include "Transcript.hpp"
+
+constexpr double kTolerance = 0.01;
+constexpr uint64_t kInterval = 1000000;
+constexpr uint32_t kNumStable = 3;
+constexpr uint32_t kMaxPasses = 20;
+
+struct Simulation {
+    std::vector<uint32_t> lengths;
+    // The expected number of reads of each transcript in one interval
+    std::vector<double> expectedCounts;
+};
+
+static Simulation simulate(size_t numTranscripts, std::mt19937& gen) {
+    Simulation sim;
+    std::uniform_int_distribution<uint32_t> length(500, 5000);
+    std::lognormal_distribution<double> expression(0.0, 2.0);
+    double total{0.0};
+    for (size_t i = 0; i < numTranscripts; ++i) {
+        sim.lengths.push_back(length(gen));
+        sim.expectedCounts.push_back(expression(gen));
+        total += sim.expectedCounts.back();
+    }
+    for (auto& c : sim.expectedCounts) { c *= kInterval / total; }
+    return sim;
+}
+
+/** Add the reads of one more interval to the counts */
+static void addInterval(const Simulation& sim, std::mt19937& gen, std::vector<double>& counts) {
+    std::normal_distribution<double> noise(0.0, 1.0);
+    counts.resize(sim.expectedCounts.size(), 0.0);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        double lambda = sim.expectedCounts[i];
+        counts[i] += std::max(0.0, lambda + std::sqrt(lambda) * noise(gen));
+    }
+}
+
+/**
+ * The transcripts with the counts as their masses; they are built in place,
+ * as moving a Transcript drops its mass.
+ */
+static void makeTranscripts(const Simulation& sim, const std::vector<double>& counts,
+                            std::vector<Transcript>& transcripts) {
+    transcripts.clear();
+    transcripts.reserve(sim.lengths.size());
+    for (size_t i = 0; i < sim.lengths.size(); ++i) {
+        transcripts.emplace_back(i, "t", sim.lengths[i]);
+        if (counts[i] > 0.0) { transcripts.back().addMass(std::log(counts[i])); }
+    }
+}
+
+/**
+ * The largest relative change of the estimated counts of the transcripts
+ * with at least 10 reads, i.e. what the monitor used to test.
+ */
+static double largestRelativeChange(std::vector<Transcript>& prev, std::vector<Transcript>& cur) {
+    double largest{0.0};
+    for (size_t i = 0; i < cur.size(); ++i) {
+        double p = std::exp(prev[i].mass(false));
+        double c = std::exp(cur[i].mass(false));
+        double m = std::max(p, c);
+        if (m >= 10.0) { largest = std::max(largest, std::abs(c - p) / m); }
+    }
+    return largest;
+}
+
+static bool check(bool cond, const std::string& msg) {
+    if (!cond) { std::cerr << "FAILED: " << msg << "\n"; }
+    return cond;
+}
+
+int main() {
+    std::mt19937 gen(114);
+    bool ok{true};
+
+    Simulation sim = simulate(2000, gen);
+
+    // Converged estimates: the monitor must stop within a few checkpoints
+    // after the first numStable ones.
+    {
+        ConvergenceMonitor monitor(kTolerance, kInterval, kNumStable);
+        std::vector<double> counts;
+        std::vector<Transcript> prev, cur;
+        double largest{0.0};
+        uint32_t pass{0};
+        while (!monitor.converged() and pass < kMaxPasses) {
+            ++pass;
+            addInterval(sim, gen, counts);
+            makeTranscripts(sim, counts, cur);
+            if (!prev.empty()) { largest = std::max(largest, largestRelativeChange(prev, cur)); }
+            monitor.checkpoint(pass * kInterval, kInterval, cur);
+            std::swap(prev, cur);
+        }
+        auto& cp = monitor.trajectory().back();
+        std::cerr << "converged input: " << pass << " checkpoints, last abundance change = "
+                  << cp.abundanceChange << ", count change = " << cp.countChange
+                  << ", largest relative change = " << largest << "\n";
+        ok &= check(largest > kTolerance,
+                    "the noise of the lowly expressed transcripts should exceed the tolerance");
+        ok &= check(monitor.converged(), "converged estimates were not detected");
+        ok &= check(pass <= kNumStable + 3, "converged estimates took more than "
+                    + std::to_string(kNumStable + 3) + " checkpoints");
+    }
+
+    // Estimates that still move: a fifth of the reads keep shifting between
+    // the two most expressed transcripts, so the monitor must not stop.
+    {
+        size_t first = std::max_element(sim.expectedCounts.begin(), sim.expectedCounts.end())
+                       - sim.expectedCounts.begin();
+        size_t second = (first == 0) ? 1 : 0;
+        for (size_t i = 0; i < sim.expectedCounts.size(); ++i) {
+            if (i != first and sim.expectedCounts[i] > sim.expectedCounts[second]) { second = i; }
+        }
+        double shift = 0.2 * kInterval;
+        sim.expectedCounts[first] += shift;
+
+        ConvergenceMonitor monitor(kTolerance, kInterval, kNumStable);
+        std::vector<double> counts;
+        std::vector<Transcript> cur;
+        for (uint32_t pass = 1; pass <= kMaxPasses; ++pass) {
+            std::swap(sim.expectedCounts[first], sim.expectedCounts[second]);
+            counts.clear();
+            addInterval(sim, gen, counts);
+            makeTranscripts(sim, counts, cur);
+            monitor.checkpoint(pass * kInterval, kInterval, cur);
+        }
+        ok &= check(!monitor.converged(), "changing estimates were taken as converged");
+    }
+
+    return ok ? 0 : 1;
+}
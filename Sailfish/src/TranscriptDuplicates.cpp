@@ -0,0 +1,274 @@
+#include "TranscriptDuplicates.hpp"
+
+#include "format.h"
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_scheduler_init.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+
+namespace {
+    struct FastaRecord {
+        std::string header;
+        std::string name;
+        std::string seq;
+    };
+
+    // Length of the prefixes used to find the candidate containers of a sequence
+    constexpr uint32_t kPrefixLen = 31;
+
+    inline int nucCode(char c) {
+        switch (c) {
+            case 'A': return 0;
+            case 'C': return 1;
+            case 'G': return 2;
+            case 'T': return 3;
+            default: return -1;
+        }
+    }
+
+    void readFasta(const std::string& fname, std::vector<FastaRecord>& records) {
+        std::ifstream in(fname);
+        if (!in.good()) {
+            std::stringstream errstr;
+            errstr << "Could not open the transcript file [" << fname << "]";
+            throw std::invalid_argument(errstr.str());
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() and line.back() == '\r') { line.pop_back(); }
+            if (line.empty()) { continue; }
+            if (line[0] == '>') {
+                records.push_back(FastaRecord());
+                records.back().header = line.substr(1);
+                records.back().name = line.substr(1, line.find_first_of(" \t") - 1);
+            } else if (!records.empty()) {
+                std::string& seq = records.back().seq;
+                size_t start = seq.size();
+                seq += line;
+                std::transform(seq.begin() + start, seq.end(), seq.begin() + start,
+                               [](char c) -> char { return std::toupper(c); });
+            }
+        }
+    }
+}
+
+size_t TranscriptDuplicates::collapse(const std::vector<std::string>& fastaFiles,
+                                      const boost::filesystem::path& outFasta,
+                                      bool collapseContained, uint32_t numThreads) {
+    members_.clear();
+    std::vector<FastaRecord> records;
+    for (auto& fname : fastaFiles) { readFasta(fname, records); }
+    size_t n = records.size();
+
+    tbb::task_scheduler_init init(numThreads);
+
+    std::vector<size_t> hashes(n);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, n),
+        [&records, &hashes](const tbb::blocked_range<size_t>& range) -> void {
+            std::hash<std::string> hasher;
+            for (auto i = range.begin(); i != range.end(); ++i) {
+                hashes[i] = hasher(records[i].seq);
+            }
+        });
+
+    // The representative of each sequence, or -1 if it is indexed
+    std::vector<int64_t> representative(n, -1);
+    std::vector<bool> contained(n, false);
+    {
+        std::unordered_map<size_t, std::vector<size_t>> byHash;
+        for (size_t i = 0; i < n; ++i) {
+            auto& candidates = byHash[hashes[i]];
+            for (auto j : candidates) {
+                if (records[j].seq == records[i].seq) {
+                    representative[i] = j;
+                    break;
+                }
+            }
+            if (representative[i] == -1) { candidates.push_back(i); }
+        }
+    }
+
+    if (collapseContained) {
+        // Index the distinct sequences by their first k-mer, then look for
+        // these k-mers along every distinct sequence.
+        std::unordered_map<uint64_t, std::vector<size_t>> prefixes;
+        for (size_t i = 0; i < n; ++i) {
+            auto& seq = records[i].seq;
+            if (representative[i] != -1 or seq.size() < kPrefixLen) { continue; }
+            uint64_t code{0};
+            uint32_t j = 0;
+            for (; j < kPrefixLen and nucCode(seq[j]) >= 0; ++j) {
+                code = (code << 2) | nucCode(seq[j]);
+            }
+            if (j == kPrefixLen) { prefixes[code].push_back(i); }
+        }
+
+        std::unique_ptr<std::atomic<int64_t>[]> container(new std::atomic<int64_t>[n]);
+        for (size_t i = 0; i < n; ++i) { container[i] = -1; }
+        const uint64_t mask = (uint64_t(1) << (2 * kPrefixLen)) - 1;
+
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, n),
+            [&](const tbb::blocked_range<size_t>& range) -> void {
+                for (auto s = range.begin(); s != range.end(); ++s) {
+                    if (representative[s] != -1) { continue; }
+                    auto& seq = records[s].seq;
+                    uint64_t code{0};
+                    uint32_t valid{0};
+                    for (size_t p = 0; p < seq.size(); ++p) {
+                        int c = nucCode(seq[p]);
+                        if (c < 0) { valid = 0; code = 0; continue; }
+                        code = ((code << 2) | c) & mask;
+                        if (++valid < kPrefixLen) { continue; }
+                        auto it = prefixes.find(code);
+                        if (it == prefixes.end()) { continue; }
+                        size_t start = p + 1 - kPrefixLen;
+                        for (auto t : it->second) {
+                            auto& tseq = records[t].seq;
+                            if (tseq.size() >= seq.size() or start + tseq.size() > seq.size() or
+                                seq.compare(start, tseq.size(), tseq) != 0) {
+                                continue;
+                            }
+                            // keep the first container, so that the result
+                            // doesn't depend on the scheduling
+                            int64_t cur = container[t].load();
+                            while ((cur == -1 or static_cast<int64_t>(s) < cur) and
+                                   !container[t].compare_exchange_weak(cur, s)) {}
+                        }
+                    }
+                }
+            });
+
+        // Containers are strictly longer, so following them terminates
+        for (size_t t = 0; t < n; ++t) {
+            if (container[t] == -1) { continue; }
+            int64_t c = container[t];
+            while (container[c] != -1) { c = container[c]; }
+            representative[t] = c;
+            contained[t] = true;
+        }
+        // The copies of a contained sequence go to its container too
+        for (size_t i = 0; i < n; ++i) {
+            int64_t r = representative[i];
+            if (r != -1 and !contained[i] and contained[r]) {
+                representative[i] = representative[r];
+                contained[i] = true;
+            }
+        }
+    }
+
+    std::ofstream out(outFasta.string());
+    size_t numRemoved{0};
+    for (size_t i = 0; i < n; ++i) {
+        if (representative[i] == -1) {
+            out << '>' << records[i].header << '\n' << records[i].seq << '\n';
+        } else {
+            auto& rep = records[representative[i]];
+            members_[rep.name].push_back({records[i].name,
+                                          static_cast<uint32_t>(records[i].seq.size()),
+                                          contained[i]});
+            ++numRemoved;
+        }
+    }
+    return numRemoved;
+}
+
+size_t TranscriptDuplicates::numRemoved() const {
+    size_t numRemoved{0};
+    for (auto& kv : members_) { numRemoved += kv.second.size(); }
+    return numRemoved;
+}
+
+const std::vector<TranscriptDuplicates::Member>*
+TranscriptDuplicates::membersOf(const std::string& representative) const {
+    auto it = members_.find(representative);
+    return (it == members_.end()) ? nullptr : &(it->second);
+}
+
+void TranscriptDuplicates::save(const boost::filesystem::path& fname) const {
+    std::ofstream out(fname.string());
+    for (auto& kv : members_) {
+        for (auto& m : kv.second) {
+            out << kv.first << '\t' << m.name << '\t' << m.length << '\t'
+                << (m.contained ? "contained" : "identical") << '\n';
+        }
+    }
+}
+
+bool TranscriptDuplicates::load(const boost::filesystem::path& fname) {
+    members_.clear();
+    std::ifstream in(fname.string());
+    if (!in.good()) { return false; }
+    std::string rep, kind;
+    Member m;
+    while (in >> rep >> m.name >> m.length >> kind) {
+        m.contained = (kind == "contained");
+        members_[rep].push_back(m);
+    }
+    return true;
+}
+
+bool TranscriptDuplicates::expandQuantFile(const boost::filesystem::path& fname) const {
+    std::vector<std::string> comments;
+    std::vector<std::vector<std::string>> rows;
+    std::unordered_map<std::string, size_t> rowOf;
+    {
+        std::ifstream in(fname.string());
+        if (!in.good()) { return false; }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty()) { continue; }
+            if (line[0] == '#') { comments.push_back(line); continue; }
+            std::vector<std::string> fields;
+            std::stringstream ss(line);
+            std::string field;
+            while (std::getline(ss, field, '\t')) { fields.push_back(field); }
+            rowOf[fields[0]] = rows.size();
+            rows.push_back(fields);
+        }
+    }
+
+    size_t numRows = rows.size();
+    for (size_t r = 0; r < numRows; ++r) {
+        auto* members = membersOf(rows[r][0]);
+        if (members == nullptr) { continue; }
+        size_t numCopies = 1 + std::count_if(members->begin(), members->end(),
+                                             [](const Member& m) -> bool { return !m.contained; });
+        for (size_t c = 2; c < rows[r].size(); ++c) {
+            rows[r][c] = fmt::format("{}", std::stod(rows[r][c]) / numCopies);
+        }
+        for (auto& m : *members) {
+            std::vector<std::string> fields(rows[r]);
+            fields[0] = m.name;
+            fields[1] = fmt::format("{}", m.length);
+            if (m.contained) {
+                std::fill(fields.begin() + 2, fields.end(), "0");
+            }
+            // The member may already be listed, e.g. from a transcript to gene map
+            auto it = rowOf.find(m.name);
+            if (it != rowOf.end()) {
+                rows[it->second] = fields;
+            } else {
+                rowOf[m.name] = rows.size();
+                rows.push_back(fields);
+            }
+        }
+    }
+
+    std::ofstream out(fname.string());
+    for (auto& line : comments) { out << line << '\n'; }
+    for (auto& fields : rows) {
+        for (size_t c = 0; c < fields.size(); ++c) {
+            out << (c ? "\t" : "") << fields[c];
+        }
+        out << '\n';
+    }
+    return true;
+}
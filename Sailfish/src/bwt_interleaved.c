@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bwt_interleaved.h"
+#include "kvec.h"
+#include "utils.h"
+
+#ifdef USE_MALLOC_WRAPPERS
+#  include "malloc_wrap.h"
+#endif
+
+#define bwtil_block(b, k) ((b)->blocks + ((k) >> BWTIL_BLOCK_SHIFT) * BWTIL_BLOCK_WORDS)
+// the word holding base k, after the 4 counts
+#define bwtil_word(b, k) (bwtil_block(b, k)[4 + (((k) & (BWTIL_BLOCK_BASES - 1)) >> 5)])
+#define bwtil_B0(b, k) (bwtil_word(b, k) >> ((~(k) & 31) << 1) & 3)
+
+static uint64_t *bwtil_alloc_blocks(bwtint_t n_blocks)
+{
+	void *p;
+	if (posix_memalign(&p, 64, n_blocks * BWTIL_BLOCK_WORDS * sizeof(uint64_t)) != 0)
+		err_fatal(__func__, "failed to allocate %lld blocks", (long long)n_blocks);
+	memset(p, 0, n_blocks * BWTIL_BLOCK_WORDS * sizeof(uint64_t));
+	return (uint64_t*)p;
+}
+
+bwtil_t *bwtil_from_bwt(const bwt_t *bwt)
+{
+	bwtil_t *b;
+	bwtint_t i, cnt[4];
+	b = (bwtil_t*)calloc(1, sizeof(bwtil_t));
+	b->primary = bwt->primary;
+	b->seq_len = bwt->seq_len;
+	memcpy(b->L2, bwt->L2, 5 * sizeof(bwtint_t));
+	b->n_blocks = (bwt->seq_len >> BWTIL_BLOCK_SHIFT) + 1;
+	b->blocks = bwtil_alloc_blocks(b->n_blocks);
+	cnt[0] = cnt[1] = cnt[2] = cnt[3] = 0;
+	for (i = 0; i < bwt->seq_len; ++i) {
+		int c = bwt_B0(bwt, i);
+		if ((i & (BWTIL_BLOCK_BASES - 1)) == 0)
+			memcpy(bwtil_block(b, i), cnt, 4 * sizeof(bwtint_t));
+		bwtil_word(b, i) |= (uint64_t)c << ((~i & 31) << 1);
+		++cnt[c];
+	}
+	if ((bwt->seq_len & (BWTIL_BLOCK_BASES - 1)) == 0) // the last block is empty
+		memcpy(bwtil_block(b, bwt->seq_len), cnt, 4 * sizeof(bwtint_t));
+	return b;
+}
+
+void bwtil_dump(const char *fn, const bwtil_t *b)
+{
+	FILE *fp;
+	fp = xopen(fn, "wb");
+	err_fwrite(&b->primary, sizeof(bwtint_t), 1, fp);
+	err_fwrite(b->L2 + 1, sizeof(bwtint_t), 4, fp);
+	err_fwrite(&b->seq_len, sizeof(bwtint_t), 1, fp);
+	err_fwrite(&b->n_blocks, sizeof(bwtint_t), 1, fp);
+	err_fwrite(b->blocks, sizeof(uint64_t), b->n_blocks * BWTIL_BLOCK_WORDS, fp);
+	err_fflush(fp);
+	err_fclose(fp);
+}
+
+bwtil_t *bwtil_restore(const char *fn)
+{
+	bwtil_t *b;
+	FILE *fp;
+	b = (bwtil_t*)calloc(1, sizeof(bwtil_t));
+	fp = xopen(fn, "rb");
+	err_fread_noeof(&b->primary, sizeof(bwtint_t), 1, fp);
+	err_fread_noeof(b->L2 + 1, sizeof(bwtint_t), 4, fp);
+	err_fread_noeof(&b->seq_len, sizeof(bwtint_t), 1, fp);
+	err_fread_noeof(&b->n_blocks, sizeof(bwtint_t), 1, fp);
+	b->blocks = bwtil_alloc_blocks(b->n_blocks);
+	err_fread_noeof(b->blocks, sizeof(uint64_t), b->n_blocks * BWTIL_BLOCK_WORDS, fp);
+	err_fclose(fp);
+	return b;
+}
+
+void bwtil_destroy(bwtil_t *b)
+{
+	if (b == 0) return;
+	free(b->blocks);
+	free(b);
+}
+
+// number of bases c in the 32 bases of y
+static inline int __occ_aux(uint64_t y, int c)
+{
+	y = ((c&2)? y : ~y) >> 1 & ((c&1)? y : ~y) & 0x5555555555555555ull;
+	return __builtin_popcountll(y);
+}
+
+bwtint_t bwtil_occ(const bwtil_t *b, bwtint_t k, ubyte_t c)
+{
+	const uint64_t *p;
+	bwtint_t n;
+	int i, w;
+
+	if (k == b->seq_len) return b->L2[c+1] - b->L2[c];
+	if (k == (bwtint_t)(-1)) return 0;
+	k -= (k >= b->primary); // because $ is not in bwt
+
+	p = bwtil_block(b, k);
+	n = p[c];
+	w = (k & (BWTIL_BLOCK_BASES - 1)) >> 5;
+	for (i = 0; i < w; ++i) n += __occ_aux(p[4+i], c);
+	// the bases after k in its word are masked to 0, i.e. A
+	n += __occ_aux(p[4+w] & ~((1ull<<((~k&31)<<1)) - 1), c);
+	if (c == 0) n -= ~k&31;
+	return n;
+}
+
+void bwtil_2occ(const bwtil_t *b, bwtint_t k, bwtint_t l, ubyte_t c, bwtint_t *ok, bwtint_t *ol)
+{
+	*ok = bwtil_occ(b, k, c);
+	*ol = bwtil_occ(b, l, c);
+}
+
+void bwtil_occ4(const bwtil_t *b, bwtint_t k, bwtint_t cnt[4])
+{
+	const uint64_t *p;
+	uint64_t y;
+	int i, w;
+
+	if (k == (bwtint_t)(-1)) {
+		memset(cnt, 0, 4 * sizeof(bwtint_t));
+		return;
+	}
+	k -= (k >= b->primary); // because $ is not in bwt
+
+	p = bwtil_block(b, k);
+	memcpy(cnt, p, 4 * sizeof(bwtint_t));
+	w = (k & (BWTIL_BLOCK_BASES - 1)) >> 5;
+	for (i = 0; i <= w; ++i) {
+		y = (i < w)? p[4+i] : p[4+i] & ~((1ull<<((~k&31)<<1)) - 1);
+		cnt[0] += __occ_aux(y, 0);
+		cnt[1] += __occ_aux(y, 1);
+		cnt[2] += __occ_aux(y, 2);
+		cnt[3] += __occ_aux(y, 3);
+	}
+	cnt[0] -= ~k&31;
+}
+
+void bwtil_2occ4(const bwtil_t *b, bwtint_t k, bwtint_t l, bwtint_t cntk[4], bwtint_t cntl[4])
+{
+	// when k and l are in the same block, the second call hits the same cache line
+	bwtil_occ4(b, k, cntk);
+	bwtil_occ4(b, l, cntl);
+}
+
+void bwtil_extend(const bwtil_t *b, const bwtintv_t *ik, bwtintv_t ok[4], int is_back)
+{
+	bwtint_t tk[4], tl[4];
+	int i;
+	bwtil_2occ4(b, ik->x[!is_back] - 1, ik->x[!is_back] - 1 + ik->x[2], tk, tl);
+	for (i = 0; i != 4; ++i) {
+		ok[i].x[!is_back] = b->L2[i] + 1 + tk[i];
+		ok[i].x[2] = tl[i] - tk[i];
+	}
+	ok[3].x[is_back] = ik->x[is_back] + (ik->x[!is_back] <= b->primary && ik->x[!is_back] + ik->x[2] - 1 >= b->primary);
+	ok[2].x[is_back] = ok[3].x[is_back] + ok[3].x[2];
+	ok[1].x[is_back] = ok[2].x[is_back] + ok[2].x[2];
+	ok[0].x[is_back] = ok[1].x[is_back] + ok[1].x[2];
+}
+
+static void bwtil_reverse_intvs(bwtintv_v *p)
+{
+	if (p->n > 1) {
+		int j;
+		for (j = 0; j < p->n>>1; ++j) {
+			bwtintv_t tmp = p->a[p->n - 1 - j];
+			p->a[p->n - 1 - j] = p->a[j];
+			p->a[j] = tmp;
+		}
+	}
+}
+
+int bwtil_smem1a(const bwtil_t *b, int len, const uint8_t *q, int x, int min_intv, uint64_t max_intv, bwtintv_v *mem, bwtintv_v *tmpvec[2])
+{
+	int i, j, c, ret;
+	bwtintv_t ik, ok[4];
+	bwtintv_v a[2], *prev, *curr, *swap;
+
+	mem->n = 0;
+	if (q[x] > 3) return x + 1;
+	if (min_intv < 1) min_intv = 1; // the interval size should be at least 1
+	kv_init(a[0]); kv_init(a[1]);
+	prev = tmpvec && tmpvec[0]? tmpvec[0] : &a[0]; // use the temporary vector if provided
+	curr = tmpvec && tmpvec[1]? tmpvec[1] : &a[1];
+	bwt_set_intv(b, q[x], ik); // the initial interval of a single base
+	ik.info = x + 1;
+
+	for (i = x + 1, curr->n = 0; i < len; ++i) { // forward search
+		if (ik.x[2] < max_intv) { // an interval small enough
+			kv_push(bwtintv_t, *curr, ik);
+			break;
+		} else if (q[i] < 4) { // an A/C/G/T base
+			c = 3 - q[i]; // complement of q[i]
+			bwtil_extend(b, &ik, ok, 0);
+			if (ok[c].x[2] != ik.x[2]) { // change of the interval size
+				kv_push(bwtintv_t, *curr, ik);
+				if (ok[c].x[2] < min_intv) break; // the interval size is too small to be extended further
+			}
+			ik = ok[c]; ik.info = i + 1;
+		} else { // an ambiguous base
+			kv_push(bwtintv_t, *curr, ik);
+			break; // always terminate extension at an ambiguous base; in this case, i<len always stands
+		}
+	}
+	if (i == len) kv_push(bwtintv_t, *curr, ik); // push the last interval if we reach the end
+	bwtil_reverse_intvs(curr); // s.t. smaller intervals (i.e. longer matches) visited first
+	ret = curr->a[0].info; // this will be the returned value
+	swap = curr; curr = prev; prev = swap;
+
+	for (i = x - 1; i >= -1; --i) { // backward search for MEMs
+		c = i < 0? -1 : q[i] < 4? q[i] : -1; // c==-1 if i<0 or q[i] is an ambiguous base
+		for (j = 0, curr->n = 0; j < prev->n; ++j) {
+			bwtintv_t *p = &prev->a[j];
+			if (c >= 0 && ik.x[2] >= max_intv) bwtil_extend(b, p, ok, 1);
+			if (c < 0 || ik.x[2] < max_intv || ok[c].x[2] < min_intv) { // keep the hit if reaching the beginning or an ambiguous base or the intv is small enough
+				if (curr->n == 0) { // test curr->n>0 to make sure there are no longer matches
+					if (mem->n == 0 || i + 1 < mem->a[mem->n-1].info>>32) { // skip contained matches
+						ik = *p; ik.info |= (uint64_t)(i + 1)<<32;
+						kv_push(bwtintv_t, *mem, ik);
+					}
+				} // otherwise the match is contained in another longer match
+			} else if (curr->n == 0 || ok[c].x[2] != curr->a[curr->n-1].x[2]) {
+				ok[c].info = p->info;
+				kv_push(bwtintv_t, *curr, ok[c]);
+			}
+		}
+		if (curr->n == 0) break;
+		swap = curr; curr = prev; prev = swap;
+	}
+	bwtil_reverse_intvs(mem); // s.t. sorted by the start coordinate
+
+	if (tmpvec == 0 || tmpvec[0] == 0) free(a[0].a);
+	if (tmpvec == 0 || tmpvec[1] == 0) free(a[1].a);
+	return ret;
+}
+
+int bwtil_smem1(const bwtil_t *b, int len, const uint8_t *q, int x, int min_intv, bwtintv_v *mem, bwtintv_v *tmpvec[2])
+{
+	return bwtil_smem1a(b, len, q, x, min_intv, 0, mem, tmpvec);
+}
+
+int bwtil_seed_strategy1(const bwtil_t *b, int len, const uint8_t *q, int x, int min_len, int max_intv, bwtintv_t *mem)
+{
+	int i, c;
+	bwtintv_t ik, ok[4];
+
+	memset(mem, 0, sizeof(bwtintv_t));
+	if (q[x] > 3) return x + 1;
+	bwt_set_intv(b, q[x], ik); // the initial interval of a single base
+	for (i = x + 1; i < len; ++i) { // forward search
+		if (q[i] < 4) { // an A/C/G/T base
+			c = 3 - q[i]; // complement of q[i]
+			bwtil_extend(b, &ik, ok, 0);
+			if (ok[c].x[2] < max_intv && i - x >= min_len) {
+				*mem = ok[c];
+				mem->info = (uint64_t)x<<32 | (i + 1);
+				return i + 1;
+			}
+			ik = ok[c];
+		} else return i + 1;
+	}
+	return len;
+}
+
+static inline bwtint_t bwtil_invPsi(const bwtil_t *b, bwtint_t k)
+{
+	bwtint_t j;
+	ubyte_t c;
+	if (k == b->primary) return 0;
+	j = k - (k > b->primary); // because $ is not in bwt
+	c = bwtil_B0(b, j);
+	return b->L2[c] + bwtil_occ(b, k, c);
+}
+
+bwtint_t bwtil_sa(const bwtil_t *b, const bwt_t *bwt, bwtint_t k)
+{
+	bwtint_t sa = 0, mask = bwt->sa_intv - 1;
+	while (k & mask) {
+		++sa;
+		k = bwtil_invPsi(b, k);
+	}
+	return sa + bwt->sa[k/bwt->sa_intv];
+}
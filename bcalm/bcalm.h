@@ -0,0 +1,55 @@
+#ifndef BCALM
+#define BCALM
+
+/*
+ * Library interface: compaction of a set of k-mers without going through files for the input and the output
+ */
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "input.h"
+#include "ograph.h"
+#include "unitigindex.h"
+#include "profile.h"
+
+using namespace std;
+
+// number of k-mers read to estimate the m-mer frequencies
+#define DEFAULT_SAMPLE_SIZE 1000000
+
+// parameters of a compaction
+struct bcalmoptions
+{
+	int k;
+	int minimizersize;	// even, at most 10; 4^(minimizersize/2) files are open at the same time
+	int nb_threads;	// used to count the m-mers of the sample
+	uint64_t sample_size;
+	vector<string> scratchdirs;	// temporary buckets are striped over these directories, "." when empty
+	cleaning clean;
+	bool keeplargestbucket;	// debugging: copy the largest bucket to largest_bucket.dot
+	string indexfile;	// when set, an index of the positions of the k-mers in the unitigs is written there
+	string profilefile;	// when set, the time, I/O and memory of each phase and the bucket sizes are written there as JSON
+
+	bcalmoptions(int ki = 0) : k(ki), minimizersize(10), nb_threads(1), sample_size(DEFAULT_SAMPLE_SIZE), keeplargestbucket(false) {}
+};
+
+// called once for each unitig, in no particular order; the rank of the call is the unitig id used by the index
+typedef function<void(const string&)> unitigcallback;
+
+// Compact the k-mers of input, false if the scratch directories cannot be created or k is too low;
+// without cleaning each unitig is given to output as soon as its bucket is compacted, with cleaning at the end
+bool compactkmers(kmersource& input, const bcalmoptions& options, const unitigcallback& output);
+
+// Compact the k-mers of a file, one unitig per line in the output file
+bool compactfile(const string& namein, const string& nameout, const bcalmoptions& options);
+
+// Merge compacted graphs (files with one unitig per line, as written by compactfile) and the k-mers of newkmers when not NULL;
+// identical unitigs are kept once, only the unitigs that can be joined or that share k-mers are compacted again.
+// The graphs are not cleaned again
+bool mergegraphs(const vector<string>& graphs, kmersource* newkmers, const bcalmoptions& options, const unitigcallback& output);
+
+// Merge compacted graph files and the k-mers of a file, if newkmers is not empty, into one output file
+bool mergefiles(const vector<string>& graphs, const string& newkmers, const string& nameout, const bcalmoptions& options);
+
+#endif
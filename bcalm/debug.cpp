@@ -6,7 +6,11 @@
 #include <ctime>
 #include <unordered_map>
 #include <algorithm>
+#include <cctype>
+#include <sys/resource.h>
+#include <thread>
 #include "debug.h"
+#include "verify.h"
 #include "ograph.h"
 
 
@@ -32,19 +36,19 @@ int detectk(const string& input){
 	if(in){
 		getline(in,line);
 	}
-	return(line.size()-1);
+	// the k-mer is followed by ';' or by its abundance
+	uint64_t k(0);
+	while(k<line.size() && isalpha(line[k]))
+		k++;
+	return(k);
 }
 
 bool testulimit(int l)
 {
-	system("ulimit -n > .ulimit");
-	ifstream in(".ulimit");
-	string line;
-	getline(in,line);
-	int n;
-	n=stoi(line);
-	remove(".ulimit");
-	return (n>=l);
+	struct rlimit limit;
+	if(getrlimit(RLIMIT_NOFILE,&limit)!=0)
+		return false;
+	return (limit.rlim_cur==RLIM_INFINITY || limit.rlim_cur>=(rlim_t)l);
 }
 
 
@@ -108,69 +112,11 @@ void createinputlm(int64_t lr,int k,const char *name){
 }
 
 
+//Check that the unitigs of name2 are the compaction of the nodes of name1, see verifygraph
 bool checkfile(string name1, string name2,int k){
-	int fail(0),lowfail(0);
-	ifstream t1(name1), t2(name2);
-	string line,kmer;
-	unordered_map<string,bool> s1,s2,e1,e2;
-	while(!t1.eof()){
-		getline(t1,line);
-		if(line.size()>2){
-			string node=line.substr(0,line.size()-1);
-			node=min(node,reversecompletment(node));
-			s1.insert(make_pair(node,false));
-		}
-	}
-	while(!t2.eof()){
-		getline(t2,line);
-		if(line.size()>2){
-			string node=line.substr(0,line.size()-1);
-			node=min(node,reversecompletment(node));
-			s2.insert(make_pair(node,false));
-		}
-	}
-	for(auto it=s1.begin(); it!=s1.end(); it++){
-			string str=it->first;
-			auto smt=s2.find(str);
-			if(smt==s2.end()){
-				lowfail++;
-				for(int i(0);i+k<=(int)str.size();i++){
-					kmer=str.substr(i,k);
-					kmer=min(kmer,reversecompletment(kmer));
-					e2.insert(make_pair(kmer,false));
-				}
-			}
-			else
-				smt->second=true;
-	}
-	for(auto it=s2.begin(); it!=s2.end(); it++)
-		if(!it->second)
-		{
-			string str=it->first;
-			lowfail++;
-			for(int i(0);i+k<=(int)str.size();i++){
-				kmer=str.substr(i,k);
-				kmer=min(kmer,reversecompletment(kmer));
-				e1.insert(make_pair(kmer,false));
-			}
-		}
-	for(auto it=e2.begin(); it!=e2.end(); it++){
-		string str=it->first;
-		auto smt=e1.find(str);
-		if(smt==s1.end()){
-			fail++;
-			cout<<str<<endl;
-		}
-		else
-			smt->second=true;
-	}
-	for(auto it=e1.begin(); it!=e1.end(); it++){
-		if(!it->second){
-			fail++;
-			cout<<it->first<<endl;
-		}
-	}
-	cout<<"Lowrrors:"<<lowfail<<endl;
-	cout<<"Errors:"<<fail<<endl;
-	return(lowfail==0);
+	verifyreport report;
+	if(!verifygraph(name1,name2,k,thread::hardware_concurrency(),vector<string>(),&report))
+		return false;
+	report.print();
+	return report.ok();
 }
@@ -1,6 +1,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 #include "input.h"
 #include "ograph.h"
@@ -13,53 +14,148 @@ using namespace std;
 
 
 void InputDot::init_input(string namefile, const int k){
+	name=namefile;
 	in.open(namefile);
 	in.seekg(0,ios_base::end);
 	size = in.tellg();
-    buffer_size = 10*(k+2);
-    nb_buffers = size/buffer_size;
+    buffer_size = 1000*(k+2);
 	in.seekg(0,ios::beg);
     index = 0;
-    indexb=0;
-    if(nb_buffers!=0)
-    {
-		buffer=readn(&in,buffer_size);
-	}
-	else
-	{
-		buffer=readn(&in,size-nb_buffers*buffer_size);
-	}
+    buffer = "";
+    abundance = 1;
+}
+
+// split a line in k-mer and abundance, false for lines without a k-mer
+bool InputDot::parse(const string& line, const int k, string *km, uint64_t *ab){
+	if(line.size()<(uint64_t)k)
+		return false;
+	*km=line.substr(0,k);
+	*ab=1;
+	uint64_t i(k);
+	while(i<line.size() && (line[i]==' ' || line[i]=='\t'))
+		i++;
+	if(i<line.size() && line[i]>='0' && line[i]<='9')
+		*ab=stoull(line.substr(i));
+	return true;
 }
 
 string InputDot::next_input(const int k){
 	kmer="";
-	if(index>=buffer.size())
+	while(true)
 	{
-		index=0;
-		indexb++;
-		if(indexb<nb_buffers)
-		{
-			buffer=readn(&in,buffer_size);
-		}
-		else
+		uint64_t end(buffer.find('\n',index));
+		if(end==string::npos)
 		{
-			if(indexb==nb_buffers)
+			// keep the incomplete line and read the next chunk
+			string chunk(buffer_size,'\0');
+			in.read(&chunk[0],buffer_size);
+			chunk.resize(in.gcount());
+			buffer=buffer.substr(index)+chunk;
+			index=0;
+			end=buffer.find('\n');
+			if(end==string::npos)
 			{
-				buffer=readn(&in,size-nb_buffers*buffer_size);
-			}
-			else{
-				buffer="";
+				if(!chunk.empty())
+					continue;
+				end=buffer.size();
 			}
 		}
+		if(index>=buffer.size())
+			return kmer;
+		string line(buffer.substr(index,end-index));
+		index=end+1;
+		if(parse(line,k,&kmer,&abundance))
+			return kmer;
 	}
+}
 
-	if(buffer.size()>=index+k)
-	{
-		kmer=buffer.substr(index,k);
-		index += k+2;
+// read about n k-mers spread over the whole file, as a few contiguous blocks to limit seeks
+// the whole file is returned when it holds less than n k-mers
+vector<string> InputDot::sample(uint64_t n, const int k){
+	vector<string> res;
+	ifstream file(name);
+	uint64_t nb_blocks(256),block_bytes,ab;
+	string km;
+	if(!file || n==0)
+		return res;
+	if(size<=n*(k+2)){
+		nb_blocks=1;
+		block_bytes=size;
 	}
-	return kmer;
-	
+	else{
+		nb_blocks=min(nb_blocks,n);
+		block_bytes=((n+nb_blocks-1)/nb_blocks)*(k+2);
+	}
+	for(uint64_t b(0);b<nb_blocks && res.size()<n;b++){
+		uint64_t position(b*(size/nb_blocks));
+		file.seekg(position,ios::beg);
+		string block(min(block_bytes,size-position),'\0');
+		file.read(&block[0],block.size());
+		// skip the line cut by the seek, and the one cut at the end of the block
+		uint64_t lp(0);
+		if(position!=0){
+			lp=block.find('\n');
+			if(lp==string::npos)
+				continue;
+			lp++;
+		}
+		for(uint64_t i(block.find('\n',lp));i!=string::npos && res.size()<n;lp=i+1,i=block.find('\n',lp))
+			if(parse(block.substr(lp,i-lp),k,&km,&ab))
+				res.push_back(km);
+	}
+	return res;
 }
 
 // l'idee sera d'avoir des classes ayant la meme intreface que InputDot pour gerer d'autres format d'entree
+
+
+string InputKmers::next_input(const int k){
+	if(index>=kmers.size())
+		return "";
+	abundance=(abundances!=NULL) ? (*abundances)[index] : 1;
+	return kmers[index++];
+}
+
+// evenly spaced k-mers
+vector<string> InputKmers::sample(uint64_t n, const int k){
+	vector<string> res;
+	if(n==0 || kmers.empty())
+		return res;
+	uint64_t step(max((uint64_t)1,(uint64_t)kmers.size()/n));
+	for(uint64_t i(0);i<kmers.size() && res.size()<n;i+=step)
+		res.push_back(kmers[i]);
+	return res;
+}
+
+
+string InputIterator::next_input(const int k){
+	string kmer;
+	if(index<head.size()){
+		kmer=head[index].first;
+		abundance=head[index].second;
+		index++;
+		if(index==head.size()){
+			head.clear();
+			head.shrink_to_fit();
+			index=0;
+		}
+		return kmer;
+	}
+	abundance=1;
+	if(!generator(kmer,abundance))
+		return "";
+	return kmer;
+}
+
+// the first n k-mers, the input cannot be read twice
+vector<string> InputIterator::sample(uint64_t n, const int k){
+	vector<string> res;
+	string kmer;
+	uint64_t ab(1);
+	while(head.size()<n && generator(kmer,ab)){
+		head.push_back(make_pair(kmer,ab));
+		res.push_back(kmer);
+		ab=1;
+	}
+	return res;
+}
@@ -2,27 +2,84 @@
 #define INPUT
 
 #include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <functional>
 
 
 
 using namespace std;
 
-void init_input(string namefile, const int k);
+// a source of distinct k-mers, read once in order after an optional sample
+class kmersource{
 
-string next_input(const int k);
+public:
+// abundance of the last k-mer returned by next_input, 1 when the input has none
+uint64_t abundance;
+
+virtual ~kmersource() {}
+
+// next k-mer, "" at the end
+virtual string next_input(const int k) = 0;
+
+// about n k-mers representative of the whole input, taken before the first next_input
+virtual vector<string> sample(uint64_t n, const int k) = 0;
+
+};
 
 
-class InputDot{
+// one k-mer per line, "kmer;" or "kmer abundance;"
+class InputDot : public kmersource{
 	
-uint64_t size, buffer_size, nb_buffers, index,indexb;
-string buffer,kmer;
+uint64_t size, buffer_size, index;
+string buffer,kmer,name;
 ifstream in;
 
+bool parse(const string& line, const int k, string *km, uint64_t *ab);
+
 public:
 void init_input(string namefile, const int k);
 
 string next_input(const int k);
 
+vector<string> sample(uint64_t n, const int k);
+
+};
+
+
+// k-mers held in memory by the caller, abundances are optional
+class InputKmers : public kmersource{
+
+const vector<string>& kmers;
+const vector<uint64_t> *abundances;
+uint64_t index;
+
+public:
+InputKmers(const vector<string>& km, const vector<uint64_t> *ab = NULL) : kmers(km), abundances(ab), index(0) { abundance = 1; }
+
+string next_input(const int k);
+
+vector<string> sample(uint64_t n, const int k);
+
+};
+
+
+// k-mers produced by a function, which returns false at the end;
+// the sample is the beginning of the input, kept in memory until it is read again
+class InputIterator : public kmersource{
+
+function<bool(string&, uint64_t&)> generator;
+vector<pair<string,uint64_t>> head;
+uint64_t index;
+
+public:
+InputIterator(const function<bool(string&, uint64_t&)>& g) : generator(g), index(0) { abundance = 1; }
+
+string next_input(const int k);
+
+vector<string> sample(uint64_t n, const int k);
+
 };
 
 #endif
@@ -5,6 +5,7 @@
 #include <iterator>
 #include <ctime>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -12,9 +13,11 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <thread>
 
 #include "lm.h"
 #include "input.h"
+#include "workspace.h"
 
 /*
  * Constuct the compacted de bruijn graph from list of distinct kmers
@@ -25,19 +28,42 @@ using namespace std;
 // 10 chars to store the integer hash of a minimizer
 #define MINIMIZER_STR_SIZE 10
 
-// keep largest bucket seen, disregarding small ones
-unsigned long nb_elts_in_largest_bucket = 10000;
+// superbuckets larger than this many times the mean are reported
+#define MAX_BUCKET_SKEW 20
 
+// k-mers distributed by each thread at a time
+#define DISTRIBUTION_BATCH 16384
+
+// abundance, dead ends and minimizers stored after each node in the buckets
+#define ABUNDANCE_STR_SIZE 10
+#define RECORD_SUFFIX_SIZE (ABUNDANCE_STR_SIZE + 1 + MINIMIZER_STR_SIZE * 2)
+
+// -1, an end that must not be compacted, is written "-000000001"
 string minimizer2string(int input_int)
 {
     long long i = input_int;
-    string str = to_string(i);
-    assert(str.size() <= MINIMIZER_STR_SIZE);
+    string str = to_string(i < 0 ? -i : i);
+    assert(str.size() < MINIMIZER_STR_SIZE);
     if(MINIMIZER_STR_SIZE > str.size())
         str.insert(0, MINIMIZER_STR_SIZE- str.size(), '0');
+    if(i < 0)
+        str[0] = '-';
     return str;
 }
 
+// the end flags are written as one hexadecimal digit, ';' would be taken for the end of the record
+string recordsuffix(uint64_t abundance, unsigned char endflags, int leftmin, int rightmin)
+{
+    string str = to_string((unsigned long long)min(abundance, (uint64_t)9999999999ULL));
+    str.insert(0, ABUNDANCE_STR_SIZE - str.size(), '0');
+    return str + "0123456789abcdef"[endflags & 15] + minimizer2string(leftmin) + minimizer2string(rightmin);
+}
+
+unsigned char string2endflags(char c)
+{
+    return (c >= 'a') ? c - 'a' + 10 : c - '0';
+}
+
 bool nextchar(char * c){
 	switch(*c){
 		case 'a':
@@ -60,57 +86,128 @@ bool nextchar(char * c){
 }
 
 
-// reads k-mers and Put kmers in superbuckets
-// (other behavior: just count m-mers)
-void sortentry(string namefile, const int k, const int m, bool create_buckets, bool m_mer_count){
-	int numbersuperbucket(pow(4,m));
-	ofstream out[2100];
-    ofstream checkpoint;
-    InputDot ind;
-    if (create_buckets)
-    {
-    	for(long long i(0);i<numbersuperbucket;i++)
-    		out[i].open(".bcalmtmp/z"+to_string(i),ofstream::app);
-    }
-
-    ind.init_input(namefile,k);
-
-    while (1)
-    {
-        string kmer = ind.next_input(k);
-
-        if (kmer == "")
-            break;
-
-        if (m_mer_count)
-        {
-            count_m_mers(kmer, 2*m, k);
-            continue;
-        }
-
-        int middlemin, leftmostmin, rightmostmin, min;
-        
-        middlemin=minimiserrc(kmer.substr(1,k-2),2*m);
-        leftmostmin=minimiserrc(kmer.substr(0,2*m),2*m);
-        rightmostmin=minimiserrc(kmer.substr(kmer.size()-2*m,2*m),2*m);
+// minimizers of the (k-1)-prefix and of the (k-1)-suffix of a k-mer
+void endminimizers(const string& kmer, const int k, const int m, const vector<uint32_t>& order, int *leftmin, int *rightmin){
+	int middlemin, leftmostmin, rightmostmin;
 
-        int leftmin = (leftmostmin < middlemin) ? leftmostmin : middlemin;
+	middlemin=minimiserrc(kmer.substr(1,k-2),2*m,order);
+	leftmostmin=minimiserrc(kmer.substr(0,2*m),2*m,order);
+	rightmostmin=minimiserrc(kmer.substr(kmer.size()-2*m,2*m),2*m,order);
 
-        int rightmin = (rightmostmin < middlemin) ? rightmostmin : middlemin ;
-
-        min = (leftmin < rightmin) ? leftmin : rightmin;
+	*leftmin = (leftmostmin < middlemin) ? leftmostmin : middlemin;
+	*rightmin = (rightmostmin < middlemin) ? rightmostmin : middlemin ;
+}
 
-        uint64_t h = min/numbersuperbucket;
+// print how elements are spread over buckets, warn when the largest bucket is far above the mean
+double bucketbalance(const vector<uint64_t>& sizes, const string& what){
+	uint64_t total(0),largest(0),nonempty(0);
+	for(auto it=sizes.begin();it!=sizes.end();it++){
+		total+=*it;
+		largest=max(largest,*it);
+		if(*it!=0)
+			nonempty++;
+	}
+	if(total==0)
+		return 0;
+	double ratio(largest*(double)sizes.size()/total);
+	cout<<what<<": "<<total<<" k-mers in "<<nonempty<<"/"<<sizes.size()<<" buckets, largest "<<largest<<" ("<<ratio<<"x mean)"<<endl;
+	if(ratio>MAX_BUCKET_SKEW)
+		cerr<<"Warning: "<<what<<" is unbalanced, largest bucket is "<<ratio<<"x the mean"<<endl;
+	return ratio;
+}
 
-        if (create_buckets)
-            out[h]<<kmer<< minimizer2string(leftmin) << minimizer2string(rightmin) <<";";
-        else
-            cout << h << ":" << kmer<< minimizer2string(leftmin) << minimizer2string(rightmin) << ";\n";
+// k-mers read by the main thread, and their records for each superbucket filled by a worker
+struct distributionbatch
+{
+	vector<string> kmers;
+	vector<uint64_t> abundances;
+	vector<string> records;
+	vector<uint64_t> sizes;
+};
+
+static bool readbatch(kmersource& input, const int k, distributionbatch *b){
+	b->kmers.clear();
+	b->abundances.clear();
+	while(b->kmers.size()<DISTRIBUTION_BATCH){
+		string kmer(input.next_input(k));
+		if(kmer=="")
+			break;
+		b->kmers.push_back(kmer);
+		b->abundances.push_back(input.abundance);
+	}
+	return !b->kmers.empty();
+}
 
-        //checkpoint << kmer << minimizer2string(leftmin) << minimizer2string(rightmin) <<";\n";
+static void distributebatch(const compaction& c, distributionbatch *b){
+	int numbersuperbucket(pow(4,c.m));
+	b->records.assign(numbersuperbucket,"");
+	b->sizes.assign(numbersuperbucket,0);
+	for(uint64_t i(0);i<b->kmers.size();i++){
+		int leftmin, rightmin;
+		endminimizers(b->kmers[i],c.options.k,c.m,c.order,&leftmin,&rightmin);
+		uint64_t h(min(leftmin,rightmin)/numbersuperbucket);
+		b->sizes[h]++;
+		b->records[h]+=b->kmers[i]+recordsuffix(b->abundances[i],0,leftmin,rightmin)+";";
+	}
 }
-    if (create_buckets)
-        cout << "initial partitioning done" << endl;
+
+// reads k-mers and Put kmers in superbuckets
+// the minimizer order is first fixed from a sample of the input, then the distribution is done in a single pass
+void sortentry(compaction& c, kmersource& input){
+	const int k(c.options.k), m(c.m);
+	int numbersuperbucket(pow(4,m));
+	ofstream out[2100];
+	for(long long i(0);i<numbersuperbucket;i++)
+		out[i].open(c.ws.path("z"+to_string(i)),ofstream::app);
+
+    // m-mer frequency order, estimated on the sample
+    c.prof.enter(PHASE_COUNTING);
+    vector<string> sample(input.sample(c.options.sample_size,k));
+    c.order=create_hash_function_from_m_mers(count_m_mers_sample(sample,2*m,k,c.options.nb_threads),2*m);
+
+    vector<uint64_t> sizes(numbersuperbucket,0);
+    for(auto it=sample.begin();it!=sample.end();it++){
+        int leftmin, rightmin;
+        endminimizers(*it,k,m,c.order,&leftmin,&rightmin);
+        sizes[min(leftmin,rightmin)/numbersuperbucket]++;
+    }
+    bucketbalance(sizes,"sampled superbuckets");
+    sample.clear();
+    sizes.assign(numbersuperbucket,0);
+    c.prof.leave();
+
+    c.prof.enter(PHASE_DISTRIBUTION);
+
+    // a round is one batch per thread; the next round is read while the workers compute the minimizers,
+    // then the records are appended in the order of the input, as a sequential pass would do
+    int nbthreads(max(1,c.options.nb_threads));
+    vector<distributionbatch> current(nbthreads), next(nbthreads);
+    uint64_t nbbatches(0);
+    while(nbbatches<(uint64_t)nbthreads && readbatch(input,k,&current[nbbatches]))
+        nbbatches++;
+    while(nbbatches>0){
+        vector<thread> workers;
+        for(uint64_t t(0);t<nbbatches;t++)
+            workers.push_back(thread(distributebatch,cref(c),&current[t]));
+        uint64_t nbnext(0);
+        while(nbnext<(uint64_t)nbthreads && readbatch(input,k,&next[nbnext]))
+            nbnext++;
+        for(auto it=workers.begin();it!=workers.end();it++)
+            it->join();
+        for(uint64_t t(0);t<nbbatches;t++)
+            for(int h(0);h<numbersuperbucket;h++)
+                if(current[t].sizes[h]>0){
+                    out[h]<<current[t].records[h];
+                    sizes[h]+=current[t].sizes[h];
+                }
+        swap(current,next);
+        nbbatches=nbnext;
+    }
+	for(long long i(0);i<numbersuperbucket;i++)
+		c.ws.record("z"+to_string(i),out[i].tellp());
+    c.prof.leave();
+    bucketbalance(sizes,"superbuckets");
+    cout << "initial partitioning done" << endl;
 }
 
 
@@ -147,9 +244,14 @@ void copylmrv(ifstream* in,int64_t n,ofstream* out){
 
 
 //Put nodes from superbuckets to buckets
-void createbucket(const string superbucketname,const int m){
+void createbucket(compaction& c, const string superbucketname){
+	const int m(c.m);
 	int superbucketnum(stoi(superbucketname));
-	ifstream in(".bcalmtmp/z"+superbucketname);
+	if(c.ws.size("z"+superbucketname)==0){
+		c.ws.forget("z"+superbucketname);
+		return;
+	}
+	ifstream in(c.ws.path("z"+superbucketname));
 	if(!in.is_open()){
 		cerr<<"Problem with Createbucket"<<endl;
 		return;
@@ -157,15 +259,16 @@ void createbucket(const string superbucketname,const int m){
 	in.seekg(0, ios_base::end);
 	int64_t size(in.tellg()), buffsize(1000000), numberbuffer(size/buffsize),nb(pow(4,m)),suffix;
 	if(size==0){
-		remove((".bcalmtmp/z"+superbucketname).c_str());
+		c.ws.forget("z"+superbucketname);
 		return;
 	}
 	in.seekg(0,ios::beg);
 	ofstream out[5000];
 	for(long long i(0);i<nb;i++){
-		out[i].open(".bcalmtmp/"+to_string(superbucketnum*nb+i),ofstream::app);
+		out[i].open(c.ws.path(to_string(superbucketnum*nb+i)),ofstream::app);
 	}
 	int64_t lastposition(-1),position(0),point(0),mini;
+	uint64_t nbnodes(0);
 	string buffer;
 	vector<string> miniv;
 	in.seekg(0);
@@ -205,19 +308,24 @@ void createbucket(const string superbucketname,const int m){
 				in.seekg(lastposition+1,ios_base::beg);
 				copylm(&in,position-lastposition,&out[suffix]);
 				lastposition=position;
+				nbnodes++;
 			}
         }
 		in.seekg(point);
 	}
-	remove((".bcalmtmp/z"+superbucketname).c_str());
+	for(long long i(0);i<nb;i++)
+		c.ws.record(to_string(superbucketnum*nb+i),out[i].tellp());
+	if(c.prof.enabled)
+		c.prof.superbuckets.add(superbucketnum,size,nbnodes);
+	c.ws.forget("z"+superbucketname);
 }
 
 
 
 //count the length of each node
-vector<int64_t> countbucket(const string& name){
+vector<int64_t> countbucket(compaction& c, const string& name){
 	vector<int64_t> count;
-	ifstream in(".bcalmtmp/"+name);
+	ifstream in(c.ws.path(name));
 	if(in){
 		in.seekg( 0 , ios_base::end );
 		int64_t size(in.tellg()),buffsize(10),numberbuffer(size/buffsize),lastposition(-1),position(0);
@@ -274,8 +382,9 @@ int taglength(const string& node, int64_t j){
 
 
 //Write a node remplacing tags by their sequences
-void writeit(const string& outfile,const string& node, int leftmin, int rightmin, vector<pair<int64_t,int64_t>>* tagsposition,ifstream* tagfile,int64_t j,const string& fout){
-	ofstream out(".bcalmtmp/"+outfile,ios::app);
+void writeit(compaction& c, const string& outfile,const string& node, const string& suffix, vector<pair<int64_t,int64_t>>* tagsposition,ifstream* tagfile,int64_t j){
+	c.prof.enter(PHASE_TAGS);
+	ofstream out(c.ws.path(outfile),ios::app);
 	char rc;
 	if(out){
 		int64_t lastposition(0),tag,tagl,position,length;
@@ -301,76 +410,127 @@ void writeit(const string& outfile,const string& node, int leftmin, int rightmin
 				copylmrv(tagfile,length,&out);
 		}
 		while(!notag(node,lastposition,&j));
-		if(outfile!=fout)
-			out<<node.substr(lastposition)<< minimizer2string(leftmin) << minimizer2string(rightmin) <<";";
-		else
-			out<<node.substr(lastposition) <<";"<<endl;
+		out<<node.substr(lastposition)<< suffix <<";";
+		c.ws.record(outfile,out.tellp());
 	}
 	else
 		cerr<<"writeitbug"<<endl;
+	c.prof.leave();
 }
 
-void put(const string& outfile,const string& node, int leftmin, int rightmin, const string& fout){
-	ofstream out(".bcalmtmp/"+outfile,ios::app);
-	if(outfile==fout)
-	    out<<node <<";" << endl;
-    else
-	    out<<node<< minimizer2string(leftmin) << minimizer2string(rightmin) <<";";
+void put(compaction& c, const string& outfile,const string& node, const string& suffix){
+	ofstream out(c.ws.path(outfile),ios::app);
+	out<<node<< suffix <<";";
+	c.ws.record(outfile,out.tellp());
 }
 
-void putorwrite(const string& outfile, const string& node, int leftmin, int rightmin, vector<pair<int64_t,int64_t>>* tagsposition , ifstream* tagfile,const string& fout){
+void putorwrite(compaction& c, const string& outfile, const string& node, const string& suffix, vector<pair<int64_t,int64_t>>* tagsposition , ifstream* tagfile){
 	int64_t i;
 	if(notag(node,0,&i))
-		put(outfile,node,leftmin, rightmin, fout);
+		put(c,outfile,node,suffix);
 	else
-		writeit(outfile,node, leftmin, rightmin, tagsposition,tagfile,i,fout);
+		writeit(c,outfile,node, suffix, tagsposition,tagfile,i);
+}
+
+//Sequence of a node, with its tags replaced by their sequences
+string expand(compaction& c, const string& node, vector<pair<int64_t,int64_t>>* tagsposition, ifstream* tagfile){
+	int64_t j;
+	if(notag(node,0,&j))
+		return node;
+	c.prof.enter(PHASE_TAGS);
+	string res;
+	int64_t lastposition(0),tag,tagl;
+	do{
+		res+=node.substr(lastposition,j-lastposition-1);
+		tagl=taglength(node,j);
+		char rc(node[j-1]);
+		if(rc=='+')
+			tag=stoi(node.substr(j,tagl));
+		else
+			tag=stoi(reversecompletment(node.substr(j,tagl)));
+		lastposition=j+tagl;
+		tagfile->seekg((*tagsposition)[tag].first,ios_base::beg);
+		string sequence(readn(tagfile,(*tagsposition)[tag].second));
+		res+=(rc=='+') ? sequence : reversecompletment(sequence);
+	}
+	while(!notag(node,lastposition,&j));
+	c.prof.leave();
+	return res+node.substr(lastposition);
+}
+
+//Give a unitig to the caller, and index its k-mers
+void deliver(compaction& c, const string& unitig){
+	if(!c.options.indexfile.empty())
+		c.index.add(unitig,c.nbunitigs);
+	c.nbunitigs++;
+	c.output(unitig);
+}
+
+//A unitig is finished: give it to the caller, or keep it for the reconnection pass of the cleaning
+void emit(compaction& c, const string& unitig){
+	if(c.options.clean.tiplength>0){
+		ofstream out(c.ws.path(WORKSPACE_OUTPUT),ios::app);
+		out<<unitig<<";"<<endl;
+	}
+	else
+		deliver(c,unitig);
 }
 
 //Decide where to put a node
-void goodplace(const string& node, int leftmin, int rightmin, const string& bucketname,vector<pair<int64_t,int64_t>>* tagsposition,ifstream* tagfile,const int m,const string& nameout){
-	int nb(pow(4,m)),prefixnumber(stoi(bucketname)/nb+1);
+void goodplace(compaction& c, const string& node, int leftmin, int rightmin, const string& suffix, const string& bucketname,vector<pair<int64_t,int64_t>>* tagsposition,ifstream* tagfile){
+	int nb(pow(4,c.m)),prefixnumber(stoi(bucketname)/nb+1);
 	long long mini(minbutbiggerthan(leftmin, rightmin, bucketname));
 	if(mini==-1)
-		putorwrite( nameout, node, leftmin, rightmin, tagsposition,tagfile,nameout);
+		emit(c,expand(c,node,tagsposition,tagfile));
 	else{
 		long long minipre(mini/nb);
 		string miniprefix('z'+to_string(minipre));
-		putorwrite( ((minipre >= prefixnumber) ?  miniprefix: to_string(mini)), node, leftmin, rightmin, tagsposition,tagfile,nameout);
+		putorwrite(c, ((minipre >= prefixnumber) ?  miniprefix: to_string(mini)), node, suffix, tagsposition,tagfile);
 	}
 }
 
 
 
 //Compact a bucket and put the nodes on the right place
-void compactbucket(const int& prefix,const int& suffix,const int k,const char *nameout,const int m){
-	int64_t buffsize(k),postags(0),length,nb(pow(4,m));
+void compactbucket(compaction& c, const int& prefix,const int& suffix){
+	const int k(c.options.k);
+	const cleaning& params(c.options.clean);
+	int64_t buffsize(k),postags(0),length,nb(pow(4,c.m));
 	long long tagnumber(0),numberbucket(prefix*nb+suffix);
 	string fullname(to_string(numberbucket)),node,tag,end;
-	auto count(countbucket(fullname));
+	if(c.ws.size(fullname)==0)
+		return;
+	auto count(countbucket(c,fullname));
 	if(count.size()==0)	{
-		remove((".bcalmtmp/"+fullname).c_str());
+		c.ws.forget(fullname);
 		return;
 	}
+	if(c.prof.enabled)
+		c.prof.buckets.add(numberbucket,c.ws.size(fullname),count.size());
 
-    // keep largest bucket seen
-    if (count.size() > nb_elts_in_largest_bucket)
+    // keep largest bucket seen, disregarding small ones
+    if (c.options.keeplargestbucket && count.size() > c.largestbucket)
     {
-        nb_elts_in_largest_bucket = count.size();
-	    system(("cp .bcalmtmp/" + fullname + " largest_bucket.dot").c_str());
+        c.largestbucket = count.size();
+	    ifstream bucket(c.ws.path(fullname));
+	    ofstream largest("largest_bucket.dot",ios::trunc);
+	    largest<<bucket.rdbuf();
     }
 
-	ifstream in(".bcalmtmp/"+fullname);
-	ofstream tagfile(".bcalmtmp/tags"),out(".bcalmtmp/"+(string)nameout,ios_base::app);
+	ifstream in(c.ws.path(fullname));
+	ofstream tagfile(c.ws.path("tags"));
 	graph g(k);
 	vector<pair<int64_t,int64_t>> tagsposition;
 
     // add nodes to graph
-	if(in && tagfile && out){
+	if(in && tagfile){
 		for(auto it=count.begin();it!=count.end();it++){
 			length=*it;
-			if(length-(MINIMIZER_STR_SIZE*2)<=2*buffsize){
+			if(length-RECORD_SUFFIX_SIZE<=2*buffsize){
 				node=readn(&in,length+1);
-				g.addvertex(node.substr(0,length-(MINIMIZER_STR_SIZE*2)));
+				g.addvertex(node.substr(0,length-RECORD_SUFFIX_SIZE));
+				g.abundances.back()=stoull(node.substr(length-RECORD_SUFFIX_SIZE,ABUNDANCE_STR_SIZE));
+				g.endflags.back()=string2endflags(node[length-RECORD_SUFFIX_SIZE+ABUNDANCE_STR_SIZE]);
                 g.addleftmin(stoi(node.substr(length-(MINIMIZER_STR_SIZE*2),MINIMIZER_STR_SIZE)));
                 g.addrightmin(stoi(node.substr(length-MINIMIZER_STR_SIZE,MINIMIZER_STR_SIZE)));
 			}
@@ -379,12 +539,15 @@ void compactbucket(const int& prefix,const int& suffix,const int k,const char *n
 				tag=to_string(tagnumber);
 				node+="+"+tag+"+";
 				tagnumber++;
-				copylm(&in,length-(MINIMIZER_STR_SIZE*2)-2*buffsize,&tagfile);
-				tagsposition.push_back(make_pair(postags,length-(MINIMIZER_STR_SIZE*2)-2*buffsize));
-				postags+=length-(MINIMIZER_STR_SIZE*2)-2*buffsize;
+				copylm(&in,length-RECORD_SUFFIX_SIZE-2*buffsize,&tagfile);
+				tagsposition.push_back(make_pair(postags,length-RECORD_SUFFIX_SIZE-2*buffsize));
+				postags+=length-RECORD_SUFFIX_SIZE-2*buffsize;
 				end=readn(&in,buffsize);
 				node+=end.substr(0,buffsize);
 				g.addvertex(node);
+				g.kmers.back()=length-RECORD_SUFFIX_SIZE-k+1;
+				g.abundances.back()=stoull(readn(&in,ABUNDANCE_STR_SIZE));
+				g.endflags.back()=string2endflags(readn(&in,1)[0]);
                 g.addleftmin(stoi(readn(&in,MINIMIZER_STR_SIZE)));
                 g.addrightmin(stoi(readn(&in,MINIMIZER_STR_SIZE)));
                 readn(&in,1); // the ';'
@@ -393,11 +556,20 @@ void compactbucket(const int& prefix,const int& suffix,const int k,const char *n
 		tagfile.close();
 	}
 
-	remove((".bcalmtmp/"+fullname).c_str());
+	c.ws.forget(fullname);
 	g.debruijn();
 
 	g.compressh(stoi(fullname));
-	ifstream fichiertagin(".bcalmtmp/tags");
+	if(params.tiplength>0){
+		g.markends(stoi(fullname),params.ratio);
+		uint64_t removed(g.clean(stoi(fullname),params,&c.junctions));
+		if(removed>0){
+			c.removed+=removed;
+			g.compressh(stoi(fullname));
+			g.markends(stoi(fullname),params.ratio);
+		}
+	}
+	ifstream fichiertagin(c.ws.path("tags"));
     int node_index = 0;
     
 	for(auto it(g.nodes.begin());it!=g.nodes.end();it++)
@@ -406,40 +578,141 @@ void compactbucket(const int& prefix,const int& suffix,const int k,const char *n
         {
             int leftmin = g.leftmins[node_index];
             int rightmin = g.rightmins[node_index];
-			goodplace(*it, leftmin, rightmin,fullname,&tagsposition,&fichiertagin,m,nameout);
+			string record(recordsuffix(g.abundances[node_index],g.endflags[node_index],leftmin,rightmin));
+			goodplace(c,*it, leftmin, rightmin,record,fullname,&tagsposition,&fichiertagin);
         }
         node_index++;
     }
 
-	remove(".bcalmtmp/tags");
-	return;
+	remove(c.ws.path("tags").c_str());
 }
 
-//Create a file with the nodes of the compacted graph
-void createoutfile(const char *namein,const char *nameout,const int k,const int m){
-	auto start=chrono::system_clock::now();
-	HashMap hm(build_hash_map(2*m));
-	int64_t nbsuperbucket(pow(4,m)),sys(0);
-	mkdir(".bcalmtmp",0777);
-	sys+=system("rm -rf .bcalmtmp/*");
-	remove(nameout);
-
-    // create the hash function
-    init_m_mers_table(2*m);
-    sortentry(namein,k,m, false, true);
-    create_hash_function_from_m_mers(2*m);
-
-	sortentry(namein,k,m);
+//Second pass of the cleaning: compact again the unitigs that were next to a removed node,
+//at an end that was resolved in an earlier bucket; only these unitigs are loaded,
+//then all the unitigs are given to the caller
+void reconnect(compaction& c){
+	const int k(c.options.k);
+	unordered_set<string> ends;
+	for(auto it=c.junctions.begin();it!=c.junctions.end();it++)
+		ends.insert(min(*it,reversecompletment(*it)));
+	ifstream in(c.ws.path(WORKSPACE_OUTPUT));
+	graph g(k);
+	string line;
+	while(getline(in,line)){
+		if(line.size()<=(uint64_t)k)
+			continue;
+		string node(line.substr(0,line.size()-1)),left(node.substr(0,k-1)),right(node.substr(node.size()-k+1));
+		if(ends.count(min(left,reversecompletment(left))) || ends.count(min(right,reversecompletment(right)))){
+			g.addvertex(node);
+			g.addleftmin(-1);
+			g.addrightmin(-1);
+		}
+		else
+			deliver(c,node);
+	}
+	in.close();
+	g.debruijn();
+	g.compress();
+	for(uint64_t i(1);i<g.n;i++)
+		if(!g.nodes[i].empty())
+			deliver(c,g.nodes[i]);
+	if(!c.junctions.empty())
+		cout<<g.n-1<<" unitigs reconnected after cleaning"<<endl;
+}
+
+//Fresh state for a compaction, false if k is too low or the scratch directories cannot be created
+bool initcompaction(compaction& c, const bcalmoptions& options, const unitigcallback& output){
+	c.options=options;
+	c.m=options.minimizersize/2;
+	c.output=output;
+	c.removed=0;
+	c.largestbucket=10000;
+	c.nbunitigs=0;
+	if(options.k<=2*c.m){
+		cerr<<"k too low"<<endl;
+		return false;
+	}
+	if(!c.ws.init(options.scratchdirs,c.m))
+		return false;
+	c.index.init(&c.ws,options.k);
+	c.prof.enabled=!options.profilefile.empty();
+	return true;
+}
+
+//Compact the superbuckets filled by sortentry, then finish the cleaning and the index
+bool compactbuckets(compaction& c){
+	int64_t nbsuperbucket(pow(4,c.m));
 	for(long long i(0);i<nbsuperbucket;i++){
-		createbucket(to_string(i),m);
-		for(int j(0);j<pow(4,m);j++)
-			compactbucket(i,j,k,nameout,m);
+		c.prof.enter(PHASE_BUCKETS);
+		createbucket(c,to_string(i));
+		c.prof.leave();
+		for(int j(0);j<pow(4,c.m);j++){
+			if(c.ws.size(to_string(i*nbsuperbucket+j))==0)
+				continue;
+			c.prof.enter(PHASE_COMPACTION);
+			compactbucket(c,i,j);
+			c.prof.leave();
+		}
+	}
+	if(c.options.clean.tiplength>0){
+		cout<<c.removed<<" tips and low coverage unitigs removed"<<endl;
+		c.prof.enter(PHASE_RECONNECTION);
+		reconnect(c);
+		c.prof.leave();
+	}
+	bool ok(true);
+	if(!c.options.indexfile.empty()){
+		c.prof.enter(PHASE_INDEX);
+		ok=c.index.build(c.options.indexfile,c.options.nb_threads);
+		c.prof.leave();
+	}
+	c.ws.clear();
+	if(c.prof.enabled){
+		c.prof.print();
+		ok=c.prof.write(c.options.profilefile) && ok;
 	}
-	sys+=system(("mv .bcalmtmp/"+(string)nameout+" "+(string)nameout).c_str());
-	if(sys!=0)
-		cerr<<"system call failed"<<endl;
+	return ok;
+}
+
+//Compact a set of k-mers, each unitig is given to output as soon as it is finished
+bool compactkmers(kmersource& input, const bcalmoptions& options, const unitigcallback& output){
+	auto start=chrono::system_clock::now();
+	compaction c;
+	if(!initcompaction(c,options,output))
+		return false;
+	sortentry(c,input);
+	bool ok(compactbuckets(c));
 	 auto end=chrono::system_clock::now();
 	 auto waitedFor=end-start;
 	 cout<<"Last for "<<chrono::duration_cast<chrono::seconds>(waitedFor).count()<<" seconds"<<endl;
+	return ok;
+}
+
+//Compact the k-mers of a file, one unitig per line in the output file
+bool compactfile(const string& namein, const string& nameout, const bcalmoptions& options){
+	InputDot ind;
+	ind.init_input(namein,options.k);
+	ofstream out(nameout,ios::trunc);
+	if(!out){
+		cerr<<"Cannot write "<<nameout<<endl;
+		return false;
+	}
+	return compactkmers(ind,options,[&out](const string& unitig){
+		out<<unitig<<";"<<endl;
+	});
 }
 
+//Create a file with the nodes of the compacted graph
+void createoutfile(const char *namein,const char *nameout,const int k,const int m,const int nb_threads,const uint64_t sample_size,const vector<string>& scratchdirs,const cleaning& params,const string& indexfile,const string& profilefile){
+	bcalmoptions options;
+	options.k=k;
+	options.minimizersize=2*m;
+	options.nb_threads=nb_threads;
+	options.sample_size=sample_size;
+	options.scratchdirs=scratchdirs;
+	options.clean=params;
+	options.keeplargestbucket=true;
+	options.indexfile=indexfile;
+	options.profilefile=profilefile;
+	compactfile(namein,nameout,options);
+}
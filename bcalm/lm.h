@@ -1,11 +1,38 @@
 #ifndef LM
 #define LM
 #include "ograph.h"
+#include "workspace.h"
+#include "bcalm.h"
 
 using namespace std;
 
-void createoutfile(const char *namein,const char *nameout,const int k,const int m);
+// state of one compaction, passed to each step of the algorithm
+struct compaction
+{
+	bcalmoptions options;
+	int m;	// 4^m superbuckets of 4^m buckets
+	workspace ws;
+	vector<uint32_t> order;	// rank of each m-mer in the minimizer order
+	unitigcallback output;
+	vector<string> junctions;	// ends of removed nodes, resolved in an earlier bucket
+	uint64_t removed;
+	uint64_t largestbucket;
+	uint64_t nbunitigs;
+	unitigindexbuilder index;
+	profiler prof;
+};
 
-void sortentry(string namefile, const int k, const int m, bool create_buckets = true, bool m_mer_count = false);
+void createoutfile(const char *namein,const char *nameout,const int k,const int m,const int nb_threads = 1,const uint64_t sample_size = DEFAULT_SAMPLE_SIZE,const vector<string>& scratchdirs = vector<string>(),const cleaning& params = cleaning(),const string& indexfile = "",const string& profilefile = "");
+
+bool initcompaction(compaction& c, const bcalmoptions& options, const unitigcallback& output);
+
+void sortentry(compaction& c, kmersource& input);
+
+bool compactbuckets(compaction& c);
+
+// pieces of the bucket pipeline used by the merge of compacted graphs
+string recordsuffix(uint64_t abundance, unsigned char endflags, int leftmin, int rightmin);
+double bucketbalance(const vector<uint64_t>& sizes, const string& what);
+void deliver(compaction& c, const string& unitig);
 
 #endif
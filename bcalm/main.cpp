@@ -7,9 +7,11 @@
 #include <unordered_map>
 #include <algorithm>
 #include <cmath>
+#include <thread>
 #include "lm.h"
 #include "ograph.h"
 #include "debug.h"
+#include "verify.h"
 
 using namespace std;
 
@@ -53,15 +55,77 @@ void test()
 
 
 
+// compaction of the k-mers of input, or merge of the graphs with them
+void run(const string& input, const string& output, int k, int m, const vector<string>& scratchdirs, const cleaning& params, const string& indexfile, const string& profilefile, const vector<string>& graphs)
+{
+	if(graphs.empty()){
+		createoutfile(input.c_str(),output.c_str(),k,m,thread::hardware_concurrency(),DEFAULT_SAMPLE_SIZE,scratchdirs,params,indexfile,profilefile);
+		return;
+	}
+	bcalmoptions options(k);
+	options.minimizersize=2*m;
+	options.nb_threads=thread::hardware_concurrency();
+	options.scratchdirs=scratchdirs;
+	options.clean=params;
+	options.indexfile=indexfile;
+	options.profilefile=profilefile;
+	mergefiles(graphs,(input=="-") ? "" : input,output,options);
+}
+
 int main(int argc, char ** argv)
 {
 	int sys(0);
+	// graph cleaning options may appear anywhere, the other arguments are positional
+	cleaning params;
+	string indexfile,profilefile,verifyfile;
+	vector<string> graphs;
+	int kforced(0);
+	vector<char*> positional;
+	for(int i(0);i<argc;i++){
+		string arg(argv[i]);
+		if(arg=="-tips" && i+1<argc)
+			params.tiplength=atoi(argv[++i]);
+		else if(arg=="-abundance" && i+1<argc)
+			params.minabundance=atof(argv[++i]);
+		else if(arg=="-ratio" && i+1<argc)
+			params.ratio=atof(argv[++i]);
+		else if(arg=="-index" && i+1<argc)
+			indexfile=argv[++i];
+		else if(arg=="-profile" && i+1<argc)
+			profilefile=argv[++i];
+		else if(arg=="-merge" && i+1<argc)
+			graphs=splitdirs(argv[++i]);
+		else if(arg=="-verify" && i+1<argc)
+			verifyfile=argv[++i];
+		else if(arg=="-k" && i+1<argc)
+			kforced=atoi(argv[++i]);
+		else
+			positional.push_back(argv[i]);
+	}
+	argc=positional.size();
+	argv=positional.data();
 	if(argc==1)
 	{
-        printf("usage: <input> [output.dot] [minimizer length]\n");
+        printf("usage: <input> [output.dot] [minimizer length] [scratch directories, comma separated]\n");
+        printf("options: -tips <length in k-mers> [-abundance <min mean abundance>] [-ratio <min ratio to neighbours>]\n");
+        printf("         -index <file>: also write an index of the positions of the k-mers in the unitigs\n");
+        printf("         -profile <file>: write the time, I/O and memory of each phase and the bucket sizes as JSON\n");
+        printf("         -merge <compacted graphs, comma separated>: merge these graphs with the k-mers of <input>, '-' for none\n");
+        printf("         -verify <compacted graph>: only check that the graph is the compaction of <input>\n");
+        printf("         -k <k>: k-mer size, when it cannot be read from the input\n");
         printf("Note: default behavior (minimizer length = 10) requires that you type 'ulimit -n 1100' in your shell prior to running bcalm, else the software will crash\n");
         exit(1);
 	}
+	if(!verifyfile.empty())
+	{
+		string input(argv[1]);
+		int k(kforced>0 ? kforced : detectk(input));
+		verifyreport report;
+		if(!verifygraph(input,verifyfile,k,thread::hardware_concurrency(),(argc>2) ? splitdirs(argv[2]) : vector<string>(),&report))
+			return 1;
+		report.print();
+		return report.ok() ? 0 : 1;
+	}
 	if(argc==2)
 	{
 		string input(argv[1]);
@@ -69,12 +133,12 @@ int main(int argc, char ** argv)
 		int m(5);
 		if(testulimit(1100))
 		{
-			int k(detectk(input));
+			int k(kforced>0 ? kforced : detectk(input));
 			if(k<=2*m){
 				cout<<"k too low"<<endl;
 			}
 			else{
-			createoutfile(input.c_str(),output.c_str(),k,m);
+			run(input,output,k,m,vector<string>(),params,indexfile,profilefile,graphs);
 			}
 		}else{
 		cout<<"ulimit too low"<<endl;
@@ -87,30 +151,33 @@ int main(int argc, char ** argv)
 		int m(5);
 		if(testulimit(1100))
 		{
-			int k(detectk(input));
+			int k(kforced>0 ? kforced : detectk(input));
 			if(k<=2*m){
 				cout<<"k too low"<<endl;
 			}
 			else{
-			createoutfile(input.c_str(),output.c_str(),k,m);
+			run(input,output,k,m,vector<string>(),params,indexfile,profilefile,graphs);
 			}
 		}else{
 		cout<<"ulimit too low"<<endl;
 		}
 	}
-	if(argc==4)
+	if(argc==4 || argc==5)
 	{
 		string input(argv[1]);
 		string output(argv[2]);
 		int m(atoi(argv[3])/2);
+		vector<string> scratchdirs;
+		if(argc==5)
+			scratchdirs=splitdirs(argv[4]);
 		if(testulimit(pow(4,m)+50))
 		{
-			int k(detectk(input));
+			int k(kforced>0 ? kforced : detectk(input));
 			if(k<=2*m){
 				cout<<"k too low"<<endl;
 			}
 			else{
-			createoutfile(input.c_str(),output.c_str(),k,m);
+			run(input,output,k,m,scratchdirs,params,indexfile,profilefile,graphs);
 			}
 		}else{
 		cout<<"ulimit too low"<<endl;
@@ -0,0 +1,360 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cctype>
+
+#include "lm.h"
+
+/*
+ * Merge of compacted graphs, and of new k-mers, without going back to the k-mers:
+ * identical unitigs are kept once, and only the unitigs that can be joined to another one,
+ * or that share k-mers with another one, go through the buckets again
+ */
+
+using namespace std;
+
+// one record for each (k-1)-mer between two k-mers of a unitig, or at one of its ends
+struct junctionrecord
+{
+	uint64_t key;	// canonical (k-1)-mer
+	uint64_t unitig;
+	uint32_t position;	// rank of the k-mer after the junction in the unitig
+	unsigned char leftbase;	// nucleotide added before the canonical (k-1)-mer to get the k-mer on that side, NO_BASE if none
+	unsigned char rightbase;	// nucleotide added after it
+	unsigned char flags;
+};
+
+#define NO_BASE 4
+// the canonical (k-1)-mer is read forward in the unitig
+#define JUNCTION_FORWARD 1
+// the k-mer before, or after, the junction is deduplicated with this record:
+// each k-mer is seen at the junction that is the suffix of its canonical form
+#define JUNCTION_OWNS_BEFORE 2
+#define JUNCTION_OWNS_AFTER 4
+// (k-1)-mer equal to its reverse complement, the two sides cannot be told apart
+#define JUNCTION_PALINDROME 8
+
+// what has to be done to a unitig, at a junction or at a k-mer
+struct mergeevent
+{
+	uint64_t unitig;
+	uint32_t position;
+	uint32_t type;
+
+	bool operator<(const mergeevent& e) const {
+		if(unitig!=e.unitig)
+			return unitig<e.unitig;
+		if(position!=e.position)
+			return position<e.position;
+		return type<e.type;
+	}
+};
+
+#define EVENT_CUT 0	// the junction inside the unitig is now a branching
+#define EVENT_OPEN 1	// the end of the unitig can now be joined to another unitig
+#define EVENT_DROP 2	// the k-mer is kept in another unitig
+
+static inline uint64_t junctionpartition(uint64_t key, uint64_t nb){
+	return ((key * 0x9e3779b97f4a7c15ULL) >> 32) % nb;
+}
+
+// exact below 33 nucleotides, hashed above like the keys of the graph
+static uint64_t junctionkey(const string& canonical){
+	if(canonical.size()<=32)
+		return stringtoint(canonical);
+	return kmerkey(canonical);
+}
+
+// a unitig read from one of the inputs, in its canonical orientation, sent to the partition of its hash
+static void distribute(const string& unitig, ofstream *out, uint64_t nb){
+	string canonical(min(unitig,reversecompletment(unitig)));
+	out[kmerkey(canonical)%nb]<<canonical<<'\n';
+}
+
+// k-mers taken every stride k-mers, to estimate the minimizer order
+static void samplekmers(const string& unitig, const int k, uint64_t stride, uint64_t *seen, vector<string> *sample){
+	uint64_t nk(unitig.size()-k+1);
+	for(uint64_t i((stride-*seen%stride)%stride);i<nk;i+=stride)
+		sample->push_back(unitig.substr(i,k));
+	*seen+=nk;
+}
+
+//Put the unitigs of the graphs and the new k-mers in partitions where identical unitigs meet
+static uint64_t readgraphs(compaction& c, const vector<string>& graphs, kmersource *newkmers, uint64_t nbpartitions, vector<string> *sample){
+	const int k(c.options.k);
+	vector<ofstream> out(nbpartitions);
+	for(uint64_t i(0);i<nbpartitions;i++)
+		out[i].open(c.ws.path("merge"+to_string((long long)i)));
+	uint64_t total(0),read(0),seen(0);
+	for(auto it=graphs.begin();it!=graphs.end();it++){
+		ifstream in(*it);
+		in.seekg(0,ios_base::end);
+		if(in)
+			total+=in.tellg();
+	}
+	uint64_t stride(max((uint64_t)1,total/max((uint64_t)1,c.options.sample_size)));
+	for(auto it=graphs.begin();it!=graphs.end();it++){
+		ifstream in(*it);
+		if(!in){
+			cerr<<"Cannot read "<<*it<<endl;
+			continue;
+		}
+		string line;
+		while(getline(in,line)){
+			while(!line.empty() && (line.back()==';' || isspace(line.back())))
+				line.pop_back();
+			if(line.size()<(uint64_t)k)
+				continue;
+			samplekmers(line,k,stride,&seen,sample);
+			distribute(line,out.data(),nbpartitions);
+			read++;
+		}
+	}
+	if(newkmers!=NULL){
+		vector<string> newsample(newkmers->sample(c.options.sample_size,k));
+		sample->insert(sample->end(),newsample.begin(),newsample.end());
+		for(string kmer(newkmers->next_input(k));kmer!="";kmer=newkmers->next_input(k)){
+			distribute(kmer,out.data(),nbpartitions);
+			read++;
+		}
+	}
+	return read;
+}
+
+//The records of all the junctions of a unitig
+static void addjunctions(const string& unitig, uint64_t id, const int k, ofstream *out, uint64_t nb){
+	string rc(reversecompletment(unitig));
+	uint64_t length(unitig.size()),nk(length-k+1);
+	vector<bool> forward(nk);
+	for(uint64_t i(0);i<nk;i++)
+		forward[i]=(unitig.compare(i,k,rc,length-i-k,k)<=0);
+	for(uint64_t j(0);j<=nk;j++){
+		junctionrecord r;
+		r.unitig=id;
+		r.position=j;
+		r.flags=0;
+		int cmp(unitig.compare(j,k-1,rc,length-j-k+1,k-1));
+		unsigned char before((j>0) ? chartoint(unitig[j-1]) : NO_BASE), after((j<nk) ? chartoint(unitig[j+k-1]) : NO_BASE);
+		if(cmp<=0){
+			r.key=junctionkey(unitig.substr(j,k-1));
+			r.flags|=JUNCTION_FORWARD;
+			r.leftbase=before;
+			r.rightbase=after;
+		}
+		else{
+			r.key=junctionkey(rc.substr(length-j-k+1,k-1));
+			r.leftbase=(after==NO_BASE) ? NO_BASE : 3-after;
+			r.rightbase=(before==NO_BASE) ? NO_BASE : 3-before;
+		}
+		if(cmp==0)
+			r.flags|=JUNCTION_PALINDROME;
+		if(j>0 && forward[j-1])
+			r.flags|=JUNCTION_OWNS_BEFORE;
+		if(j<nk && !forward[j])
+			r.flags|=JUNCTION_OWNS_AFTER;
+		out[junctionpartition(r.key,nb)].write((const char*)&r,sizeof(r));
+	}
+}
+
+//Keep each unitig once, numbered in the order of the distinct file, and write its junctions
+static uint64_t deduplicate(compaction& c, uint64_t nbpartitions){
+	vector<ofstream> out(nbpartitions);
+	for(uint64_t i(0);i<nbpartitions;i++)
+		out[i].open(c.ws.path("junctions"+to_string((long long)i)),ios::binary);
+	ofstream distinct(c.ws.path("distinct"));
+	uint64_t id(0);
+	for(uint64_t p(0);p<nbpartitions;p++){
+		string name(c.ws.path("merge"+to_string((long long)p)));
+		unordered_set<string> seen;
+		ifstream in(name);
+		string line;
+		while(getline(in,line))
+			if(seen.insert(line).second){
+				distinct<<line<<'\n';
+				addjunctions(line,id++,c.options.k,out.data(),nbpartitions);
+			}
+		in.close();
+		remove(name.c_str());
+	}
+	return id;
+}
+
+//Decide, for all the unitigs around one (k-1)-mer, where they are cut, which ends are open and which k-mers are dropped
+static void resolve(const junctionrecord *first, const junctionrecord *last, vector<mergeevent> *events){
+	unsigned char leftset(0),rightset(0);
+	bool palindrome(false);
+	for(const junctionrecord *r(first);r!=last;r++){
+		if(r->leftbase!=NO_BASE)
+			leftset|=1<<r->leftbase;
+		if(r->rightbase!=NO_BASE)
+			rightset|=1<<r->rightbase;
+		palindrome|=(r->flags & JUNCTION_PALINDROME)!=0;
+	}
+	// exactly one k-mer on each side: the k-mers around can be compacted together
+	bool simple(!palindrome && __builtin_popcount(leftset)==1 && __builtin_popcount(rightset)==1);
+	// records are sorted by unitig, the first occurrence of a k-mer is kept
+	bool kept[8]={false,false,false,false,false,false,false,false};
+	for(const junctionrecord *r(first);r!=last;r++){
+		bool forward(r->flags & JUNCTION_FORWARD);
+		unsigned char beforebase(forward ? r->leftbase : r->rightbase), afterbase(forward ? r->rightbase : r->leftbase);
+		bool before(beforebase!=NO_BASE), after(afterbase!=NO_BASE);
+		if(before && after && !simple)
+			events->push_back({r->unitig,r->position,EVENT_CUT});
+		if(before!=after && simple)
+			events->push_back({r->unitig,r->position,EVENT_OPEN});
+		if(r->flags & JUNCTION_OWNS_BEFORE){
+			int kmer((forward ? 0 : 4)+beforebase);
+			if(kept[kmer])
+				events->push_back({r->unitig,r->position-1,EVENT_DROP});
+			kept[kmer]=true;
+		}
+		if(r->flags & JUNCTION_OWNS_AFTER){
+			int kmer((forward ? 4 : 0)+afterbase);
+			if(kept[kmer])
+				events->push_back({r->unitig,r->position,EVENT_DROP});
+			kept[kmer]=true;
+		}
+	}
+}
+
+//Group the records of each partition by (k-1)-mer; only the exceptions are kept in memory,
+//there are few of them when the graphs are mostly the same
+static vector<mergeevent> junctionevents(compaction& c, uint64_t nbpartitions){
+	vector<mergeevent> events;
+	for(uint64_t p(0);p<nbpartitions;p++){
+		string name(c.ws.path("junctions"+to_string((long long)p)));
+		ifstream in(name,ios::binary);
+		in.seekg(0,ios_base::end);
+		vector<junctionrecord> records(in ? (uint64_t)in.tellg()/sizeof(junctionrecord) : 0);
+		in.seekg(0,ios::beg);
+		in.read((char*)records.data(),records.size()*sizeof(junctionrecord));
+		in.close();
+		remove(name.c_str());
+		sort(records.begin(),records.end(),[](const junctionrecord& a, const junctionrecord& b){
+			if(a.key!=b.key)
+				return a.key<b.key;
+			if(a.unitig!=b.unitig)
+				return a.unitig<b.unitig;
+			return a.position<b.position;
+		});
+		for(uint64_t i(0),j(0);i<records.size();i=j){
+			for(j=i+1;j<records.size() && records[j].key==records[i].key;j++);
+			resolve(records.data()+i,records.data()+j,&events);
+		}
+	}
+	sort(events.begin(),events.end());
+	return events;
+}
+
+//Cut the unitigs according to the events: pieces with no open end are finished,
+//the others are put in the superbuckets with -1 as minimizer of their closed ends
+static void cutunitigs(compaction& c, const vector<mergeevent>& events, uint64_t *passed, uint64_t *pieces){
+	const int k(c.options.k), m(c.m);
+	int numbersuperbucket(pow(4,m));
+	vector<ofstream> out(numbersuperbucket);
+	for(long long i(0);i<numbersuperbucket;i++)
+		out[i].open(c.ws.path("z"+to_string(i)),ofstream::app);
+	vector<uint64_t> sizes(numbersuperbucket,0);
+	ifstream in(c.ws.path("distinct"));
+	auto e(events.begin());
+	string unitig;
+	for(uint64_t id(0);getline(in,unitig);id++){
+		uint64_t nk(unitig.size()-k+1),start(0);
+		vector<bool> cut(nk+1,false),drop(nk,false),open(nk+1,false);
+		for(;e!=events.end() && e->unitig==id;e++){
+			if(e->type==EVENT_CUT)
+				cut[e->position]=true;
+			else if(e->type==EVENT_OPEN)
+				open[e->position]=true;
+			else
+				drop[e->position]=true;
+		}
+		auto piece=[&](uint64_t a, uint64_t b){
+			string node(unitig.substr(a,b-a+k-1));
+			bool leftopen((a==0) ? open[0] : !cut[a]), rightopen((b==nk) ? open[nk] : !cut[b]);
+			if(!leftopen && !rightopen){
+				deliver(c,node);
+				(*passed)++;
+				return;
+			}
+			int leftmin(leftopen ? minimiserrc(node.substr(0,k-1),2*m,c.order) : -1);
+			int rightmin(rightopen ? minimiserrc(node.substr(node.size()-k+1),2*m,c.order) : -1);
+			int mini((leftmin==-1) ? rightmin : (rightmin==-1) ? leftmin : min(leftmin,rightmin));
+			uint64_t h(mini/numbersuperbucket);
+			sizes[h]+=b-a;
+			out[h]<<node<<recordsuffix(b-a,0,leftmin,rightmin)<<";";
+			(*pieces)++;
+		};
+		for(uint64_t i(0);i<nk;i++){
+			if(i>start && cut[i]){
+				piece(start,i);
+				start=i;
+			}
+			if(drop[i]){
+				if(i>start)
+					piece(start,i);
+				start=i+1;
+			}
+		}
+		if(nk>start)
+			piece(start,nk);
+	}
+	in.close();
+	remove(c.ws.path("distinct").c_str());
+	for(long long i(0);i<numbersuperbucket;i++)
+		c.ws.record("z"+to_string(i),out[i].tellp());
+	bucketbalance(sizes,"superbuckets");
+}
+
+//Merge compacted graphs and new k-mers
+bool mergegraphs(const vector<string>& graphs, kmersource* newkmers, const bcalmoptions& options, const unitigcallback& output){
+	auto start=chrono::system_clock::now();
+	compaction c;
+	bcalmoptions noclean(options);
+	if(options.clean.tiplength>0){
+		cerr<<"Warning: the graphs are merged without cleaning"<<endl;
+		noclean.clean.tiplength=0;
+	}
+	if(!initcompaction(c,noclean,output))
+		return false;
+	uint64_t nbpartitions(pow(4,c.m)),passed(0),pieces(0);
+	vector<string> sample;
+	c.prof.enter(PHASE_MERGE);
+	uint64_t read(readgraphs(c,graphs,newkmers,nbpartitions,&sample));
+	c.prof.enter(PHASE_COUNTING);
+	c.order=create_hash_function_from_m_mers(count_m_mers_sample(sample,2*c.m,c.options.k,c.options.nb_threads),2*c.m);
+	sample.clear();
+	c.prof.leave();
+	uint64_t distinct(deduplicate(c,nbpartitions));
+	vector<mergeevent> events(junctionevents(c,nbpartitions));
+	c.prof.enter(PHASE_DISTRIBUTION);
+	cutunitigs(c,events,&passed,&pieces);
+	c.prof.leave();
+	c.prof.leave();
+	cout<<read<<" unitigs and k-mers read, "<<distinct<<" distinct, "<<passed<<" passed through, "<<pieces<<" pieces compacted again"<<endl;
+	bool ok(compactbuckets(c));
+	 auto end=chrono::system_clock::now();
+	 auto waitedFor=end-start;
+	 cout<<"Last for "<<chrono::duration_cast<chrono::seconds>(waitedFor).count()<<" seconds"<<endl;
+	return ok;
+}
+
+//Merge compacted graph files and the k-mers of a file, one unitig per line in the output file
+bool mergefiles(const vector<string>& graphs, const string& newkmers, const string& nameout, const bcalmoptions& options){
+	InputDot ind;
+	if(!newkmers.empty())
+		ind.init_input(newkmers,options.k);
+	ofstream out(nameout,ios::trunc);
+	if(!out){
+		cerr<<"Cannot write "<<nameout<<endl;
+		return false;
+	}
+	return mergegraphs(graphs,newkmers.empty() ? NULL : &ind,options,[&out](const string& unitig){
+		out<<unitig<<";"<<endl;
+	});
+}
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <thread>
 
 /*
  * constructs the compressed dBG from a list of arbitrary sequences
@@ -82,51 +83,59 @@ string inverse_shash(int num, int len){
 	return s;
 }
 
-uint32_t *m_mer_counts;
-
-void init_m_mers_table(int m)
-{
-    m_mer_counts = new uint32_t[(int)pow(4,m)];
-    //printf("Allocating %d MB for m-mers\n",(((int)pow(4,m)*sizeof(uint32_t))/1024)/1024);
-    for (int i = 0; i < (int)pow(4,m); i++)
-        m_mer_counts[i] = 0;
-}
-
-void count_m_mers(string str, int m, int k)
+void count_m_mers(const string& str, int m, int k, uint32_t *counts)
 {
     int previous_shash = -1;
 	for(int i(0) ;i < k-m+1 ; i+=1){
-        m_mer_counts[shash(str, previous_shash, i, m)] ++;
+        counts[shash(str, previous_shash, i, m)] ++;
     }
 }
 
-uint32_t *best_possible_hash_function;
-
-void create_hash_function_from_m_mers(int m)
+// count the m-mers of a sample of k-mers, each thread fills its own table, tables are summed at the end
+vector<uint32_t> count_m_mers_sample(const vector<string>& sample, int m, int k, int nb_threads)
 {
     int rg = pow(4,m);
-    vector<pair<int, int> > counts;
-    for (int i(0); i < rg; i++)
+    if (nb_threads < 1)
+        nb_threads = 1;
+    vector<vector<uint32_t>> tables(nb_threads, vector<uint32_t>(rg, 0));
+    vector<thread> threads;
+    uint64_t chunk = (sample.size() + nb_threads - 1) / nb_threads;
+    for (int t = 0; t < nb_threads; t++)
     {
-        if (m_mer_counts[i] > 0)
-            counts.push_back(make_pair(m_mer_counts[i],i));
+        threads.push_back(thread([&, t](){
+            uint64_t end = min((uint64_t)sample.size(), (t + 1) * chunk);
+            for (uint64_t i = t * chunk; i < end; i++)
+                count_m_mers(sample[i], m, k, tables[t].data());
+        }));
     }
+    for (auto &th : threads)
+        th.join();
+    for (int t = 1; t < nb_threads; t++)
+        for (int i = 0; i < rg; i++)
+            tables[0][i] += tables[t][i];
+    return tables[0];
+}
+
+// rank m-mers by increasing frequency; m-mers absent from the sample get the lowest ranks,
+// so that every m-mer has a distinct value and no bucket collects all the unseen ones
+vector<uint32_t> create_hash_function_from_m_mers(const vector<uint32_t>& m_mer_counts, int m)
+{
+    int rg = pow(4,m);
+    vector<pair<uint32_t, int> > counts;
+    for (int i(0); i < rg; i++)
+        counts.push_back(make_pair(m_mer_counts[i],i));
 
     printf("Sorting m-mer counts\n");
     sort(counts.begin(),counts.end());
 
-    cout<< counts[counts.size()-1].first << " " << inverse_shash(counts[counts.size()-1].second,m) <<endl;
-    cout<< counts[counts.size()-2].first << " " << inverse_shash(counts[counts.size()-2].second,m) <<endl;
-    cout<< counts[counts.size()-3].first << " " << inverse_shash(counts[counts.size()-3].second,m) <<endl;
+    for (int i = 1; i <= 3 && i <= rg; i++)
+        cout<< counts[rg-i].first << " " << inverse_shash(counts[rg-i].second,m) <<endl;
 
-    delete[] m_mer_counts; // fixme: restore this
-    best_possible_hash_function = new uint32_t[rg];
+    vector<uint32_t> best_possible_hash_function(rg, 0);
 
-    for (int i = 0; i < rg ; i++)
-        best_possible_hash_function[i] = 0;
-
-    for (unsigned int i = 0; i < counts.size(); i++)
+    for (int i = 0; i < rg; i++)
         best_possible_hash_function[counts[i].second] =  i;
+    return best_possible_hash_function;
 }
 
 // not needed anymore
@@ -144,17 +153,17 @@ HashMap build_hash_map(int len){
 
 
 
-int getash(const string& s, int& previous_shash, int start_pos = 0, int length = -1){
+int getash(const vector<uint32_t>& order, const string& s, int& previous_shash, int start_pos = 0, int length = -1){
 	//return ((*hm)[s]); // slow
     //return shash(s, start_pos, length);
-    return best_possible_hash_function[shash(s, previous_shash, start_pos, length)];
+    return order[shash(s, previous_shash, start_pos, length)];
 }
 
-int minimiserv(const string &node,const int &minimisersize){
+int minimiserv(const string &node,const int &minimisersize,const vector<uint32_t>& order){
     int previous_shash = -1;
-	int minimiser_value(getash(node, previous_shash, 0, minimisersize)),vsub;
+	int minimiser_value(getash(order, node, previous_shash, 0, minimisersize)),vsub;
 	for(uint64_t i(1);i<node.size()-minimisersize+1;i++){
-		vsub=getash(node, previous_shash,i,minimisersize);
+		vsub=getash(order, node, previous_shash,i,minimisersize);
 		if( minimiser_value > vsub){
 			minimiser_value = vsub;
 		}
@@ -162,14 +171,14 @@ int minimiserv(const string &node,const int &minimisersize){
     return(minimiser_value);
 }
 
-int minimiserrc(const string &node,const int &minimisersize){
+int minimiserrc(const string &node,const int &minimisersize,const vector<uint32_t>& order){
 	int h1, h2;
-	h1 = minimiserv(node,minimisersize);
-	h2 = minimiserv(reversecompletment(node),minimisersize);
+	h1 = minimiserv(node,minimisersize,order);
+	h2 = minimiserv(reversecompletment(node),minimisersize,order);
     return (h1 > h2) ? h2 : h1;
 }
 
-int minimiserrc_openmp(const string &node,const int &minimisersize){
+int minimiserrc_openmp(const string &node,const int &minimisersize,const vector<uint32_t>& order){
 	string nodes[2];
 	int resHash[2];
 
@@ -178,7 +187,7 @@ int minimiserrc_openmp(const string &node,const int &minimisersize){
 
 	//~ #pragma omp parallel for
 	for (int i=0; i<2; i++){
-		resHash[i] = minimiserv(nodes[i],minimisersize);
+		resHash[i] = minimiserv(nodes[i],minimisersize,order);
 	}
 
 	if(resHash[0] < resHash[1]){
@@ -290,6 +299,9 @@ uint64_t stringtointc(const string& str){
 void graph::addvertex(string str){
 	n++;
 	nodes.push_back(str);
+	kmers.push_back(str.size()>=(uint64_t)k ? str.size()-k+1 : 1);
+	abundances.push_back(kmers.back());
+	endflags.push_back(0);
 	uint64_t i(nodes.size()-1);
 	uint64_t key(getkey(str));
 	uint64_t keyrc(getkeyrevc(str));
@@ -395,6 +407,14 @@ uint64_t graph::becompacted(uint64_t nodeindice, int min, unsigned char *type){
 	return 0;
 }
 
+static inline unsigned char leftflags(unsigned char flags){
+	return flags & (DEAD_LEFT | WEAK_LEFT);
+}
+
+static inline unsigned char rightflags(unsigned char flags){
+	return flags & (DEAD_RIGHT | WEAK_RIGHT);
+}
+
 void graph::reverse(int64_t with){
 	string newnode(nodes[with]);
 	int64_t indice,type;
@@ -404,6 +424,7 @@ void graph::reverse(int64_t with){
         int temp = leftmins[with];
         leftmins[with] = rightmins[with];
         rightmins[with] = temp;
+        endflags[with] = (leftflags(endflags[with]) << 1) | (rightflags(endflags[with]) >> 1);
 
 		for(auto i(0);i<8;i++){
 			indice=neighbor[with].list[i].first;
@@ -448,6 +469,8 @@ void graph::compact(uint64_t nodeindice,uint64_t with, unsigned char c){
 	if(nodeindice==with || node.empty() || son.empty())
 		return;
 	unsigned char type;
+	abundances[with] += abundances[nodeindice];
+	kmers[with] += kmers[nodeindice];
 	switch(c){
 		case 1:
 		newnode=node+son.substr(k-1);
@@ -456,6 +479,7 @@ void graph::compact(uint64_t nodeindice,uint64_t with, unsigned char c){
 
         leftmins[with] = leftmins[nodeindice];
         //rightmins[with] = rightmins[with];
+        endflags[with] = rightflags(endflags[with]) | leftflags(endflags[nodeindice]);
 
 		for(int  i(0);i<8;i++){
 			indice=neighbor[nodeindice].list[i].first;
@@ -482,6 +506,7 @@ void graph::compact(uint64_t nodeindice,uint64_t with, unsigned char c){
 
         rightmins[with] = leftmins[with];
         leftmins[with] = leftmins[nodeindice];
+        endflags[with] = (leftflags(endflags[with]) << 1) | leftflags(endflags[nodeindice]);
 
 		for(auto i(0);i<8;i++){
 			indice=neighbor[with].list[i].first;
@@ -519,6 +544,7 @@ void graph::compact(uint64_t nodeindice,uint64_t with, unsigned char c){
 
         leftmins[with] = rightmins[nodeindice];
         //rightmins[with] = rightmins[with];
+        endflags[with] = rightflags(endflags[with]) | (rightflags(endflags[nodeindice]) >> 1);
 
 
 		neighbor[with].removep(nodeindice,3);
@@ -545,6 +571,7 @@ void graph::compact(uint64_t nodeindice,uint64_t with, unsigned char c){
 
         // leftmins[with] = leftmins[with];
         rightmins[with] = rightmins[nodeindice];
+        endflags[with] = leftflags(endflags[with]) | rightflags(endflags[nodeindice]);
 
 		for(auto i(0);i<8;i++){
 			indice=neighbor[nodeindice].list[i].first;
@@ -589,6 +616,88 @@ void graph::compress(){
 
 
 
+//Flag the ends whose minimizer is the one of the bucket: all their neighbours are in the bucket,
+//so they are known to be dead ends or to be much less covered than a neighbour
+void graph::markends(int min, double ratio){
+	for(uint64_t nodeindice(1);nodeindice<n;nodeindice++){
+		if(nodes[nodeindice].empty())
+			continue;
+		double left(-1), right(-1);
+		if(min==-1 || leftmins[nodeindice]==min)
+			left=0;
+		if(min==-1 || rightmins[nodeindice]==min)
+			right=0;
+		for(int i(0);i<8;i++){
+			uint64_t indice(neighbor[nodeindice].list[i].first);
+			unsigned char type(neighbor[nodeindice].list[i].second);
+			if(indice==0)
+				continue;
+			if((type==1 || type==2) && right>=0)
+				right=max(right,meanabundance(indice));
+			if((type==3 || type==4) && left>=0)
+				left=max(left,meanabundance(indice));
+		}
+		double mean(meanabundance(nodeindice));
+		if(left==0)
+			endflags[nodeindice] |= DEAD_LEFT;
+		if(left>0 && mean<ratio*left)
+			endflags[nodeindice] |= WEAK_LEFT;
+		if(right==0)
+			endflags[nodeindice] |= DEAD_RIGHT;
+		if(right>0 && mean<ratio*right)
+			endflags[nodeindice] |= WEAK_RIGHT;
+	}
+}
+
+double graph::meanabundance(uint64_t nodeindice){
+	return (double)abundances[nodeindice]/kmers[nodeindice];
+}
+
+void graph::removenode(uint64_t nodeindice){
+	for(int i(0);i<8;i++){
+		uint64_t indice(neighbor[nodeindice].list[i].first);
+		if(indice!=0)
+			neighbor[indice].remove(nodeindice);
+	}
+	neighbor[nodeindice]=neighbour();
+	nodes[nodeindice]="";
+}
+
+//Remove short dead ends and short low coverage branches among the nodes that leave the bucket for the output
+//ends whose neighbours were in a previous bucket are added to junctions, they are reconnected by a later pass
+uint64_t graph::clean(int min, const cleaning& params, vector<string> *junctions){
+	uint64_t removed(0);
+	vector<uint64_t> toremove;
+	for(uint64_t nodeindice(1);nodeindice<n;nodeindice++){
+		if(nodes[nodeindice].empty() || kmers[nodeindice]>=params.tiplength)
+			continue;
+		if(min!=-1 && (leftmins[nodeindice]>min || rightmins[nodeindice]>min))
+			continue;
+		unsigned char flags(endflags[nodeindice]);
+		bool leftdead(flags & DEAD_LEFT), rightdead(flags & DEAD_RIGHT), weak(flags & (WEAK_LEFT | WEAK_RIGHT));
+		bool remove(false);
+		if(leftdead && rightdead)
+			remove=(meanabundance(nodeindice)<params.minabundance);
+		else if(leftdead || rightdead)
+			remove=(meanabundance(nodeindice)<params.minabundance || weak);
+		else
+			remove=weak;
+		if(!remove)
+			continue;
+		toremove.push_back(nodeindice);
+		const string& node(nodes[nodeindice]);
+		if(!leftdead && min!=-1 && leftmins[nodeindice]!=min)
+			junctions->push_back(node.substr(0,k-1));
+		if(!rightdead && min!=-1 && rightmins[nodeindice]!=min)
+			junctions->push_back(node.substr(node.size()-k+1));
+	}
+	for(auto it=toremove.begin();it!=toremove.end();it++){
+		removenode(*it);
+		removed++;
+	}
+	return removed;
+}
+
 //import graph from file
 void graph::importg(const char *name){
 	cout<<"importg"<<endl;
@@ -11,9 +11,9 @@
 
 using namespace std;
 
-void create_hash_function_from_m_mers(int m);
-void count_m_mers(string str, int m, int k);
-void init_m_mers_table(int m);
+vector<uint32_t> create_hash_function_from_m_mers(const vector<uint32_t>& m_mer_counts, int m);
+void count_m_mers(const string& str, int m, int k, uint32_t *counts);
+vector<uint32_t> count_m_mers_sample(const vector<string>& sample, int m, int k, int nb_threads);
 
 typedef unordered_map<string,int> HashMap;
 
@@ -23,7 +23,7 @@ int shash(const string& s, int& previous_shash, unsigned int start_pos = 0, int
 
 string inverse_shash (int num, int len);
 
-int minimiserrc(const string &node,const int &minimisersize);
+int minimiserrc(const string &node,const int &minimisersize,const vector<uint32_t>& order);
 
 int minbutbiggerthan(int leftmin, int rightmin, const string &namebucket);
 
@@ -34,6 +34,7 @@ bool adjacent (const string& node1,const  string& node2,int k);
 string readn(ifstream *file,uint64_t n);
 
 int chartoint(char c);
+uint64_t stringtoint(const string& str);
 
 string minimalsub(const string &w, const int &p,const int &k);
 
@@ -58,6 +59,23 @@ class neighbour
 
 };
 
+// thresholds of the graph cleaning, which is disabled when tiplength is 0
+struct cleaning
+{
+	uint64_t tiplength;	// only unitigs with less k-mers than this are removed
+	double minabundance;	// dead ends and isolated unitigs with a lower mean abundance are removed
+	double ratio;	// unitigs with a mean abundance under ratio times the one of a neighbour are removed
+
+	cleaning(uint64_t t = 0, double a = 2, double r = 0.1) : tiplength(t), minabundance(a), ratio(r) {}
+};
+
+// bits of graph::endflags, set when an end of a node is known to have no neighbour,
+// or a neighbour with a mean abundance above 1/ratio times the one of the node
+#define DEAD_LEFT 1
+#define DEAD_RIGHT 2
+#define WEAK_LEFT 4
+#define WEAK_RIGHT 8
+
 class graph
 {
 	public:
@@ -66,6 +84,9 @@ class graph
 		vector<string> nodes;
 		vector<int> leftmins;
 		vector<int> rightmins;
+		vector<uint64_t> abundances;	// sum of the abundances of the k-mers of each node
+		vector<uint64_t> kmers;	// number of k-mers of each node
+		vector<unsigned char> endflags;
 		unordered_multimap<uint64_t,uint64_t> map;
 		unordered_multimap<uint64_t,uint64_t> maprev;
 		vector<neighbour> neighbor;
@@ -77,6 +98,9 @@ class graph
 			nodes.push_back("");
 			leftmins.push_back(-1);
 			rightmins.push_back(-1);
+			abundances.push_back(0);
+			kmers.push_back(1);
+			endflags.push_back(0);
 		}
 
 		uint64_t getkey(string str);
@@ -89,6 +113,10 @@ class graph
 		void debruijn();
 		void compressh(int min=-1);
 		void compress();
+		void markends(int min, double ratio);
+		double meanabundance(uint64_t nodeindice);
+		void removenode(uint64_t nodeindice);
+		uint64_t clean(int min, const cleaning& params, vector<string> *junctions);
 		void importg(const char *name);
 		void print(const char *name);
 		void printedges(const char *name);
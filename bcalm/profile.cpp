@@ -0,0 +1,153 @@
+#include <iostream>
+#include <fstream>
+#include <sys/resource.h>
+
+#include "profile.h"
+
+/*
+ * Per phase profiling of a compaction
+ */
+
+using namespace std;
+
+static const char *phasenames[NB_PHASES]={"m-mer counting","distribution","bucket creation","compaction","tag resolution","reconnection","index","merge"};
+
+// bytes given to read and write calls by the process so far, 0 when /proc is not available
+static void iocounters(uint64_t *read, uint64_t *written){
+	*read=0;
+	*written=0;
+	ifstream in("/proc/self/io");
+	string name;
+	uint64_t value;
+	while(in>>name>>value){
+		if(name=="rchar:")
+			*read=value;
+		else if(name=="wchar:")
+			*written=value;
+	}
+}
+
+static uint64_t peakrss(){
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF,&usage)!=0)
+		return 0;
+	return usage.ru_maxrss;
+}
+
+static int log2bin(uint64_t x){
+	int res(0);
+	while(x>1){
+		x>>=1;
+		res++;
+	}
+	return res;
+}
+
+void sizehistogram::add(int64_t number, uint64_t nbbytes, uint64_t nbnodes){
+	int b(log2bin(nbbytes)),n(log2bin(nbnodes));
+	if(bytes.size()<=(uint64_t)b)
+		bytes.resize(b+1,0);
+	if(nodes.size()<=(uint64_t)n)
+		nodes.resize(n+1,0);
+	bytes[b]++;
+	nodes[n]++;
+	count++;
+	largestbytes=max(largestbytes,nbbytes);
+	if(nbnodes>largestnodes || largest==-1){
+		largestnodes=nbnodes;
+		largest=number;
+	}
+}
+
+
+
+profiler::profiler() : lastread(0), lastwritten(0), enabled(false){
+	for(int i(0);i<NB_PHASES;i++)
+		phases[i]={0,0,0,0,0};
+}
+
+//give what happened since the last call to the current phase
+void profiler::charge(bool io){
+	auto now(chrono::steady_clock::now());
+	uint64_t read(lastread),written(lastwritten);
+	if(io)
+		iocounters(&read,&written);
+	if(!stack.empty()){
+		phasestats& p(phases[stack.back()]);
+		p.seconds+=chrono::duration<double>(now-last).count();
+		p.bytesread+=read-lastread;
+		p.byteswritten+=written-lastwritten;
+	}
+	last=now;
+	lastread=read;
+	lastwritten=written;
+}
+
+void profiler::enter(int p){
+	if(!enabled)
+		return;
+	charge(p!=PHASE_TAGS);
+	stack.push_back(p);
+	phases[p].calls++;
+}
+
+void profiler::leave(){
+	if(!enabled || stack.empty())
+		return;
+	int p(stack.back());
+	charge(p!=PHASE_TAGS);
+	if(p!=PHASE_TAGS)
+		phases[p].peakrss=peakrss();
+	stack.pop_back();
+}
+
+void profiler::print() const{
+	if(!enabled)
+		return;
+	for(int i(0);i<NB_PHASES;i++)
+		if(phases[i].calls>0){
+			cout<<phasenames[i]<<": "<<phases[i].seconds<<" s";
+			if(i!=PHASE_TAGS)
+				cout<<", "<<phases[i].bytesread<<" bytes read, "<<phases[i].byteswritten<<" bytes written";
+			cout<<endl;
+		}
+	cout<<"peak memory: "<<peakrss()<<" kB"<<endl;
+}
+
+static void writehistogram(ofstream& out, const string& name, const sizehistogram& h, bool last){
+	out<<"  \""<<name<<"\": {\"count\": "<<h.count<<", \"largest_bytes\": "<<h.largestbytes<<", \"largest_nodes\": "<<h.largestnodes<<", \"largest\": "<<h.largest;
+	out<<", \"bytes_log2\": [";
+	for(uint64_t i(0);i<h.bytes.size();i++)
+		out<<(i ? ", " : "")<<h.bytes[i];
+	out<<"], \"nodes_log2\": [";
+	for(uint64_t i(0);i<h.nodes.size();i++)
+		out<<(i ? ", " : "")<<h.nodes[i];
+	out<<"]}"<<(last ? "" : ",")<<endl;
+}
+
+//bin i of a histogram counts the sizes from 2^i to 2^(i+1)-1
+bool profiler::write(const string& name) const{
+	ofstream out(name,ios::trunc);
+	if(!out){
+		cerr<<"Cannot write "<<name<<endl;
+		return false;
+	}
+	out<<"{"<<endl;
+	out<<"  \"peak_rss_kb\": "<<peakrss()<<","<<endl;
+	out<<"  \"phases\": ["<<endl;
+	bool first(true);
+	for(int i(0);i<NB_PHASES;i++){
+		if(phases[i].calls==0)
+			continue;
+		out<<(first ? "" : ",\n")<<"    {\"name\": \""<<phasenames[i]<<"\", \"seconds\": "<<phases[i].seconds<<", \"calls\": "<<phases[i].calls;
+		if(i!=PHASE_TAGS)
+			out<<", \"bytes_read\": "<<phases[i].bytesread<<", \"bytes_written\": "<<phases[i].byteswritten<<", \"peak_rss_kb\": "<<phases[i].peakrss;
+		out<<"}";
+		first=false;
+	}
+	out<<endl<<"  ],"<<endl;
+	writehistogram(out,"superbuckets",superbuckets,false);
+	writehistogram(out,"buckets",buckets,true);
+	out<<"}"<<endl;
+	return true;
+}
@@ -0,0 +1,64 @@
+#ifndef PROFILE
+#define PROFILE
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+/*
+ * Time, bytes read and written and peak memory of each phase of a compaction,
+ * and the distribution of the sizes of the superbuckets and of the buckets, written as JSON
+ */
+
+enum phase {PHASE_COUNTING, PHASE_DISTRIBUTION, PHASE_BUCKETS, PHASE_COMPACTION, PHASE_TAGS, PHASE_RECONNECTION, PHASE_INDEX, PHASE_MERGE, NB_PHASES};
+
+struct phasestats
+{
+	double seconds;
+	uint64_t bytesread;
+	uint64_t byteswritten;
+	uint64_t calls;
+	uint64_t peakrss;	// high-water mark of the resident memory at the end of the phase, in kB
+};
+
+// sizes of the superbuckets or of the buckets, in powers of two
+struct sizehistogram
+{
+	vector<uint64_t> bytes;
+	vector<uint64_t> nodes;
+	uint64_t count;
+	uint64_t largestbytes;
+	uint64_t largestnodes;
+	int64_t largest;	// number of the bucket with the most nodes
+
+	sizehistogram() : count(0), largestbytes(0), largestnodes(0), largest(-1) {}
+	void add(int64_t number, uint64_t nbbytes, uint64_t nbnodes);
+};
+
+// phases can be nested, the time of the inner phase is not counted in the outer one;
+// the bytes are read from /proc/self/io, except for the tag resolution which is too frequent and only timed
+class profiler
+{
+	vector<int> stack;
+	chrono::steady_clock::time_point last;
+	uint64_t lastread, lastwritten;
+
+	void charge(bool io);
+
+	public:
+		bool enabled;
+		phasestats phases[NB_PHASES];
+		sizehistogram superbuckets;
+		sizehistogram buckets;
+
+		profiler();
+		void enter(int p);
+		void leave();
+		void print() const;
+		bool write(const string& name) const;
+};
+
+#endif
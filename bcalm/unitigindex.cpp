@@ -0,0 +1,319 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "unitigindex.h"
+#include "ograph.h"
+
+/*
+ * k-mer to unitig position index, built from the unitigs as they are produced
+ */
+
+using namespace std;
+
+// levels of the minimal perfect hash function, keys left after the last one are stored in a sorted array
+#define INDEX_MAX_LEVELS 32
+// bits per key of each level
+#define INDEX_GAMMA 2
+// 64 bits words per rank sample
+#define INDEX_RANK_WORDS 8
+
+// record of the construction, stored in the partition files of the workspace
+struct indexrecord
+{
+	uint64_t key;
+	uint64_t unitig;
+	uint32_t offset;
+	uint32_t reverse;
+};
+
+static inline uint64_t mix(uint64_t x){
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+static uint64_t hashstring(const string& str){
+	uint64_t h(0xcbf29ce484222325ULL);
+	for(uint64_t i(0);i<str.size();i++){
+		h ^= (unsigned char)str[i];
+		h *= 0x100000001b3ULL;
+	}
+	return mix(h);
+}
+
+static inline uint64_t levelhash(uint64_t key, uint64_t level){
+	return mix(key + (level+1) * 0x9e3779b97f4a7c15ULL);
+}
+
+static inline uint64_t fingerprint(uint64_t key){
+	return key >> 48;
+}
+
+uint64_t kmerkey(const string& kmer){
+	return hashstring(min(kmer,reversecompletment(kmer)));
+}
+
+// number of bits set before position bit
+static inline uint64_t bitrank(const uint64_t *words, const uint64_t *ranks, uint64_t bit){
+	uint64_t word(bit/64), res(ranks[word/INDEX_RANK_WORDS]);
+	for(uint64_t i(word-word%INDEX_RANK_WORDS);i<word;i++)
+		res+=__builtin_popcountll(words[i]);
+	if(bit%64!=0)
+		res+=__builtin_popcountll(words[word] & ((1ULL << (bit%64)) - 1));
+	return res;
+}
+
+
+
+void unitigindexbuilder::init(workspace *w, const int ki){
+	ws=w;
+	k=ki;
+	nb_kmers=0;
+	buffers.assign(INDEX_PARTITIONS,"");
+}
+
+void unitigindexbuilder::flush(uint64_t partition){
+	ofstream out(ws->path("index"+to_string((long long)partition)),ios::app|ios::binary);
+	out<<buffers[partition];
+	buffers[partition].clear();
+}
+
+//positions of all the k-mers of a unitig
+void unitigindexbuilder::add(const string& unitig, uint64_t id){
+	for(uint64_t i(0);i+k<=unitig.size();i++){
+		string kmer(unitig.substr(i,k)),rc(reversecompletment(kmer));
+		indexrecord record;
+		record.reverse=(rc<kmer);
+		record.key=hashstring(record.reverse ? rc : kmer);
+		record.unitig=id;
+		record.offset=i;
+		uint64_t partition(record.key%INDEX_PARTITIONS);
+		buffers[partition].append((const char*)&record,sizeof(record));
+		if(buffers[partition].size()>1000000)
+			flush(partition);
+		nb_kmers++;
+	}
+}
+
+//minimal perfect hash function of the keys of a partition, written as one block of the index
+bool unitigindexbuilder::buildpartition(uint64_t partition){
+	string name("index"+to_string((long long)partition));
+	vector<indexrecord> records;
+	ifstream in(ws->path(name),ios::binary);
+	if(in){
+		in.seekg(0,ios_base::end);
+		records.resize(in.tellg()/sizeof(indexrecord));
+		in.seekg(0,ios::beg);
+		in.read((char*)records.data(),records.size()*sizeof(indexrecord));
+		in.close();
+	}
+	remove(ws->path(name).c_str());
+
+	vector<uint64_t> words, levelstarts(1,0), place(records.size(),(uint64_t)-1), current, next;
+	for(uint64_t i(0);i<records.size();i++)
+		current.push_back(i);
+	for(uint64_t level(0);level<INDEX_MAX_LEVELS && !current.empty();level++){
+		uint64_t nbits(((INDEX_GAMMA*current.size()+63)/64)*64);
+		vector<uint64_t> seen(nbits/64,0), collision(nbits/64,0);
+		for(auto it=current.begin();it!=current.end();it++){
+			uint64_t bit(levelhash(records[*it].key,level)%nbits);
+			if(seen[bit/64] & (1ULL << (bit%64)))
+				collision[bit/64] |= 1ULL << (bit%64);
+			seen[bit/64] |= 1ULL << (bit%64);
+		}
+		next.clear();
+		for(auto it=current.begin();it!=current.end();it++){
+			uint64_t bit(levelhash(records[*it].key,level)%nbits);
+			if(collision[bit/64] & (1ULL << (bit%64)))
+				next.push_back(*it);
+			else
+				place[*it]=levelstarts.back()+bit;
+		}
+		for(uint64_t i(0);i<seen.size();i++)
+			words.push_back(seen[i] & ~collision[i]);
+		levelstarts.push_back(levelstarts.back()+nbits);
+		current.swap(next);
+	}
+	sort(current.begin(),current.end(),[&records](uint64_t a, uint64_t b){ return records[a].key<records[b].key; });
+
+	vector<uint64_t> ranks(words.size()/INDEX_RANK_WORDS+1,0);
+	uint64_t set(0);
+	for(uint64_t i(0);i<words.size();i++){
+		if(i%INDEX_RANK_WORDS==0)
+			ranks[i/INDEX_RANK_WORDS]=set;
+		set+=__builtin_popcountll(words[i]);
+	}
+
+	vector<uint64_t> fallback, entries(2*records.size(),0);
+	for(uint64_t i(0);i<current.size();i++){
+		fallback.push_back(records[current[i]].key);
+		fallback.push_back(set+i);
+	}
+	for(uint64_t i(0);i<records.size();i++){
+		uint64_t slot;
+		if(place[i]!=(uint64_t)-1)
+			slot=bitrank(words.data(),ranks.data(),place[i]);
+		else
+			slot=set+(lower_bound(current.begin(),current.end(),i,[&records](uint64_t a, uint64_t b){ return records[a].key<records[b].key; })-current.begin());
+		entries[2*slot]=records[i].unitig;
+		entries[2*slot+1]=records[i].offset | (fingerprint(records[i].key) << 32) | ((uint64_t)records[i].reverse << 48);
+	}
+	// keys equal to another one share the first fallback slot, fill the others
+	for(uint64_t i(1);i<current.size();i++)
+		if(records[current[i]].key==records[current[i-1]].key){
+			entries[2*(set+i)]=records[current[i]].unitig;
+			entries[2*(set+i)+1]=records[current[i]].offset | (fingerprint(records[current[i]].key) << 32) | ((uint64_t)records[current[i]].reverse << 48);
+		}
+
+	ofstream out(ws->path("indexpart"+to_string((long long)partition)),ios::binary|ios::trunc);
+	uint64_t header[4]={records.size(),levelstarts.size()-1,current.size(),words.size()};
+	out.write((const char*)header,sizeof(header));
+	out.write((const char*)levelstarts.data(),levelstarts.size()*8);
+	out.write((const char*)words.data(),words.size()*8);
+	out.write((const char*)ranks.data(),ranks.size()*8);
+	out.write((const char*)fallback.data(),fallback.size()*8);
+	out.write((const char*)entries.data(),entries.size()*8);
+	return (bool)out;
+}
+
+//build the partitions in parallel then gather them in one file
+bool unitigindexbuilder::build(const string& nameout, int nb_threads){
+	for(uint64_t p(0);p<INDEX_PARTITIONS;p++)
+		flush(p);
+	nb_threads=max(1,nb_threads);
+	vector<thread> threads;
+	vector<char> ok(INDEX_PARTITIONS,0);
+	for(int t(0);t<nb_threads;t++)
+		threads.push_back(thread([&,t](){
+			for(uint64_t p(t);p<INDEX_PARTITIONS;p+=nb_threads)
+				ok[p]=buildpartition(p);
+		}));
+	for(auto it=threads.begin();it!=threads.end();it++)
+		it->join();
+
+	ofstream out(nameout,ios::binary|ios::trunc);
+	char magic[8];
+	memcpy(magic,INDEX_MAGIC,8);
+	uint32_t version(INDEX_VERSION),kmersize(k);
+	uint64_t nb_partitions(INDEX_PARTITIONS);
+	vector<uint64_t> offsets(INDEX_PARTITIONS+1,32+(INDEX_PARTITIONS+1)*8);
+	for(uint64_t p(0);p<INDEX_PARTITIONS;p++){
+		struct stat st;
+		if(!ok[p] || stat(ws->path("indexpart"+to_string((long long)p)).c_str(),&st)!=0){
+			cerr<<"Problem with the index partition "<<p<<endl;
+			return false;
+		}
+		offsets[p+1]=offsets[p]+st.st_size;
+	}
+	out.write(magic,8);
+	out.write((const char*)&version,4);
+	out.write((const char*)&kmersize,4);
+	out.write((const char*)&nb_partitions,8);
+	out.write((const char*)&nb_kmers,8);
+	out.write((const char*)offsets.data(),offsets.size()*8);
+	for(uint64_t p(0);p<INDEX_PARTITIONS;p++){
+		string name(ws->path("indexpart"+to_string((long long)p)));
+		ifstream in(name,ios::binary);
+		if(in.peek()!=EOF)
+			out<<in.rdbuf();
+		in.close();
+		remove(name.c_str());
+	}
+	cout<<"index of "<<nb_kmers<<" k-mers written to "<<nameout<<endl;
+	return (bool)out;
+}
+
+
+
+bool unitigindex::open(const string& name){
+	close();
+	int fd(::open(name.c_str(),O_RDONLY));
+	if(fd<0)
+		return false;
+	struct stat st;
+	if(fstat(fd,&st)!=0 || st.st_size<32){
+		::close(fd);
+		return false;
+	}
+	size=st.st_size;
+	void *map(mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0));
+	::close(fd);
+	if(map==MAP_FAILED)
+		return false;
+	data=(const char*)map;
+	uint32_t version;
+	memcpy(&version,data+8,4);
+	if(memcmp(data,INDEX_MAGIC,8)!=0 || version!=INDEX_VERSION){
+		cerr<<name<<" is not a bcalm index"<<endl;
+		close();
+		return false;
+	}
+	uint32_t kmersize;
+	memcpy(&kmersize,data+12,4);
+	k=kmersize;
+	memcpy(&nb_partitions,data+16,8);
+	memcpy(&nb_kmers,data+24,8);
+	partitions=(const uint64_t*)(data+32);
+	return true;
+}
+
+void unitigindex::close(){
+	if(data!=NULL)
+		munmap((void*)data,size);
+	data=NULL;
+	size=0;
+}
+
+//false when the k-mer is not in the graph, up to fingerprint collisions
+bool unitigindex::lookup(const string& kmer, unitigposition *position) const{
+	if(data==NULL || kmer.size()!=(uint64_t)k)
+		return false;
+	string rc(reversecompletment(kmer));
+	bool flipped(rc<kmer);
+	uint64_t key(hashstring(flipped ? rc : kmer));
+	const uint64_t *block((const uint64_t*)(data+partitions[key%nb_partitions]));
+	uint64_t nb_keys(block[0]),nb_levels(block[1]),nb_fallback(block[2]),nb_words(block[3]);
+	if(nb_keys==0)
+		return false;
+	const uint64_t *levelstarts(block+4),*words(levelstarts+nb_levels+1),*ranks(words+nb_words);
+	const uint64_t *fallback(ranks+nb_words/INDEX_RANK_WORDS+1),*entries(fallback+2*nb_fallback);
+	uint64_t slot((uint64_t)-1);
+	for(uint64_t level(0);level<nb_levels;level++){
+		uint64_t bit(levelstarts[level]+levelhash(key,level)%(levelstarts[level+1]-levelstarts[level]));
+		if(words[bit/64] & (1ULL << (bit%64))){
+			slot=bitrank(words,ranks,bit);
+			break;
+		}
+	}
+	if(slot==(uint64_t)-1){
+		uint64_t low(0),high(nb_fallback);
+		while(low<high){
+			uint64_t middle((low+high)/2);
+			if(fallback[2*middle]<key)
+				low=middle+1;
+			else
+				high=middle;
+		}
+		if(low==nb_fallback || fallback[2*low]!=key)
+			return false;
+		slot=fallback[2*low+1];
+	}
+	uint64_t info(entries[2*slot+1]);
+	if(((info >> 32) & 0xffff)!=fingerprint(key))
+		return false;
+	position->unitig=entries[2*slot];
+	position->offset=info & 0xffffffff;
+	position->reverse=((info >> 48) & 1) ^ flipped;
+	return true;
+}
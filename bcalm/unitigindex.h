@@ -0,0 +1,71 @@
+#ifndef UNITIGINDEX
+#define UNITIGINDEX
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+#include "workspace.h"
+
+using namespace std;
+
+/*
+ * Index from each k-mer of the compacted graph to its position in the unitigs:
+ * one minimal perfect hash function per partition of the k-mers, and a 16 bits fingerprint per k-mer
+ * to reject most k-mers absent from the graph. The file is read through mmap.
+ */
+
+#define INDEX_MAGIC "BCALMIDX"
+#define INDEX_VERSION 1
+#define INDEX_PARTITIONS 64
+
+// where a k-mer is: reverse when the unitig holds the reverse complement of the k-mer that was looked up
+struct unitigposition
+{
+	uint64_t unitig;	// rank of the unitig in the output, starting at 0
+	uint32_t offset;
+	bool reverse;
+};
+
+// hash of the canonical form of a k-mer, used as key of the index
+uint64_t kmerkey(const string& kmer);
+
+// collects the positions of the k-mers while the unitigs are produced, then builds the index
+class unitigindexbuilder
+{
+	workspace *ws;
+	int k;
+	vector<string> buffers;
+
+	void flush(uint64_t partition);
+	bool buildpartition(uint64_t partition);
+
+	public:
+		uint64_t nb_kmers;
+
+		void init(workspace *w, const int ki);
+		void add(const string& unitig, uint64_t id);
+		bool build(const string& nameout, int nb_threads);
+};
+
+// read only access to an index file
+class unitigindex
+{
+	const char *data;
+	uint64_t size;
+	uint64_t nb_partitions;
+	const uint64_t *partitions;
+
+	public:
+		int k;
+		uint64_t nb_kmers;
+
+		unitigindex() : data(NULL), size(0) {}
+		~unitigindex() { close(); }
+		bool open(const string& name);
+		void close();
+		bool lookup(const string& kmer, unitigposition *position) const;
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+
+#include "verify.h"
+#include "workspace.h"
+#include "unitigindex.h"
+#include "ograph.h"
+
+/*
+ * Scalable check of the output of a compaction
+ */
+
+using namespace std;
+
+// length of the minimizers used to partition the k-mers
+#define VERIFY_MINIMIZER_SIZE 12
+// errors of each kind printed by each thread
+#define VERIFY_EXAMPLES 5
+
+// state of one unitig end, gathered from the partitions of its neighbours
+struct unitigend
+{
+	unsigned char outward;	// k-mers extending the end out of the unitig
+	unsigned char inward;	// k-mers extending the end (k-1)-mer towards the unitig, the last k-mer included
+	uint64_t neighbour;	// unitig of the outward k-mer
+};
+
+static inline uint64_t mix(uint64_t x){
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+static inline int code(char c){
+	switch(c){
+		case 'a': return 0;
+		case 'c': return 1;
+		case 'g': return 2;
+		case 't': return 3;
+		default: return -1;
+	}
+}
+
+static bool valid(const string& seq){
+	for(uint64_t i(0);i<seq.size();i++)
+		if(code(seq[i])<0)
+			return false;
+	return true;
+}
+
+static string unpack(uint64_t word, int w){
+	string res(w,'a');
+	for(int i(w-1);i>=0;i--,word>>=2)
+		res[i]="acgt"[word&3];
+	return res;
+}
+
+// canonical 2 bits encodings of all the words of length w of seq, w <= 32
+static void canonicalwords(const string& seq, int w, vector<uint64_t> *res){
+	res->clear();
+	uint64_t mask((w==32) ? ~0ULL : (1ULL<<(2*w))-1),fw(0),rc(0);
+	for(uint64_t i(0);i<seq.size();i++){
+		uint64_t c(code(seq[i]));
+		fw=((fw<<2)|c)&mask;
+		rc=(rc>>2)|((3-c)<<(2*(w-1)));
+		if(i+1>=(uint64_t)w)
+			res->push_back(min(fw,rc));
+	}
+}
+
+// packed canonical k-mers of a sequence, hashed when k > 32
+static void packkmers(const string& seq, int k, vector<uint64_t> *res){
+	if(k<=32){
+		canonicalwords(seq,k,res);
+		return;
+	}
+	res->clear();
+	for(uint64_t i(0);i+k<=seq.size();i++)
+		res->push_back(kmerkey(seq.substr(i,k)));
+}
+
+// partition of each k-mer of a sequence, from the hash of its smallest m-mer
+static void kmerpartitions(const string& seq, int k, uint64_t nb, vector<uint64_t> *words, vector<uint64_t> *res){
+	int m(min(k,VERIFY_MINIMIZER_SIZE));
+	canonicalwords(seq,m,words);
+	for(auto it=words->begin();it!=words->end();it++)
+		*it=mix(*it);
+	res->clear();
+	// sliding minimum over the k-m+1 m-mers of each k-mer
+	vector<uint64_t> window;
+	uint64_t w(k-m+1),head(0);
+	for(uint64_t i(0);i<words->size();i++){
+		while(window.size()>head && (*words)[window.back()]>=(*words)[i])
+			window.pop_back();
+		window.push_back(i);
+		if(window[head]+w<=i)
+			head++;
+		if(i+1>=w)
+			res->push_back((*words)[window[head]]%nb);
+	}
+}
+
+// cut a sequence into runs of k-mers of the same partition, each run is written with a prefix
+static void distribute(const string& seq, int k, const string& prefix, vector<ofstream>& out, vector<uint64_t> *words, vector<uint64_t> *parts){
+	kmerpartitions(seq,k,out.size(),words,parts);
+	for(uint64_t i(0),j(0);i<parts->size();i=j){
+		for(j=i+1;j<parts->size() && (*parts)[j]==(*parts)[i];j++);
+		out[(*parts)[i]]<<prefix<<seq.substr(i,j-i+k-1)<<'\n';
+	}
+}
+
+// the sequence of a line of a node file, without the ';' and the abundance
+static string sequence(const string& line){
+	uint64_t end(0);
+	while(end<line.size() && line[end]!=';' && line[end]!=' ' && line[end]!='\t')
+		end++;
+	return line.substr(0,end);
+}
+
+//The 16 k-mers around the two ends of a unitig, sent to the partitions where they would be
+static void addqueries(const string& unitig, uint64_t id, int k, vector<ofstream>& out, vector<uint64_t> *words, vector<uint64_t> *parts){
+	for(int end(0);end<2;end++){
+		string y(end ? unitig.substr(unitig.size()-k+1) : unitig.substr(0,k-1));
+		if(y==reversecompletment(y))
+			continue;
+		for(int c(0);c<4;c++){
+			string after(y+"acgt"[c]),before("acgt"[c]+y);
+			// outward: after the right end, before the left end
+			string outward(end ? after : before),inward(end ? before : after);
+			kmerpartitions(outward,k,out.size(),words,parts);
+			out[(*parts)[0]]<<"q "<<id<<" "<<end<<" 1 "<<outward<<'\n';
+			kmerpartitions(inward,k,out.size(),words,parts);
+			out[(*parts)[0]]<<"q "<<id<<" "<<end<<" 0 "<<inward<<'\n';
+		}
+	}
+}
+
+// checks of one partition, results are added to the report under the lock
+struct partitionchecker
+{
+	int k;
+	verifyreport *report;
+	vector<unitigend> *ends;
+	mutex *lock;
+	uint64_t examples[3];
+
+	void example(int kind, const string& what, uint64_t kmer){
+		if(examples[kind]>=VERIFY_EXAMPLES)
+			return;
+		examples[kind]++;
+		cerr<<what<<((k<=32) ? unpack(kmer,k) : "k-mer hashed, k > 32")<<endl;
+	}
+
+	void check(const string& name){
+		vector<uint64_t> input,kmers;
+		vector<pair<uint64_t,uint64_t>> output;
+		struct query { uint64_t kmer, id; int end, outward; };
+		vector<query> queries;
+		ifstream in(name);
+		string line;
+		while(getline(in,line)){
+			if(line.size()<3)
+				continue;
+			if(line[0]=='i'){
+				packkmers(line.substr(2),k,&kmers);
+				input.insert(input.end(),kmers.begin(),kmers.end());
+			}
+			else if(line[0]=='o'){
+				uint64_t space(line.find(' ',2)),id(stoull(line.substr(2,space-2)));
+				packkmers(line.substr(space+1),k,&kmers);
+				for(auto it=kmers.begin();it!=kmers.end();it++)
+					output.push_back(make_pair(*it,id));
+			}
+			else{
+				uint64_t a(line.find(' ',2)),id(stoull(line.substr(2,a-2)));
+				packkmers(line.substr(a+5),k,&kmers);
+				queries.push_back({kmers[0],id,line[a+1]-'0',line[a+3]-'0'});
+			}
+		}
+		in.close();
+		remove(name.c_str());
+
+		sort(input.begin(),input.end());
+		input.erase(unique(input.begin(),input.end()),input.end());
+		sort(output.begin(),output.end());
+		uint64_t missing(0),extra(0),duplicates(0);
+		uint64_t i(0),j(0);
+		while(i<input.size() || j<output.size()){
+			if(j>0 && j<output.size() && output[j].first==output[j-1].first){
+				duplicates++;
+				example(0,"k-mer found twice in the unitigs: ",output[j].first);
+				j++;
+			}
+			else if(j==output.size() || (i<input.size() && input[i]<output[j].first)){
+				missing++;
+				example(1,"k-mer of the input missing from the unitigs: ",input[i]);
+				i++;
+			}
+			else if(i==input.size() || output[j].first<input[i]){
+				extra++;
+				example(2,"k-mer of the unitigs absent from the input: ",output[j].first);
+				j++;
+			}
+			else{
+				i++;
+				j++;
+			}
+		}
+
+		// queries found in the unitigs, with the unitig where they are
+		vector<pair<const query*,uint64_t>> found;
+		for(auto q=queries.begin();q!=queries.end();q++){
+			auto it(lower_bound(output.begin(),output.end(),make_pair(q->kmer,(uint64_t)0)));
+			if(it!=output.end() && it->first==q->kmer)
+				found.push_back(make_pair(&*q,it->second));
+		}
+
+		lock_guard<mutex> guard(*lock);
+		report->inputkmers+=input.size();
+		report->outputkmers+=output.size();
+		report->missing+=missing;
+		report->extra+=extra;
+		report->duplicates+=duplicates;
+		for(auto it=found.begin();it!=found.end();it++){
+			unitigend& e((*ends)[2*it->first->id+it->first->end]);
+			if(it->first->outward){
+				e.outward++;
+				e.neighbour=it->second;
+			}
+			else
+				e.inward++;
+		}
+	}
+};
+
+void verifyreport::print() const{
+	cout<<inputkmers<<" distinct k-mers in the input, "<<outputkmers<<" k-mers in "<<unitigs<<" unitigs"<<endl;
+	cout<<"missing: "<<missing<<", extra: "<<extra<<", duplicated: "<<duplicates<<", ends not maximal: "<<notmaximal<<", invalid lines: "<<invalid<<endl;
+	cout<<(ok() ? "Graph is correct" : "Graph is NOT correct")<<endl;
+}
+
+//Check that the unitigs of output hold exactly the k-mers of input, once each, and cannot be compacted further
+bool verifygraph(const string& input, const string& output, const int k, const int nb_threads, const vector<string>& scratchdirs, verifyreport *report){
+	*report=verifyreport();
+	workspace ws;
+	if(k<2 || !ws.init(scratchdirs,1))
+		return false;
+	ifstream inputfile(input),outputfile(output);
+	if(!inputfile || !outputfile){
+		cerr<<"Cannot read "<<(inputfile ? output : input)<<endl;
+		ws.clear();
+		return false;
+	}
+
+	vector<ofstream> out(VERIFY_PARTITIONS);
+	for(uint64_t p(0);p<out.size();p++)
+		out[p].open(ws.path("v"+to_string((long long)p)));
+	vector<uint64_t> words,parts;
+	string line;
+	while(getline(inputfile,line)){
+		string seq(sequence(line));
+		if(seq.empty())
+			continue;
+		if(seq.size()<(uint64_t)k || !valid(seq)){
+			report->invalid++;
+			continue;
+		}
+		distribute(seq,k,"i ",out,&words,&parts);
+	}
+	while(getline(outputfile,line)){
+		string seq(sequence(line));
+		if(seq.empty())
+			continue;
+		uint64_t id(report->unitigs++);
+		if(seq.size()<(uint64_t)k || !valid(seq)){
+			report->invalid++;
+			continue;
+		}
+		distribute(seq,k,"o "+to_string((unsigned long long)id)+" ",out,&words,&parts);
+		addqueries(seq,id,k,out,&words,&parts);
+	}
+	for(uint64_t p(0);p<out.size();p++)
+		out[p].close();
+
+	vector<unitigend> ends(2*report->unitigs,{0,0,0});
+	mutex lock;
+	atomic<uint64_t> next(0);
+	vector<thread> threads;
+	for(int t(0);t<max(1,nb_threads);t++)
+		threads.push_back(thread([&](){
+			partitionchecker checker{k,report,&ends,&lock,{0,0,0}};
+			for(uint64_t p(next++);p<VERIFY_PARTITIONS;p=next++)
+				checker.check(ws.path("v"+to_string((long long)p)));
+		}));
+	for(auto it=threads.begin();it!=threads.end();it++)
+		it->join();
+
+	// an end is compactable when it has one neighbour, which has no other neighbour on this side
+	for(uint64_t i(0);i<ends.size();i++)
+		if(ends[i].outward==1 && ends[i].inward==1 && ends[i].neighbour!=i/2){
+			if(report->notmaximal<VERIFY_EXAMPLES)
+				cerr<<"unitig "<<i/2<<" can be extended at its "<<((i%2) ? "right" : "left")<<" end with unitig "<<ends[i].neighbour<<endl;
+			report->notmaximal++;
+		}
+	ws.clear();
+	return true;
+}
@@ -0,0 +1,37 @@
+#ifndef VERIFY
+#define VERIFY
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/*
+ * Check of a compacted graph against its input, in bounded memory: the k-mers are packed (hashed above k=32)
+ * and spread over partitions by minimizer, the partitions are checked in parallel
+ */
+
+// number of partitions, each thread holds one partition in memory at a time
+#define VERIFY_PARTITIONS 512
+
+struct verifyreport
+{
+	uint64_t inputkmers;	// distinct k-mers of the input
+	uint64_t outputkmers;	// k-mers of the unitigs, with repetitions
+	uint64_t unitigs;
+	uint64_t missing;	// k-mers of the input absent from the unitigs
+	uint64_t extra;	// k-mers of the unitigs absent from the input
+	uint64_t duplicates;	// k-mers found more than once in the unitigs
+	uint64_t notmaximal;	// unitig ends that could be compacted with another unitig
+	uint64_t invalid;	// lines with other characters than acgt, or shorter than k
+
+	verifyreport() : inputkmers(0), outputkmers(0), unitigs(0), missing(0), extra(0), duplicates(0), notmaximal(0), invalid(0) {}
+	bool ok() const { return missing==0 && extra==0 && duplicates==0 && notmaximal==0 && invalid==0; }
+	void print() const;
+};
+
+// input holds k-mers or nodes ("sequence;" or "sequence abundance;" per line), output one unitig per line
+bool verifygraph(const string& input, const string& output, const int k, const int nb_threads, const vector<string>& scratchdirs, verifyreport *report);
+
+#endif
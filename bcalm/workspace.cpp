@@ -0,0 +1,111 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+#include <cerrno>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "workspace.h"
+
+/*
+ * Scratch directories of a run, so that several runs can share a working directory or a disk
+ */
+
+using namespace std;
+
+// comma separated list of directories
+vector<string> splitdirs(const string& list){
+	vector<string> res;
+	uint64_t lp(0);
+	for(uint64_t i(0);i<=list.size();i++){
+		if(i==list.size() || list[i]==','){
+			if(i>lp)
+				res.push_back(list.substr(lp,i-lp));
+			lp=i+1;
+		}
+	}
+	return res;
+}
+
+static bool isnumber(const string& name, uint64_t start){
+	if(start>=name.size())
+		return false;
+	for(uint64_t i(start);i<name.size();i++)
+		if(name[i]<'0' || name[i]>'9')
+			return false;
+	return true;
+}
+
+//create a private directory for this run under each root
+bool workspace::init(const vector<string>& roots, const int m){
+	vector<string> r(roots);
+	if(r.empty())
+		r.push_back(".");
+	for(auto it=r.begin();it!=r.end();it++){
+		string base(*it+"/.bcalmtmp."+to_string((long long)getpid()));
+		string dir(base);
+		for(int attempt(1);mkdir(dir.c_str(),0777)!=0;attempt++){
+			if(errno!=EEXIST || attempt>1000){
+				cerr<<"Cannot create scratch directory "<<dir<<endl;
+				clear();
+				return false;
+			}
+			dir=base+"."+to_string((long long)attempt);
+		}
+		dirs.push_back(dir);
+	}
+	bucketsizes.assign(pow(4,2*m),0);
+	superbucketsizes.assign(pow(4,m),0);
+	return true;
+}
+
+//where a bucket, a superbucket ('z' prefix) or another scratch file lives
+string workspace::path(const string& name) const{
+	if(isnumber(name,0))
+		return dirs[stoll(name)%dirs.size()]+"/"+name;
+	if(name[0]=='z' && isnumber(name,1))
+		return dirs[stoll(name.substr(1))%dirs.size()]+"/"+name;
+	return dirs[0]+"/"+name;
+}
+
+void workspace::record(const string& name, uint64_t size){
+	if(isnumber(name,0))
+		bucketsizes[stoll(name)]=size;
+	else if(name[0]=='z' && isnumber(name,1))
+		superbucketsizes[stoll(name.substr(1))]=size;
+}
+
+//remove a bucket file and its manifest entry
+void workspace::forget(const string& name){
+	remove(path(name).c_str());
+	record(name,0);
+}
+
+uint64_t workspace::size(const string& name) const{
+	if(isnumber(name,0))
+		return bucketsizes[stoll(name)];
+	if(name[0]=='z' && isnumber(name,1))
+		return superbucketsizes[stoll(name.substr(1))];
+	return 0;
+}
+
+//delete the scratch directories of this run and everything left in them
+void workspace::clear(){
+	for(auto it=dirs.begin();it!=dirs.end();it++){
+		DIR *d(opendir(it->c_str()));
+		if(d){
+			struct dirent *entry;
+			while((entry=readdir(d))!=NULL){
+				string name(entry->d_name);
+				if(name!="." && name!="..")
+					remove((*it+"/"+name).c_str());
+			}
+			closedir(d);
+		}
+		rmdir(it->c_str());
+	}
+	dirs.clear();
+}
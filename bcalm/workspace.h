@@ -0,0 +1,33 @@
+#ifndef WORKSPACE
+#define WORKSPACE
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// unitigs kept in the workspace until the end of the cleaning
+#define WORKSPACE_OUTPUT "compacted"
+
+// scratch files of one run: a private directory under each scratch root,
+// buckets and superbuckets are striped over these directories
+class workspace
+{
+	public:
+		vector<string> dirs;
+		// manifest: size in bytes of every bucket and superbucket written so far
+		vector<uint64_t> bucketsizes;
+		vector<uint64_t> superbucketsizes;
+
+		bool init(const vector<string>& roots, const int m);
+		string path(const string& name) const;
+		void record(const string& name, uint64_t size);
+		void forget(const string& name);
+		uint64_t size(const string& name) const;
+		void clear();
+};
+
+vector<string> splitdirs(const string& list);
+
+#endif